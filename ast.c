@@ -7,18 +7,23 @@
 #include "spl.tab.h"
 
 // Return the file location from an AST
-file_location *ast_file_loc(AST t) {
+file_location ast_file_loc(AST t) {
     return t.generic.file_loc;
 }
 
 // Return the filename from the AST t
 const char *ast_filename(AST t) {
-    return ast_file_loc(t)->filename;
+    return file_location_filename(ast_file_loc(t));
 }
 
 // Return the line number from the AST t
 unsigned int ast_line(AST t) {
-    return ast_file_loc(t)->line;
+    return file_location_line(ast_file_loc(t));
+}
+
+// Return the column number from the AST t
+unsigned int ast_column(AST t) {
+    return file_location_column(ast_file_loc(t));
 }
 
 // Return the type tag of the AST t
@@ -43,12 +48,13 @@ block_t ast_block(token_t begin_tok, const_decls_t const_decls,
 		  stmts_t stmts)
 {
     block_t ret;
-    ret.file_loc = file_location_copy(begin_tok.file_loc);
+    ret.file_loc = begin_tok.file_loc;
     ret.type_tag = block_ast;
     ret.const_decls = const_decls;
     ret.var_decls = var_decls;
     ret.proc_decls = proc_decls;
     ret.stmts = stmts;
+    ret.frame_size = 0;
     return ret;
 }
 
@@ -137,8 +143,7 @@ extern const_def_list_t ast_const_def_list(const_def_list_t const_def_list,
 const_def_t ast_const_def(ident_t ident, number_t number)
 {
     const_def_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
-    assert((ret.file_loc)->filename != NULL);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = const_def_ast;
     ret.next = NULL;
     ret.ident = ident;
@@ -232,6 +237,7 @@ proc_decls_t ast_proc_decls_empty(empty_t empty)
     ret.file_loc = empty.file_loc;
     ret.type_tag = proc_decls_ast;
     ret.proc_decls = NULL;
+    ret.last = NULL;
     return ret;
 }
 
@@ -247,12 +253,12 @@ proc_decls_t ast_proc_decls(proc_decls_t proc_decls,
     }		    
     *p = proc_decl;		
     p->next = NULL;    
-    proc_decl_t *last = ast_last_list_elem(ret.proc_decls);
-    if (last == NULL) {
+    if (ret.last == NULL) {
 	ret.proc_decls = p;
     } else {
-	last->next = p;
+	ret.last->next = p;
     }
+    ret.last = p;
     return ret;
 }
 
@@ -260,16 +266,19 @@ proc_decls_t ast_proc_decls(proc_decls_t proc_decls,
 proc_decl_t ast_proc_decl(ident_t ident, block_t block)
 {
     proc_decl_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = proc_decl_ast;
     ret.next = NULL;
     ret.name = ident.name;
+    ret.idu = NULL;
     block_t *p = (block_t *) malloc(sizeof(block_t));
     if (p == NULL) {
 	bail_with_error("Unable to allocate space for a %s!", "block_t");
     }
     *p = block;
     ret.block = p;
+    ret.body_first = 0;
+    ret.body_end = 0;
     return ret;
 }
 
@@ -285,9 +294,10 @@ print_stmt_t ast_print_stmt(expr_t expr) {
 // Return an AST for a read statement
 read_stmt_t ast_read_stmt(ident_t ident) {
     read_stmt_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = read_stmt_ast;
     ret.name = ident.name;
+    ret.idu = NULL;
     return ret;
 }
 
@@ -371,9 +381,10 @@ block_stmt_t ast_block_stmt(block_t block)
  call_stmt_t ast_call_stmt(ident_t ident)
 {
     call_stmt_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = call_stmt_ast;
     ret.name = ident.name;
+    ret.idu = NULL;
     return ret;
 }
 
@@ -381,10 +392,11 @@ block_stmt_t ast_block_stmt(block_t block)
 assign_stmt_t ast_assign_stmt(ident_t ident, expr_t expr)
 {
     assign_stmt_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = assign_stmt_ast;
     ret.name = ident.name;
     assert(ret.name != NULL);
+    ret.idu = NULL;
     expr_t *p = (expr_t *) malloc(sizeof(expr_t));
     if (p == NULL) {
 	bail_with_error("Unable to allocate space for a %s!", "expr_t");
@@ -399,14 +411,14 @@ assign_stmt_t ast_assign_stmt(ident_t ident, expr_t expr)
 stmts_t ast_stmts_empty(empty_t empty)
 {
     stmts_t ret;
-    ret.file_loc = file_location_copy(empty.file_loc);
+    ret.file_loc = empty.file_loc;
     ret.type_tag = stmts_ast;
     ret.stmts_kind = empty_stmts_e;
     return ret;
 }
 
 // Return an AST for empty found in the given file location
-empty_t ast_empty(file_location *file_loc)
+empty_t ast_empty(file_location file_loc)
 {
     empty_t ret;
     ret.file_loc = file_loc;
@@ -635,7 +647,7 @@ expr_t ast_expr_binary_op(binary_op_expr_t e)
 expr_t ast_expr_signed_expr(token_t sign, expr_t e)
 {
     expr_t ret;
-    ret.file_loc = file_location_copy(sign.file_loc);
+    ret.file_loc = sign.file_loc;
     ret.type_tag = expr_ast;
     switch (sign.code) {
     case minussym:
@@ -662,7 +674,7 @@ expr_t ast_expr_signed_expr(token_t sign, expr_t e)
 expr_t ast_expr_pos_number(token_t sign, number_t number)
 {
     expr_t ret;
-    ret.file_loc = file_location_copy(sign.file_loc);
+    ret.file_loc = sign.file_loc;
     ret.type_tag = expr_ast;
     ret.expr_kind = expr_number;
     ret.data.number = number;
@@ -670,7 +682,7 @@ expr_t ast_expr_pos_number(token_t sign, number_t number)
 }
 
 // Return an AST for the given token
-token_t ast_token(file_location *file_loc, const char *text, int code)
+token_t ast_token(file_location file_loc, const char *text, int code)
 {
     token_t ret;
     ret.file_loc = file_loc;
@@ -684,19 +696,20 @@ token_t ast_token(file_location *file_loc, const char *text, int code)
 number_t ast_number(token_t sgn, word_type value)
 {
     number_t ret;
-    ret.file_loc = file_location_copy(sgn.file_loc);
+    ret.file_loc = sgn.file_loc;
     ret.type_tag = number_ast;
     ret.value = value;
     return ret;
 }
 
 // Return an AST for an identifier
-ident_t ast_ident(file_location *file_loc, const char *name)
+ident_t ast_ident(file_location file_loc, const char *name)
 {
     ident_t ret;
     ret.file_loc = file_loc;
     ret.type_tag = ident_ast;
     ret.name = name;
+    ret.idu = NULL;
     return ret;
 }
 
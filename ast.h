@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "machine_types.h"
 #include "file_location.h"
+#include "id_use.h"
 
 // types of ASTs (type tags)
 typedef enum {
@@ -27,28 +28,29 @@ typedef enum {
 // The generic struct type (generic_t) has the fields that
 // should be in all alternatives for ASTs.
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag; // says what field of the union is active
     void *next; // for lists
 } generic_t;
 
 // empty ::=
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
 } empty_t;
 
 // identifiers
 typedef struct ident_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct ident_s *next; // for lists this is a part of
     const char *name;
+    id_use *idu; // set by scope checking, NULL before that
 } ident_t;
 
 // (possibly signed) numbers
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     word_type value;
@@ -56,7 +58,7 @@ typedef struct {
 
 // tokens as ASTs
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     int code;
@@ -71,7 +73,7 @@ struct expr_s;
 // expr ::= expr arithOp expr
 // arithOp ::= + | - | * | /
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct expr_s *expr1;
     token_t arith_op;
@@ -80,14 +82,14 @@ typedef struct {
 
 // expr ::= - expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct expr_s *expr;
 } negated_expr_t;
     
 // expr ::= expr arithOp expr | ident | number
 typedef struct expr_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_kind_e expr_kind;
     union {
@@ -102,14 +104,14 @@ typedef struct expr_s {
 typedef enum { ck_db, ck_rel } condition_kind_e;
 
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_t dividend;
     expr_t divisor;
 } db_condition_t;
 
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_t expr1;
     token_t rel_op;
@@ -118,7 +120,7 @@ typedef struct {
 
 // condition ::= divisible expr expr | expr relOp expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     condition_kind_e cond_kind;
     union cond_u {
@@ -136,7 +138,7 @@ struct stmt_s;
 
 // stmt-list ::= stmt | stmt-list stmt
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct stmt_s *start;
 } stmt_list_t;
@@ -145,7 +147,7 @@ typedef enum { empty_stmts_e, stmt_list_e } stmts_kind_e;
 
 // stmts ::= { stmts }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     stmts_kind_e stmts_kind;
     stmt_list_t stmt_list; // when stmts_kind != empty_stmts_e
@@ -153,17 +155,19 @@ typedef struct {
 
 // stmt ::= ident := expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
+    id_use *idu; // set by scope checking, NULL before that
     struct expr_s *expr;
 } assign_stmt_t;
 
 // stmt ::= call ident
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
+    id_use *idu; // set by scope checking, NULL before that
 } call_stmt_t;
 
 // forward declaration for block type
@@ -171,14 +175,14 @@ struct block_s;
 
 // block-stmt ::= block
 typedef struct block_stmt_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct block_s *block;
 } block_stmt_t;
 
 // if-stmt ::= if condition stmts stmts | if condition stmts
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     condition_t condition;
     stmts_t *then_stmts;
@@ -187,7 +191,7 @@ typedef struct {
 
 // stmt ::= while condition stmt
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     condition_t condition;
     stmts_t *body;
@@ -195,14 +199,15 @@ typedef struct {
 
 // stmt ::= read ident
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
+    id_use *idu; // set by scope checking, NULL before that
 } read_stmt_t;
 
 // stmt ::= print expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_t expr;
 } print_stmt_t;
@@ -210,7 +215,7 @@ typedef struct {
 // stmt ::= assign-stmt | call-stmt | if-stmt
 //        | while-stmt | read-stmt | print-stmt | block-stmt
 typedef struct stmt_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct stmt_s *next; // for lists this is a part of
     stmt_kind_e stmt_kind;
@@ -227,30 +232,36 @@ typedef struct stmt_s {
 
 // procDecl ::= proc ident block
 typedef struct proc_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct proc_decl_s *next; // for lists
     const char *name;
-    struct block_s *block;
+    id_use *idu; // set by scope checking, NULL before that
+    struct block_s *block;   // NULL if the body was skipped (see parser.h),
+    unsigned int body_first; // and then it is made of the lexer's tokens
+    unsigned int body_end;   // from body_first up to (not including) body_end
+                             // (none, if it had syntax errors)
 } proc_decl_t;
 
 // proc-decls ::= { proc-decl }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     proc_decl_t *proc_decls;
+    proc_decl_t *last; // the last of them, while they are being parsed
+                       // (so that appending one takes constant time)
 } proc_decls_t;
 
 // ident-list ::= ident | ident-list ident
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     ident_t *start;
 } ident_list_t;
 
 // var-decl ::= var ident-list
 typedef struct var_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct var_decl_s *next; // for lists this is a part of
     ident_list_t ident_list;
@@ -258,14 +269,14 @@ typedef struct var_decl_s {
 
 // var-decls ::= { var-decl }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     var_decl_t *var_decls;
 } var_decls_t;
 
 // const-def ::= ident number
 typedef struct const_def_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct const_def_s *next; // for lists this is a part of
     ident_t ident;
@@ -274,14 +285,14 @@ typedef struct const_def_s {
 
 // const-def-list ::= { const-def }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const_def_t *start;
 } const_def_list_t;
 
 // const-decl ::= const const-def-list
 typedef struct const_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct const_decl_s *next; // for lists this is a part of
     const_def_list_t const_def_list;
@@ -289,19 +300,22 @@ typedef struct const_decl_s {
 
 // const-decls ::= { const-decl }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const_decl_t *start;
 } const_decls_t;
 
 // block ::= begin const-decls var-decls proc-decls stmts
 typedef struct block_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const_decls_t const_decls;
     var_decls_t var_decls;
     proc_decls_t proc_decls;
     stmts_t stmts;
+    // the number of constants and variables it declares
+    // (the size of its frame, set by scope checking)
+    unsigned int frame_size;
 } block_t;
 
 // program ::= block
@@ -341,7 +355,7 @@ typedef union AST_u {
 } AST;
 
 // Return the file location from an AST
-extern file_location *ast_file_loc(AST t);
+extern file_location ast_file_loc(AST t);
 
 // Return the filename from the AST t
 extern const char *ast_filename(AST t);
@@ -349,6 +363,9 @@ extern const char *ast_filename(AST t);
 // Return the line number from the AST t
 extern unsigned int ast_line(AST t);
 
+// Return the column number from the AST t
+extern unsigned int ast_column(AST t);
+
 // Return the type tag of the AST t
 extern AST_type ast_type_tag(AST t);
 
@@ -409,7 +426,7 @@ extern proc_decl_t ast_proc_decl(ident_t ident, block_t block);
 extern stmts_t ast_stmts_empty(empty_t empty);
 
 // Return an AST for empty found in the given file location
-extern empty_t ast_empty(file_location *file_loc);
+extern empty_t ast_empty(file_location file_loc);
 
 // Return an AST for the list of statements 
 extern stmts_t ast_stmts(stmt_list_t stmt_list);
@@ -501,11 +518,11 @@ extern expr_t ast_expr_signed_expr(token_t sign, expr_t expr);
 // The following are made by the lexer...
 
 // Return an AST for the given token
-extern token_t ast_token(file_location *file_loc, const char *text, int code);
+extern token_t ast_token(file_location file_loc, const char *text, int code);
 
 // Return an AST for an identifier
 // found in the file named fn, on line ln, with the given name.
-extern ident_t ast_ident(file_location *file_loc, const char *name);
+extern ident_t ast_ident(file_location file_loc, const char *name);
 
 // Some operations on AST lists
 
@@ -0,0 +1,557 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ast_binary.h"
+#include "parser.h"
+#include "utilities.h"
+
+// Depends on the sizes of the pointers and of the AST's nodes
+#define AST_BINARY_LAYOUT ((uint32_t) ((sizeof(void *) << 16) | sizeof(AST)))
+
+// Alignment of each node in the file (which is mapped at a page boundary)
+#define AST_BINARY_ALIGN 16
+
+// The start of each file (the offsets are from the start of the file)
+typedef struct {
+    char magic[8];            // AST_BINARY_MAGIC
+    uint32_t version;         // AST_BINARY_VERSION
+    uint32_t layout;          // AST_BINARY_LAYOUT
+    uint32_t size;            // of the whole file, in bytes
+    uint32_t root;            // offset of the program's block_t
+    uint32_t filename;        // offset of the source file's name
+    uint32_t base;            // the source file's first location then
+    uint32_t line_starts;     // offset of the source file's line starts
+    uint32_t num_lines;
+    uint32_t ptr_relocs;      // offset of the offsets of pointer fields
+    uint32_t num_ptr_relocs;
+    uint32_t loc_relocs;      // offset of the offsets of file_location fields
+    uint32_t num_loc_relocs;
+} ast_binary_header;
+
+// A node copied into the image, whose fields still have to be fixed
+typedef struct {
+    size_t offset;
+    AST_type type;
+} pending_node;
+
+// A file being built in memory
+typedef struct {
+    char *bytes;
+    size_t size;
+    size_t capacity;
+    uint32_t *ptr_relocs;
+    size_t num_ptr_relocs;
+    size_t ptr_relocs_capacity;
+    uint32_t *loc_relocs;
+    size_t num_loc_relocs;
+    size_t loc_relocs_capacity;
+    pending_node *pending;
+    size_t num_pending;
+    size_t pending_capacity;
+} image_t;
+
+// Make sure that the array *elems (with *capacity elements of elem_size
+// bytes each) has room for count elements
+static void reserve(void **elems, size_t *capacity, size_t count,
+		    size_t elem_size)
+{
+    if (count <= *capacity) {
+	return;
+    }
+    size_t cap = (*capacity == 0) ? 1024 : *capacity;
+    while (cap < count) {
+	cap *= 2;
+    }
+    *elems = realloc(*elems, cap * elem_size);
+    if (*elems == NULL) {
+	bail_with_error("No space for writing an AST file!");
+    }
+    *capacity = cap;
+}
+
+// Append size bytes from data (zeros if data is NULL) to img,
+// at the next aligned offset, and return that offset
+static size_t image_append(image_t *img, const void *data, size_t size)
+{
+    size_t off = (img->size + AST_BINARY_ALIGN - 1)
+	& ~(size_t) (AST_BINARY_ALIGN - 1);
+    reserve((void **) &img->bytes, &img->capacity, off + size, 1);
+    memset(img->bytes + img->size, 0, off - img->size);
+    if (data == NULL) {
+	memset(img->bytes + off, 0, size);
+    } else {
+	memcpy(img->bytes + off, data, size);
+    }
+    img->size = off + size;
+    if (img->size > UINT32_MAX) {
+	bail_with_error("The AST is too large to write to a file!");
+    }
+    return off;
+}
+
+// Return the pointer stored in img at offset off
+static void *pointer_at(image_t *img, size_t off)
+{
+    void *p;
+    memcpy(&p, img->bytes + off, sizeof(void *));
+    return p;
+}
+
+// Store the offset val (as a pointer-sized value) in img at offset off,
+// and record that it has to be relocated if val is not 0 (NULL)
+static void set_offset_at(image_t *img, size_t off, size_t val)
+{
+    uintptr_t v = (uintptr_t) val;
+    memcpy(img->bytes + off, &v, sizeof(uintptr_t));
+    if (val != 0) {
+	reserve((void **) &img->ptr_relocs, &img->ptr_relocs_capacity,
+		img->num_ptr_relocs + 1, sizeof(uint32_t));
+	img->ptr_relocs[img->num_ptr_relocs++] = (uint32_t) off;
+    }
+}
+
+// The file_location field at offset off in img has to be relocated
+static void fix_loc(image_t *img, size_t off)
+{
+    reserve((void **) &img->loc_relocs, &img->loc_relocs_capacity,
+	    img->num_loc_relocs + 1, sizeof(uint32_t));
+    img->loc_relocs[img->num_loc_relocs++] = (uint32_t) off;
+}
+
+// Copy the string pointed to by the field at offset off in img
+// into img, and make the field its offset
+static void fix_string(image_t *img, size_t off)
+{
+    const char *s = (const char *) pointer_at(img, off);
+    size_t val = (s == NULL) ? 0 : image_append(img, s, strlen(s) + 1);
+    set_offset_at(img, off, val);
+}
+
+// The pointer field at offset off in img is not kept in the file
+static void fix_null(image_t *img, size_t off)
+{
+    set_offset_at(img, off, 0);
+}
+
+// Copy the node (of type t, and size bytes long) pointed to by the field
+// at offset off in img into img, make the field its offset,
+// and remember to fix the copy's fields
+static void fix_pointer(image_t *img, size_t off, AST_type t, size_t size)
+{
+    void *p = pointer_at(img, off);
+    if (p == NULL) {
+	set_offset_at(img, off, 0);
+	return;
+    }
+    if (t == proc_decl_ast) {
+	// its body was parsed (if it was skipped) by ast_binary_write
+	assert(((proc_decl_t *) p)->block != NULL);
+    }
+    size_t val = image_append(img, p, size);
+    set_offset_at(img, off, val);
+    reserve((void **) &img->pending, &img->pending_capacity,
+	    img->num_pending + 1, sizeof(pending_node));
+    img->pending[img->num_pending].offset = val;
+    img->pending[img->num_pending].type = t;
+    img->num_pending++;
+}
+
+// Fix the fields of the identifier at offset off in img,
+// other than its file_location and next fields
+static void fix_ident(image_t *img, size_t off)
+{
+    fix_string(img, off + offsetof(ident_t, name));
+    fix_null(img, off + offsetof(ident_t, idu));
+}
+
+// The offset in img of the field f of the struct of type T at offset off
+#define FIELD(off, T, f) ((off) + offsetof(T, f))
+
+// Fix the fields of the node (of type t) at offset off in img.
+// Nodes that are pointed to are copied and fixed later (see ast_binary_write),
+// so this only recurses into the nodes embedded in this one,
+// which are never nested very deeply.
+static void fix_node(image_t *img, size_t off, AST_type t)
+{
+    // all nodes start with their file_location
+    fix_loc(img, off);
+    switch (t) {
+    case block_ast:
+	fix_node(img, FIELD(off, block_t, const_decls), const_decls_ast);
+	fix_node(img, FIELD(off, block_t, var_decls), var_decls_ast);
+	fix_node(img, FIELD(off, block_t, proc_decls), proc_decls_ast);
+	fix_node(img, FIELD(off, block_t, stmts), stmts_ast);
+	break;
+    case const_decls_ast:
+	fix_pointer(img, FIELD(off, const_decls_t, start),
+		    const_decl_ast, sizeof(const_decl_t));
+	break;
+    case const_decl_ast:
+	fix_pointer(img, FIELD(off, const_decl_t, next),
+		    const_decl_ast, sizeof(const_decl_t));
+	fix_node(img, FIELD(off, const_decl_t, const_def_list),
+		 const_def_list_ast);
+	break;
+    case const_def_list_ast:
+	fix_pointer(img, FIELD(off, const_def_list_t, start),
+		    const_def_ast, sizeof(const_def_t));
+	break;
+    case const_def_ast:
+	fix_pointer(img, FIELD(off, const_def_t, next),
+		    const_def_ast, sizeof(const_def_t));
+	fix_loc(img, FIELD(off, const_def_t, ident));
+	fix_null(img, FIELD(off, const_def_t, ident) + offsetof(ident_t, next));
+	fix_ident(img, FIELD(off, const_def_t, ident));
+	fix_node(img, FIELD(off, const_def_t, number), number_ast);
+	break;
+    case var_decls_ast:
+	fix_pointer(img, FIELD(off, var_decls_t, var_decls),
+		    var_decl_ast, sizeof(var_decl_t));
+	break;
+    case var_decl_ast:
+	fix_pointer(img, FIELD(off, var_decl_t, next),
+		    var_decl_ast, sizeof(var_decl_t));
+	fix_node(img, FIELD(off, var_decl_t, ident_list), ident_list_ast);
+	break;
+    case ident_list_ast:
+	fix_pointer(img, FIELD(off, ident_list_t, start),
+		    ident_ast, sizeof(ident_t));
+	break;
+    case ident_ast:
+	// only the identifiers in ident lists are linked by their next fields
+	// (which are not set in the others, so fix_node is not used for those)
+	fix_pointer(img, FIELD(off, ident_t, next), ident_ast, sizeof(ident_t));
+	fix_ident(img, off);
+	break;
+    case number_ast:
+	// the text of numbers is not set by the parser
+	fix_null(img, FIELD(off, number_t, text));
+	break;
+    case token_ast:
+	fix_string(img, FIELD(off, token_t, text));
+	break;
+    case proc_decls_ast:
+	fix_pointer(img, FIELD(off, proc_decls_t, proc_decls),
+		    proc_decl_ast, sizeof(proc_decl_t));
+	// (it is only used while parsing)
+	fix_null(img, FIELD(off, proc_decls_t, last));
+	break;
+    case proc_decl_ast:
+	fix_pointer(img, FIELD(off, proc_decl_t, next),
+		    proc_decl_ast, sizeof(proc_decl_t));
+	fix_string(img, FIELD(off, proc_decl_t, name));
+	fix_null(img, FIELD(off, proc_decl_t, idu));
+	fix_pointer(img, FIELD(off, proc_decl_t, block),
+		    block_ast, sizeof(block_t));
+	break;
+    case stmts_ast:
+	// the stmt_list of empty stmts is not set
+	if (((stmts_t *) (img->bytes + off))->stmts_kind == stmt_list_e) {
+	    fix_node(img, FIELD(off, stmts_t, stmt_list), stmt_list_ast);
+	}
+	break;
+    case stmt_list_ast:
+	fix_pointer(img, FIELD(off, stmt_list_t, start),
+		    stmt_ast, sizeof(stmt_t));
+	break;
+    case stmt_ast: {
+	stmt_t *s = (stmt_t *) (img->bytes + off);
+	size_t d = FIELD(off, stmt_t, data);
+	stmt_kind_e kind = s->stmt_kind;
+	fix_pointer(img, FIELD(off, stmt_t, next), stmt_ast, sizeof(stmt_t));
+	switch (kind) {
+	case assign_stmt:
+	    fix_node(img, d, assign_stmt_ast);
+	    break;
+	case call_stmt:
+	    fix_node(img, d, call_stmt_ast);
+	    break;
+	case if_stmt:
+	    fix_node(img, d, if_stmt_ast);
+	    break;
+	case while_stmt:
+	    fix_node(img, d, while_stmt_ast);
+	    break;
+	case read_stmt:
+	    fix_node(img, d, read_stmt_ast);
+	    break;
+	case print_stmt:
+	    fix_node(img, d, print_stmt_ast);
+	    break;
+	case block_stmt:
+	    fix_node(img, d, block_stmt_ast);
+	    break;
+	default:
+	    bail_with_error("Unexpected stmt_kind (%d) in fix_node!", kind);
+	    break;
+	}
+	break;
+    }
+    case assign_stmt_ast:
+	fix_string(img, FIELD(off, assign_stmt_t, name));
+	fix_null(img, FIELD(off, assign_stmt_t, idu));
+	fix_pointer(img, FIELD(off, assign_stmt_t, expr),
+		    expr_ast, sizeof(expr_t));
+	break;
+    case call_stmt_ast:
+	fix_string(img, FIELD(off, call_stmt_t, name));
+	fix_null(img, FIELD(off, call_stmt_t, idu));
+	break;
+    case if_stmt_ast:
+	fix_node(img, FIELD(off, if_stmt_t, condition), condition_ast);
+	fix_pointer(img, FIELD(off, if_stmt_t, then_stmts),
+		    stmts_ast, sizeof(stmts_t));
+	fix_pointer(img, FIELD(off, if_stmt_t, else_stmts),
+		    stmts_ast, sizeof(stmts_t));
+	break;
+    case while_stmt_ast:
+	fix_node(img, FIELD(off, while_stmt_t, condition), condition_ast);
+	fix_pointer(img, FIELD(off, while_stmt_t, body),
+		    stmts_ast, sizeof(stmts_t));
+	break;
+    case read_stmt_ast:
+	fix_string(img, FIELD(off, read_stmt_t, name));
+	fix_null(img, FIELD(off, read_stmt_t, idu));
+	break;
+    case print_stmt_ast:
+	fix_node(img, FIELD(off, print_stmt_t, expr), expr_ast);
+	break;
+    case block_stmt_ast:
+	fix_pointer(img, FIELD(off, block_stmt_t, block),
+		    block_ast, sizeof(block_t));
+	break;
+    case condition_ast: {
+	condition_t *c = (condition_t *) (img->bytes + off);
+	size_t d = FIELD(off, condition_t, data);
+	if (c->cond_kind == ck_db) {
+	    fix_node(img, d, db_condition_ast);
+	} else {
+	    fix_node(img, d, rel_op_condition_ast);
+	}
+	break;
+    }
+    case db_condition_ast:
+	fix_node(img, FIELD(off, db_condition_t, dividend), expr_ast);
+	fix_node(img, FIELD(off, db_condition_t, divisor), expr_ast);
+	break;
+    case rel_op_condition_ast:
+	fix_node(img, FIELD(off, rel_op_condition_t, expr1), expr_ast);
+	fix_node(img, FIELD(off, rel_op_condition_t, rel_op), token_ast);
+	fix_node(img, FIELD(off, rel_op_condition_t, expr2), expr_ast);
+	break;
+    case expr_ast: {
+	expr_t *e = (expr_t *) (img->bytes + off);
+	size_t d = FIELD(off, expr_t, data);
+	switch (e->expr_kind) {
+	case expr_bin:
+	    fix_node(img, d, binary_op_expr_ast);
+	    break;
+	case expr_negated:
+	    fix_node(img, d, negated_expr_ast);
+	    break;
+	case expr_ident:
+	    fix_loc(img, d);
+	    fix_null(img, d + offsetof(ident_t, next));
+	    fix_ident(img, d);
+	    break;
+	case expr_number:
+	    fix_node(img, d, number_ast);
+	    break;
+	default:
+	    bail_with_error("Unexpected expr_kind (%d) in fix_node!",
+			    e->expr_kind);
+	    break;
+	}
+	break;
+    }
+    case binary_op_expr_ast:
+	fix_pointer(img, FIELD(off, binary_op_expr_t, expr1),
+		    expr_ast, sizeof(expr_t));
+	fix_node(img, FIELD(off, binary_op_expr_t, arith_op), token_ast);
+	fix_pointer(img, FIELD(off, binary_op_expr_t, expr2),
+		    expr_ast, sizeof(expr_t));
+	break;
+    case negated_expr_ast:
+	fix_pointer(img, FIELD(off, negated_expr_t, expr),
+		    expr_ast, sizeof(expr_t));
+	break;
+    default:
+	bail_with_error("Unexpected AST type (%d) in fix_node!", t);
+	break;
+    }
+}
+
+// Requires: prog was returned by parseProgram
+// Write prog to the file named filename,
+// first parsing the bodies of any procedures that were skipped
+// (if they have syntax errors, nothing is written and false is returned,
+// after reporting them).
+// The id_use fields are written as NULL, so they are only set
+// in the loaded AST by scope checking it.
+bool ast_binary_write(const char *filename, block_t *prog)
+{
+    if (!parser_proc_bodies(prog)) {
+	return false;
+    }
+    image_t img;
+    memset(&img, 0, sizeof(img));
+    ast_binary_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    image_append(&img, NULL, sizeof(hdr));
+
+    // copy the nodes, fixing each one's fields after it is copied,
+    // (which copies the nodes it points to) until all have been fixed
+    hdr.root = (uint32_t) image_append(&img, prog, sizeof(block_t));
+    fix_node(&img, hdr.root, block_ast);
+    size_t done = 0;
+    while (done < img.num_pending) {
+	pending_node pn = img.pending[done++];
+	fix_node(&img, pn.offset, pn.type);
+    }
+
+    unsigned int file_id = file_location_file_id(prog->file_loc);
+    hdr.base = file_location_make(file_id, 0);
+    const char *source = file_location_filename(prog->file_loc);
+    hdr.filename = (uint32_t) image_append(&img, source, strlen(source) + 1);
+    unsigned int num_lines;
+    const unsigned int *lines = file_location_line_starts(file_id,
+							  &num_lines);
+    hdr.line_starts = (uint32_t)
+	image_append(&img, lines, num_lines * sizeof(unsigned int));
+    hdr.num_lines = num_lines;
+    hdr.ptr_relocs = (uint32_t)
+	image_append(&img, img.ptr_relocs,
+		     img.num_ptr_relocs * sizeof(uint32_t));
+    hdr.num_ptr_relocs = (uint32_t) img.num_ptr_relocs;
+    hdr.loc_relocs = (uint32_t)
+	image_append(&img, img.loc_relocs,
+		     img.num_loc_relocs * sizeof(uint32_t));
+    hdr.num_loc_relocs = (uint32_t) img.num_loc_relocs;
+
+    memcpy(hdr.magic, AST_BINARY_MAGIC, sizeof(AST_BINARY_MAGIC));
+    hdr.version = AST_BINARY_VERSION;
+    hdr.layout = AST_BINARY_LAYOUT;
+    hdr.size = (uint32_t) img.size;
+    memcpy(img.bytes, &hdr, sizeof(hdr));
+
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL) {
+	bail_with_error("Cannot open %s for writing!", filename);
+    }
+    if (fwrite(img.bytes, 1, img.size, out) != img.size
+	|| fclose(out) != 0) {
+	bail_with_error("Error writing the AST to %s!", filename);
+    }
+    free(img.bytes);
+    free(img.ptr_relocs);
+    free(img.loc_relocs);
+    free(img.pending);
+    return true;
+}
+
+// Is the table of count uint32_t values at offset off within a file
+// of size bytes?
+static bool table_fits(uint32_t off, uint32_t count, uint32_t size)
+{
+    return off <= size && count <= (size - off) / sizeof(uint32_t);
+}
+
+// Requires: filename names a file written by ast_binary_write
+// Map the file named filename into memory and return its program's AST.
+// The AST's locations are in the source file it was parsed from,
+// and the AST stays in memory (and can be changed, e.g., by scope checking,
+// without changing the file) until the program exits.
+block_t *ast_binary_load(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+	bail_with_error("Cannot open %s!", filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+	bail_with_error("Cannot find the size of %s!", filename);
+    }
+    if ((size_t) st.st_size < sizeof(ast_binary_header)
+	|| st.st_size > UINT32_MAX) {
+	bail_with_error("File %s is not an AST file!", filename);
+    }
+    // a private mapping, so changes to the AST are not written to the file
+    char *base = (char *) mmap(NULL, (size_t) st.st_size,
+			       PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+	bail_with_error("Cannot map %s into memory!", filename);
+    }
+    close(fd);
+
+    ast_binary_header *hdr = (ast_binary_header *) base;
+    uint32_t size = (uint32_t) st.st_size;
+    if (memcmp(hdr->magic, AST_BINARY_MAGIC, sizeof(AST_BINARY_MAGIC)) != 0
+	|| hdr->size != size) {
+	bail_with_error("File %s is not an AST file!", filename);
+    }
+    if (hdr->version != AST_BINARY_VERSION
+	|| hdr->layout != AST_BINARY_LAYOUT) {
+	bail_with_error("AST file %s was written by another version"
+			" of the compiler!", filename);
+    }
+    if (hdr->root > size - sizeof(block_t)
+	|| hdr->filename >= size || hdr->num_lines == 0
+	|| memchr(base + hdr->filename, '\0', size - hdr->filename) == NULL
+	|| !table_fits(hdr->line_starts, hdr->num_lines, size)
+	|| !table_fits(hdr->ptr_relocs, hdr->num_ptr_relocs, size)
+	|| !table_fits(hdr->loc_relocs, hdr->num_loc_relocs, size)) {
+	bail_with_error("AST file %s is damaged!", filename);
+    }
+
+    const uint32_t *relocs = (const uint32_t *) (base + hdr->ptr_relocs);
+    for (uint32_t i = 0; i < hdr->num_ptr_relocs; i++) {
+	uintptr_t v;
+	if (relocs[i] > size - sizeof(uintptr_t)) {
+	    bail_with_error("AST file %s is damaged!", filename);
+	}
+	memcpy(&v, base + relocs[i], sizeof(uintptr_t));
+	if (v >= size) {
+	    bail_with_error("AST file %s is damaged!", filename);
+	}
+	v += (uintptr_t) base;
+	memcpy(base + relocs[i], &v, sizeof(uintptr_t));
+    }
+
+    // the source file's length is at least that of its last location
+    relocs = (const uint32_t *) (base + hdr->loc_relocs);
+    file_location last = hdr->base;
+    for (uint32_t i = 0; i < hdr->num_loc_relocs; i++) {
+	file_location fl;
+	if (relocs[i] > size - sizeof(file_location)) {
+	    bail_with_error("AST file %s is damaged!", filename);
+	}
+	memcpy(&fl, base + relocs[i], sizeof(file_location));
+	if (fl < hdr->base) {
+	    bail_with_error("AST file %s is damaged!", filename);
+	}
+	last = MAX(last, fl);
+    }
+    unsigned int file_id = file_location_register_lines(
+	base + hdr->filename,
+	(const unsigned int *) (base + hdr->line_starts), hdr->num_lines,
+	last - hdr->base);
+    file_location new_base = file_location_make(file_id, 0);
+    if (new_base != hdr->base) {
+	// the locations have to be in the newly registered file's range
+	for (uint32_t i = 0; i < hdr->num_loc_relocs; i++) {
+	    file_location fl;
+	    memcpy(&fl, base + relocs[i], sizeof(file_location));
+	    fl = new_base + (fl - hdr->base);
+	    memcpy(base + relocs[i], &fl, sizeof(file_location));
+	}
+    }
+    return (block_t *) (base + hdr->root);
+}
@@ -0,0 +1,42 @@
+#ifndef _AST_BINARY_H
+#define _AST_BINARY_H
+#include "ast.h"
+
+// A binary form of a program's AST that can be written after parsing
+// and loaded back (by mapping the file into memory) without parsing.
+//
+// The file holds a header, then copies of the AST's nodes and strings,
+// in which each pointer is replaced by the byte offset (from the start
+// of the file) of what it points to (0 for NULL). After the nodes come
+// the source file's name and table of line starts, and two tables of
+// relocations: the offsets of the pointer fields, and of the file_location
+// fields (which are moved to the range of locations that the source file
+// is given when the file is loaded).
+// Loading only maps the file and adds its address to each pointer field.
+//
+// The nodes are laid out as the C structs in ast.h, so a file can only be
+// loaded by a compiler built for the same AST_BINARY_VERSION and layout.
+
+// Identifies files written by ast_binary_write
+#define AST_BINARY_MAGIC "SPL-AST"
+
+// Incremented whenever the file format, or the structs in ast.h, change
+#define AST_BINARY_VERSION 6
+
+// Requires: prog was returned by parseProgram
+// Write prog to the file named filename,
+// first parsing the bodies of any procedures that were skipped
+// (if they have syntax errors, nothing is written and false is returned,
+// after reporting them).
+// The id_use fields are written as NULL, so they are only set
+// in the loaded AST by scope checking it.
+extern bool ast_binary_write(const char *filename, block_t *prog);
+
+// Requires: filename names a file written by ast_binary_write
+// Map the file named filename into memory and return its program's AST.
+// The AST's locations are in the source file it was parsed from,
+// and the AST stays in memory (and can be changed, e.g., by scope checking,
+// without changing the file) until the program exits.
+extern block_t *ast_binary_load(const char *filename);
+
+#endif
@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include "ast_walk.h"
+#include "parser.h"
+#include "utilities.h"
+
+// What to do with a node taken off the work stack
+typedef enum { walk_enter, walk_between, walk_exit } walk_action;
+
+// An entry in the work stack
+typedef struct {
+    void *node;
+    AST_type type;
+    walk_action action;
+    int child;  // for walk_between, the number of the child just visited
+} walk_item;
+
+// The work stack, which grows as needed
+typedef struct {
+    walk_item *items;
+    size_t size;
+    size_t capacity;
+} walk_stack;
+
+// Push the given item on the stack st
+static void push(walk_stack *st, void *node, AST_type t, walk_action a,
+		 int child)
+{
+    if (st->size == st->capacity) {
+	st->capacity = (st->capacity == 0) ? 256 : 2 * st->capacity;
+	st->items = (walk_item *) realloc(st->items,
+					  st->capacity * sizeof(walk_item));
+	if (st->items == NULL) {
+	    bail_with_error("Cannot allocate space for the AST walk stack!");
+	}
+    }
+    walk_item *it = &st->items[st->size++];
+    it->node = node;
+    it->type = t;
+    it->action = a;
+    it->child = child;
+}
+
+// Push the child c (of type t) of the node being expanded,
+// preceded by a between item for it if this is not its first child.
+// The items are pushed in source order and reversed by push_children.
+static void push_child(walk_stack *st, ast_visitor *v, void *parent,
+		       AST_type pt, int *count, void *c, AST_type t)
+{
+    if (*count > 0 && v->between != NULL) {
+	push(st, parent, pt, walk_between, *count - 1);
+    }
+    push(st, c, t, walk_enter, 0);
+    (*count)++;
+}
+
+// Push the children of node (of type t), so that they are popped
+// in source order; return false (pushing none) if node is
+// a procedure declaration whose skipped body has syntax errors
+static bool push_children(walk_stack *st, ast_visitor *v,
+			  void *node, AST_type t)
+{
+    size_t start = st->size;
+    int n = 0;
+    switch (t) {
+    case block_ast: {
+	block_t *b = (block_t *) node;
+	push_child(st, v, node, t, &n, &b->const_decls, const_decls_ast);
+	push_child(st, v, node, t, &n, &b->var_decls, var_decls_ast);
+	push_child(st, v, node, t, &n, &b->proc_decls, proc_decls_ast);
+	push_child(st, v, node, t, &n, &b->stmts, stmts_ast);
+	break;
+    }
+    case const_decls_ast:
+	for (const_decl_t *cd = ((const_decls_t *) node)->start;
+	     cd != NULL; cd = cd->next) {
+	    push_child(st, v, node, t, &n, cd, const_decl_ast);
+	}
+	break;
+    case const_decl_ast:
+	for (const_def_t *def = ((const_decl_t *) node)->const_def_list.start;
+	     def != NULL; def = def->next) {
+	    push_child(st, v, node, t, &n, def, const_def_ast);
+	}
+	break;
+    case var_decls_ast:
+	for (var_decl_t *vd = ((var_decls_t *) node)->var_decls;
+	     vd != NULL; vd = vd->next) {
+	    push_child(st, v, node, t, &n, vd, var_decl_ast);
+	}
+	break;
+    case var_decl_ast:
+	for (ident_t *id = ((var_decl_t *) node)->ident_list.start;
+	     id != NULL; id = id->next) {
+	    push_child(st, v, node, t, &n, id, ident_ast);
+	}
+	break;
+    case proc_decls_ast:
+	for (proc_decl_t *pd = ((proc_decls_t *) node)->proc_decls;
+	     pd != NULL; pd = pd->next) {
+	    push_child(st, v, node, t, &n, pd, proc_decl_ast);
+	}
+	break;
+    case proc_decl_ast: {
+	block_t *body = parser_proc_body((proc_decl_t *) node);
+	if (body == NULL) {
+	    return false;
+	}
+	push_child(st, v, node, t, &n, body, block_ast);
+	break;
+    }
+    case stmts_ast: {
+	stmts_t *stmts = (stmts_t *) node;
+	if (stmts->stmts_kind != empty_stmts_e) {
+	    for (stmt_t *s = stmts->stmt_list.start; s != NULL; s = s->next) {
+		push_child(st, v, node, t, &n, s, stmt_ast);
+	    }
+	}
+	break;
+    }
+    case stmt_ast: {
+	stmt_t *s = (stmt_t *) node;
+	switch (s->stmt_kind) {
+	case assign_stmt:
+	    push_child(st, v, node, t, &n, s->data.assign_stmt.expr, expr_ast);
+	    break;
+	case if_stmt:
+	    push_child(st, v, node, t, &n, &s->data.if_stmt.condition,
+		       condition_ast);
+	    push_child(st, v, node, t, &n, s->data.if_stmt.then_stmts,
+		       stmts_ast);
+	    if (s->data.if_stmt.else_stmts != NULL) {
+		push_child(st, v, node, t, &n, s->data.if_stmt.else_stmts,
+			   stmts_ast);
+	    }
+	    break;
+	case while_stmt:
+	    push_child(st, v, node, t, &n, &s->data.while_stmt.condition,
+		       condition_ast);
+	    push_child(st, v, node, t, &n, s->data.while_stmt.body, stmts_ast);
+	    break;
+	case print_stmt:
+	    push_child(st, v, node, t, &n, &s->data.print_stmt.expr, expr_ast);
+	    break;
+	case block_stmt:
+	    push_child(st, v, node, t, &n, s->data.block_stmt.block,
+		       block_ast);
+	    break;
+	case call_stmt: case read_stmt:
+	    break;
+	default:
+	    bail_with_error("Unknown stmt_kind (%d) in ast_walk!",
+			    s->stmt_kind);
+	    break;
+	}
+	break;
+    }
+    case condition_ast: {
+	condition_t *c = (condition_t *) node;
+	switch (c->cond_kind) {
+	case ck_db:
+	    push_child(st, v, node, t, &n, &c->data.db_cond.dividend,
+		       expr_ast);
+	    push_child(st, v, node, t, &n, &c->data.db_cond.divisor, expr_ast);
+	    break;
+	case ck_rel:
+	    push_child(st, v, node, t, &n, &c->data.rel_op_cond.expr1,
+		       expr_ast);
+	    push_child(st, v, node, t, &n, &c->data.rel_op_cond.expr2,
+		       expr_ast);
+	    break;
+	default:
+	    bail_with_error("Unknown condition_kind (%d) in ast_walk!",
+			    c->cond_kind);
+	    break;
+	}
+	break;
+    }
+    case expr_ast: {
+	expr_t *e = (expr_t *) node;
+	switch (e->expr_kind) {
+	case expr_bin:
+	    push_child(st, v, node, t, &n, e->data.binary.expr1, expr_ast);
+	    push_child(st, v, node, t, &n, e->data.binary.expr2, expr_ast);
+	    break;
+	case expr_negated:
+	    push_child(st, v, node, t, &n, e->data.negated.expr, expr_ast);
+	    break;
+	case expr_ident: case expr_number:
+	    break;
+	default:
+	    bail_with_error("Unknown expr_kind (%d) in ast_walk!",
+			    e->expr_kind);
+	    break;
+	}
+	break;
+    }
+    case const_def_ast: case ident_ast:
+	break;
+    default:
+	bail_with_error("Unexpected AST type (%d) in ast_walk!", t);
+	break;
+    }
+    // reverse the pushed items, so the first child is on top
+    size_t lo = start;
+    size_t hi = st->size;
+    while (lo + 1 < hi) {
+	walk_item tmp = st->items[lo];
+	st->items[lo++] = st->items[--hi];
+	st->items[hi] = tmp;
+    }
+    return true;
+}
+
+// Requires: node points to an AST of the kind t (as listed in ast_walk.h)
+// Visit node and its descendants in order,
+// calling the visitor's callbacks for each of them;
+// return false if a skipped procedure body had syntax errors
+// (which are reported, and the body is then not visited).
+bool ast_walk(void *node, AST_type t, ast_visitor *v)
+{
+    bool parsed = true;
+    walk_stack st = { NULL, 0, 0 };
+    push(&st, node, t, walk_enter, 0);
+    while (st.size > 0) {
+	walk_item it = st.items[--st.size];
+	switch (it.action) {
+	case walk_enter:
+	    if (v->pre == NULL || v->pre(it.node, it.type, v->data)) {
+		push(&st, it.node, it.type, walk_exit, 0);
+		if (!push_children(&st, v, it.node, it.type)) {
+		    parsed = false;
+		}
+	    }
+	    break;
+	case walk_between:
+	    v->between(it.node, it.type, it.child, v->data);
+	    break;
+	case walk_exit:
+	    if (v->post != NULL) {
+		v->post(it.node, it.type, v->data);
+	    }
+	    break;
+	}
+    }
+    free(st.items);
+    return parsed;
+}
@@ -0,0 +1,56 @@
+#ifndef _AST_WALK_H
+#define _AST_WALK_H
+#include <stdbool.h>
+#include "ast.h"
+
+// A non-recursive traversal of ASTs, driven by the AST_type of each node.
+// The nodes visited, and their children (in source order), are:
+//   block_ast (block_t): const_decls_ast, var_decls_ast,
+//                        proc_decls_ast, stmts_ast
+//   const_decls_ast (const_decls_t): each const_decl_ast
+//   const_decl_ast (const_decl_t): each const_def_ast
+//   const_def_ast (const_def_t): none
+//   var_decls_ast (var_decls_t): each var_decl_ast
+//   var_decl_ast (var_decl_t): each ident_ast in its ident_list
+//   ident_ast (ident_t): none
+//   proc_decls_ast (proc_decls_t): each proc_decl_ast
+//   proc_decl_ast (proc_decl_t): block_ast (parsed first, if it was skipped;
+//                                none if that fails)
+//   stmts_ast (stmts_t): each stmt_ast (none if empty)
+//   stmt_ast (stmt_t), depending on its stmt_kind:
+//       assign_stmt: expr_ast,  call_stmt: none,
+//       if_stmt: condition_ast, stmts_ast (then), stmts_ast (else, if any),
+//       while_stmt: condition_ast, stmts_ast,
+//       read_stmt: none,  print_stmt: expr_ast,  block_stmt: block_ast
+//   condition_ast (condition_t): expr_ast, expr_ast
+//   expr_ast (expr_t), depending on its expr_kind:
+//       expr_bin: expr_ast, expr_ast,  expr_negated: expr_ast,
+//       expr_ident: none,  expr_number: none
+// The type passed to the callbacks is the one listed above
+// (which is not always the node's type_tag field).
+// The walk keeps its pending work in a heap-allocated stack,
+// so the C stack does not grow with the depth of the AST.
+
+// The callbacks for a walk (any of them may be NULL)
+typedef struct {
+    // Called before node's children are visited;
+    // if this returns false, the rest of the visit to node
+    // (its children, and the between and post calls) is skipped
+    bool (*pre)(void *node, AST_type t, void *data);
+    // Called after the i-th child (counting from 0) of node has been visited,
+    // when there is another child still to visit
+    void (*between)(void *node, AST_type t, int i, void *data);
+    // Called after all of node's children have been visited
+    void (*post)(void *node, AST_type t, void *data);
+    // Passed to each callback
+    void *data;
+} ast_visitor;
+
+// Requires: node points to an AST of the kind t (as listed above)
+// Visit node and its descendants in order,
+// calling the visitor's callbacks for each of them;
+// return false if a skipped procedure body had syntax errors
+// (which are reported, and the body is then not visited).
+extern bool ast_walk(void *node, AST_type t, ast_visitor *v);
+
+#endif
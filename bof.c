@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "bof.h"
+#include "utilities.h"
+
+// Write the word w on out, in little-endian byte order
+static void write_word(FILE *out, unsigned int w)
+{
+    for (int i = 0; i < BYTES_PER_WORD; i++) {
+	putc((w >> (8 * i)) & 0xFF, out);
+    }
+}
+
+// Write the n words starting at words on out
+static void write_words(FILE *out, const word_type *words, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+	write_word(out, (unsigned int) words[i]);
+    }
+}
+
+// Requires: the lengths in hdr are multiples of BYTES_PER_WORD,
+//           and text and data hold that many bytes
+// Write the BOF with the header hdr (filling in its magic)
+// and the given text and data to the file named filename
+void bof_write(const char *filename, bof_header hdr,
+	       const word_type *text, const word_type *data)
+{
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL) {
+	bail_with_error("Cannot open %s for writing!", filename);
+    }
+    memcpy(hdr.magic, BOF_MAGIC, sizeof(hdr.magic));
+    fwrite(hdr.magic, 1, sizeof(hdr.magic), out);
+    write_word(out, hdr.text_start_address);
+    write_word(out, hdr.text_length);
+    write_word(out, hdr.data_start_address);
+    write_word(out, hdr.data_length);
+    write_word(out, hdr.stack_bottom_address);
+    write_words(out, text, hdr.text_length / BYTES_PER_WORD);
+    write_words(out, data, hdr.data_length / BYTES_PER_WORD);
+    if (ferror(out) || fclose(out) != 0) {
+	bail_with_error("Error writing the program to %s!", filename);
+    }
+}
+
+// Read a word (in little-endian byte order) from in into *w,
+// returning false if the input ends first
+static bool read_word(FILE *in, word_type *w)
+{
+    unsigned int v = 0;
+    for (int i = 0; i < BYTES_PER_WORD; i++) {
+	int c = getc(in);
+	if (c == EOF) {
+	    return false;
+	}
+	v |= (unsigned int) c << (8 * i);
+    }
+    *w = (word_type) v;
+    return true;
+}
+
+// Read len bytes (a multiple of BYTES_PER_WORD) of words from in
+// into newly allocated space, returning NULL if the input ends first
+static word_type *read_words(FILE *in, address_type len)
+{
+    size_t n = len / BYTES_PER_WORD;
+    word_type *words = (word_type *) malloc((n + 1) * sizeof(word_type));
+    if (words == NULL) {
+	bail_with_error("No space to read a BOF!");
+    }
+    for (size_t i = 0; i < n; i++) {
+	if (!read_word(in, &words[i])) {
+	    free(words);
+	    return NULL;
+	}
+    }
+    return words;
+}
+
+// Read the BOF in the file named filename,
+// exiting with an error message if it is not one
+bof_file bof_read(const char *filename)
+{
+    FILE *in = fopen(filename, "rb");
+    if (in == NULL) {
+	bail_with_error("Cannot open %s!", filename);
+    }
+    bof_file bf;
+    bof_header *hdr = &bf.header;
+    word_type fields[5];
+    bool ok = fread(hdr->magic, 1, sizeof(hdr->magic), in)
+	== sizeof(hdr->magic)
+	&& memcmp(hdr->magic, BOF_MAGIC, sizeof(hdr->magic)) == 0;
+    for (int i = 0; ok && i < 5; i++) {
+	ok = read_word(in, &fields[i]);
+    }
+    if (!ok) {
+	errno = 0;
+	bail_with_error("File %s is not a BOF!", filename);
+    }
+    hdr->text_start_address = (address_type) fields[0];
+    hdr->text_length = (address_type) fields[1];
+    hdr->data_start_address = (address_type) fields[2];
+    hdr->data_length = (address_type) fields[3];
+    hdr->stack_bottom_address = (address_type) fields[4];
+    if (hdr->text_start_address % BYTES_PER_WORD != 0
+	|| hdr->text_length % BYTES_PER_WORD != 0
+	|| hdr->data_start_address % BYTES_PER_WORD != 0
+	|| hdr->data_length % BYTES_PER_WORD != 0
+	|| hdr->stack_bottom_address % BYTES_PER_WORD != 0) {
+	errno = 0;
+	bail_with_error("BOF %s has an unaligned address or length!",
+			filename);
+    }
+    bf.text = read_words(in, hdr->text_length);
+    bf.data = (bf.text == NULL) ? NULL : read_words(in, hdr->data_length);
+    if (bf.data == NULL || getc(in) != EOF) {
+	errno = 0;
+	bail_with_error("BOF %s does not have the lengths in its header!",
+			filename);
+    }
+    fclose(in);
+    return bf;
+}
@@ -0,0 +1,43 @@
+#ifndef _BOF_H
+#define _BOF_H
+#include "machine_types.h"
+
+// Binary object files (BOFs) for the SRM (see instruction.h):
+// a header, then the words of the text (the program's instructions),
+// then those of its data; each word (including the header's numbers)
+// is written in little-endian byte order.
+// Running a BOF starts at its text_start_address,
+// with GPR[GP] holding its data_start_address,
+// and GPR[SP] and GPR[FP] holding its stack_bottom_address;
+// the stack grows down from there (towards the data).
+
+#define BOF_MAGIC "SRM1"
+
+typedef struct {
+    char magic[4];                   // BOF_MAGIC (without a 0 byte)
+    address_type text_start_address; // (all addresses are in bytes)
+    address_type text_length;        // the number of bytes of text
+    address_type data_start_address;
+    address_type data_length;        // the number of bytes of data
+    address_type stack_bottom_address;
+} bof_header;
+
+// A BOF read into memory
+typedef struct {
+    bof_header header;
+    word_type *text;  // (text_length / BYTES_PER_WORD words)
+    word_type *data;  // (data_length / BYTES_PER_WORD words)
+} bof_file;
+
+// Requires: the lengths in hdr are multiples of BYTES_PER_WORD,
+//           and text and data hold that many bytes
+// Write the BOF with the header hdr (filling in its magic)
+// and the given text and data to the file named filename
+extern void bof_write(const char *filename, bof_header hdr,
+		      const word_type *text, const word_type *data);
+
+// Read the BOF in the file named filename,
+// exiting with an error message if it is not one
+extern bof_file bof_read(const char *filename);
+
+#endif
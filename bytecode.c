@@ -0,0 +1,497 @@
+#include <stdlib.h>
+#include "bytecode.h"
+#include "ast_walk.h"
+#include "parser.h"
+#include "ptr_map.h"
+#include "utilities.h"
+#include "spl.tab.h"
+
+// What there is no space to do, if growing an array fails
+#define PURPOSE "compile the program to bytecode"
+
+// What the code at the end of a block does
+typedef enum { block_halts, block_returns, block_leaves } block_end;
+
+// The state of the compiler (which compiles one program at a time)
+typedef struct {
+    block_t *prog;
+    bytecode *bc;
+    unsigned int code_size;     // the allocated size of bc->code
+    unsigned int locs_size;     // and of bc->locs
+    unsigned int divisors_size; // and of bc->divisors
+    unsigned int depth;         // the values on the operand stack here
+    ptr_map constants;          // the id_attrs of each constant -> its def
+    ptr_map entries;            // the id_attrs of each procedure -> its pc
+    bool proc_body_next;        // is the next block a procedure's?
+    // the pcs of the operands of the jumps still to be filled in
+    // (and of the starts of the loops being compiled)
+    unsigned int *patches;
+    unsigned int num_patches;
+    unsigned int patches_size;
+    // how each of the blocks being compiled ends (innermost last)
+    block_end *ends;
+    unsigned int num_ends;
+    unsigned int ends_size;
+} compiler;
+
+// Append the words of an instruction (its opcode, then n operands)
+static void emit(compiler *c, bytecode_op op, unsigned int n,
+		 word_type a, word_type b)
+{
+    bytecode *bc = c->bc;
+    reserve_array((void **) &bc->code, &c->code_size, sizeof(word_type),
+		  bc->length + 1 + n, PURPOSE);
+    bc->code[bc->length++] = op;
+    if (n > 0) {
+	bc->code[bc->length++] = a;
+    }
+    if (n > 1) {
+	bc->code[bc->length++] = b;
+    }
+}
+
+// Note that the operand stack grows (or shrinks, if n < 0) by n values
+static void stack_effect(compiler *c, int n)
+{
+    c->depth += n;
+    if (c->depth > c->bc->max_depth) {
+	c->bc->max_depth = c->depth;
+    }
+}
+
+// Note that the next instruction, which can fail at run-time,
+// is for the source at loc (and, for op_assign_constant, name)
+static void note_loc(compiler *c, file_location loc, const char *name)
+{
+    bytecode *bc = c->bc;
+    reserve_array((void **) &bc->locs, &c->locs_size, sizeof(bytecode_loc),
+		  bc->num_locs + 1, PURPOSE);
+    bc->locs[bc->num_locs++] = (bytecode_loc) { bc->length, loc, name };
+}
+
+// If expr is a number or a constant whose value is not 0, or the
+// negation of one, put its value in *v and return the number of words
+// of its code (which pushes it); otherwise return 0
+static unsigned int constant_divisor(compiler *c, expr_t *expr,
+				     word_type *v)
+{
+    unsigned int words = 2;
+    if (expr->expr_kind == expr_negated) {
+	expr = expr->data.negated.expr;
+	words = 3;
+    }
+    if (expr->expr_kind == expr_number) {
+	*v = expr->data.number.value;
+    } else if (expr->expr_kind == expr_ident
+	       && expr->data.ident.idu->attrs->kind == constant_idk) {
+	const_def_t *def = (const_def_t *)
+	    ptr_map_get(&c->constants, expr->data.ident.idu->attrs);
+	*v = def->number.value;
+    } else {
+	return 0;
+    }
+    if (words == 3) {
+	*v = (word_type) (0u - (unsigned int) *v);
+    }
+    return (*v != 0) ? words : 0;
+}
+
+// Requires: the last words words of code push the divisor d (not 0)
+// Remove them, returning the index of d in the divisors
+static word_type take_divisor(compiler *c, word_type d, unsigned int words)
+{
+    bytecode *bc = c->bc;
+    bc->length -= words;
+    stack_effect(c, -1);
+    reserve_array((void **) &bc->divisors, &c->divisors_size,
+		  sizeof(bytecode_divisor), bc->num_divisors + 1, PURPOSE);
+    bc->divisors[bc->num_divisors] = bytecode_divisor_make(d);
+    return (word_type) bc->num_divisors++;
+}
+
+// Push pc on the stack of patches
+static void push_patch(compiler *c, unsigned int pc)
+{
+    reserve_array((void **) &c->patches, &c->patches_size,
+		  sizeof(unsigned int), c->num_patches + 1, PURPOSE);
+    c->patches[c->num_patches++] = pc;
+}
+
+// Pop the stack of patches
+static unsigned int pop_patch(compiler *c)
+{
+    return c->patches[--c->num_patches];
+}
+
+// Make the jump whose operand is at pc go to the next instruction
+static void patch_here(compiler *c, unsigned int pc)
+{
+    c->bc->code[pc] = c->bc->length;
+}
+
+// Append a jump (of the given kind) whose target is filled in later,
+// pushing the pc of its operand on the stack of patches
+static void emit_forward_jump(compiler *c, bytecode_op op)
+{
+    emit(c, op, 1, 0, 0);
+    push_patch(c, c->bc->length - 1);
+}
+
+// Append an instruction that uses the variable of idu
+// (op if it is declared in the block of the code, otherwise outer_op)
+static void emit_variable(compiler *c, bytecode_op op, bytecode_op outer_op,
+			  const id_use *idu)
+{
+    if (idu->levelsOutward == 0) {
+	emit(c, op, 1, idu->attrs->offset_count, 0);
+    } else {
+	emit(c, outer_op, 2, idu->levelsOutward, idu->attrs->offset_count);
+    }
+}
+
+// Start the code for block
+static void compile_block_start(compiler *c, block_t *block)
+{
+    reserve_array((void **) &c->ends, &c->ends_size, sizeof(block_end),
+		  c->num_ends + 1, PURPOSE);
+    if (c->proc_body_next) {
+	c->proc_body_next = false;
+	c->ends[c->num_ends++] = block_returns;
+	emit(c, op_enter, 1, block->frame_size, 0);
+    } else {
+	c->ends[c->num_ends++] = (block == c->prog) ? block_halts
+	    : block_leaves;
+	note_loc(c, block->file_loc, NULL);
+	emit(c, op_block, 1, block->frame_size, 0);
+    }
+}
+
+// Append the code for the start of stmt (what comes before its children)
+// and return false if it has no children to compile
+static bool compile_stmt_start(compiler *c, stmt_t *stmt)
+{
+    switch (stmt->stmt_kind) {
+    case assign_stmt: {
+	assign_stmt_t *as = &stmt->data.assign_stmt;
+	if (as->idu->attrs->kind != variable_idk) {
+	    note_loc(c, stmt->file_loc, as->name);
+	    emit(c, op_assign_constant, 0, 0, 0);
+	    return false;
+	}
+	return true;
+    }
+    case call_stmt: {
+	id_use *idu = stmt->data.call_stmt.idu;
+	unsigned int *entry = (unsigned int *)
+	    ptr_map_get(&c->entries, idu->attrs);
+	note_loc(c, stmt->file_loc, NULL);
+	emit(c, op_call, 2, idu->levelsOutward, *entry);
+	return false;
+    }
+    case read_stmt: {
+	id_use *idu = stmt->data.read_stmt.idu;
+	emit(c, op_read, 2, idu->levelsOutward, idu->attrs->offset_count);
+	return false;
+    }
+    case while_stmt:
+	// the start of the loop, where its condition is checked
+	push_patch(c, c->bc->length);
+	return true;
+    default:
+	return true;
+    }
+}
+
+// Append the code for an expression that is a name or a number
+static void compile_leaf(compiler *c, expr_t *expr)
+{
+    if (expr->expr_kind == expr_number) {
+	emit(c, op_push, 1, expr->data.number.value, 0);
+    } else {
+	id_use *idu = expr->data.ident.idu;
+	if (idu->attrs->kind == constant_idk) {
+	    const_def_t *def = (const_def_t *)
+		ptr_map_get(&c->constants, idu->attrs);
+	    emit(c, op_push, 1, def->number.value, 0);
+	} else {
+	    emit_variable(c, op_load, op_load_outer, idu);
+	}
+    }
+    stack_effect(c, 1);
+}
+
+// The walk's pre callback
+static bool compile_pre(void *node, AST_type t, void *data)
+{
+    compiler *c = (compiler *) data;
+    switch (t) {
+    case block_ast:
+	compile_block_start(c, (block_t *) node);
+	return true;
+    case const_def_ast: {
+	const_def_t *def = (const_def_t *) node;
+	ptr_map_put(&c->constants, def->ident.idu->attrs, def);
+	return true;
+    }
+    case proc_decl_ast: {
+	proc_decl_t *pd = (proc_decl_t *) node;
+	unsigned int *entry = (unsigned int *) malloc(sizeof(unsigned int));
+	if (entry == NULL) {
+	    bail_with_error("No space to compile the program to bytecode!");
+	}
+	*entry = c->bc->length;
+	ptr_map_put(&c->entries, pd->idu->attrs, entry);
+	c->proc_body_next = true;
+	return true;
+    }
+    case stmt_ast:
+	return compile_stmt_start(c, (stmt_t *) node);
+    case expr_ast: {
+	expr_t *expr = (expr_t *) node;
+	if (expr->expr_kind == expr_number || expr->expr_kind == expr_ident) {
+	    compile_leaf(c, expr);
+	}
+	return true;
+    }
+    default:
+	return true;
+    }
+}
+
+// The walk's between callback
+static void compile_between(void *node, AST_type t, int i, void *data)
+{
+    compiler *c = (compiler *) data;
+    if (t == block_ast) {
+	// the block's procedures are jumped over
+	if (((block_t *) node)->proc_decls.proc_decls != NULL) {
+	    if (i == 1) {
+		emit_forward_jump(c, op_jump);
+	    } else if (i == 2) {
+		patch_here(c, pop_patch(c));
+	    }
+	}
+    } else if (t == stmt_ast && ((stmt_t *) node)->stmt_kind == if_stmt
+	       && i == 1) {
+	// between the then and else branches, jump over the else branch
+	unsigned int cond_jump = pop_patch(c);
+	emit_forward_jump(c, op_jump);
+	patch_here(c, cond_jump);
+    }
+}
+
+// Return the opcode for the arithmetic operator op
+static bytecode_op arith_op(const token_t *op)
+{
+    switch (op->code) {
+    case plussym:
+	return op_add;
+    case minussym:
+	return op_sub;
+    case multsym:
+	return op_mul;
+    default:
+	return op_div;
+    }
+}
+
+// Return the opcode of the jump taken unless the relation op holds
+static bytecode_op rel_op_jump(const token_t *op)
+{
+    switch (op->code) {
+    case eqsym:
+	return op_jump_unless_eq;
+    case neqsym:
+	return op_jump_unless_ne;
+    case ltsym:
+	return op_jump_unless_lt;
+    case leqsym:
+	return op_jump_unless_le;
+    case gtsym:
+	return op_jump_unless_gt;
+    default:
+	return op_jump_unless_ge;
+    }
+}
+
+// The walk's post callback
+static void compile_post(void *node, AST_type t, void *data)
+{
+    compiler *c = (compiler *) data;
+    switch (t) {
+    case block_ast: {
+	block_end end = c->ends[--c->num_ends];
+	emit(c, (end == block_halts) ? op_halt
+	     : (end == block_returns) ? op_return : op_leave, 0, 0, 0);
+	break;
+    }
+    case expr_ast: {
+	expr_t *expr = (expr_t *) node;
+	if (expr->expr_kind == expr_negated) {
+	    emit(c, op_neg, 0, 0, 0);
+	} else if (expr->expr_kind == expr_bin) {
+	    token_t *op = &expr->data.binary.arith_op;
+	    word_type d;
+	    unsigned int words = (op->code == divsym)
+		? constant_divisor(c, expr->data.binary.expr2, &d) : 0;
+	    if (words > 0) {
+		// (dividing by a constant can't fail, and needs no divide)
+		emit(c, op_div_const, 1, take_divisor(c, d, words), 0);
+	    } else {
+		if (op->code == divsym) {
+		    note_loc(c, op->file_loc, NULL);
+		}
+		emit(c, arith_op(op), 0, 0, 0);
+		stack_effect(c, -1);
+	    }
+	}
+	break;
+    }
+    case condition_ast: {
+	condition_t *cond = (condition_t *) node;
+	word_type d;
+	unsigned int words = (cond->cond_kind == ck_db)
+	    ? constant_divisor(c, &cond->data.db_cond.divisor, &d) : 0;
+	if (words > 0) {
+	    emit(c, op_jump_unless_divisible_const, 2,
+		 take_divisor(c, d, words), 0);
+	    push_patch(c, c->bc->length - 1);
+	    stack_effect(c, -1);
+	} else {
+	    if (cond->cond_kind == ck_db) {
+		note_loc(c, cond->data.db_cond.divisor.file_loc, NULL);
+		emit_forward_jump(c, op_jump_unless_divisible);
+	    } else {
+		emit_forward_jump(c,
+				  rel_op_jump(&cond->data.rel_op_cond.rel_op));
+	    }
+	    stack_effect(c, -2);
+	}
+	break;
+    }
+    case stmt_ast: {
+	stmt_t *stmt = (stmt_t *) node;
+	switch (stmt->stmt_kind) {
+	case assign_stmt:
+	    emit_variable(c, op_store, op_store_outer,
+			  stmt->data.assign_stmt.idu);
+	    stack_effect(c, -1);
+	    break;
+	case print_stmt:
+	    emit(c, op_print, 0, 0, 0);
+	    stack_effect(c, -1);
+	    break;
+	case if_stmt:
+	    patch_here(c, pop_patch(c));
+	    break;
+	case while_stmt: {
+	    unsigned int cond_jump = pop_patch(c);
+	    emit(c, op_jump, 1, pop_patch(c), 0);
+	    patch_here(c, cond_jump);
+	    break;
+	}
+	default:
+	    break;
+	}
+	break;
+    }
+    default:
+	break;
+    }
+}
+
+// Requires: prog has been scope checked without errors
+// Return the bytecode for prog (which starts running at its first word)
+bytecode *bytecode_compile(block_t *prog)
+{
+    compiler c = { 0 };
+    c.prog = prog;
+    c.bc = (bytecode *) calloc(1, sizeof(bytecode));
+    if (c.bc == NULL) {
+	bail_with_error("No space to compile the program to bytecode!");
+    }
+    ast_visitor v = { compile_pre, compile_between, compile_post, &c };
+    ast_walk(prog, block_ast, &v);
+
+    for (size_t i = 0; i < c.entries.size; i++) {
+	free(c.entries.entries[i].value);
+    }
+    ptr_map_free(&c.entries);
+    ptr_map_free(&c.constants);
+    free(c.patches);
+    free(c.ends);
+    return c.bc;
+}
+
+// Requires: d != 0
+// Return the description of the divisor d
+bytecode_divisor bytecode_divisor_make(word_type d)
+{
+    bytecode_divisor dv = { d, 0, 0, 0, 1, 0, 0 };
+    // |d| (where the most negative word's is 2 to the 31)
+    uint32_t ad = (d < 0) ? 0u - (uint32_t) d : (uint32_t) d;
+    if ((ad & (ad - 1)) == 0) {
+	while ((1u << dv.shift) != ad) {
+	    dv.shift++;
+	}
+	return dv;
+    }
+    // the multiplier's excess, times |a| (at most 2 to the 31), must be
+    // below 2 to the (32 + shift) for the quotient to be right; this
+    // holds once 2 to the (shift + 1) exceeds |d|, so the multiplier
+    // is always a word
+    for (;; dv.shift++) {
+	uint64_t p = (uint64_t) 1 << (32 + dv.shift);
+	uint64_t m = (p + ad - 1) / ad;
+	if (m * ad - p < ((uint64_t) 2 << dv.shift)) {
+	    dv.multiplier = (uint32_t) m;
+	    break;
+	}
+    }
+    while (((ad >> dv.zeros) & 1) == 0) {
+	dv.zeros++;
+    }
+    // (Newton's method, where each step doubles the bits that are right,
+    // starting with 3, as odd * odd is 1 modulo 8)
+    uint32_t odd = ad >> dv.zeros;
+    dv.inverse = odd;
+    for (int i = 0; i < 4; i++) {
+	dv.inverse *= 2 - odd * dv.inverse;
+    }
+    uint32_t m = 0x7FFFFFFFu / ad;
+    dv.bias = m << dv.zeros;
+    dv.limit = 2 * m;
+    return dv;
+}
+
+// Return the number of operands of the instructions with opcode op
+unsigned int bytecode_num_operands(bytecode_op op)
+{
+    static const unsigned char num_operands[BYTECODE_NUM_OPS] = {
+	[op_push] = 1, [op_load] = 1, [op_load_outer] = 2, [op_store] = 1,
+	[op_store_outer] = 2, [op_read] = 2, [op_jump] = 1,
+	[op_jump_unless_eq] = 1, [op_jump_unless_ne] = 1,
+	[op_jump_unless_lt] = 1, [op_jump_unless_le] = 1,
+	[op_jump_unless_gt] = 1, [op_jump_unless_ge] = 1,
+	[op_jump_unless_divisible] = 1, [op_call] = 2, [op_enter] = 1,
+	[op_block] = 1, [op_div_const] = 1,
+	[op_jump_unless_divisible_const] = 2
+    };
+    return num_operands[op];
+}
+
+// Requires: the instruction at pc in bc can fail at run-time
+// Return the source location of that instruction
+const bytecode_loc *bytecode_location(const bytecode *bc, unsigned int pc)
+{
+    unsigned int lo = 0, hi = bc->num_locs;
+    while (hi - lo > 1) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (bc->locs[mid].pc <= pc) {
+	    lo = mid;
+	} else {
+	    hi = mid;
+	}
+    }
+    return &bc->locs[lo];
+}
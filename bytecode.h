@@ -0,0 +1,152 @@
+#ifndef _BYTECODE_H
+#define _BYTECODE_H
+#include <stdint.h>
+#include "ast.h"
+#include "machine_types.h"
+
+// A compact linear bytecode for SPL programs, for a stack machine
+// (see vm.h), and the compiler from scope checked ASTs to it.
+//
+// The code is an array of words: each instruction is its opcode followed
+// by its operands. Expressions push their values on an operand stack.
+// Constants are inlined (as push instructions), and each variable is
+// addressed by its lexical address: its number of levels outward and
+// its offset (offset_count) in the activation record of that level.
+// Each procedure's code starts with op_enter, and each block statement's
+// with op_block, giving the number of slots in its activation records
+// (one for each constant and variable declared in its block).
+//
+// A division or divisibility test whose divisor is a constant (other
+// than 0) is compiled to an instruction that needs no divide: its
+// divisor is described (see bytecode_divisor) by an entry in the
+// program's table of divisors, so that the quotient is found with a
+// multiplication by a fixed-point reciprocal and shifts, and whether a
+// number is divisible with a multiplication by the inverse of the
+// divisor's odd part (or, for powers of two, with shifts and masks).
+
+// The opcodes; the operands are listed after each one
+typedef enum {
+    op_halt,               // stop running
+    op_push,               // value: push value
+    op_load,               // offset: push the variable at offset
+                           // (in the activation record in use)
+    op_load_outer,         // levels offset: push the variable there
+    op_store,              // offset: pop into the variable at offset
+    op_store_outer,        // levels offset: pop into the variable there
+    op_read,               // levels offset: read a character into there
+    op_print,              // pop and print
+    op_add, op_sub, op_mul, op_div, // pop b, pop a, and push a op b
+    op_neg,                // pop a and push -a
+    op_jump,               // target: go to target
+    // target: pop b, pop a, and go to target unless a op b
+    op_jump_unless_eq, op_jump_unless_ne, op_jump_unless_lt,
+    op_jump_unless_le, op_jump_unless_gt, op_jump_unless_ge,
+    op_jump_unless_divisible, // target: ... unless a is divisible by b
+    op_call,               // levels target: call the procedure at target
+    op_enter,              // size: start the called procedure's record
+    op_return,             // return from the procedure
+    op_block,              // size: start a block's record
+    op_leave,              // leave the block
+    op_assign_constant,    // report that a constant is assigned to
+    op_div_const,          // divisor: pop a, and push a / that divisor
+    // divisor target: pop a, and go to target unless a is divisible
+    // by that divisor (of the divisors table)
+    op_jump_unless_divisible_const
+} bytecode_op;
+
+// The number of opcodes
+#define BYTECODE_NUM_OPS (op_jump_unless_divisible_const + 1)
+
+// The source location of an instruction that can fail at run-time
+// (and, for op_assign_constant, the constant's name)
+typedef struct {
+    unsigned int pc;
+    file_location loc;
+    const char *name;
+} bytecode_loc;
+
+// A constant divisor d (not 0), with what is needed to divide by it
+// (where |a| <= 2 to the 31, the arithmetic is on unsigned words, and
+// the product with the multiplier has 64 bits).
+// If |d| is a power of two, 2 to the shift, then multiplier is 0 and
+//   |a / d| = |a| >> shift,   a is divisible by d if a's low shift bits
+//                             are all 0.
+// Otherwise, multiplier is 2 to the (32 + shift) divided by |d| and
+// rounded up, |d| is an odd number times 2 to the zeros, inverse is that
+// odd number's inverse (modulo 2 to the 32), and with m the largest
+// quotient of a word and |d|, bias is m times 2 to the zeros and limit
+// is 2 * m, so that
+//   |a / d| = (|a| * multiplier) >> (32 + shift),
+//   a is divisible by d if rotate_right(a * inverse + bias, zeros) <= limit
+// (as the multiples of |d| times inverse are 2 to the zeros times each
+// number from -m to m, and no other word's are). The quotient is
+// negative if the signs of a and d differ.
+typedef struct {
+    word_type divisor;
+    unsigned int shift;
+    uint32_t multiplier;
+    unsigned int zeros;
+    uint32_t inverse;
+    uint32_t bias;
+    uint32_t limit;
+} bytecode_divisor;
+
+// A compiled program
+typedef struct {
+    word_type *code;
+    unsigned int length;     // the number of words in code
+    unsigned int max_depth;  // the most values on the operand stack
+    bytecode_loc *locs;      // sorted by pc
+    unsigned int num_locs;
+    bytecode_divisor *divisors; // for op_div_const and its jump
+    unsigned int num_divisors;
+} bytecode;
+
+// Requires: prog has been scope checked without errors
+// Return the bytecode for prog (which starts running at its first word)
+extern bytecode *bytecode_compile(block_t *prog);
+
+// Requires: d != 0
+// Return the description of the divisor d
+extern bytecode_divisor bytecode_divisor_make(word_type d);
+
+// Requires: d was returned by bytecode_divisor_make
+// Return a / d, without dividing (as the vm does, in line)
+static inline word_type bytecode_divide_const(const bytecode_divisor *d,
+					      word_type a)
+{
+    // (all 1s if a is negative, so that xoring and subtracting it
+    // negates, and likewise for the quotient)
+    uint32_t neg = 0u - ((uint32_t) a >> 31);
+    uint32_t abs = ((uint32_t) a ^ neg) - neg;
+    uint32_t q = (d->multiplier == 0) ? abs >> d->shift
+	: (uint32_t) (((uint64_t) abs * d->multiplier) >> (32 + d->shift));
+    uint32_t sign = (d->divisor < 0) ? ~neg : neg;
+    return (word_type) ((q ^ sign) - sign);
+}
+
+// Requires: d was returned by bytecode_divisor_make
+// Return true if a is divisible by d, without dividing
+// (as the vm does, in line)
+static inline bool bytecode_divisible_const(const bytecode_divisor *d,
+					    word_type a)
+{
+    if (d->multiplier == 0) {
+	return ((uint32_t) a & ((1u << d->shift) - 1)) == 0;
+    }
+    uint32_t x = (uint32_t) a * d->inverse + d->bias;
+    if (d->zeros > 0) {
+	x = (x >> d->zeros) | (x << (32 - d->zeros));
+    }
+    return x <= d->limit;
+}
+
+// Return the number of operands of the instructions with opcode op
+extern unsigned int bytecode_num_operands(bytecode_op op);
+
+// Requires: the instruction at pc in bc can fail at run-time
+// Return the source location of that instruction
+extern const bytecode_loc *bytecode_location(const bytecode *bc,
+					     unsigned int pc);
+
+#endif
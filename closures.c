@@ -0,0 +1,997 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "closures.h"
+#include "ast_walk.h"
+#include "parser.h"
+#include "ptr_map.h"
+#include "utilities.h"
+#include "spl.tab.h"
+
+// What there is no space to do, if growing an array fails
+#define PURPOSE "compile the program to closures"
+
+// Expressions are closures nested up to this many levels deep;
+// the parts of an expression nested deeper are evaluated with an
+// explicit stack (see e_deep)
+#define MAX_CLOSURE_DEPTH 256
+
+// Each activation record starts with a header of HEADER_WORDS words:
+// its static link (the start of the record of the block it is declared
+// in) and the start of the record in use before it; its slots (for the
+// constants and variables of its block) follow
+#define HEADER_WORDS 2
+#define STATIC_LINK 0
+#define DYNAMIC_LINK 1
+
+// The most words that the stack of activation records may hold
+#define MAX_STACK_WORDS (1u << 24)
+
+typedef struct cl_expr cl_expr;
+typedef struct cl_cond cl_cond;
+typedef struct cl_stmt cl_stmt;
+
+// A step of a deep expression's evaluation: push the value of operand,
+// or (if operand is NULL) apply the operator op (0 for negation)
+// to the values on top of the stack
+typedef struct {
+    const cl_expr *operand;
+    int op;
+    const file_location *loc;  // for a division
+} cl_step;
+
+// The operands captured by the closure of a binary operator or relation,
+// by their shapes: the first is a local variable (a variable of the
+// block in use, at offset1) or any expression (a), and the second is
+// a local variable (at offset2), a constant (value), or any expression (b)
+typedef enum {
+    shape_xx, shape_ll, shape_lc, shape_lx, shape_xl, shape_xc
+} operands_shape;
+
+#define NUM_SHAPES (shape_xc + 1)
+
+typedef struct {
+    const cl_expr *a, *b;
+    unsigned int offset1, offset2;
+    word_type value;
+    const file_location *loc;  // for a division (or divisibility test)
+} cl_operands;
+
+// An expression's closure: eval returns its value
+struct cl_expr {
+    word_type (*eval)(const cl_expr *e);
+    union {
+	word_type value;                        // e_const
+	struct {
+	    unsigned int levels, offset;
+	} var;                                  // e_local, e_outer
+	cl_operands bin;                        // e_neg (only a), e_add, ...
+	struct {
+	    cl_step *steps;
+	    unsigned int num_steps;
+	    word_type *values;                  // (its stack)
+	} deep;                                 // e_deep
+    } data;
+};
+
+// A condition's closure: holds returns whether it holds
+struct cl_cond {
+    bool (*holds)(const cl_cond *c);
+    cl_operands bin;
+};
+
+// A procedure: where its code starts and the size of its records
+typedef struct {
+    const cl_stmt *entry;
+    unsigned int size;
+} cl_proc;
+
+// A statement's closure: exec runs it and returns the statement
+// to run next (NULL when the program is done)
+struct cl_stmt {
+    const cl_stmt *(*exec)(const cl_stmt *s);
+    const cl_stmt *next;    // what runs after it
+    const cl_stmt *target;  // for s_branch, what runs if cond holds
+    const cl_cond *cond;
+    const cl_expr *expr;
+    unsigned int levels, offset;
+    unsigned int offset2;   // for s_add_local, the variable added to
+    word_type value;        // and what is added
+    const cl_proc *proc;    // for s_call
+    unsigned int size;      // for s_block, the size of its records
+    const file_location *loc;
+    const char *name;       // for s_assign_constant
+};
+
+struct closure_program {
+    const cl_stmt *start;
+};
+
+// The stack of activation records: the record in use starts at fp
+// (its slots are at slots), and the next one goes at sp
+static word_type *stack = NULL;
+static size_t stack_size = 0;
+static size_t sp = 0;
+static size_t fp = 0;
+static word_type *slots = NULL;
+
+// The statements to return to, for the calls in progress
+static const cl_stmt **returns = NULL;
+static size_t returns_size = 0;
+static size_t returns_top = 0;
+
+// Report the run-time error described by fmt (which may use name) at loc
+static void run_error(const file_location *loc, const char *fmt,
+		      const char *name)
+{
+    errno = 0;
+    bail_with_prog_error(*loc, fmt, name);
+}
+
+// Make the stack hold at least need words,
+// reporting a run-time error at loc if it can't
+static void grow_stack(size_t need, const file_location *loc)
+{
+    if (need > MAX_STACK_WORDS) {
+	run_error(loc, "the run-time stack is full (too many nested calls)!",
+		  NULL);
+    }
+    size_t new_size = (stack_size == 0) ? 1024 : stack_size;
+    while (new_size < need) {
+	new_size *= 2;
+    }
+    stack = (word_type *) realloc(stack, new_size * sizeof(word_type));
+    if (stack == NULL) {
+	bail_with_error("No space for the run-time stack!");
+    }
+    stack_size = new_size;
+}
+
+// Return the address of the slot at offset in the record levels
+// static links out from the one in use
+static inline word_type *outer_slot(unsigned int levels, unsigned int offset)
+{
+    size_t f = fp;
+    for (; levels > 0; levels--) {
+	f = (size_t) stack[f + STATIC_LINK];
+    }
+    return &stack[f + HEADER_WORDS + offset];
+}
+
+// The arithmetic on words (which wraps around as in two's complement)
+static inline word_type add(word_type a, word_type b)
+{
+    return (word_type) ((unsigned int) a + (unsigned int) b);
+}
+
+static inline word_type sub(word_type a, word_type b)
+{
+    return (word_type) ((unsigned int) a - (unsigned int) b);
+}
+
+static inline word_type mul(word_type a, word_type b)
+{
+    return (word_type) ((unsigned int) a * (unsigned int) b);
+}
+
+// Return a / b, reporting division by zero at loc
+static inline word_type divide(word_type a, word_type b,
+			       const file_location *loc)
+{
+    if (b == 0) {
+	run_error(loc, "division by zero!", NULL);
+    }
+    // (the most negative word divided by -1 wraps around to itself)
+    return (b == -1) ? sub(0, a) : a / b;
+}
+
+// Return whether a is divisible by b, reporting division by zero at loc
+static inline bool divisible(word_type a, word_type b,
+			     const file_location *loc)
+{
+    if (b == 0) {
+	run_error(loc, "division by zero!", NULL);
+    }
+    return b == -1 || a % b == 0;
+}
+
+// The closures of the expressions
+
+static word_type e_const(const cl_expr *e)
+{
+    return e->data.value;
+}
+
+static word_type e_local(const cl_expr *e)
+{
+    return slots[e->data.var.offset];
+}
+
+static word_type e_outer(const cl_expr *e)
+{
+    return *outer_slot(e->data.var.levels, e->data.var.offset);
+}
+
+static word_type e_neg(const cl_expr *e)
+{
+    return sub(0, e->data.bin.a->eval(e->data.bin.a));
+}
+
+// The operands (in the cl_operands o), by their shapes
+#define FIRST_L slots[o->offset1]
+#define FIRST_X o->a->eval(o->a)
+#define SECOND_L slots[o->offset2]
+#define SECOND_C o->value
+#define SECOND_X o->b->eval(o->b)
+
+// The closure name, whose parameter is param and whose operands are ops,
+// that returns result (of type) computed from a and b
+// (the first operand is evaluated first)
+#define BIN_CLOSURE(type, name, param, ops, first, second, result)	\
+    static type name(param)						\
+    {									\
+	const cl_operands *o = (ops);					\
+	word_type a = first;						\
+	word_type b = second;						\
+	return result;							\
+    }
+
+// The closures for each shape of operands (with the suffixes of the
+// shapes' names), in the order of operands_shape
+#define BIN_CLOSURES(type, name, param, ops, result)			\
+    BIN_CLOSURE(type, name, param, ops, FIRST_X, SECOND_X, result)	\
+    BIN_CLOSURE(type, name##_ll, param, ops, FIRST_L, SECOND_L, result) \
+    BIN_CLOSURE(type, name##_lc, param, ops, FIRST_L, SECOND_C, result) \
+    BIN_CLOSURE(type, name##_lx, param, ops, FIRST_L, SECOND_X, result) \
+    BIN_CLOSURE(type, name##_xl, param, ops, FIRST_X, SECOND_L, result) \
+    BIN_CLOSURE(type, name##_xc, param, ops, FIRST_X, SECOND_C, result)
+
+#define SHAPES(name)							\
+    { name, name##_ll, name##_lc, name##_lx, name##_xl, name##_xc }
+
+#define ARITH_CLOSURES(name, result)					\
+    BIN_CLOSURES(word_type, name, const cl_expr *e, &e->data.bin, result)
+
+ARITH_CLOSURES(e_add, add(a, b))
+ARITH_CLOSURES(e_sub, sub(a, b))
+ARITH_CLOSURES(e_mul, mul(a, b))
+ARITH_CLOSURES(e_div, divide(a, b, o->loc))
+
+// The closures of + - * / (in that order) for each shape of operands
+static word_type (*const arith_closures[][NUM_SHAPES])(const cl_expr *) = {
+    SHAPES(e_add), SHAPES(e_sub), SHAPES(e_mul), SHAPES(e_div)
+};
+
+// Return the value of the binary operator op applied to a and b
+static word_type arith(int op, word_type a, word_type b,
+		       const file_location *loc)
+{
+    switch (op) {
+    case plussym:
+	return add(a, b);
+    case minussym:
+	return sub(a, b);
+    case multsym:
+	return mul(a, b);
+    default:
+	return divide(a, b, loc);
+    }
+}
+
+static word_type e_deep(const cl_expr *e)
+{
+    word_type *v = e->data.deep.values;
+    size_t top = 0;
+    for (unsigned int i = 0; i < e->data.deep.num_steps; i++) {
+	const cl_step *step = &e->data.deep.steps[i];
+	if (step->operand != NULL) {
+	    v[top++] = step->operand->eval(step->operand);
+	} else if (step->op == 0) {
+	    v[top - 1] = sub(0, v[top - 1]);
+	} else {
+	    top--;
+	    v[top - 1] = arith(step->op, v[top - 1], v[top], step->loc);
+	}
+    }
+    return v[0];
+}
+
+// The closures of the conditions
+
+#define COND_CLOSURES(name, result)					\
+    BIN_CLOSURES(bool, name, const cl_cond *c, &c->bin, result)
+
+COND_CLOSURES(c_eq, a == b)
+COND_CLOSURES(c_ne, a != b)
+COND_CLOSURES(c_lt, a < b)
+COND_CLOSURES(c_le, a <= b)
+COND_CLOSURES(c_gt, a > b)
+COND_CLOSURES(c_ge, a >= b)
+COND_CLOSURES(c_divisible, divisible(a, b, o->loc))
+
+// The closures of == != < <= > >= and divisibility (in that order)
+// for each shape of operands
+static bool (*const cond_closures[][NUM_SHAPES])(const cl_cond *) = {
+    SHAPES(c_eq), SHAPES(c_ne), SHAPES(c_lt), SHAPES(c_le), SHAPES(c_gt),
+    SHAPES(c_ge), SHAPES(c_divisible)
+};
+
+// The closures of the statements
+
+static const cl_stmt *s_assign_local(const cl_stmt *s)
+{
+    slots[s->offset] = s->expr->eval(s->expr);
+    return s->next;
+}
+
+static const cl_stmt *s_assign_outer(const cl_stmt *s)
+{
+    word_type value = s->expr->eval(s->expr);
+    *outer_slot(s->levels, s->offset) = value;
+    return s->next;
+}
+
+// x := y + value (or - value), for local variables x and y
+static const cl_stmt *s_add_local(const cl_stmt *s)
+{
+    slots[s->offset] = add(slots[s->offset2], s->value);
+    return s->next;
+}
+
+static const cl_stmt *s_assign_constant(const cl_stmt *s)
+{
+    run_error(s->loc, "cannot assign to constant \"%s\"!", s->name);
+    return NULL;
+}
+
+static const cl_stmt *s_read(const cl_stmt *s)
+{
+    int ch = getchar();
+    *outer_slot(s->levels, s->offset) = (ch == EOF) ? -1 : ch;
+    return s->next;
+}
+
+static const cl_stmt *s_print(const cl_stmt *s)
+{
+    printf("%d\n", s->expr->eval(s->expr));
+    return s->next;
+}
+
+// an if's or a while's test
+static const cl_stmt *s_branch(const cl_stmt *s)
+{
+    return s->cond->holds(s->cond) ? s->target : s->next;
+}
+
+static const cl_stmt *s_call(const cl_stmt *s)
+{
+    const cl_proc *p = s->proc;
+    size_t need = sp + HEADER_WORDS + p->size;
+    if (need > stack_size) {
+	grow_stack(need, s->loc);
+    }
+    if (returns_top == returns_size) {
+	returns_size = (returns_size == 0) ? 256 : 2 * returns_size;
+	returns = (const cl_stmt **)
+	    realloc(returns, returns_size * sizeof(const cl_stmt *));
+	if (returns == NULL) {
+	    bail_with_error("No space for the return stack!");
+	}
+    }
+    returns[returns_top++] = s->next;
+    size_t f = fp;
+    for (unsigned int l = s->levels; l > 0; l--) {
+	f = (size_t) stack[f + STATIC_LINK];
+    }
+    stack[sp + STATIC_LINK] = (word_type) f;
+    stack[sp + DYNAMIC_LINK] = (word_type) fp;
+    fp = sp;
+    slots = &stack[fp + HEADER_WORDS];
+    memset(slots, 0, p->size * sizeof(word_type));
+    sp = need;
+    return p->entry;
+}
+
+static const cl_stmt *s_return(const cl_stmt *s)
+{
+    (void) s;
+    sp = fp;
+    fp = (size_t) stack[fp + DYNAMIC_LINK];
+    slots = &stack[fp + HEADER_WORDS];
+    return returns[--returns_top];
+}
+
+static const cl_stmt *s_block(const cl_stmt *s)
+{
+    size_t need = sp + HEADER_WORDS + s->size;
+    if (need > stack_size) {
+	grow_stack(need, s->loc);
+    }
+    stack[sp + STATIC_LINK] = (word_type) fp;
+    stack[sp + DYNAMIC_LINK] = (word_type) fp;
+    fp = sp;
+    slots = &stack[fp + HEADER_WORDS];
+    memset(slots, 0, s->size * sizeof(word_type));
+    sp = need;
+    return s->next;
+}
+
+static const cl_stmt *s_leave(const cl_stmt *s)
+{
+    sp = fp;
+    fp = (size_t) stack[fp + DYNAMIC_LINK];
+    slots = &stack[fp + HEADER_WORDS];
+    return s->next;
+}
+
+static const cl_stmt *s_halt(const cl_stmt *s)
+{
+    (void) s;
+    return NULL;
+}
+
+// The compiler
+
+// What a block's code ends with
+typedef enum { block_halts, block_returns, block_leaves } block_end;
+
+// A list of the fields (of statements already compiled) that are to
+// point to a statement not compiled yet
+typedef struct patch_cell {
+    const cl_stmt **field;
+    struct patch_cell *next;
+} patch_cell;
+
+typedef struct {
+    patch_cell *head;
+    patch_cell *tail;
+} patch_list;
+
+// The closure of an expression compiled but not yet used, and its height
+// (if that is over MAX_CLOSURE_DEPTH, closure is NULL)
+typedef struct {
+    cl_expr *closure;
+    expr_t *expr;
+    unsigned int height;
+} operand;
+
+// The state of the compiler (which compiles one program at a time)
+typedef struct {
+    block_t *prog;
+    ptr_map constants;        // the id_attrs of each constant -> its def
+    ptr_map procs;            // the id_attrs of each procedure -> cl_proc
+    ptr_map shallow;          // the operands of deep expressions -> closures
+    cl_proc *proc_body_next;  // the procedure whose block is next, if any
+    patch_list pending;       // the fields to point to the next statement
+    const cl_cond *cond;      // the condition compiled last
+    operand *operands;
+    unsigned int num_operands, operands_size;
+    cl_stmt **branches;       // the ifs and whiles being compiled
+    unsigned int num_branches, branches_size;
+    patch_list *saved;        // the pending lists set aside
+    unsigned int num_saved, saved_size;
+    block_end *ends;          // the ends of the blocks being compiled
+    unsigned int num_ends, ends_size;
+} compiler;
+
+// Return a new zeroed object of size bytes
+static void *new_closure(size_t size)
+{
+    void *p = calloc(1, size);
+    if (p == NULL) {
+	bail_with_error("No space to compile the program to closures!");
+    }
+    return p;
+}
+
+// Return the list of just field
+static patch_list patch_list_of(const cl_stmt **field)
+{
+    patch_cell *cell = (patch_cell *) new_closure(sizeof(patch_cell));
+    cell->field = field;
+    return (patch_list) { cell, cell };
+}
+
+// Return the list of the fields of a, then those of b
+static patch_list patch_list_append(patch_list a, patch_list b)
+{
+    if (a.head == NULL) {
+	return b;
+    }
+    if (b.head != NULL) {
+	a.tail->next = b.head;
+	a.tail = b.tail;
+    }
+    return a;
+}
+
+// Make each field in the list l point to s, and free the list
+static void patch(patch_list l, const cl_stmt *s)
+{
+    patch_cell *cell = l.head;
+    while (cell != NULL) {
+	patch_cell *next = cell->next;
+	*cell->field = s;
+	free(cell);
+	cell = next;
+    }
+}
+
+// Return a new statement that runs by exec, for the source at loc,
+// making the pending fields point to it
+static cl_stmt *new_stmt(compiler *c,
+			 const cl_stmt *(*exec)(const cl_stmt *s),
+			 file_location *loc)
+{
+    cl_stmt *s = (cl_stmt *) new_closure(sizeof(cl_stmt));
+    s->exec = exec;
+    s->loc = loc;
+    patch(c->pending, s);
+    c->pending = (patch_list) { NULL, NULL };
+    return s;
+}
+
+// Set the list of pending fields aside, and start the list l
+static void save_pending(compiler *c, patch_list l)
+{
+    reserve_array((void **) &c->saved, &c->saved_size, sizeof(patch_list),
+		  c->num_saved + 1, PURPOSE);
+    c->saved[c->num_saved++] = c->pending;
+    c->pending = l;
+}
+
+// Push the operand for expr, whose closure is e and height is height
+static void push_operand(compiler *c, cl_expr *e, expr_t *expr,
+			 unsigned int height)
+{
+    reserve_array((void **) &c->operands, &c->operands_size, sizeof(operand),
+		  c->num_operands + 1, PURPOSE);
+    c->operands[c->num_operands++] = (operand) { e, expr, height };
+}
+
+// Return the closure for the expression that is a name or a number
+static cl_expr *compile_leaf(compiler *c, expr_t *expr)
+{
+    cl_expr *e = (cl_expr *) new_closure(sizeof(cl_expr));
+    if (expr->expr_kind == expr_number) {
+	e->eval = e_const;
+	e->data.value = expr->data.number.value;
+	return e;
+    }
+    id_use *idu = expr->data.ident.idu;
+    if (idu->attrs->kind == constant_idk) {
+	const_def_t *def = (const_def_t *)
+	    ptr_map_get(&c->constants, idu->attrs);
+	e->eval = e_const;
+	e->data.value = def->number.value;
+    } else {
+	e->eval = (idu->levelsOutward == 0) ? e_local : e_outer;
+	e->data.var.levels = idu->levelsOutward;
+	e->data.var.offset = idu->attrs->offset_count;
+    }
+    return e;
+}
+
+// Capture the operands a and b in o (freeing those that are captured
+// other than by their closures) and return their shape
+static operands_shape capture(cl_operands *o, const cl_expr *a,
+			      const cl_expr *b)
+{
+    bool first_local = (a->eval == e_local);
+    operands_shape shape;
+    if (first_local) {
+	o->offset1 = a->data.var.offset;
+	free((cl_expr *) a);
+    } else {
+	o->a = a;
+    }
+    if (b->eval == e_local) {
+	shape = first_local ? shape_ll : shape_xl;
+	o->offset2 = b->data.var.offset;
+	free((cl_expr *) b);
+    } else if (b->eval == e_const) {
+	shape = first_local ? shape_lc : shape_xc;
+	o->value = b->data.value;
+	free((cl_expr *) b);
+    } else {
+	shape = first_local ? shape_lx : shape_xx;
+	o->b = b;
+    }
+    return shape;
+}
+
+// Return the closure for a op b, where op is an arithmetic operator at loc
+static cl_expr *compile_arith(int op, const cl_expr *a, const cl_expr *b,
+			      file_location *loc)
+{
+    // (the operands of + and * may be swapped if one is a constant,
+    // as evaluating a constant can't fail)
+    if ((op == plussym || op == multsym)
+	&& a->eval == e_const && b->eval != e_const) {
+	const cl_expr *t = a;
+	a = b;
+	b = t;
+    }
+    cl_expr *e = (cl_expr *) new_closure(sizeof(cl_expr));
+    int i = (op == plussym) ? 0 : (op == minussym) ? 1 : (op == multsym) ? 2
+	: 3;
+    e->eval = arith_closures[i][capture(&e->data.bin, a, b)];
+    e->data.bin.loc = loc;
+    return e;
+}
+
+// Compile the expression expr (whose operands' closures, or deep parts,
+// are on top of the stack of operands), replacing its operands by it
+static void compile_expr(compiler *c, expr_t *expr)
+{
+    switch (expr->expr_kind) {
+    case expr_number: case expr_ident:
+	push_operand(c, compile_leaf(c, expr), expr, 1);
+	break;
+    case expr_negated: {
+	operand x = c->operands[--c->num_operands];
+	if (x.height < MAX_CLOSURE_DEPTH) {
+	    cl_expr *e = (cl_expr *) new_closure(sizeof(cl_expr));
+	    e->eval = e_neg;
+	    e->data.bin.a = x.closure;
+	    push_operand(c, e, expr, x.height + 1);
+	} else {
+	    if (x.closure != NULL) {
+		ptr_map_put(&c->shallow, x.expr, x.closure);
+	    }
+	    push_operand(c, NULL, expr, x.height + 1);
+	}
+	break;
+    }
+    case expr_bin: {
+	operand b = c->operands[--c->num_operands];
+	operand a = c->operands[--c->num_operands];
+	unsigned int height = 1 + ((a.height > b.height) ? a.height
+				   : b.height);
+	binary_op_expr_t *bin = &expr->data.binary;
+	if (height <= MAX_CLOSURE_DEPTH) {
+	    push_operand(c, compile_arith(bin->arith_op.code, a.closure,
+					  b.closure, &bin->arith_op.file_loc),
+			 expr, height);
+	} else {
+	    if (a.closure != NULL) {
+		ptr_map_put(&c->shallow, a.expr, a.closure);
+	    }
+	    if (b.closure != NULL) {
+		ptr_map_put(&c->shallow, b.expr, b.closure);
+	    }
+	    push_operand(c, NULL, expr, height);
+	}
+	break;
+    }
+    }
+}
+
+// Return the closure of an expression nested too deeply for closures
+// that call each other: the steps of its evaluation (in postfix order)
+static cl_expr *compile_deep(compiler *c, expr_t *expr)
+{
+    cl_expr *e = (cl_expr *) new_closure(sizeof(cl_expr));
+    e->eval = e_deep;
+    unsigned int steps_size = 0, depth = 0, max_depth = 0;
+    // the expressions still to compile (those to apply are tagged by NULL
+    // after them, as their operands are compiled first)
+    expr_t **work = NULL;
+    unsigned int work_top = 0, work_size = 0;
+    reserve_array((void **) &work, &work_size, sizeof(expr_t *), 1, PURPOSE);
+    work[work_top++] = expr;
+    while (work_top > 0) {
+	expr_t *x = work[--work_top];
+	reserve_array((void **) &e->data.deep.steps, &steps_size,
+		      sizeof(cl_step), e->data.deep.num_steps + 1, PURPOSE);
+	cl_step *step = &e->data.deep.steps[e->data.deep.num_steps];
+	cl_expr *closure;
+	if (x == NULL) {
+	    // apply the operator of the expression below the tag
+	    x = work[--work_top];
+	    *step = (x->expr_kind == expr_negated) ? (cl_step) { NULL, 0, NULL }
+		: (cl_step) { NULL, x->data.binary.arith_op.code,
+			      &x->data.binary.arith_op.file_loc };
+	    if (x->expr_kind == expr_bin) {
+		depth--;
+	    }
+	    e->data.deep.num_steps++;
+	} else if ((closure = (cl_expr *) ptr_map_get(&c->shallow, x))
+		   != NULL) {
+	    *step = (cl_step) { closure, 0, NULL };
+	    e->data.deep.num_steps++;
+	    if (++depth > max_depth) {
+		max_depth = depth;
+	    }
+	} else {
+	    reserve_array((void **) &work, &work_size, sizeof(expr_t *),
+			  work_top + 4, PURPOSE);
+	    work[work_top++] = x;
+	    work[work_top++] = NULL;
+	    if (x->expr_kind == expr_negated) {
+		work[work_top++] = x->data.negated.expr;
+	    } else {
+		work[work_top++] = x->data.binary.expr2;
+		work[work_top++] = x->data.binary.expr1;
+	    }
+	}
+    }
+    free(work);
+    e->data.deep.values = (word_type *)
+	new_closure(max_depth * sizeof(word_type));
+    return e;
+}
+
+// Pop the closure of the expression compiled last
+static const cl_expr *pop_expr(compiler *c)
+{
+    operand x = c->operands[--c->num_operands];
+    return (x.closure != NULL) ? x.closure : compile_deep(c, x.expr);
+}
+
+// Compile the condition cond (whose expressions' closures are on top
+// of the stack of operands)
+static void compile_condition(compiler *c, condition_t *cond)
+{
+    const cl_expr *b = pop_expr(c);
+    const cl_expr *a = pop_expr(c);
+    cl_cond *cc = (cl_cond *) new_closure(sizeof(cl_cond));
+    int i = 6;  // (divisibility)
+    if (cond->cond_kind == ck_rel) {
+	int rel_op = cond->data.rel_op_cond.rel_op.code;
+	// (a constant on the left is moved to the right,
+	// with the relation turned around)
+	if (a->eval == e_const && b->eval != e_const) {
+	    const cl_expr *t = a;
+	    a = b;
+	    b = t;
+	    rel_op = (rel_op == ltsym) ? gtsym : (rel_op == leqsym) ? geqsym
+		: (rel_op == gtsym) ? ltsym : (rel_op == geqsym) ? leqsym
+		: rel_op;
+	}
+	i = (rel_op == eqsym) ? 0 : (rel_op == neqsym) ? 1
+	    : (rel_op == ltsym) ? 2 : (rel_op == leqsym) ? 3
+	    : (rel_op == gtsym) ? 4 : 5;
+    } else {
+	cc->bin.loc = &cond->data.db_cond.divisor.file_loc;
+    }
+    cc->holds = cond_closures[i][capture(&cc->bin, a, b)];
+    c->cond = cc;
+}
+
+// Compile the assignment statement stmt
+// (whose expression's closure is on top of the stack of operands)
+static void compile_assign(compiler *c, stmt_t *stmt)
+{
+    id_use *idu = stmt->data.assign_stmt.idu;
+    const cl_expr *e = pop_expr(c);
+    cl_stmt *s;
+    if (idu->levelsOutward == 0
+	&& (e->eval == e_add_lc || e->eval == e_sub_lc)) {
+	s = new_stmt(c, s_add_local, &stmt->file_loc);
+	s->offset2 = e->data.bin.offset1;
+	s->value = (e->eval == e_add_lc) ? e->data.bin.value
+	    : sub(0, e->data.bin.value);
+	free((cl_expr *) e);
+    } else {
+	s = new_stmt(c, (idu->levelsOutward == 0) ? s_assign_local
+		     : s_assign_outer, &stmt->file_loc);
+	s->expr = e;
+    }
+    s->levels = idu->levelsOutward;
+    s->offset = idu->attrs->offset_count;
+    c->pending = patch_list_of(&s->next);
+}
+
+// Compile the start of stmt (what comes before its children)
+// and return false if it has no children to compile
+static bool compile_stmt_start(compiler *c, stmt_t *stmt)
+{
+    cl_stmt *s;
+    switch (stmt->stmt_kind) {
+    case assign_stmt: {
+	assign_stmt_t *as = &stmt->data.assign_stmt;
+	if (as->idu->attrs->kind != variable_idk) {
+	    s = new_stmt(c, s_assign_constant, &stmt->file_loc);
+	    s->name = as->name;
+	    return false;
+	}
+	return true;
+    }
+    case call_stmt: {
+	id_use *idu = stmt->data.call_stmt.idu;
+	s = new_stmt(c, s_call, &stmt->file_loc);
+	s->proc = (const cl_proc *) ptr_map_get(&c->procs, idu->attrs);
+	s->levels = idu->levelsOutward;
+	c->pending = patch_list_of(&s->next);
+	return false;
+    }
+    case read_stmt: {
+	id_use *idu = stmt->data.read_stmt.idu;
+	s = new_stmt(c, s_read, &stmt->file_loc);
+	s->levels = idu->levelsOutward;
+	s->offset = idu->attrs->offset_count;
+	c->pending = patch_list_of(&s->next);
+	return false;
+    }
+    default:
+	return true;
+    }
+}
+
+// The walk's pre callback
+static bool compile_pre(void *node, AST_type t, void *data)
+{
+    compiler *c = (compiler *) data;
+    switch (t) {
+    case block_ast: {
+	block_t *block = (block_t *) node;
+	reserve_array((void **) &c->ends, &c->ends_size, sizeof(block_end),
+		      c->num_ends + 1, PURPOSE);
+	if (c->proc_body_next != NULL) {
+	    c->proc_body_next->size = block->frame_size;
+	    c->proc_body_next = NULL;
+	    c->ends[c->num_ends++] = block_returns;
+	} else {
+	    c->ends[c->num_ends++] = (block == c->prog) ? block_halts
+		: block_leaves;
+	    cl_stmt *s = new_stmt(c, s_block, &block->file_loc);
+	    s->size = block->frame_size;
+	    c->pending = patch_list_of(&s->next);
+	}
+	return true;
+    }
+    case const_def_ast: {
+	const_def_t *def = (const_def_t *) node;
+	ptr_map_put(&c->constants, def->ident.idu->attrs, def);
+	return true;
+    }
+    case proc_decl_ast: {
+	// (the procedure's code is not reached from the code before it)
+	proc_decl_t *pd = (proc_decl_t *) node;
+	cl_proc *p = (cl_proc *) new_closure(sizeof(cl_proc));
+	ptr_map_put(&c->procs, pd->idu->attrs, p);
+	save_pending(c, patch_list_of(&p->entry));
+	c->proc_body_next = p;
+	return true;
+    }
+    case stmt_ast:
+	return compile_stmt_start(c, (stmt_t *) node);
+    default:
+	return true;
+    }
+}
+
+// The walk's between callback
+static void compile_between(void *node, AST_type t, int i, void *data)
+{
+    compiler *c = (compiler *) data;
+    if (t != stmt_ast) {
+	return;
+    }
+    stmt_t *stmt = (stmt_t *) node;
+    if (stmt->stmt_kind != if_stmt && stmt->stmt_kind != while_stmt) {
+	return;
+    }
+    if (i == 0) {
+	// after the condition, its test, which goes to the body
+	// (or then branch) if it holds
+	cl_stmt *s = new_stmt(c, s_branch, &stmt->file_loc);
+	s->cond = c->cond;
+	reserve_array((void **) &c->branches, &c->branches_size,
+		      sizeof(cl_stmt *), c->num_branches + 1, PURPOSE);
+	c->branches[c->num_branches++] = s;
+	c->pending = patch_list_of(&s->target);
+    } else {
+	// after an if's then branch, its else branch
+	cl_stmt *s = c->branches[c->num_branches - 1];
+	save_pending(c, patch_list_of(&s->next));
+    }
+}
+
+// The walk's post callback
+static void compile_post(void *node, AST_type t, void *data)
+{
+    compiler *c = (compiler *) data;
+    switch (t) {
+    case block_ast: {
+	block_end end = c->ends[--c->num_ends];
+	block_t *block = (block_t *) node;
+	cl_stmt *s = new_stmt(c, (end == block_halts) ? s_halt
+			      : (end == block_returns) ? s_return : s_leave,
+			      &block->file_loc);
+	if (end == block_leaves) {
+	    c->pending = patch_list_of(&s->next);
+	}
+	break;
+    }
+    case proc_decl_ast:
+	c->pending = c->saved[--c->num_saved];
+	break;
+    case expr_ast:
+	compile_expr(c, (expr_t *) node);
+	break;
+    case condition_ast:
+	compile_condition(c, (condition_t *) node);
+	break;
+    case stmt_ast: {
+	stmt_t *stmt = (stmt_t *) node;
+	switch (stmt->stmt_kind) {
+	case assign_stmt:
+	    compile_assign(c, stmt);
+	    break;
+	case print_stmt: {
+	    const cl_expr *e = pop_expr(c);
+	    cl_stmt *s = new_stmt(c, s_print, &stmt->file_loc);
+	    s->expr = e;
+	    c->pending = patch_list_of(&s->next);
+	    break;
+	}
+	case if_stmt: {
+	    cl_stmt *s = c->branches[--c->num_branches];
+	    // what follows is reached from the end of each branch
+	    // (or if there is no else branch, when the test fails)
+	    c->pending = patch_list_append(c->pending,
+		(stmt->data.if_stmt.else_stmts != NULL)
+		? c->saved[--c->num_saved] : patch_list_of(&s->next));
+	    break;
+	}
+	case while_stmt: {
+	    cl_stmt *s = c->branches[--c->num_branches];
+	    patch(c->pending, s);
+	    c->pending = patch_list_of(&s->next);
+	    break;
+	}
+	default:
+	    break;
+	}
+	break;
+    }
+    default:
+	break;
+    }
+}
+
+// Requires: prog has been scope checked without errors
+// Return the closures for prog
+closure_program *closures_compile(block_t *prog)
+{
+    compiler c = { 0 };
+    c.prog = prog;
+    closure_program *p = (closure_program *)
+	new_closure(sizeof(closure_program));
+    c.pending = patch_list_of(&p->start);
+    ast_visitor v = { compile_pre, compile_between, compile_post, &c };
+    ast_walk(prog, block_ast, &v);
+
+    ptr_map_free(&c.constants);
+    ptr_map_free(&c.procs);
+    ptr_map_free(&c.shallow);
+    free(c.operands);
+    free(c.branches);
+    free(c.saved);
+    free(c.ends);
+    return p;
+}
+
+// Requires: p was returned by closures_compile
+// Run p, reporting a run-time error (on stderr, with its location)
+// and exiting with a failure code if one happens;
+// return the number of statements' closures run
+uint64_t closures_run(const closure_program *p)
+{
+    uint64_t executed = 0;
+    for (const cl_stmt *s = p->start; s != NULL; s = s->exec(s)) {
+	executed++;
+    }
+    fflush(stdout);
+    free(stack);
+    free(returns);
+    stack = NULL;
+    returns = NULL;
+    stack_size = returns_size = 0;
+    sp = fp = returns_top = 0;
+    slots = NULL;
+    return executed;
+}
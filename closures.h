@@ -0,0 +1,39 @@
+#ifndef _CLOSURES_H
+#define _CLOSURES_H
+#include <stdint.h>
+#include "ast.h"
+
+// Running SPL programs as closures: each statement, condition and
+// expression of a scope checked AST is converted, once, into a function
+// pointer with the operands it needs captured with it (such as a
+// constant's value, or a variable's offset in its activation record).
+// Common shapes have functions of their own, so, for example, "i + 1"
+// and "i < n" (for variables i and n of the block in use) are each one
+// call that works on the slots of the record directly, and
+// "divisible x by 2" is one call with 2 captured; running then never
+// switches on the kinds of the AST's nodes.
+//
+// Expressions and conditions are trees of closures, each calling those
+// of its operands; expressions nested more than a few hundred levels
+// deep are instead evaluated with an explicit stack, with closures for
+// their shallow operands. Statements are threaded: each statement's
+// closure returns the next one to run (an if's or a while's picks its
+// branch by its condition), and calls return through an explicit stack,
+// so neither deep nesting nor deep recursion grows the C stack.
+// The results, and run-time errors, are those of the AST interpreter
+// (see interpreter.h).
+
+// The closures of a program
+typedef struct closure_program closure_program;
+
+// Requires: prog has been scope checked without errors
+// Return the closures for prog
+extern closure_program *closures_compile(block_t *prog);
+
+// Requires: p was returned by closures_compile
+// Run p, reporting a run-time error (on stderr, with its location)
+// and exiting with a failure code if one happens;
+// return the number of statements' closures run
+extern uint64_t closures_run(const closure_program *p);
+
+#endif
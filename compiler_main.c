@@ -1,39 +1,447 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
 #include "parser.h"
 #include "lexer.h"
 #include "ast.h"
+#include "ast_binary.h"
+#include "id_attrs.h"
+#include "incremental.h"
+#include "intern.h"
+#include "interpreter.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "closures.h"
+#include "emit_c.h"
+#include "gen_code.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "language_server.h"
 #include "symtab.h"
 #include "scope_check.h"
+#include "srm.h"
 #include "utilities.h"
 #include "unparser.h"
+#include "watch.h"
+#include "xref.h"
 
 /* Print a usage message on stderr 
    and exit with failure. */
 static void usage(const char *cmdname)
 {
     fprintf(stderr,
-	    "Usage: %s file.spl\n",
-	    cmdname);
+	    "Usage: %s [--max-errors=N] [--jobs=N] [--pretokenize]"
+	    " [--lex-jobs=N] [--lazy-procs]\n"
+	    "       [--list-tokens] [--list-decls] [--no-unparse] [--write-ast=FILE]"
+	    " [--write-xref=FILE]\n"
+	    "       [--optimize] [--write-bof=FILE] [--write-c=FILE]"
+	    " [--run[=ENGINE] [--time]]\n"
+	    "       file.spl\n"
+	    "   or: %s [options] --read-ast file.ast\n"
+	    "   or: %s [--find=NAME] --read-xref file.xref\n"
+	    "   or: %s [--stats] --run-bof file.bof\n"
+	    "   or: %s [--max-errors=N] [--no-unparse] --edits=FILE file.spl\n"
+	    "   or: %s [--max-errors=N] [--no-unparse] --watch file.spl ...\n"
+	    "   or: %s --lsp\n"
+	    "  --max-errors=N  stop after N syntax errors,"
+	    " or N declaration errors (0 means no limit)\n"
+	    "  --jobs=N        check sibling procedures on N threads"
+	    " (0 means one per processor)\n"
+	    "  --pretokenize   read all the tokens before parsing\n"
+	    "  --lex-jobs=N    read all the tokens before parsing,"
+	    " lexing a large file on N threads\n"
+	    "                  (0 means one per processor)\n"
+	    "  --lazy-procs    read all the tokens before parsing,"
+	    " and only parse the bodies\n"
+	    "                  of the program's procedures when needed\n"
+	    "  --list-tokens   only print the tokens read"
+	    " (and the lexical errors),\n"
+	    "                  one per line with its line and column\n"
+	    "  --list-decls    only print the program's declarations"
+	    " (not those nested in it)\n"
+	    "  --no-unparse    do not print the unparsed program\n"
+	    "  --write-ast=FILE  write the parsed program's AST to FILE\n"
+	    "  --read-ast      read the program's AST from file.ast"
+	    " (written by --write-ast)\n"
+	    "                  instead of parsing it\n"
+	    "  --write-xref=FILE  write the index of the names declared"
+	    " and their uses\n"
+	    "                  (found by declaration checking) to FILE\n"
+	    "  --read-xref     print the declarations in the index file.xref"
+	    " (written by\n"
+	    "                  --write-xref) with their uses\n"
+	    "  --find=NAME     only print the declarations of NAME\n"
+	    "  --optimize      simplify the program (if it has no errors)"
+	    " before writing or\n"
+	    "                  running it, print it simplified"
+	    " (unless --no-unparse),\n"
+	    "                  and print the number of statements removed"
+	    " as never\n"
+	    "                  running on stderr\n"
+	    "  --write-bof=FILE  write the program (if it has no errors),"
+	    " compiled for the SRM,\n"
+	    "                  to the binary object file FILE\n"
+	    "  --write-c=FILE  write the program (if it has no errors),"
+	    " translated to C, to FILE\n"
+	    "                  (which a C compiler can compile to run it"
+	    " natively)\n"
+	    "  --run-bof       run the program in file.bof (written by"
+	    " --write-bof)\n"
+	    "                  on the SRM simulator\n"
+	    "  --stats         print what running file.bof did (on stderr):"
+	    " the instructions\n"
+	    "                  executed (in all, and of each kind), the memory"
+	    " read and\n"
+	    "                  written, and the simulated cycles\n"
+	    "  --run[=ENGINE]  run the program (if it has no errors)"
+	    " after checking it,\n"
+	    "                  on the ENGINE: ast (walking its AST),"
+	    " closure (converting\n"
+	    "                  its AST to closures first), vm (the default,"
+	    " compiling it\n"
+	    "                  to bytecode for a virtual machine), or jit"
+	    " (compiling its\n"
+	    "                  bytecode to x86-64 machine code, or using the"
+	    " vm where that\n"
+	    "                  is not available)\n"
+	    "  --time          print how long parsing, checking declarations,"
+	    " and running\n"
+	    "                  the program took (on stderr)\n"
+	    "  --edits=FILE    compile file.spl, then apply each edit in FILE"
+	    " to its text\n"
+	    "                  and compile the result incrementally\n"
+	    "  --watch         compile each file, then again each time it is"
+	    " saved (until\n"
+	    "                  the end of the input), printing how long"
+	    " that took\n"
+	    "  --lsp           serve editors as a language server"
+	    " (on stdin and stdout)\n",
+	    cmdname, cmdname, cmdname, cmdname, cmdname, cmdname, cmdname);
     exit(EXIT_FAILURE);
 }
 
+// If arg is the option opt followed by "=" and a number (of decimal
+// digits, that fits in an unsigned int), then put the number in *value
+// and return true, otherwise return false.
+static bool numeric_option(const char *arg, const char *opt,
+			   unsigned int *value)
+{
+    size_t len = strlen(opt);
+    if (strncmp(arg, opt, len) != 0 || arg[len] != '=') {
+	return false;
+    }
+    // (strtoul would skip spaces, and accept a sign, negating the number)
+    if (!isdigit((unsigned char) arg[len + 1])) {
+	return false;
+    }
+    char *end;
+    errno = 0;
+    unsigned long v = strtoul(arg + len + 1, &end, 10);
+    if (*end != '\0' || errno == ERANGE || v > UINT_MAX) {
+	return false;
+    }
+    *value = (unsigned int) v;
+    return true;
+}
+
+// If arg is the option opt followed by "=" and a (non-empty) string,
+// then put the string in *value and return true, otherwise return false.
+static bool string_option(const char *arg, const char *opt,
+			  const char **value)
+{
+    size_t len = strlen(opt);
+    if (strncmp(arg, opt, len) != 0 || arg[len] != '='
+	|| arg[len + 1] == '\0') {
+	return false;
+    }
+    *value = arg + len + 1;
+    return true;
+}
+
+// Print (on stdout) the constants, variables, and procedures
+// declared in the program's outermost block, one per line
+static void print_declarations(block_t prog)
+{
+    for (const_decl_t *cd = prog.const_decls.start; cd != NULL;
+	 cd = cd->next) {
+	for (const_def_t *def = cd->const_def_list.start; def != NULL;
+	     def = def->next) {
+	    printf("const %s = %d\n", def->ident.name, def->number.value);
+	}
+    }
+    for (var_decl_t *vd = prog.var_decls.var_decls; vd != NULL;
+	 vd = vd->next) {
+	for (ident_t *id = vd->ident_list.start; id != NULL; id = id->next) {
+	    printf("var %s\n", id->name);
+	}
+    }
+    for (proc_decl_t *pd = prog.proc_decls.proc_decls; pd != NULL;
+	 pd = pd->next) {
+	printf("proc %s\n", pd->name);
+    }
+}
+
+// Print (on stdout) the tokens read by the lexer (which end with the end
+// of file token), one per line with its line and column, and its code
+// and text (or the message of a lexical error)
+static void print_tokens(const token_array *ta)
+{
+    for (unsigned int i = 0; i < ta->count; i++) {
+	const token_rec *t = &ta->tokens[i];
+	printf("%u:%u ", file_location_line(t->loc),
+	       file_location_column(t->loc));
+	if (t->kind == TOKEN_LEXICAL_ERROR) {
+	    printf("error: %s\n", intern_text(t->text));
+	} else {
+	    printf("%d \"%s\"\n", t->kind, intern_text(t->text));
+	}
+    }
+}
+
+// Print (on stdout) the declarations in x, each with its uses,
+// or only those of name if it is not NULL
+static void print_xref(const xref_index *x, const char *name)
+{
+    const xref_decl *decls = x->decls;
+    unsigned int count = x->num_decls;
+    if (name != NULL) {
+	decls = xref_find(x, name, &count);
+    }
+    for (unsigned int i = 0; i < count; i++) {
+	const xref_decl *d = &decls[i];
+	printf("%s %s (offset %u) declared in %s: line %u column %u\n",
+	       kind2str(xref_kind(d)), xref_name(x, d), d->offset_count,
+	       x->source, d->line, d->column);
+	const xref_use *uses = xref_uses(x, d);
+	for (unsigned int u = 0; u < d->num_uses; u++) {
+	    printf("    line %u column %u: %s, %u levels outward\n",
+		   uses[u].line, uses[u].column,
+		   xref_use_kind2str((xref_use_kind) uses[u].kind),
+		   uses[u].levels_outward);
+	}
+    }
+}
+
+// Return the number of milliseconds from start to end
+static double elapsed_ms(const struct timespec *start,
+			 const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e3
+	+ (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Run prog (which has been checked without errors) on the given engine
+// ("ast", "closure", "vm" or "jit", which uses the vm if the program's
+// machine code can't be run), then if time_run is true, print on stderr
+// how long that took (and for closures, how many statements were run,
+// and for the vm, how many instructions it executed)
+static void run_program(block_t *prog, const char *engine, bool time_run)
+{
+    struct timespec start, end;
+    timespec_get(&start, TIME_UTC);
+    if (strcmp(engine, "ast") == 0) {
+	interpreter_run(prog);
+	timespec_get(&end, TIME_UTC);
+	if (time_run) {
+	    fprintf(stderr, "%% ran in %.3f ms\n", elapsed_ms(&start, &end));
+	}
+	return;
+    }
+    if (strcmp(engine, "closure") == 0) {
+	uint64_t executed = closures_run(closures_compile(prog));
+	timespec_get(&end, TIME_UTC);
+	if (time_run) {
+	    double ms = elapsed_ms(&start, &end);
+	    fprintf(stderr, "%% ran in %.3f ms (%llu statements,"
+		    " %.1f million per second)\n", ms,
+		    (unsigned long long) executed,
+		    (ms > 0) ? executed / ms / 1e3 : 0.0);
+	}
+	return;
+    }
+    // (the same bytecode is run by the vm if the jit can't run it)
+    bytecode *bc = bytecode_compile(prog);
+    if (strcmp(engine, "jit") == 0 && jit_available() && jit_run(bc)) {
+	timespec_get(&end, TIME_UTC);
+	if (time_run) {
+	    fprintf(stderr, "%% ran in %.3f ms (as machine code)\n",
+		    elapsed_ms(&start, &end));
+	}
+    } else {
+	uint64_t executed = vm_run(bc);
+	timespec_get(&end, TIME_UTC);
+	if (time_run) {
+	    double ms = elapsed_ms(&start, &end);
+	    fprintf(stderr, "%% ran in %.3f ms (%llu instructions,"
+		    " %.1f million per second)\n", ms,
+		    (unsigned long long) executed,
+		    (ms > 0) ? executed / ms / 1e3 : 0.0);
+	}
+    }
+}
+
 int main(int argc, char *argv[])
 {
     const char *cmdname = argv[0];
+    unsigned int n;
+    bool unparse = true;
+    bool pretokenize = false;
+    bool lex_in_parallel = false;
+    unsigned int lex_jobs = 0;
+    bool lazy_procs = false;
+    bool list_tokens = false;
+    bool list_decls = false;
+    const char *ast_output = NULL;
+    bool read_ast = false;
+    const char *edits = NULL;
+    const char *xref_output = NULL;
+    bool read_xref = false;
+    const char *find = NULL;
+    bool watch = false;
+    const char *bof_output = NULL;
+    const char *c_output = NULL;
+    bool optimize = false;
+    bool run_bof = false;
+    bool stats = false;
+    const char *run = NULL;
+    bool time_run = false;
     --argc;
-    /* 1 non-option argument */
-    if (argc != 1 || argv[1][0] == '-') {
+    argv++;
+    if (argc == 1 && strcmp(argv[0], "--lsp") == 0) {
+	return language_server_run(stdin, stdout);
+    }
+    /* options, then 1 non-option argument */
+    while (argc > 0 && argv[0][0] == '-') {
+	if (numeric_option(argv[0], "--max-errors", &n)) {
+	    parser_set_error_limit(n);
+	    scope_check_set_error_limit(n);
+	} else if (numeric_option(argv[0], "--jobs", &n)) {
+	    scope_check_set_jobs(n);
+	} else if (numeric_option(argv[0], "--lex-jobs", &lex_jobs)) {
+	    lex_in_parallel = true;
+	} else if (strcmp(argv[0], "--pretokenize") == 0) {
+	    pretokenize = true;
+	} else if (strcmp(argv[0], "--lazy-procs") == 0) {
+	    lazy_procs = true;
+	} else if (strcmp(argv[0], "--list-tokens") == 0) {
+	    list_tokens = true;
+	} else if (strcmp(argv[0], "--list-decls") == 0) {
+	    list_decls = true;
+	} else if (string_option(argv[0], "--write-ast", &ast_output)) {
+	    ;
+	} else if (string_option(argv[0], "--edits", &edits)) {
+	    ;
+	} else if (strcmp(argv[0], "--read-ast") == 0) {
+	    read_ast = true;
+	} else if (string_option(argv[0], "--write-xref", &xref_output)) {
+	    ;
+	} else if (strcmp(argv[0], "--read-xref") == 0) {
+	    read_xref = true;
+	} else if (string_option(argv[0], "--find", &find)) {
+	    ;
+	} else if (string_option(argv[0], "--write-bof", &bof_output)) {
+	    ;
+	} else if (string_option(argv[0], "--write-c", &c_output)) {
+	    ;
+	} else if (strcmp(argv[0], "--optimize") == 0) {
+	    optimize = true;
+	} else if (strcmp(argv[0], "--run-bof") == 0) {
+	    run_bof = true;
+	} else if (strcmp(argv[0], "--stats") == 0) {
+	    stats = true;
+	} else if (strcmp(argv[0], "--watch") == 0) {
+	    watch = true;
+	} else if (strcmp(argv[0], "--run") == 0) {
+	    run = "vm";
+	} else if (string_option(argv[0], "--run", &run)) {
+	    if (strcmp(run, "ast") != 0 && strcmp(run, "closure") != 0
+		&& strcmp(run, "vm") != 0 && strcmp(run, "jit") != 0) {
+		usage(cmdname);
+	    }
+	} else if (strcmp(argv[0], "--time") == 0) {
+	    time_run = true;
+	} else if (strcmp(argv[0], "--no-unparse") == 0) {
+	    unparse = false;
+	} else {
 	    usage(cmdname);
+	}
+	--argc;
+	argv++;
+    }
+    if (watch && argc > 0) {
+	return watch_files(argv, (unsigned int) argc, unparse);
+    }
+    if (argc != 1) {
+	usage(cmdname);
+    }
+    char *file_name = argv[0];
+
+    if (read_xref) {
+	print_xref(xref_load(file_name), find);
+	return EXIT_SUCCESS;
+    }
+
+    if (run_bof) {
+	bof_file bof = bof_read(file_name);
+	srm_stats st;
+	int code = srm_run(&bof, &st);
+	if (stats) {
+	    srm_print_stats(stderr, &st);
+	}
+	return code;
+    }
+
+    if (edits != NULL) {
+	incremental_open(file_name);
+	incremental_print(unparse);
+	incremental_replay(edits, unparse);
+	return EXIT_SUCCESS;
+    }
+
+    struct timespec start, end;
+    timespec_get(&start, TIME_UTC);
+    block_t progast;
+    if (read_ast) {
+	progast = *ast_binary_load(file_name);
+    } else {
+	lexer_init(file_name);
+	if (lex_in_parallel) {
+	    lexer_tokenize_all_parallel(lex_jobs);
+	} else if (pretokenize || lazy_procs || list_tokens) {
+	    lexer_tokenize_all();
+	}
+	if (list_tokens) {
+	    print_tokens(lexer_tokens());
+	    return EXIT_SUCCESS;
+	}
+	parser_set_lazy_procs(lazy_procs);
+
+	// parsing
+	progast = parseProgram(file_name);
+    }
+    if (time_run) {
+	timespec_get(&end, TIME_UTC);
+	fprintf(stderr, "%% parsed in %.3f ms\n", elapsed_ms(&start, &end));
     }
 
-    lexer_init(argv[1]);
+    if (ast_output != NULL && !ast_binary_write(ast_output, &progast)) {
+	return EXIT_FAILURE;
+    }
 
-    // parsing
-    block_t progast = parseProgram(argv[1]);
+    if (list_decls) {
+	print_declarations(progast);
+	return EXIT_SUCCESS;
+    }
 
     // unparse to check on the AST
-    unparseProgram(stdout, progast);
+    // (after it is simplified, if it is to be optimized)
+    if (unparse && !optimize && !unparseProgram(stdout, progast)) {
+	return EXIT_FAILURE;
+    }
 
     // comment out the next two commands to disable declaration checking
 
@@ -41,7 +449,51 @@ int main(int argc, char *argv[])
     symtab_initialize();
 
     // check for duplicate declarations
-    scope_check_program(progast);
+    timespec_get(&start, TIME_UTC);
+    progast = scope_check_program(progast);
+    if (time_run) {
+	timespec_get(&end, TIME_UTC);
+	fprintf(stderr, "%% checked declarations in %.3f ms\n",
+		elapsed_ms(&start, &end));
+    }
+    if (parser_proc_body_errors()) {
+	// (a skipped procedure body had syntax errors)
+	return EXIT_FAILURE;
+    }
+
+    if (xref_output != NULL) {
+	xref_write(xref_output, &progast);
+    }
+
+    if (optimize) {
+	unsigned int removed = 0;
+	if (scope_check_error_count() == 0) {
+	    removed = optimize_program(&progast);
+	}
+	if (unparse) {
+	    unparseProgram(stdout, progast);
+	}
+	fflush(stdout); // so the count comes after the program printed
+	fprintf(stderr, "%% optimizing removed %u statement%s\n", removed,
+		(removed == 1) ? "" : "s");
+    }
+
+    if ((bof_output != NULL || c_output != NULL || run != NULL)
+	&& scope_check_error_count() != 0) {
+	return EXIT_FAILURE;
+    }
+
+    if (bof_output != NULL) {
+	gen_code_program(&progast, bof_output);
+    }
+
+    if (c_output != NULL) {
+	emit_c_program(&progast, c_output);
+    }
+
+    if (run != NULL) {
+	run_program(&progast, run, time_run);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,122 @@
+// Checking the division and divisibility tests by constant divisors
+// (see bytecode_divisor), which the vm does with bytecode_divide_const
+// and bytecode_divisible_const, against dividing (with / and %).
+//
+// Usage: divisor_check [divisor ...]
+// For each divisor given, every word is checked as a dividend; then
+// the dividends near 0, near both ends of the range of words, and near
+// the first and last multiples of the divisor in that range, are checked
+// for each divisor from -EDGE_DIVISORS to EDGE_DIVISORS (except 0), each
+// power of two (and the numbers next to it, and their negations),
+// and the ends of the range of words.
+// The failures (at most MAX_FAILURES of them) are printed on stdout,
+// and the exit code is EXIT_FAILURE if there were any.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include "bytecode.h"
+
+#define EDGE_DIVISORS 10000
+#define EDGE_DIVIDENDS 1000
+#define MAX_FAILURES 20
+
+static unsigned long failures = 0;
+
+// Check the quotient of a and d, and whether a is divisible by d,
+// printing the failure (if any)
+static void check(const bytecode_divisor *d, word_type a)
+{
+    // (the most negative word divided by -1 wraps around to itself)
+    word_type q = (d->divisor == -1) ? (word_type) (0u - (uint32_t) a)
+	: a / d->divisor;
+    bool divisible = (d->divisor == -1) || a % d->divisor == 0;
+    word_type got = bytecode_divide_const(d, a);
+    bool got_divisible = bytecode_divisible_const(d, a);
+    if (got != q || got_divisible != divisible) {
+	if (failures < MAX_FAILURES) {
+	    printf("%d / %d: expected %d (%sdivisible),"
+		   " got %d (%sdivisible)\n", a, d->divisor, q,
+		   divisible ? "" : "not ", got, got_divisible ? "" : "not ");
+	}
+	failures++;
+    }
+}
+
+// Check the count dividends from first on (those in the range of words)
+static void check_from(const bytecode_divisor *d, int64_t first,
+		       int64_t count)
+{
+    for (int64_t a = first; a < first + count; a++) {
+	if (INT32_MIN <= a && a <= INT32_MAX) {
+	    check(d, (word_type) a);
+	}
+    }
+}
+
+// Check every word as a dividend for the divisor dv
+static void check_all_dividends(word_type dv)
+{
+    bytecode_divisor d = bytecode_divisor_make(dv);
+    uint32_t a = 0;
+    do {
+	check(&d, (word_type) a);
+    } while (++a != 0);
+}
+
+// Check the dividends at the edges (see above) for the divisor dv
+static void check_edges(word_type dv)
+{
+    bytecode_divisor d = bytecode_divisor_make(dv);
+    int64_t abs = (dv < 0) ? -(int64_t) dv : dv;
+    int64_t last = (INT32_MAX / abs) * abs;
+    int64_t first = -((-(int64_t) INT32_MIN / abs) * abs);
+    check_from(&d, -EDGE_DIVIDENDS, 2 * EDGE_DIVIDENDS + 1);
+    check_from(&d, INT32_MIN, EDGE_DIVIDENDS);
+    check_from(&d, (int64_t) INT32_MAX - EDGE_DIVIDENDS + 1, EDGE_DIVIDENDS);
+    for (int64_t k = 0; k < EDGE_DIVIDENDS / abs + 1; k++) {
+	check_from(&d, last - k * abs - 1, 3);
+	check_from(&d, first + k * abs - 1, 3);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+	char *end;
+	long long dv = strtoll(argv[i], &end, 10);
+	if (*end != '\0' || dv == 0 || dv < INT32_MIN || dv > INT32_MAX) {
+	    fprintf(stderr, "%s: bad divisor: %s\n", argv[0], argv[i]);
+	    return EXIT_FAILURE;
+	}
+	printf("checking every dividend for the divisor %lld\n", dv);
+	check_all_dividends((word_type) dv);
+    }
+    unsigned int edges = 0;
+    for (word_type dv = -EDGE_DIVISORS; dv <= EDGE_DIVISORS; dv++) {
+	if (dv != 0) {
+	    check_edges(dv);
+	    edges++;
+	}
+    }
+    for (int shift = 0; shift < 31; shift++) {
+	for (int64_t dv = ((int64_t) 1 << shift) - 1;
+	     dv <= ((int64_t) 1 << shift) + 1; dv++) {
+	    if (dv > EDGE_DIVISORS) {
+		check_edges((word_type) dv);
+		check_edges((word_type) -dv);
+		edges += 2;
+	    }
+	}
+    }
+    check_edges(INT32_MAX);
+    check_edges(-INT32_MAX);
+    check_edges(INT32_MIN);
+    edges += 3;
+    printf("checked the edges for %u divisors\n", edges);
+    if (failures > 0) {
+	printf("%lu failures!\n", failures);
+	return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,764 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "emit_c.h"
+#include "ast_walk.h"
+#include "file_location.h"
+#include "ptr_map.h"
+#include "utilities.h"
+#include "spl.tab.h"
+
+// What there is no space to do, if growing an array fails
+#define PURPOSE "translate the program to C"
+
+// The number of words in the header of each of the vm's activation
+// records (see vm.c), which the C counts to find when the stack is full
+#define HEADER_WORDS 3
+
+// A growable string of C
+typedef struct {
+    char *chars;
+    size_t length;
+    size_t size;
+} text;
+
+// A procedure, as it is called
+typedef struct {
+    const char *name;
+    unsigned int id;    // the id of its block (and so of its frame)
+    unsigned int words; // the words of its vm activation record
+} proc_info;
+
+// What the code at the end of a block does
+typedef enum { block_returns, block_leaves } block_end;
+
+// A block being translated
+typedef struct {
+    unsigned int id;    // its frame is struct frame_<id> f<id>
+    unsigned int func;  // the index of the function it is in
+    unsigned int words; // the words of its vm activation record
+    block_end end;
+} block_info;
+
+// A C function being written
+typedef struct {
+    text head;              // its header
+    text locals;            // the declarations of its local variables
+    text body;              // its statements
+    unsigned int first;     // the index of its outermost block
+    unsigned int temps;     // the temporaries it uses
+} func_info;
+
+// The labels of an if or while statement being translated
+typedef struct {
+    unsigned int skip;  // where its condition jumps to when false
+    unsigned int other; // the end of an if, or the start of a while
+} labels;
+
+// The state of the translator (which translates one program at a time)
+typedef struct {
+    text structs;               // the frames' struct types
+    text prototypes;            // the functions' prototypes
+    text functions;             // the functions finished
+    ptr_map constants;          // the id_attrs of each constant -> its def
+    ptr_map procs;              // the id_attrs of each procedure -> its info
+    proc_info *proc_next;       // the procedure whose block is next, if any
+    unsigned int next_id;       // the id of the next block
+    unsigned int next_label;    // the number of the next label
+    unsigned int depth;         // the temporaries in use here
+    // the blocks being translated (innermost last)
+    block_info *blocks;
+    unsigned int num_blocks;
+    unsigned int blocks_size;
+    // the functions being written (innermost last)
+    func_info *funcs;
+    unsigned int num_funcs;
+    unsigned int funcs_size;
+    // the labels of the ifs and whiles being translated (innermost last)
+    labels *labels;
+    unsigned int num_labels;
+    unsigned int labels_size;
+} translator;
+
+// The start of each translation: the words of SPL, the operations on them,
+// and the count of the words on the vm's stack of activation records
+static const char prelude[] =
+    "#include <inttypes.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "#include <unistd.h>\n"
+    "#endif\n"
+    "#if defined(_POSIX_THREADS) && _POSIX_THREADS > 0"
+    " && !defined(SPL_NO_THREADS)\n"
+    "#include <pthread.h>\n"
+    "#define SPL_THREADS\n"
+    "#endif\n"
+    "\n"
+    "typedef int32_t word;\n"
+    "\n"
+    "// the most words that the stack of activation records may hold\n"
+    "#define SPL_MAX_STACK_WORDS ((size_t) 1 << 24)\n"
+    "// the size of the stack of the thread that runs the program\n"
+    "#define SPL_THREAD_STACK_BYTES ((size_t) 1 << 30)\n"
+    "\n"
+    "// the words the stack of activation records holds\n"
+    "static size_t spl_sp = 0;\n"
+    "\n"
+    "static void spl_fail(const char *msg)\n"
+    "{\n"
+    "    fflush(stdout);\n"
+    "    fprintf(stderr, \"%s\\n\", msg);\n"
+    "    exit(EXIT_FAILURE);\n"
+    "}\n"
+    "\n"
+    "static inline void spl_push(size_t words, const char *msg)\n"
+    "{\n"
+    "    if (spl_sp + words > SPL_MAX_STACK_WORDS) {\n"
+    "        spl_fail(msg);\n"
+    "    }\n"
+    "    spl_sp += words;\n"
+    "}\n"
+    "\n"
+    "static inline word spl_add(word a, word b)\n"
+    "{\n"
+    "    return (word) ((uint32_t) a + (uint32_t) b);\n"
+    "}\n"
+    "\n"
+    "static inline word spl_sub(word a, word b)\n"
+    "{\n"
+    "    return (word) ((uint32_t) a - (uint32_t) b);\n"
+    "}\n"
+    "\n"
+    "static inline word spl_mul(word a, word b)\n"
+    "{\n"
+    "    return (word) ((uint32_t) a * (uint32_t) b);\n"
+    "}\n"
+    "\n"
+    "static inline word spl_neg(word a)\n"
+    "{\n"
+    "    return (word) (0u - (uint32_t) a);\n"
+    "}\n"
+    "\n"
+    "static inline word spl_div(word a, word b, const char *msg)\n"
+    "{\n"
+    "    if (b == 0) {\n"
+    "        spl_fail(msg);\n"
+    "    }\n"
+    "    // (the most negative word divided by -1 wraps around to itself)\n"
+    "    return (b == -1) ? spl_neg(a) : a / b;\n"
+    "}\n"
+    "\n"
+    "static inline int spl_divisible(word a, word b, const char *msg)\n"
+    "{\n"
+    "    if (b == 0) {\n"
+    "        spl_fail(msg);\n"
+    "    }\n"
+    "    return b == -1 || a % b == 0;\n"
+    "}\n"
+    "\n"
+    "static inline void spl_print(word a)\n"
+    "{\n"
+    "    printf(\"%\" PRId32 \"\\n\", a);\n"
+    "}\n"
+    "\n"
+    "static inline word spl_read(void)\n"
+    "{\n"
+    "    int ch = getchar();\n"
+    "    return (ch == EOF) ? -1 : ch;\n"
+    "}\n"
+    "\n";
+
+// The end of each translation, which runs the program
+static const char postlude[] =
+    "static void *spl_run(void *arg)\n"
+    "{\n"
+    "    (void) arg;\n"
+    "    spl_program();\n"
+    "    return NULL;\n"
+    "}\n"
+    "\n"
+    "int main(void)\n"
+    "{\n"
+    "#ifdef SPL_THREADS\n"
+    "    pthread_attr_t attr;\n"
+    "    pthread_t thread;\n"
+    "    if (pthread_attr_init(&attr) == 0\n"
+    "        && pthread_attr_setstacksize(&attr, SPL_THREAD_STACK_BYTES)"
+    " == 0\n"
+    "        && pthread_create(&thread, &attr, spl_run, NULL) == 0) {\n"
+    "        pthread_join(thread, NULL);\n"
+    "        return EXIT_SUCCESS;\n"
+    "    }\n"
+    "#endif\n"
+    "    spl_run(NULL);\n"
+    "    return EXIT_SUCCESS;\n"
+    "}\n";
+
+// Append the n chars at s to t
+static void append(text *t, const char *s, size_t n)
+{
+    if (n == 0) {
+	return;
+    }
+    if (t->length + n + 1 > t->size) {
+	size_t new_size = (t->size == 0) ? 1024 : t->size;
+	while (new_size < t->length + n + 1) {
+	    new_size *= 2;
+	}
+	t->chars = (char *) realloc(t->chars, new_size);
+	if (t->chars == NULL) {
+	    bail_with_error("No space to translate the program to C!");
+	}
+	t->size = new_size;
+    }
+    memcpy(t->chars + t->length, s, n);
+    t->length += n;
+    t->chars[t->length] = '\0';
+}
+
+// Append the text formatted by fmt (as in printf) to t
+static void append_format(text *t, const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t) n >= sizeof(buf)) {
+	bail_with_error("A line of C is too long to translate the program!");
+    }
+    append(t, buf, (size_t) n);
+}
+
+// Append the message for the run-time error described by fmt (which may
+// use name) at loc to t, as a C string literal
+static void append_message(text *t, file_location loc, const char *fmt,
+			   const char *name)
+{
+    char msg[2048];
+    int n = snprintf(msg, sizeof(msg), "%s: line %u ",
+		     file_location_filename(loc), file_location_line(loc));
+    snprintf(msg + n, sizeof(msg) - n, fmt, name);
+    append(t, "\"", 1);
+    for (const char *p = msg; *p != '\0'; p++) {
+	unsigned char c = (unsigned char) *p;
+	if (c == '"' || c == '\\' || c == '?') {
+	    // (escaping ? keeps it out of trigraphs)
+	    char esc[2] = { '\\', (char) c };
+	    append(t, esc, 2);
+	} else if (c < ' ' || c > '~') {
+	    append_format(t, "\\%03o", c);
+	} else {
+	    append(t, p, 1);
+	}
+    }
+    append(t, "\"", 1);
+}
+
+// Return the function being written
+static func_info *current_func(translator *tr)
+{
+    return &tr->funcs[tr->num_funcs - 1];
+}
+
+// Append a statement (formatted by fmt, as in printf, without its
+// newline) to the body of the function being written
+static void line(translator *tr, const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t) n >= sizeof(buf)) {
+	bail_with_error("A line of C is too long to translate the program!");
+    }
+    text *body = &current_func(tr)->body;
+    append(body, "    ", 4);
+    append(body, buf, (size_t) n);
+    append(body, "\n", 1);
+}
+
+// Append a label (numbered label) to the function being written
+static void label(translator *tr, unsigned int label)
+{
+    append_format(&current_func(tr)->body, "L%u: ;\n", label);
+}
+
+// Append the C for the number v to t
+static void append_number(text *t, word_type v)
+{
+    if (v == INT_MIN) {
+	// (the literal 2147483648 would not be an int)
+	append_format(t, "(%d - 1)", INT_MIN + 1);
+    } else {
+	append_format(t, "%d", v);
+    }
+}
+
+// Append the C for the frame levels static links out from the innermost
+// block to t: the frame itself if it is in the function being written
+// (followed by "." if member is true, and with & before it otherwise),
+// and otherwise the chain of static links to it (followed by "->"
+// if member is true)
+static void append_frame(translator *tr, text *t, unsigned int levels,
+			 bool member)
+{
+    unsigned int b = tr->num_blocks - 1 - levels;
+    func_info *f = current_func(tr);
+    if (b >= f->first) {
+	append_format(t, member ? "f%u." : "&f%u", tr->blocks[b].id);
+    } else {
+	// (the function's static link is the frame just outside of it)
+	append(t, "sl", 2);
+	for (unsigned int i = b + 1; i < f->first; i++) {
+	    append(t, "->sl", 4);
+	}
+	if (member) {
+	    append(t, "->", 2);
+	}
+    }
+}
+
+// Start a statement in the body of the function being written
+// with the C for the variable name (whose use is idu);
+// the caller finishes the statement
+static void start_variable(translator *tr, const char *name,
+			   const id_use *idu)
+{
+    text *body = &current_func(tr)->body;
+    append(body, "    ", 4);
+    append_frame(tr, body, idu->levelsOutward, true);
+    append_format(body, "v_%s", name);
+}
+
+// Append the struct type of the frame for block (whose id is id)
+// to the structs
+static void frame_struct(translator *tr, block_t *block, unsigned int id)
+{
+    text *s = &tr->structs;
+    append_format(s, "struct frame_%u {\n", id);
+    if (tr->num_blocks == 0) {
+	append(s, "    void *sl;\n", 14);
+    } else {
+	append_format(s, "    struct frame_%u *sl;\n",
+		      tr->blocks[tr->num_blocks - 1].id);
+    }
+    for (var_decl_t *vd = block->var_decls.var_decls; vd != NULL;
+	 vd = vd->next) {
+	for (ident_t *id = vd->ident_list.start; id != NULL; id = id->next) {
+	    append_format(s, "    word v_%s;\n", id->name);
+	}
+    }
+    append(s, "};\n\n", 4);
+}
+
+// Start writing a function (whose header is added by the caller)
+static void start_func(translator *tr)
+{
+    reserve_array((void **) &tr->funcs, &tr->funcs_size, sizeof(func_info),
+		  tr->num_funcs + 1, PURPOSE);
+    func_info *f = &tr->funcs[tr->num_funcs++];
+    memset(f, 0, sizeof(func_info));
+    f->first = tr->num_blocks;
+}
+
+// Finish the function being written, adding it to the functions
+static void finish_func(translator *tr)
+{
+    func_info *f = current_func(tr);
+    text *out = &tr->functions;
+    append(out, f->head.chars, f->head.length);
+    append(out, "{\n", 2);
+    append(out, f->locals.chars, f->locals.length);
+    for (unsigned int i = 0; i < f->temps; i++) {
+	append_format(out, (i % 10 == 0) ? "    word t%u" : ", t%u", i);
+	if (i % 10 == 9 || i + 1 == f->temps) {
+	    append(out, ";\n", 2);
+	}
+    }
+    append(out, f->body.chars, f->body.length);
+    append(out, "}\n\n", 3);
+    free(f->head.chars);
+    free(f->locals.chars);
+    free(f->body.chars);
+    tr->num_funcs--;
+}
+
+// Note (in the locals of f) that the frame with the given id is used,
+// as the C compiler would warn about one that holds no variables in use
+static void frame_used(func_info *f, unsigned int id)
+{
+    append_format(&f->locals, "    (void) f%u;\n", id);
+}
+
+// Start the translation of block
+static void translate_block_start(translator *tr, block_t *block)
+{
+    unsigned int id = tr->next_id++;
+    unsigned int words = HEADER_WORDS + block->frame_size;
+    frame_struct(tr, block, id);
+    block_end end = block_leaves;
+    if (tr->proc_next != NULL) {
+	proc_info *p = tr->proc_next;
+	tr->proc_next = NULL;
+	p->id = id;
+	p->words = words;
+	end = block_returns;
+	unsigned int parent = tr->blocks[tr->num_blocks - 1].id;
+	append_format(&tr->prototypes,
+		      "static void proc_%u_%s(struct frame_%u *sl);\n",
+		      id, p->name, parent);
+	start_func(tr);
+	func_info *f = current_func(tr);
+	append_format(&f->head, "static void proc_%u_%s(struct frame_%u *sl)\n",
+		      id, p->name, parent);
+	append_format(&f->locals, "    struct frame_%u f%u = { .sl = sl };\n",
+		      id, id);
+	frame_used(f, id);
+    } else if (tr->num_blocks == 0) {
+	// the program's block
+	end = block_returns;
+	append(&tr->prototypes, "static void spl_program(void);\n", 31);
+	start_func(tr);
+	func_info *f = current_func(tr);
+	append(&f->head, "static void spl_program(void)\n", 30);
+	append_format(&f->locals,
+		      "    struct frame_%u f%u = { .sl = NULL };\n", id, id);
+	frame_used(f, id);
+	append_format(&f->body, "    spl_push(%u, ", words);
+	append_message(&f->body, block->file_loc,
+		       "the run-time stack is full (too many nested calls)!",
+		       NULL);
+	append(&f->body, ");\n", 3);
+    } else {
+	// a block statement's frame is made afresh each time it starts
+	func_info *f = current_func(tr);
+	append_format(&f->locals, "    struct frame_%u f%u;\n", id, id);
+	frame_used(f, id);
+	append_format(&f->body, "    spl_push(%u, ", words);
+	append_message(&f->body, block->file_loc,
+		       "the run-time stack is full (too many nested calls)!",
+		       NULL);
+	append(&f->body, ");\n", 3);
+	line(tr, "f%u = (struct frame_%u) { .sl = &f%u };", id, id,
+	     tr->blocks[tr->num_blocks - 1].id);
+    }
+    reserve_array((void **) &tr->blocks, &tr->blocks_size, sizeof(block_info),
+		  tr->num_blocks + 1, PURPOSE);
+    tr->blocks[tr->num_blocks++] = (block_info) {
+	id, tr->num_funcs - 1, words, end
+    };
+}
+
+// Finish the translation of the innermost block
+static void translate_block_end(translator *tr)
+{
+    block_info *b = &tr->blocks[tr->num_blocks - 1];
+    if (b->end == block_leaves) {
+	line(tr, "spl_sp -= %u;", b->words);
+	tr->num_blocks--;
+    } else {
+	tr->num_blocks--;
+	finish_func(tr);
+    }
+}
+
+// Push the labels of an if or while statement
+static labels *push_labels(translator *tr)
+{
+    reserve_array((void **) &tr->labels, &tr->labels_size, sizeof(labels),
+		  tr->num_labels + 1, PURPOSE);
+    labels *l = &tr->labels[tr->num_labels++];
+    l->skip = tr->next_label++;
+    l->other = tr->next_label++;
+    return l;
+}
+
+// Translate the start of stmt (what comes before its children)
+// and return false if it has no children to translate
+static bool translate_stmt_start(translator *tr, stmt_t *stmt)
+{
+    switch (stmt->stmt_kind) {
+    case assign_stmt: {
+	assign_stmt_t *as = &stmt->data.assign_stmt;
+	if (as->idu->attrs->kind != variable_idk) {
+	    text *body = &current_func(tr)->body;
+	    append(body, "    spl_fail(", 13);
+	    append_message(body, stmt->file_loc,
+			   "cannot assign to constant \"%s\"!", as->name);
+	    append(body, ");\n", 3);
+	    return false;
+	}
+	return true;
+    }
+    case call_stmt: {
+	call_stmt_t *cs = &stmt->data.call_stmt;
+	proc_info *p = (proc_info *) ptr_map_get(&tr->procs, cs->idu->attrs);
+	text *body = &current_func(tr)->body;
+	append_format(body, "    spl_push(%u, ", p->words);
+	append_message(body, stmt->file_loc,
+		       "the run-time stack is full (too many nested calls)!",
+		       NULL);
+	append_format(body, ");\n    proc_%u_%s(", p->id, p->name);
+	append_frame(tr, body, cs->idu->levelsOutward, false);
+	append(body, ");\n", 3);
+	line(tr, "spl_sp -= %u;", p->words);
+	return false;
+    }
+    case read_stmt: {
+	read_stmt_t *rs = &stmt->data.read_stmt;
+	start_variable(tr, rs->name, rs->idu);
+	append(&current_func(tr)->body, " = spl_read();\n", 15);
+	return false;
+    }
+    case if_stmt:
+	push_labels(tr);
+	return true;
+    case while_stmt:
+	// the start of the loop, where its condition is checked
+	label(tr, push_labels(tr)->other);
+	return true;
+    default:
+	return true;
+    }
+}
+
+// Note that another temporary is in use
+static unsigned int new_temp(translator *tr)
+{
+    func_info *f = current_func(tr);
+    unsigned int t = tr->depth++;
+    if (tr->depth > f->temps) {
+	f->temps = tr->depth;
+    }
+    return t;
+}
+
+// Translate an expression that is a name or a number into a temporary
+static void translate_leaf(translator *tr, expr_t *expr)
+{
+    unsigned int t = new_temp(tr);
+    text *body = &current_func(tr)->body;
+    append_format(body, "    t%u = ", t);
+    if (expr->expr_kind == expr_number) {
+	append_number(body, expr->data.number.value);
+    } else {
+	id_use *idu = expr->data.ident.idu;
+	if (idu->attrs->kind == constant_idk) {
+	    const_def_t *def = (const_def_t *)
+		ptr_map_get(&tr->constants, idu->attrs);
+	    append_number(body, def->number.value);
+	} else {
+	    append_frame(tr, body, idu->levelsOutward, true);
+	    append_format(body, "v_%s", expr->data.ident.name);
+	}
+    }
+    append(body, ";\n", 2);
+}
+
+// The walk's pre callback
+static bool translate_pre(void *node, AST_type t, void *data)
+{
+    translator *tr = (translator *) data;
+    switch (t) {
+    case block_ast:
+	translate_block_start(tr, (block_t *) node);
+	return true;
+    case const_def_ast: {
+	const_def_t *def = (const_def_t *) node;
+	ptr_map_put(&tr->constants, def->ident.idu->attrs, def);
+	return true;
+    }
+    case proc_decl_ast: {
+	proc_decl_t *pd = (proc_decl_t *) node;
+	proc_info *p = (proc_info *) malloc(sizeof(proc_info));
+	if (p == NULL) {
+	    bail_with_error("No space to translate the program to C!");
+	}
+	p->name = pd->name;
+	ptr_map_put(&tr->procs, pd->idu->attrs, p);
+	tr->proc_next = p;
+	return true;
+    }
+    case stmt_ast:
+	return translate_stmt_start(tr, (stmt_t *) node);
+    case expr_ast: {
+	expr_t *expr = (expr_t *) node;
+	if (expr->expr_kind == expr_number || expr->expr_kind == expr_ident) {
+	    translate_leaf(tr, expr);
+	}
+	return true;
+    }
+    default:
+	return true;
+    }
+}
+
+// The walk's between callback
+static void translate_between(void *node, AST_type t, int i, void *data)
+{
+    translator *tr = (translator *) data;
+    if (t == stmt_ast && ((stmt_t *) node)->stmt_kind == if_stmt
+	&& i == 1) {
+	// between the then and else branches, jump over the else branch
+	labels *l = &tr->labels[tr->num_labels - 1];
+	line(tr, "goto L%u;", l->other);
+	label(tr, l->skip);
+    }
+}
+
+// Return the name of the function for the arithmetic operator op
+static const char *arith_func(const token_t *op)
+{
+    switch (op->code) {
+    case plussym:
+	return "spl_add";
+    case minussym:
+	return "spl_sub";
+    case multsym:
+	return "spl_mul";
+    default:
+	return "spl_div";
+    }
+}
+
+// Return the C for the relation op
+static const char *rel_op(const token_t *op)
+{
+    switch (op->code) {
+    case eqsym:
+	return "==";
+    case neqsym:
+	return "!=";
+    case ltsym:
+	return "<";
+    case leqsym:
+	return "<=";
+    case gtsym:
+	return ">";
+    default:
+	return ">=";
+    }
+}
+
+// The walk's post callback
+static void translate_post(void *node, AST_type t, void *data)
+{
+    translator *tr = (translator *) data;
+    switch (t) {
+    case block_ast:
+	translate_block_end(tr);
+	break;
+    case expr_ast: {
+	expr_t *expr = (expr_t *) node;
+	if (expr->expr_kind == expr_negated) {
+	    unsigned int a = tr->depth - 1;
+	    line(tr, "t%u = spl_neg(t%u);", a, a);
+	} else if (expr->expr_kind == expr_bin) {
+	    token_t *op = &expr->data.binary.arith_op;
+	    unsigned int b = --tr->depth;
+	    unsigned int a = b - 1;
+	    text *body = &current_func(tr)->body;
+	    append_format(body, "    t%u = %s(t%u, t%u", a, arith_func(op),
+			  a, b);
+	    if (op->code == divsym) {
+		append(body, ", ", 2);
+		append_message(body, op->file_loc, "division by zero!", NULL);
+	    }
+	    append(body, ");\n", 3);
+	}
+	break;
+    }
+    case condition_ast: {
+	condition_t *cond = (condition_t *) node;
+	unsigned int a = tr->depth -= 2;
+	unsigned int skip = tr->labels[tr->num_labels - 1].skip;
+	if (cond->cond_kind == ck_db) {
+	    text *body = &current_func(tr)->body;
+	    append_format(body, "    if (!spl_divisible(t%u, t%u, ", a, a + 1);
+	    append_message(body, cond->data.db_cond.divisor.file_loc,
+			   "division by zero!", NULL);
+	    append_format(body, ")) goto L%u;\n", skip);
+	} else {
+	    line(tr, "if (!(t%u %s t%u)) goto L%u;", a,
+		 rel_op(&cond->data.rel_op_cond.rel_op), a + 1, skip);
+	}
+	break;
+    }
+    case stmt_ast: {
+	stmt_t *stmt = (stmt_t *) node;
+	switch (stmt->stmt_kind) {
+	case assign_stmt: {
+	    assign_stmt_t *as = &stmt->data.assign_stmt;
+	    tr->depth--;
+	    start_variable(tr, as->name, as->idu);
+	    append(&current_func(tr)->body, " = t0;\n", 7);
+	    break;
+	}
+	case print_stmt:
+	    tr->depth--;
+	    line(tr, "spl_print(t0);");
+	    break;
+	case if_stmt: {
+	    labels *l = &tr->labels[--tr->num_labels];
+	    label(tr, (stmt->data.if_stmt.else_stmts != NULL)
+		  ? l->other : l->skip);
+	    break;
+	}
+	case while_stmt: {
+	    labels *l = &tr->labels[--tr->num_labels];
+	    line(tr, "goto L%u;", l->other);
+	    label(tr, l->skip);
+	    break;
+	}
+	default:
+	    break;
+	}
+	break;
+    }
+    default:
+	break;
+    }
+}
+
+// Requires: prog has been scope checked without errors
+// Write the C translation of prog to the file named filename
+void emit_c_program(block_t *prog, const char *filename)
+{
+    translator tr = { 0 };
+    ast_visitor v = { translate_pre, translate_between, translate_post, &tr };
+    ast_walk(prog, block_ast, &v);
+
+    FILE *out = fopen(filename, "w");
+    if (out == NULL) {
+	bail_with_error("Cannot open %s for writing!", filename);
+    }
+    fputs(prelude, out);
+    if (tr.structs.length > 0) {
+	fputs(tr.structs.chars, out);
+    }
+    fputs(tr.prototypes.chars, out);
+    fputs("\n", out);
+    fputs(tr.functions.chars, out);
+    fputs(postlude, out);
+    if (ferror(out) || fclose(out) != 0) {
+	bail_with_error("Error writing the program to %s!", filename);
+    }
+
+    for (size_t i = 0; i < tr.procs.size; i++) {
+	free(tr.procs.entries[i].value);
+    }
+    ptr_map_free(&tr.procs);
+    ptr_map_free(&tr.constants);
+    free(tr.structs.chars);
+    free(tr.prototypes.chars);
+    free(tr.functions.chars);
+    free(tr.blocks);
+    free(tr.funcs);
+    free(tr.labels);
+}
@@ -0,0 +1,31 @@
+#ifndef _EMIT_C_H
+#define _EMIT_C_H
+#include "ast.h"
+
+// Translating SPL programs into C, so that they can be compiled
+// (e.g., with gcc -O2) to run at the speed of native code.
+//
+// Each block (the program's, each procedure's, and each block
+// statement's) has a frame: a struct holding a static link (a pointer to
+// the frame of the block it is declared in) and one word for each of the
+// block's variables (its constants are written as numbers where they are
+// used). Each procedure is a C function, which is passed the static link
+// of its frame and keeps the frame in a local variable; the frames of
+// the block statements in it are also local variables of that function.
+// A name declared in another function's block is found by following
+// static links. Expressions are evaluated into temporaries and the
+// statements are jumps between labels, so the C does not nest as deeply
+// as the program does.
+//
+// Running the compiled C has the same results as running the program
+// with --run: arithmetic wraps around as in the vm, and the run-time
+// errors (with their locations) are the same, including the run-time
+// stack becoming full, as the C counts the words that the vm's
+// activation records would use. Where POSIX threads are available, the
+// program runs on a thread with a large stack, for deep recursion.
+
+// Requires: prog has been scope checked without errors
+// Write the C translation of prog to the file named filename
+extern void emit_c_program(block_t *prog, const char *filename);
+
+#endif
@@ -2,33 +2,327 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stddef.h>
+#include <string.h>
 #include "file_location.h"
 #include "utilities.h"
 
+// The files registered, each with its range of locations
+// and its table of line starts
+typedef struct {
+    const char *filename;
+    file_location base;        // location of its first character
+    uint64_t room;             // number of locations in its range
+    unsigned int *line_starts; // offset of each line's first character
+    unsigned int num_lines;    // number of line_starts in use
+    unsigned int capacity;     // allocated size of line_starts
+} file_lines;
+
+static file_lines *files = NULL;
+static unsigned int num_files = 0;
+static unsigned int files_capacity = 0;
+
+// The ids of the files, in increasing order of their bases
+// (the ranges of locations are given out in increasing order,
+// so a file whose range is moved goes to the end)
+static unsigned int *by_base = NULL;
+
+// The start of the locations that have not been given out
+static uint64_t next_base = 0;
+
+// Return the number of locations to give a file of length bytes:
+// one for each offset in it (including its end), and room for it
+// to grow by half (as a file being edited does) before it has to move
+static uint64_t room_for(size_t length)
+{
+    return (uint64_t) length + length / 2 + 1024;
+}
+
+// Give the file fls (of length bytes) the next range of locations
+static void give_range(file_lines *fls, size_t length)
+{
+    uint64_t room = room_for(length);
+    if (next_base + room > (uint64_t) UINT32_MAX + 1) {
+	bail_with_error("Too much source text to track locations in %s!",
+			fls->filename);
+    }
+    fls->base = (file_location) next_base;
+    fls->room = room;
+    next_base += room;
+}
+
+// Return the table for a newly registered file named filename
+// (whose id is num_files), with a range of locations for length bytes
+static file_lines *new_file(const char *filename, size_t length)
+{
+    if (num_files == files_capacity) {
+	files_capacity = (files_capacity == 0) ? 16 : 2 * files_capacity;
+	files = (file_lines *)
+	    realloc(files, files_capacity * sizeof(file_lines));
+	by_base = (unsigned int *)
+	    realloc(by_base, files_capacity * sizeof(unsigned int));
+	if (files == NULL || by_base == NULL) {
+	    bail_with_error("No space to track locations in %s!", filename);
+	}
+    }
+    file_lines *fls = &files[num_files];
+    fls->filename = filename;
+    give_range(fls, length);
+    by_base[num_files] = num_files;
+    return fls;
+}
+
 // Requires: filename != NULL
-// Return a (pointer to a) fresh file_location with the given
-// information
-file_location *file_location_make(const char *filename,
-					 unsigned int line)
+// Start an (empty) table of line starts for the file named filename,
+// which has length bytes, giving it a range of locations (with room
+// for it to grow some), and return the file's id
+unsigned int file_location_register(const char *filename, size_t length)
+{
+    assert(filename != NULL);
+    file_lines *fls = new_file(filename, length);
+    fls->line_starts = NULL;
+    fls->num_lines = 0;
+    fls->capacity = 0;
+    unsigned int file_id = num_files++;
+    // the first line starts at the beginning of the file
+    file_location_add_line(file_id, 0);
+    return file_id;
+}
+
+// Requires: filename != NULL, num_lines > 0, line_starts[0] == 0,
+//           and line_starts is sorted in increasing order
+// Like file_location_register, but the file's line starts are given
+// (and are used in place, so they must outlive the file's locations,
+// and no lines can be added to the file with file_location_add_line)
+unsigned int file_location_register_lines(const char *filename,
+					  const unsigned int *line_starts,
+					  unsigned int num_lines,
+					  size_t length)
 {
-    file_location *ret = (file_location *) malloc(sizeof(file_location));
-    if (ret == NULL) {
-	bail_with_error("Could not allocate space for a file_location!");
+    assert(filename != NULL && num_lines > 0 && line_starts[0] == 0);
+    file_lines *fls = new_file(filename, length);
+    fls->line_starts = (unsigned int *) line_starts;
+    fls->num_lines = num_lines;
+    // a capacity smaller than num_lines marks the table as not growable
+    fls->capacity = 0;
+    return num_files++;
+}
+
+// Requires: file_id was returned by file_location_register
+// Forget the line starts of the file with id file_id (except the first),
+// so that the file (which now has length bytes) can be read again
+// with the same id; its range of locations is moved if it has no room
+// for length bytes, so its old locations must no longer be used
+void file_location_restart(unsigned int file_id, size_t length)
+{
+    assert(file_id < num_files);
+    file_lines *fls = &files[file_id];
+    // (a table given to file_location_register_lines cannot be changed)
+    assert(fls->num_lines <= fls->capacity);
+    fls->num_lines = 1;
+    if (file_location_fits(file_id, length)) {
+	return;
+    }
+    if (fls->base + fls->room == next_base) {
+	// the file's range is the last one, so it can just grow
+	next_base = fls->base;
+	give_range(fls, length);
+	return;
+    }
+    // its old range is left unused
+    unsigned int i = 0;
+    while (by_base[i] != file_id) {
+	i++;
     }
-    ret->filename = filename;
-    ret->line = line;
-    return ret;
+    memmove(&by_base[i], &by_base[i + 1],
+	    (num_files - i - 1) * sizeof(unsigned int));
+    by_base[num_files - 1] = file_id;
+    give_range(fls, length);
 }
 
-// Requires: fl != NULL
-// Return a (pointer to a) fresh copy of fl
-file_location *file_location_copy(file_location *fl)
+// Requires: file_id was returned by file_location_register
+// Does the range of locations of the file with id file_id have room
+// for length bytes? (If not, the file has to be restarted
+// before it can have that many.)
+bool file_location_fits(unsigned int file_id, size_t length)
 {
-    file_location *ret = (file_location *) malloc(sizeof(file_location));
-    if (ret == NULL) {
-	bail_with_error("Could not allocate space for a file_location!");
+    assert(file_id < num_files);
+    return length < files[file_id].room;
+}
+
+// Requires: file_id was returned by file_location_register
+//           and offset is larger than the start of each line already added
+// Record that the next line of the file with the given id starts at offset
+void file_location_add_line(unsigned int file_id, unsigned int offset)
+{
+    assert(file_id < num_files);
+    file_lines *fls = &files[file_id];
+    assert(fls->num_lines <= fls->capacity);
+    if (fls->num_lines == fls->capacity) {
+	fls->capacity = (fls->capacity == 0) ? 1024 : 2 * fls->capacity;
+	fls->line_starts = (unsigned int *)
+	    realloc(fls->line_starts, fls->capacity * sizeof(unsigned int));
+	if (fls->line_starts == NULL) {
+	    bail_with_error("Could not allocate space for line starts of %s!",
+			    fls->filename);
+	}
+    }
+    assert(fls->num_lines == 0
+	   || fls->line_starts[fls->num_lines - 1] < offset);
+    fls->line_starts[fls->num_lines++] = offset;
+}
+
+// Return the index in the line starts of fls of the first line
+// that starts at or after offset
+static unsigned int first_line_from(file_lines *fls, unsigned int offset)
+{
+    unsigned int lo = 0;
+    unsigned int hi = fls->num_lines;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (fls->line_starts[mid] < offset) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+// Requires: file_id was returned by file_location_register,
+//           start <= old_end, start <= new_end,
+//           and lines are the increasing offsets of the lines that start
+//           in the file after start, up to new_end (i.e., after each
+//           newline in the text from start up to new_end)
+// Record that the file's text from start up to old_end was replaced
+// by text from start up to new_end, which has the given lines,
+// so the lines that started after old_end are moved by new_end - old_end
+void file_location_replace_lines(unsigned int file_id, unsigned int start,
+				 unsigned int old_end, unsigned int new_end,
+				 const unsigned int *lines,
+				 unsigned int num_lines)
+{
+    assert(file_id < num_files);
+    file_lines *fls = &files[file_id];
+    assert(fls->num_lines <= fls->capacity);
+    unsigned int first = first_line_from(fls, start + 1);
+    unsigned int end = first_line_from(fls, old_end + 1);
+    unsigned int after = fls->num_lines - end;
+    unsigned int count = first + num_lines + after;
+    while (fls->capacity < count) {
+	fls->capacity = (fls->capacity == 0) ? 1024 : 2 * fls->capacity;
+	fls->line_starts = (unsigned int *)
+	    realloc(fls->line_starts, fls->capacity * sizeof(unsigned int));
+	if (fls->line_starts == NULL) {
+	    bail_with_error("Could not allocate space for line starts of %s!",
+			    fls->filename);
+	}
+    }
+    memmove(&fls->line_starts[first + num_lines], &fls->line_starts[end],
+	    after * sizeof(unsigned int));
+    if (num_lines > 0) {
+	memcpy(&fls->line_starts[first], lines,
+	       num_lines * sizeof(unsigned int));
     }
-    ret->filename = fl->filename;
-    ret->line = fl->line;
-    return ret;
+    fls->num_lines = count;
+    for (unsigned int i = first + num_lines; i < count; i++) {
+	fls->line_starts[i] += new_end - old_end;
+    }
+}
+
+// Requires: file_id was returned by file_location_register
+// Return the location of the given byte offset in the file with id file_id
+file_location file_location_make(unsigned int file_id, unsigned int offset)
+{
+    assert(file_id < num_files);
+    file_lines *fls = &files[file_id];
+    if (offset >= fls->room) {
+	// (the file was longer when read than when it was registered)
+	bail_with_error("%s grew while it was being read!", fls->filename);
+    }
+    return fls->base + offset;
+}
+
+// Return the file id of fl
+static unsigned int file_id_of(file_location fl)
+{
+    // find the last file whose range starts at or before fl
+    unsigned int lo = 0;
+    unsigned int hi = num_files;
+    while (hi - lo > 1) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (files[by_base[mid]].base <= fl) {
+	    lo = mid;
+	} else {
+	    hi = mid;
+	}
+    }
+    return by_base[lo];
+}
+
+// Return the byte offset of fl
+static unsigned int offset_of(file_location fl)
+{
+    return fl - files[file_id_of(fl)].base;
+}
+
+// Return the index in the line starts of fls of the line
+// that offset is in
+static unsigned int line_index(file_lines *fls, unsigned int offset)
+{
+    // find the last line that starts at or before offset
+    unsigned int lo = 0;
+    unsigned int hi = fls->num_lines;
+    while (hi - lo > 1) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (fls->line_starts[mid] <= offset) {
+	    lo = mid;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+// Return the id of the file that fl is in
+unsigned int file_location_file_id(file_location fl)
+{
+    return file_id_of(fl);
+}
+
+// Return the byte offset of fl in its file
+unsigned int file_location_offset(file_location fl)
+{
+    return offset_of(fl);
+}
+
+// Requires: file_id was returned by file_location_register
+// Return the line starts of the file with id file_id,
+// putting the number of its lines in *num_lines
+const unsigned int *file_location_line_starts(unsigned int file_id,
+					      unsigned int *num_lines)
+{
+    assert(file_id < num_files);
+    *num_lines = files[file_id].num_lines;
+    return files[file_id].line_starts;
+}
+
+// Return the name of the file that fl is in
+const char *file_location_filename(file_location fl)
+{
+    return files[file_id_of(fl)].filename;
+}
+
+// Return the line (counting from 1) that fl is in
+unsigned int file_location_line(file_location fl)
+{
+    file_lines *fls = &files[file_id_of(fl)];
+    return line_index(fls, fl - fls->base) + 1;
+}
+
+// Return the column (counting from 1) of fl in its line
+unsigned int file_location_column(file_location fl)
+{
+    file_lines *fls = &files[file_id_of(fl)];
+    unsigned int offset = fl - fls->base;
+    return offset - fls->line_starts[line_index(fls, offset)] + 1;
 }
@@ -1,21 +1,94 @@
 /* $Id: file_location.h,v 1.2 2023/10/13 12:15:32 leavens Exp $ */
 #ifndef _FILE_LOCATION_H
 #define _FILE_LOCATION_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-// location in a source file (useful for error messages)
-typedef struct {
-    const char *filename;
-    unsigned int line; // of first token
-} file_location;
+// location in a source file (useful for error messages),
+// in 32 bits: each registered file is given a range of locations
+// (starting at its base), one for each byte offset in it,
+// so a location is its file's base plus the byte offset of the first
+// character of the token in that file, and its file is found
+// by a binary search over the bases.
+// The line and column are only computed (from the file's table of
+// line starts, built during lexing) when they are asked for.
+typedef uint32_t file_location;
 
 // Requires: filename != NULL
-// Return a (pointer to a) fresh file_location with the given
-// information
-extern file_location *file_location_make(const char *filename,
-					 unsigned int line);
-
-// Requires: fl != NULL
-// Return a (pointer to a) fresh copy of fl
-extern file_location *file_location_copy(file_location *fl);
+// Start an (empty) table of line starts for the file named filename,
+// which has length bytes, giving it a range of locations (with room
+// for it to grow some), and return the file's id
+extern unsigned int file_location_register(const char *filename,
+					   size_t length);
+
+// Requires: filename != NULL, num_lines > 0, line_starts[0] == 0,
+//           and line_starts is sorted in increasing order
+// Like file_location_register, but the file's line starts are given
+// (and are used in place, so they must outlive the file's locations,
+// and no lines can be added to the file with file_location_add_line)
+extern unsigned int file_location_register_lines(const char *filename,
+					const unsigned int *line_starts,
+					unsigned int num_lines,
+					size_t length);
+
+// Requires: file_id was returned by file_location_register
+// Forget the line starts of the file with id file_id (except the first),
+// so that the file (which now has length bytes) can be read again
+// with the same id; its range of locations is moved if it has no room
+// for length bytes, so its old locations must no longer be used
+extern void file_location_restart(unsigned int file_id, size_t length);
+
+// Requires: file_id was returned by file_location_register
+// Does the range of locations of the file with id file_id have room
+// for length bytes? (If not, the file has to be restarted
+// before it can have that many.)
+extern bool file_location_fits(unsigned int file_id, size_t length);
+
+// Requires: file_id was returned by file_location_register
+//           and offset is larger than the start of each line already added
+// Record that the next line of the file with the given id starts at offset
+extern void file_location_add_line(unsigned int file_id, unsigned int offset);
+
+// Requires: file_id was returned by file_location_register,
+//           start <= old_end, start <= new_end,
+//           and lines are the increasing offsets of the lines that start
+//           in the file after start, up to new_end (i.e., after each
+//           newline in the text from start up to new_end)
+// Record that the file's text from start up to old_end was replaced
+// by text from start up to new_end, which has the given lines,
+// so the lines that started after old_end are moved by new_end - old_end
+extern void file_location_replace_lines(unsigned int file_id,
+					unsigned int start,
+					unsigned int old_end,
+					unsigned int new_end,
+					const unsigned int *lines,
+					unsigned int num_lines);
+
+// Requires: file_id was returned by file_location_register
+// Return the location of the given byte offset in the file with id file_id
+extern file_location file_location_make(unsigned int file_id,
+					unsigned int offset);
+
+// Return the id of the file that fl is in
+extern unsigned int file_location_file_id(file_location fl);
+
+// Return the byte offset of fl in its file
+extern unsigned int file_location_offset(file_location fl);
+
+// Requires: file_id was returned by file_location_register
+// Return the line starts of the file with id file_id,
+// putting the number of its lines in *num_lines
+extern const unsigned int *file_location_line_starts(unsigned int file_id,
+						     unsigned int *num_lines);
+
+// Return the name of the file that fl is in
+extern const char *file_location_filename(file_location fl);
+
+// Return the line (counting from 1) that fl is in
+extern unsigned int file_location_line(file_location fl);
+
+// Return the column (counting from 1) of fl in its line
+extern unsigned int file_location_column(file_location fl);
 
 #endif
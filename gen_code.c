@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gen_code.h"
+#include "bof.h"
+#include "bytecode.h"
+#include "file_location.h"
+#include "instruction.h"
+#include "utilities.h"
+
+// What there is no space to do, if growing an array fails
+#define PURPOSE "generate the program's code"
+
+// Where the text is loaded, and the number of bytes for the stack
+#define TEXT_START 0
+#define STACK_BYTES (1u << 24)
+
+// The words of an activation record's header, before its slots
+#define HEADER_WORDS 3
+#define STATIC_LINK 0
+#define DYNAMIC_LINK 1
+#define RETURN_ADDRESS 2
+
+// The state of the code generator (which translates one program at a
+// time, twice: first to find where the code for each bytecode
+// instruction goes, then with the addresses of the jumps' targets)
+typedef struct {
+    const bytecode *bc;
+    word_type *text;            // the instructions generated
+    unsigned int length;        // (the number of them)
+    unsigned int text_size;
+    char *data;                 // the data (the error messages)
+    unsigned int data_length;   // (the number of bytes)
+    unsigned int data_size;
+    unsigned int last_message;  // where the last message added starts
+    address_type *addrs;        // the address of each bytecode pc's code
+    address_type stack_limit;   // the lowest address the records may use
+    // the sizes of the records of the blocks being translated
+    unsigned int *sizes;
+    unsigned int num_sizes;
+    unsigned int sizes_size;
+} gen;
+
+// Append the instruction w
+static void emit(gen *g, word_type w)
+{
+    reserve_array((void **) &g->text, &g->text_size, sizeof(word_type),
+		  g->length + 1, PURPOSE);
+    g->text[g->length++] = w;
+}
+
+static void emit_reg(gen *g, func_code func, reg_num_type rs,
+		     reg_num_type rt, reg_num_type rd, shift_type shift)
+{
+    emit(g, instruction_reg_form(func, rs, rt, rd, shift));
+}
+
+static void emit_immed(gen *g, op_code op, reg_num_type rs, reg_num_type rt,
+		       int immed)
+{
+    emit(g, instruction_immed_form(op, rs, rt, (immediate_type) immed));
+}
+
+// Append a jump (or JAL) to the byte address addr
+static void emit_jump(gen *g, op_code op, address_type addr)
+{
+    emit(g, instruction_jump_form(op, addr / BYTES_PER_WORD));
+}
+
+static void emit_syscall(gen *g, syscall_code code)
+{
+    emit(g, instruction_syscall_form(code));
+}
+
+// Does v fit in a (sign extended) immediate operand?
+static bool fits_immediate(int v)
+{
+    return -32768 <= v && v <= 32767;
+}
+
+// Return the number of instructions emit_constant uses for v
+static unsigned int constant_length(word_type v)
+{
+    return fits_immediate(v) ? 1 : 3;
+}
+
+// Append the three instructions that put v in register r
+static void emit_long_constant(gen *g, reg_num_type r, word_type v)
+{
+    emit_immed(g, ADDI_O, ZERO, r, (short) ((unsigned int) v >> 16));
+    emit_reg(g, SLL_F, ZERO, r, r, 16);
+    emit_immed(g, BORI_O, r, r, v & 0xFFFF);
+}
+
+// Append the instructions that put v in register r
+static void emit_constant(gen *g, reg_num_type r, word_type v)
+{
+    if (fits_immediate(v)) {
+	emit_immed(g, ADDI_O, ZERO, r, v);
+    } else {
+	emit_long_constant(g, r, v);
+    }
+}
+
+// Append the instructions that put GPR[s] + v in register r (not AT)
+static void emit_add_constant(gen *g, reg_num_type r, reg_num_type s,
+			      word_type v)
+{
+    if (fits_immediate(v)) {
+	emit_immed(g, ADDI_O, s, r, v);
+    } else {
+	emit_constant(g, AT, v);
+	emit_reg(g, ADD_F, s, AT, r, 0);
+    }
+}
+
+// Append the load or store (op) of register r to or from the word
+// that is words words after the address in register base (not AT)
+static void emit_memory(gen *g, op_code op, reg_num_type r,
+			reg_num_type base, unsigned int words)
+{
+    if (words <= 32767) {
+	emit_immed(g, op, base, r, (int) words);
+    } else {
+	emit_constant(g, AT, (word_type) (words * BYTES_PER_WORD));
+	emit_reg(g, ADD_F, base, AT, AT, 0);
+	emit_immed(g, op, AT, r, 0);
+    }
+}
+
+// Return the register that holds the start of the record levels static
+// links out from the one in use, appending the code that loads it into
+// r (if levels > 0)
+static reg_num_type emit_outer(gen *g, unsigned int levels, reg_num_type r)
+{
+    if (levels == 0) {
+	return FP;
+    }
+    emit_memory(g, LW_O, r, FP, STATIC_LINK);
+    for (unsigned int l = 1; l < levels; l++) {
+	emit_memory(g, LW_O, r, r, STATIC_LINK);
+    }
+    return r;
+}
+
+// Return where the message for the run-time error described by fmt
+// (which may use name) at loc starts in the data, adding it there
+// unless it is the same as the last message added
+static unsigned int message(gen *g, file_location loc, const char *fmt,
+			    const char *name)
+{
+    char msg[2048];
+    int n = snprintf(msg, sizeof(msg), "%s: line %u ",
+		     file_location_filename(loc), file_location_line(loc));
+    snprintf(msg + n, sizeof(msg) - n, fmt, name);
+    if (g->data_length > 0 && strcmp(msg, &g->data[g->last_message]) == 0) {
+	return g->last_message;
+    }
+    size_t len = strlen(msg) + 1;
+    reserve_array((void **) &g->data, &g->data_size, 1,
+		  g->data_length + (unsigned int) len, PURPOSE);
+    memcpy(&g->data[g->data_length], msg, len);
+    g->last_message = g->data_length;
+    g->data_length += (unsigned int) len;
+    return g->last_message;
+}
+
+// Return the number of instructions emit_error uses for the message at msg
+static unsigned int error_length(unsigned int msg)
+{
+    return fits_immediate((int) msg) ? 2
+	: constant_length((word_type) msg) + 2;
+}
+
+// Append the code that reports the run-time error whose message
+// is at msg in the data
+static void emit_error(gen *g, unsigned int msg)
+{
+    if (fits_immediate((int) msg)) {
+	emit_immed(g, ADDI_O, GP, A0, (int) msg);
+    } else {
+	emit_constant(g, A0, (word_type) msg);
+	emit_reg(g, ADD_F, A0, GP, A0, 0);
+    }
+    emit_syscall(g, fail_sc);
+}
+
+// Append the branch (op, on rs and rt) that skips the code that follows
+// it, which reports the run-time error of the bytecode instruction at pc
+// with the message fmt (and name)
+static void emit_check(gen *g, op_code op, reg_num_type rs, reg_num_type rt,
+		       unsigned int pc, const char *fmt)
+{
+    const bytecode_loc *l = bytecode_location(g->bc, pc);
+    unsigned int msg = message(g, l->loc, fmt, l->name);
+    emit_immed(g, op, rs, rt, (int) error_length(msg));
+    emit_error(g, msg);
+}
+
+// Append the code that checks there is space for a record of need bytes
+// below the address in register r, for the bytecode instruction at pc
+// (S0 holds the lowest address the records may use)
+static void emit_stack_check(gen *g, reg_num_type r, unsigned int need,
+			     unsigned int pc)
+{
+    emit_add_constant(g, T2, r, -(word_type) need);
+    emit_reg(g, SUB_F, T2, S0, T2, 0);
+    emit_check(g, BGEZ_O, T2, ZERO, pc,
+	       "the run-time stack is full (too many nested calls)!");
+}
+
+// Append the code that pops the value on top of the stack into r
+static void emit_pop(gen *g, reg_num_type r)
+{
+    emit_memory(g, LW_O, r, SP, 0);
+    emit_immed(g, ADDI_O, SP, SP, BYTES_PER_WORD);
+}
+
+// Append the code that pushes the value in r
+static void emit_push(gen *g, reg_num_type r)
+{
+    emit_immed(g, ADDI_O, SP, SP, -BYTES_PER_WORD);
+    emit_memory(g, SW_O, r, SP, 0);
+}
+
+// Append the code that pops the two values on top of the stack,
+// the top one into T1 and the one below it into T0
+static void emit_pop2(gen *g)
+{
+    emit_memory(g, LW_O, T1, SP, 0);
+    emit_memory(g, LW_O, T0, SP, 1);
+    emit_immed(g, ADDI_O, SP, SP, 2 * BYTES_PER_WORD);
+}
+
+// Append the code that starts a record of size slots at GPR[SP]
+// (after making space for it), with the static link in sl
+static void emit_record_start(gen *g, unsigned int size, reg_num_type sl)
+{
+    emit_memory(g, SW_O, sl, SP, STATIC_LINK);
+    emit_memory(g, SW_O, FP, SP, DYNAMIC_LINK);
+    emit_immed(g, ADDI_O, SP, FP, 0);
+    for (unsigned int i = 0; i < size; i++) {
+	emit_memory(g, SW_O, ZERO, FP, HEADER_WORDS + i);
+    }
+    reserve_array((void **) &g->sizes, &g->sizes_size, sizeof(unsigned int),
+		  g->num_sizes + 1, PURPOSE);
+    g->sizes[g->num_sizes++] = size;
+}
+
+// Return the number of bytes in a record of size slots
+static unsigned int record_bytes(unsigned int size)
+{
+    return (HEADER_WORDS + size) * BYTES_PER_WORD;
+}
+
+// Append the code that leaves the record in use
+// (ending the innermost block being translated)
+static void emit_record_end(gen *g)
+{
+    unsigned int size = g->sizes[--g->num_sizes];
+    emit_add_constant(g, SP, FP, (word_type) record_bytes(size));
+    emit_memory(g, LW_O, FP, FP, DYNAMIC_LINK);
+}
+
+// Append the code that pops two values and jumps to the code
+// for the bytecode at target unless the relation of op holds of them
+static void emit_jump_unless(gen *g, bytecode_op op, unsigned int target)
+{
+    emit_pop2(g);
+    switch (op) {
+    case op_jump_unless_eq:
+	emit_immed(g, BEQ_O, T0, T1, 1);
+	break;
+    case op_jump_unless_ne:
+	emit_immed(g, BNE_O, T0, T1, 1);
+	break;
+    default:
+	// compare T0 - T1 to 0, unless the signs of T0 and T1 differ
+	// (when the difference could overflow): then T0 (made nonzero)
+	// is compared to 0
+	emit_reg(g, XOR_F, T0, T1, T2, 0);
+	emit_immed(g, BGEZ_O, T2, ZERO, 2);
+	emit_immed(g, BORI_O, T0, T0, 1);
+	emit_immed(g, ADDI_O, ZERO, T1, 0);
+	emit_reg(g, SUB_F, T0, T1, T0, 0);
+	emit_immed(g, (op == op_jump_unless_lt) ? BLTZ_O
+		   : (op == op_jump_unless_le) ? BLEZ_O
+		   : (op == op_jump_unless_gt) ? BGTZ_O : BGEZ_O, T0, ZERO, 1);
+	break;
+    }
+    emit_jump(g, JMP_O, g->addrs[target]);
+}
+
+// Append the code that divides the value on top of the stack by d
+// (see bytecode_divisor), which needs no DIV: the SRM only shifts
+// in 0s, so a shift of a negative number is done on its complement
+static void emit_div_const(gen *g, const bytecode_divisor *d)
+{
+    emit_memory(g, LW_O, T0, SP, 0);
+    // T1 = 1 if the dividend is negative, and AT = -T1 (all 1s if so)
+    emit_reg(g, SRL_F, 0, T0, T1, 31);
+    emit_reg(g, SUB_F, ZERO, T1, AT, 0);
+    if (d->multiplier == 0) {
+	// the quotient is |a| >> shift, negated unless the signs agree
+	emit_reg(g, XOR_F, T0, AT, T0, 0);
+	emit_reg(g, SUB_F, T0, AT, T0, 0);
+	emit_reg(g, SRL_F, 0, T0, T0, d->shift);
+	if (d->divisor < 0) {
+	    emit_reg(g, NOR_F, AT, ZERO, AT, 0);
+	}
+	emit_reg(g, XOR_F, T0, AT, T0, 0);
+	emit_reg(g, SUB_F, T0, AT, T0, 0);
+    } else {
+	// HI is the product with the multiplier (as a signed word)
+	// divided by 2 to the 32 and rounded down, which the shift
+	// (of a number with the dividend's sign) keeps rounded down;
+	// rounding down is then made rounding toward 0
+	emit_constant(g, T2, (word_type) d->multiplier);
+	emit_reg(g, MUL_F, T0, T2, 0, 0);
+	emit_reg(g, MFHI_F, 0, 0, T2, 0);
+	if (d->multiplier > 0x7FFFFFFFu) {
+	    emit_reg(g, ADD_F, T2, T0, T2, 0);
+	}
+	if (d->shift > 0) {
+	    emit_reg(g, XOR_F, T2, AT, T2, 0);
+	    emit_reg(g, SRL_F, 0, T2, T2, d->shift);
+	    emit_reg(g, XOR_F, T2, AT, T2, 0);
+	}
+	if (d->divisor < 0) {
+	    emit_reg(g, SUB_F, AT, T2, T0, 0);
+	} else {
+	    emit_reg(g, ADD_F, T2, T1, T0, 0);
+	}
+    }
+    emit_memory(g, SW_O, T0, SP, 0);
+}
+
+// Append the code that pops a value and jumps to the code for the
+// bytecode at target unless it is divisible by d (see bytecode_divisor)
+static void emit_jump_unless_divisible_const(gen *g,
+					     const bytecode_divisor *d,
+					     unsigned int target)
+{
+    emit_pop(g, T0);
+    if (d->multiplier == 0) {
+	if (d->shift == 0) {
+	    // (everything is divisible by 1 and -1)
+	    return;
+	}
+	emit_reg(g, SLL_F, 0, T0, T0, 32 - d->shift);
+	emit_immed(g, BEQ_O, T0, ZERO, 1);
+    } else {
+	emit_constant(g, T1, (word_type) d->inverse);
+	emit_reg(g, MUL_F, T0, T1, 0, 0);
+	emit_reg(g, MFLO_F, 0, 0, T0, 0);
+	emit_add_constant(g, T0, T0, (word_type) d->bias);
+	if (d->zeros > 0) {
+	    emit_reg(g, SRL_F, 0, T0, T1, d->zeros);
+	    emit_reg(g, SLL_F, 0, T0, T0, 32 - d->zeros);
+	    emit_reg(g, BOR_F, T0, T1, T0, 0);
+	}
+	// (the limit is below 2 to the 31, so T0 is at most the limit
+	// if it is not negative and the limit minus it is not)
+	emit_immed(g, BLTZ_O, T0, ZERO,
+		   (int) constant_length((word_type) d->limit) + 2);
+	emit_constant(g, T1, (word_type) d->limit);
+	emit_reg(g, SUB_F, T1, T0, T0, 0);
+	emit_immed(g, BGEZ_O, T0, ZERO, 1);
+    }
+    emit_jump(g, JMP_O, g->addrs[target]);
+}
+
+// Append the code for the bytecode instruction at pc
+static void translate(gen *g, unsigned int pc)
+{
+    const word_type *code = g->bc->code;
+    const word_type *in = &code[pc];
+    switch ((bytecode_op) in[0]) {
+    case op_halt:
+	emit_immed(g, ADDI_O, ZERO, A0, 0);
+	emit_syscall(g, exit_sc);
+	break;
+    case op_push:
+	emit_constant(g, T0, in[1]);
+	emit_push(g, T0);
+	break;
+    case op_load:
+	emit_memory(g, LW_O, T0, FP, HEADER_WORDS + in[1]);
+	emit_push(g, T0);
+	break;
+    case op_load_outer:
+	emit_memory(g, LW_O, T0, emit_outer(g, in[1], T1),
+		    HEADER_WORDS + in[2]);
+	emit_push(g, T0);
+	break;
+    case op_store:
+	emit_pop(g, T0);
+	emit_memory(g, SW_O, T0, FP, HEADER_WORDS + in[1]);
+	break;
+    case op_store_outer:
+	emit_pop(g, T0);
+	emit_memory(g, SW_O, T0, emit_outer(g, in[1], T1),
+		    HEADER_WORDS + in[2]);
+	break;
+    case op_read:
+	emit_syscall(g, read_char_sc);
+	emit_memory(g, SW_O, V0, emit_outer(g, in[1], T1),
+		    HEADER_WORDS + in[2]);
+	break;
+    case op_print:
+	emit_pop(g, A0);
+	emit_syscall(g, print_int_sc);
+	emit_immed(g, ADDI_O, ZERO, A0, '\n');
+	emit_syscall(g, print_char_sc);
+	break;
+    case op_add: case op_sub: case op_mul: case op_div:
+	emit_memory(g, LW_O, T1, SP, 0);
+	emit_memory(g, LW_O, T0, SP, 1);
+	if (in[0] == op_add) {
+	    emit_reg(g, ADD_F, T0, T1, T0, 0);
+	} else if (in[0] == op_sub) {
+	    emit_reg(g, SUB_F, T0, T1, T0, 0);
+	} else {
+	    if (in[0] == op_div) {
+		emit_check(g, BNE_O, T1, ZERO, pc, "division by zero!");
+	    }
+	    emit_reg(g, (in[0] == op_mul) ? MUL_F : DIV_F, T0, T1, 0, 0);
+	    emit_reg(g, MFLO_F, 0, 0, T0, 0);
+	}
+	emit_memory(g, SW_O, T0, SP, 1);
+	emit_immed(g, ADDI_O, SP, SP, BYTES_PER_WORD);
+	break;
+    case op_div_const:
+	emit_div_const(g, &g->bc->divisors[in[1]]);
+	break;
+    case op_neg:
+	emit_memory(g, LW_O, T0, SP, 0);
+	emit_reg(g, SUB_F, ZERO, T0, T0, 0);
+	emit_memory(g, SW_O, T0, SP, 0);
+	break;
+    case op_jump:
+	emit_jump(g, JMP_O, g->addrs[in[1]]);
+	break;
+    case op_jump_unless_eq: case op_jump_unless_ne: case op_jump_unless_lt:
+    case op_jump_unless_le: case op_jump_unless_gt: case op_jump_unless_ge:
+	emit_jump_unless(g, (bytecode_op) in[0], in[1]);
+	break;
+    case op_jump_unless_divisible:
+	emit_pop2(g);
+	emit_check(g, BNE_O, T1, ZERO, pc, "division by zero!");
+	emit_reg(g, DIV_F, T0, T1, 0, 0);
+	emit_reg(g, MFHI_F, 0, 0, T0, 0);
+	emit_immed(g, BEQ_O, T0, ZERO, 1);
+	emit_jump(g, JMP_O, g->addrs[in[1]]);
+	break;
+    case op_jump_unless_divisible_const:
+	emit_jump_unless_divisible_const(g, &g->bc->divisors[in[1]], in[2]);
+	break;
+    case op_call: {
+	// (the callee's code starts with op_enter, giving its record's size)
+	emit_stack_check(g, SP, record_bytes(code[in[2] + 1]), pc);
+	reg_num_type sl = emit_outer(g, in[1], T0);
+	if (sl != T0) {
+	    emit_immed(g, ADDI_O, sl, T0, 0);
+	}
+	emit_jump(g, JAL_O, g->addrs[in[2]]);
+	break;
+    }
+    case op_enter:
+	emit_add_constant(g, SP, SP, -(word_type) record_bytes(in[1]));
+	emit_memory(g, SW_O, RA, SP, RETURN_ADDRESS);
+	emit_record_start(g, in[1], T0);
+	break;
+    case op_return:
+	emit_memory(g, LW_O, RA, FP, RETURN_ADDRESS);
+	emit_record_end(g);
+	emit_reg(g, JR_F, RA, 0, 0, 0);
+	break;
+    case op_block:
+	emit_stack_check(g, SP, record_bytes(in[1]), pc);
+	emit_add_constant(g, SP, SP, -(word_type) record_bytes(in[1]));
+	emit_record_start(g, in[1], FP);
+	break;
+    case op_leave:
+	emit_record_end(g);
+	break;
+    case op_assign_constant: {
+	const bytecode_loc *l = bytecode_location(g->bc, pc);
+	emit_error(g, message(g, l->loc, "cannot assign to constant \"%s\"!",
+			      l->name));
+	break;
+    }
+    }
+}
+
+// Translate all of the bytecode, from the start
+static void translate_all(gen *g)
+{
+    g->length = 0;
+    g->data_length = 0;
+    g->num_sizes = 0;
+    // (the stack limit is not known in the first translation,
+    // so the same number of instructions is used for any value)
+    emit_long_constant(g, S0, (word_type) g->stack_limit);
+    const bytecode *bc = g->bc;
+    for (unsigned int pc = 0; pc < bc->length;
+	 pc += 1 + bytecode_num_operands(bc->code[pc])) {
+	g->addrs[pc] = TEXT_START + g->length * BYTES_PER_WORD;
+	translate(g, pc);
+    }
+}
+
+// Requires: prog has been scope checked without errors
+// Write the code for prog, as a binary object file, to the file named
+// filename
+void gen_code_program(block_t *prog, const char *filename)
+{
+    gen g = { 0 };
+    g.bc = bytecode_compile(prog);
+    g.addrs = (address_type *)
+	calloc(g.bc->length + 1, sizeof(address_type));
+    if (g.addrs == NULL) {
+	bail_with_error("No space to generate the program's code!");
+    }
+    // (the lengths of the code and data don't depend on the addresses,
+    // so the second translation puts everything where the first did)
+    translate_all(&g);
+    bof_header hdr;
+    hdr.text_start_address = TEXT_START;
+    hdr.text_length = g.length * BYTES_PER_WORD;
+    hdr.data_start_address = TEXT_START + hdr.text_length;
+    hdr.data_length = (g.data_length + BYTES_PER_WORD - 1)
+	/ BYTES_PER_WORD * BYTES_PER_WORD;
+    // (expressions are evaluated below the records, so space is left
+    // for the values of the deepest one)
+    g.stack_limit = hdr.data_start_address + hdr.data_length
+	+ (g.bc->max_depth + 1) * BYTES_PER_WORD;
+    hdr.stack_bottom_address = hdr.data_start_address + hdr.data_length
+	+ STACK_BYTES;
+    translate_all(&g);
+
+    // the data's bytes, in little-endian words
+    word_type *data = (word_type *) calloc(hdr.data_length / BYTES_PER_WORD
+					   + 1, sizeof(word_type));
+    if (data == NULL) {
+	bail_with_error("No space to generate the program's code!");
+    }
+    for (unsigned int i = 0; i < g.data_length; i++) {
+	data[i / BYTES_PER_WORD] = (word_type) ((unsigned int)
+	    data[i / BYTES_PER_WORD]
+	    | ((unsigned int) (unsigned char) g.data[i]
+	       << (8 * (i % BYTES_PER_WORD))));
+    }
+    bof_write(filename, hdr, g.text, data);
+    free(data);
+    free(g.text);
+    free(g.data);
+    free(g.addrs);
+    free(g.sizes);
+}
@@ -0,0 +1,31 @@
+#ifndef _GEN_CODE_H
+#define _GEN_CODE_H
+#include "ast.h"
+
+// Generating code for the SRM (see instruction.h) from SPL programs.
+//
+// The code is generated from the program's bytecode (see bytecode.h),
+// translating each of its instructions in turn, and is written as a
+// binary object file (see bof.h). Each block (the program's, each
+// procedure's, and each block statement's) runs in an activation record
+// on the stack, at GPR[FP]: a header of a static link (the record of the
+// block it is declared in), a dynamic link (the record in use before it)
+// and a return address, and then one word for each of the block's
+// constants and variables (at its offset_count). Each name is found by
+// following levelsOutward static links. A call passes its procedure's
+// static link in GPR[T0], and JAL leaves the return address in GPR[RA].
+// Expressions are evaluated on the stack, below the record in use
+// (GPR[SP] is the address of the value on top).
+//
+// Running the code has the same results as running the program with
+// --run: it prints with print_int_sc and print_char_sc, reads with
+// read_char_sc, and reports run-time errors (with their locations)
+// with fail_sc. Running out of stack is such an error, as the code
+// checks that there is space for each activation record.
+
+// Requires: prog has been scope checked without errors
+// Write the code for prog, as a binary object file, to the file named
+// filename
+extern void gen_code_program(block_t *prog, const char *filename);
+
+#endif
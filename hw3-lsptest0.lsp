@@ -0,0 +1,19 @@
+{"jsonrpc":"2.0","id":1,"method":"initialize","params":{"processId":null,"rootUri":null,"capabilities":{}}}
+{"jsonrpc":"2.0","method":"initialized","params":{}}
+{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl","languageId":"spl","version":1,"text":"% served by the language server, with the requests in hw3-lsptest0.lsp\nbegin\n  const limit = 10, step = 2;\n  var total;\n  proc addUp\n  begin\n    var i;\n    i := 0;\n    while i < limit do\n      total := total + i;\n      i := i + step\n    end\n  end;\n  proc report\n  begin\n    print total\n  end;\n  call addUp;\n  read total;\n  call report\nend.\n"}}}
+{"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":8,"character":14}}}
+{"jsonrpc":"2.0","id":3,"method":"textDocument/hover","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":17,"character":7}}}
+{"jsonrpc":"2.0","id":4,"method":"textDocument/definition","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":15,"character":10}}}
+{"jsonrpc":"2.0","id":5,"method":"textDocument/references","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":3,"character":6},"context":{"includeDeclaration":true}}}
+{"jsonrpc":"2.0","id":6,"method":"textDocument/references","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":8,"character":10},"context":{"includeDeclaration":false}}}
+{"jsonrpc":"2.0","id":7,"method":"textDocument/hover","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":0,"character":3}}}
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl","version":2},"contentChanges":[{"range":{"start":{"line":6,"character":8},"end":{"line":6,"character":9}},"text":"i, i"}]}}
+{"jsonrpc":"2.0","id":8,"method":"textDocument/definition","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":10,"character":15}}}
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl","version":3},"contentChanges":[{"range":{"start":{"line":15,"character":4},"end":{"line":15,"character":4}},"text":"print )\n    "}]}}
+{"jsonrpc":"2.0","id":9,"method":"textDocument/hover","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":16,"character":11}}}
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl","version":4},"contentChanges":[{"range":{"start":{"line":15,"character":4},"end":{"line":16,"character":4}},"text":""},{"range":{"start":{"line":6,"character":9},"end":{"line":6,"character":12}},"text":""}]}}
+{"jsonrpc":"2.0","id":10,"method":"textDocument/references","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"position":{"line":15,"character":11},"context":{"includeDeclaration":true}}}
+{"jsonrpc":"2.0","id":11,"method":"textDocument/formatting","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"},"options":{}}}
+{"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest0.spl"}}}
+{"jsonrpc":"2.0","id":12,"method":"shutdown"}
+{"jsonrpc":"2.0","method":"exit"}
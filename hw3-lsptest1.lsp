@@ -0,0 +1,22 @@
+{"jsonrpc":"2.0","id":1,"method":"initialize","params":{"processId":null,"rootUri":null,"capabilities":{}}}
+{"jsonrpc":"2.0","method":"initialized","params":{}}
+{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl","languageId":"spl","version":1,"text":"% served by the language server, with the requests in hw3-lsptest1.lsp,\n% along with an untitled document (which is not a file)\nbegin\n  const base = 3;\n  var x, y;\n  proc twice\n  begin\n    x := x * 2\n  end;\n  read x;\n  call twice;\n  y := x + base;\n  print y\nend.\n"}}}
+{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"untitled:Untitled-1","languageId":"spl","version":1,"text":"begin\n  var n;\n  proc countDown\n  begin\n    while n > 0 do\n      n := n - 1\n    end\n  end;\n  n := 5;\n  call countDown\nend.\n"}}}
+{"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":11,"character":13}}}
+{"jsonrpc":"2.0","id":3,"method":"textDocument/references","params":{"textDocument":{"uri":"untitled:Untitled-1"},"position":{"line":1,"character":6},"context":{"includeDeclaration":true}}}
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl","version":2},"contentChanges":[{"range":{"start":{"line":7,"character":9},"end":{"line":7,"character":14}},"text":"x * base +\n      y"}]}}
+{"jsonrpc":"2.0","id":4,"method":"textDocument/references","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":3,"character":8},"context":{"includeDeclaration":true}}}
+{"jsonrpc":"2.0","id":5,"method":"textDocument/references","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":4,"character":9},"context":{"includeDeclaration":false}}}
+{"jsonrpc":"2.0","id":6,"method":"textDocument/definition","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":10,"character":7}}}
+{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"untitled:Untitled-1","version":2},"contentChanges":[{"range":{"start":{"line":1,"character":7},"end":{"line":1,"character":7}},"text":", m"},{"range":{"start":{"line":8,"character":2},"end":{"line":8,"character":2}},"text":"m := 1;\n  "}]}}
+{"jsonrpc":"2.0","id":7,"method":"textDocument/references","params":{"textDocument":{"uri":"untitled:Untitled-1"},"position":{"line":5,"character":6},"context":{"includeDeclaration":true}}}
+{"jsonrpc":"2.0","id":8,"method":"textDocument/hover","params":{"textDocument":{"uri":"untitled:Untitled-1"},"position":{"line":8,"character":3}}}
+{"jsonrpc":"2.0","id":9,"method":"textDocument/hover","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":11,"character":8}}}
+{"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"untitled:Untitled-1"}}}
+{"jsonrpc":"2.0","id":10,"method":"textDocument/hover","params":{"textDocument":{"uri":"untitled:Untitled-1"},"position":{"line":1,"character":6}}}
+{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"untitled:Untitled-1","languageId":"spl","version":1,"text":"begin\n  var n;\n  n := n +\nend.\n"}}}
+{"jsonrpc":"2.0","id":11,"method":"textDocument/definition","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":13,"character":8}}}
+{"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"}}}
+{"jsonrpc":"2.0","id":12,"method":"textDocument/definition","params":{"textDocument":{"uri":"file://@DIR@/hw3-lsptest1.spl"},"position":{"line":13,"character":8}}}
+{"jsonrpc":"2.0","id":13,"method":"shutdown"}
+{"jsonrpc":"2.0","method":"exit"}
@@ -1,5 +1,6 @@
 /* $Id: id_use.c,v 1.1 2023/10/15 21:29:24 leavens Exp $ */
 #include <stdlib.h>
+#include "machine_types.h"
 #include "id_use.h"
 #include "utilities.h"
 
@@ -22,18 +23,10 @@ extern id_use *id_use_create(id_attrs *attrs, unsigned int levelsOut)
     return ret;
 }
 
-// We'll use lexical addresses in HW4...
 // Requires: idu != NULL
 // Return (a pointer to) the lexical address for idu.
-/*
 extern lexical_address *id_use_2_lexical_address(id_use *idu)
 {
-    lexical_address *ret = (lexical_address *)malloc(sizeof(lexical_address));
-    if (ret == NULL) {
-	bail_with_error("No space to allocate lexical_address!");
-    }
-    ret->levelsOutward = idu->levelsOutward;
-    ret->offsetInAR = idu->attrs->offset_count * BYTES_PER_WORD;
-    return ret;
+    return lexical_address_create(idu->levelsOutward,
+				  idu->attrs->offset_count * BYTES_PER_WORD);
 }
-*/
@@ -2,8 +2,7 @@
 #ifndef _ID_USE_H
 #define _ID_USE_H
 #include "id_attrs.h"
-// we'll use lexical_address in HW4
-// #include "lexical_address.h"
+#include "lexical_address.h"
 
 // An id_use struct gives all the information from
 // a lookup in the symbol table for a name:
@@ -23,5 +22,5 @@ extern id_use *id_use_create(id_attrs *attrs, unsigned int levelsOut);
 
 // Requires: idu != NULL
 // Return (a pointer to) the lexical address for idu.
-// extern lexical_address *id_use_2_lexical_address(id_use *idu);
+extern lexical_address *id_use_2_lexical_address(id_use *idu);
 #endif
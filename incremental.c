@@ -0,0 +1,748 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "incremental.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parallel_lexer.h"
+#include "token_array.h"
+#include "scope_check.h"
+#include "unparser.h"
+#include "ast_walk.h"
+#include "utilities.h"
+
+// The name of the file, and its id for file_locations
+static char *doc_filename = NULL;
+static unsigned int doc_file_id;
+
+// The files opened so far, and their ids (which are kept if they are
+// opened again, so that their tables of line starts are reused)
+static char **opened_names = NULL;
+static unsigned int *opened_ids = NULL;
+static unsigned int num_opened = 0;
+static unsigned int opened_capacity = 0;
+
+// The file's current text, its length, and its allocated size
+static char *doc_text = NULL;
+static size_t doc_len = 0;
+static size_t doc_size = 0;
+
+// The number of lexical errors in the file's tokens
+static unsigned int doc_lexical_errors = 0;
+
+// Does the text parse without syntax errors, and if so, its AST,
+// the number of procedures declared in its outermost block,
+// and the results of scope checking it
+static bool doc_parsed = false;
+static block_t doc_program;
+static unsigned int doc_num_procs = 0;
+static scope_parts_t *doc_parts = NULL;
+
+// A block that encloses an edit, which can be parsed again alone:
+// the body of a procedure, or the block of a block statement
+typedef struct {
+    block_t **block;    // where its AST points to it
+    proc_decl_t *proc;  // the procedure whose body it is, or NULL
+    unsigned int first; // the index of its "begin" token
+    unsigned int end;   // and the index after its "end" (before the edit)
+} enclosing_t;
+
+// The blocks that enclose the edit being compiled (from the outermost
+// inward), the part of the program they are in (see find_enclosing),
+// and the allocated size of enclosing
+static enclosing_t *enclosing = NULL;
+static unsigned int num_enclosing = 0;
+static unsigned int enclosing_size = 0;
+static unsigned int enclosing_part;
+
+// The text read by incremental_reload, and its allocated size
+static char *reload_text = NULL;
+static size_t reload_size = 0;
+
+// Was the last edit compiled by parsing one block again, and if so,
+// that block, the procedure whose body it is (or NULL),
+// and the location of its "end"
+static bool doc_partial = false;
+static block_t *doc_partial_block;
+static proc_decl_t *doc_partial_proc;
+static file_location doc_partial_end;
+
+// Make sure that doc_text has room for size characters
+static void reserve_text(size_t size)
+{
+    if (size > doc_size) {
+	doc_size = (size > 2 * doc_size) ? size : 2 * doc_size;
+	doc_text = (char *) realloc(doc_text, doc_size);
+	if (doc_text == NULL) {
+	    bail_with_error("No space for the text of %s!", doc_filename);
+	}
+    }
+}
+
+// Read the text of the file named filename into doc_text
+static void read_text(const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+	bail_with_error("Cannot open %s", filename);
+    }
+    char buf[8192];
+    size_t n;
+    doc_len = 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+	reserve_text(doc_len + n);
+	memcpy(doc_text + doc_len, buf, n);
+	doc_len += n;
+    }
+    fclose(f);
+}
+
+// Return the index of the first of the tokens that is at or after offset
+// (which is the end of file token if there is no other)
+static unsigned int token_at(size_t offset)
+{
+    const token_array *ta = lexer_tokens();
+    file_location loc = file_location_make(doc_file_id,
+					   (unsigned int) offset);
+    unsigned int lo = 0;
+    unsigned int hi = ta->count - 1;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (ta->tokens[mid].loc < loc) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+// Return the number of lexical errors in the tokens from first up to end
+static unsigned int count_lexical_errors(const token_rec *tokens,
+					 unsigned int first, unsigned int end)
+{
+    unsigned int count = 0;
+    for (unsigned int i = first; i < end; i++) {
+	if (tokens[i].kind == TOKEN_LEXICAL_ERROR) {
+	    count++;
+	}
+    }
+    return count;
+}
+
+// Parse the whole text (from its tokens) and scope check it,
+// reporting any lexical and syntax errors as the compiler does
+static void compile_all()
+{
+    if (doc_parts != NULL) {
+	scope_parts_destroy(doc_parts);
+	doc_parts = NULL;
+    }
+    doc_partial = false;
+    lexer_rewind();
+    doc_parsed = parser_try_program(doc_filename, &doc_program);
+    if (!doc_parsed) {
+	return;
+    }
+    doc_num_procs = 0;
+    for (proc_decl_t *pd = doc_program.proc_decls.proc_decls; pd != NULL;
+	 pd = pd->next) {
+	doc_num_procs++;
+    }
+    doc_parts = scope_check_program_parts(&doc_program);
+}
+
+// Return the index in opened_names of the file named filename,
+// remembering it (with the id file_location_register gives it,
+// in a fresh table of line starts, whose range of locations is
+// given its size when it is read) if it was not opened before
+static unsigned int note_opened(const char *filename)
+{
+    unsigned int i = 0;
+    while (i < num_opened && strcmp(opened_names[i], filename) != 0) {
+	i++;
+    }
+    if (i < num_opened) {
+	return i;
+    }
+    if (num_opened == opened_capacity) {
+	opened_capacity = (opened_capacity == 0) ? 16 : 2 * opened_capacity;
+	opened_names = (char **)
+	    realloc(opened_names, opened_capacity * sizeof(char *));
+	opened_ids = (unsigned int *)
+	    realloc(opened_ids, opened_capacity * sizeof(unsigned int));
+	if (opened_names == NULL || opened_ids == NULL) {
+	    bail_with_error("No space to keep the id of %s!", filename);
+	}
+    }
+    // (the name is kept, even if the caller's copy is not)
+    opened_names[num_opened] = strdup(filename);
+    if (opened_names[num_opened] == NULL) {
+	bail_with_error("No space to keep the name of %s!", filename);
+    }
+    opened_ids[num_opened] =
+	file_location_register(opened_names[num_opened], 0);
+    return num_opened++;
+}
+
+// Compile the tokens of the text just read (from the start)
+static void compile_tokens()
+{
+    const token_array *ta = lexer_tokens();
+    doc_lexical_errors = count_lexical_errors(ta->tokens, 0, ta->count);
+    compile_all();
+}
+
+// Start compiling the file named filename incrementally
+// (in place of the file that was being compiled, if any);
+// its lexical and syntax errors, if any, are reported
+void incremental_open(char *filename)
+{
+    unsigned int i = note_opened(filename);
+    doc_filename = opened_names[i];
+    doc_file_id = opened_ids[i];
+    read_text(doc_filename);
+    lexer_reinit(doc_filename, doc_file_id);
+    lexer_tokenize_all();
+    compile_tokens();
+}
+
+// Start compiling the len characters of text incrementally, as the text
+// of the file named filename (which need not exist), as incremental_open
+// would; its lexical and syntax errors, if any, are reported
+void incremental_open_text(char *filename, const char *text, size_t len)
+{
+    unsigned int i = note_opened(filename);
+    doc_filename = opened_names[i];
+    doc_file_id = opened_ids[i];
+    reserve_text(len);
+    memcpy(doc_text, text, len);
+    doc_len = len;
+    file_location_restart(doc_file_id, len);
+    lexer_tokenize_text(doc_filename, doc_file_id, doc_text, doc_len);
+    compile_tokens();
+}
+
+// Return the name of the file being compiled
+const char *incremental_filename()
+{
+    return doc_filename;
+}
+
+// Return the current text of the file (which has incremental_length bytes)
+const char *incremental_text()
+{
+    return doc_text;
+}
+
+// Return the length of the current text of the file
+size_t incremental_length()
+{
+    return doc_len;
+}
+
+// The location from which locations are moved (by move_locations)
+// and by how many bytes
+typedef struct {
+    file_location from;
+    int delta;
+} move_t;
+
+// Move the location *fl by the move m, if it is at or after m's from
+static void move_loc(file_location *fl, const move_t *m)
+{
+    if (*fl >= m->from) {
+	*fl += m->delta;
+    }
+}
+
+// Move the location of a declaration (in its id_attrs) by the move m
+static void move_decl(id_use *idu, const move_t *m)
+{
+    if (idu != NULL) {
+	move_loc(&idu->attrs->file_loc, m);
+    }
+}
+
+// The walk's pre callback for move_locations: move the locations
+// in node (including those of the ASTs embedded in it that are not
+// visited on their own)
+static bool move_pre(void *node, AST_type t, void *data)
+{
+    const move_t *m = (const move_t *) data;
+    // every AST starts with its location
+    move_loc((file_location *) node, m);
+    switch (t) {
+    case const_decl_ast:
+	move_loc(&((const_decl_t *) node)->const_def_list.file_loc, m);
+	break;
+    case const_def_ast: {
+	const_def_t *def = (const_def_t *) node;
+	move_loc(&def->ident.file_loc, m);
+	move_loc(&def->number.file_loc, m);
+	move_decl(def->ident.idu, m);
+	break;
+    }
+    case var_decl_ast:
+	move_loc(&((var_decl_t *) node)->ident_list.file_loc, m);
+	break;
+    case ident_ast:
+	// only the identifiers declared as variables are visited
+	move_decl(((ident_t *) node)->idu, m);
+	break;
+    case proc_decl_ast:
+	move_decl(((proc_decl_t *) node)->idu, m);
+	break;
+    case stmts_ast: {
+	stmts_t *stmts = (stmts_t *) node;
+	if (stmts->stmts_kind == stmt_list_e) {
+	    move_loc(&stmts->stmt_list.file_loc, m);
+	}
+	break;
+    }
+    case stmt_ast: {
+	stmt_t *s = (stmt_t *) node;
+	// each kind of statement starts with its location
+	move_loc((file_location *) &s->data, m);
+	break;
+    }
+    case condition_ast: {
+	condition_t *c = (condition_t *) node;
+	if (c->cond_kind == ck_db) {
+	    move_loc(&c->data.db_cond.file_loc, m);
+	} else {
+	    move_loc(&c->data.rel_op_cond.file_loc, m);
+	    move_loc(&c->data.rel_op_cond.rel_op.file_loc, m);
+	}
+	break;
+    }
+    case expr_ast: {
+	expr_t *e = (expr_t *) node;
+	// each kind of expression starts with its location
+	move_loc((file_location *) &e->data, m);
+	if (e->expr_kind == expr_bin) {
+	    move_loc(&e->data.binary.arith_op.file_loc, m);
+	}
+	break;
+    }
+    default:
+	break;
+    }
+    return true;
+}
+
+// Move the locations in node (of type t), and in the id_attrs of the
+// declarations in it, that are at or after from by delta bytes
+static void move_locations(void *node, AST_type t, file_location from,
+			   int delta)
+{
+    move_t m = { from, delta };
+    ast_visitor v = { move_pre, NULL, NULL, &m };
+    ast_walk(node, t, &v);
+}
+
+// Return the last of the statements in stmts that starts before loc,
+// or NULL if there is none
+static stmt_t *last_stmt_before(stmts_t *stmts, file_location loc)
+{
+    stmt_t *last = NULL;
+    if (stmts != NULL && stmts->stmts_kind == stmt_list_e) {
+	for (stmt_t *s = stmts->stmt_list.start;
+	     s != NULL && s->file_loc < loc; s = s->next) {
+	    last = s;
+	}
+    }
+    return last;
+}
+
+// Return where the AST points to the block that the statement s is,
+// or that is the last of those nested in it to start before loc,
+// or NULL if there is none
+static block_t **block_in_stmt(stmt_t *s, file_location loc)
+{
+    while (s != NULL) {
+	switch (s->stmt_kind) {
+	case block_stmt:
+	    return &s->data.block_stmt.block;
+	case if_stmt: {
+	    if_stmt_t *is = &s->data.if_stmt;
+	    stmt_t *in_else = last_stmt_before(is->else_stmts, loc);
+	    s = (in_else != NULL) ? in_else
+		: last_stmt_before(is->then_stmts, loc);
+	    break;
+	}
+	case while_stmt:
+	    s = last_stmt_before(s->data.while_stmt.body, loc);
+	    break;
+	default:
+	    s = NULL;
+	    break;
+	}
+    }
+    return NULL;
+}
+
+// Note in enclosing the blocks that have the tokens from first up to end
+// strictly inside them (between their "begin" and "end"), from the
+// outermost inward, and in enclosing_part the part of the program
+// (see scope_check_block_again) that the outermost of them is in
+static void find_enclosing(unsigned int first, unsigned int end)
+{
+    num_enclosing = 0;
+    file_location loc = lexer_tokens()->tokens[first].loc;
+    block_t *outer = &doc_program;
+    for (;;) {
+	// the last procedure or statement of outer to start before the edit
+	// (its statements come after its procedures)
+	block_t **inner = NULL;
+	proc_decl_t *proc = NULL;
+	unsigned int part = 0;
+	unsigned int i = 0;
+	for (proc_decl_t *pd = outer->proc_decls.proc_decls;
+	     pd != NULL && pd->file_loc < loc; pd = pd->next) {
+	    inner = &pd->block;
+	    proc = pd;
+	    part = i++;
+	}
+	stmt_t *s = last_stmt_before(&outer->stmts, loc);
+	if (s != NULL) {
+	    inner = block_in_stmt(s, loc);
+	    proc = NULL;
+	    part = doc_num_procs;
+	}
+	if (inner == NULL) {
+	    return;
+	}
+	unsigned int begin =
+	    token_at(file_location_offset((*inner)->file_loc));
+	unsigned int begin_end = lexer_matching_end(begin);
+	if (!(begin < first && end <= begin_end)) {
+	    return;
+	}
+	if (num_enclosing == enclosing_size) {
+	    enclosing_size = (enclosing_size == 0) ? 16 : 2 * enclosing_size;
+	    enclosing = (enclosing_t *)
+		realloc(enclosing, enclosing_size * sizeof(enclosing_t));
+	    if (enclosing == NULL) {
+		bail_with_error("No space for the blocks of %s!",
+				doc_filename);
+	    }
+	}
+	if (num_enclosing == 0) {
+	    enclosing_part = part;
+	}
+	enclosing[num_enclosing].block = inner;
+	enclosing[num_enclosing].proc = proc;
+	enclosing[num_enclosing].first = begin;
+	enclosing[num_enclosing].end = begin_end + 1;
+	num_enclosing++;
+	outer = *inner;
+    }
+}
+
+// Try to compile the edit that replaced the tokens from first up to end
+// (with delta more tokens), which were at or before the location from
+// (that has moved by move bytes), by parsing only the innermost of the
+// blocks it was in (as noted by find_enclosing) whose "begin" still ends
+// at its old "end"; return true if that worked
+static bool compile_partially(int delta, file_location from, int move)
+{
+    if (!doc_parsed || doc_lexical_errors > 0) {
+	// the lexical errors would have to be reported
+	return false;
+    }
+    unsigned int k = num_enclosing;
+    while (k > 0 && lexer_matching_end(enclosing[k - 1].first) + 1
+	   != enclosing[k - 1].end + delta) {
+	k--;
+    }
+    if (k == 0) {
+	return false;
+    }
+    enclosing_t *en = &enclosing[k - 1];
+    unsigned int end = en->end + delta;
+    // the errors will be reported when the whole program is parsed
+    lexer_set_quiet(true);
+    block_t *blk = parser_try_block(en->first, end);
+    lexer_set_quiet(false);
+    if (blk == NULL) {
+	return false;
+    }
+
+    // nothing after the edit has changed, except for where it is
+    move_locations(&doc_program, block_ast, from, move);
+    scope_parts_move_errors(doc_parts, from, move);
+    free(*en->block);
+    *en->block = blk;
+
+    // the blocks around it, and the procedure in each one whose body
+    // is on the way to it (if any)
+    scope_step_t *steps = (scope_step_t *)
+	malloc(k * sizeof(scope_step_t));
+    if (steps == NULL) {
+	bail_with_error("No space for the blocks of %s!", doc_filename);
+    }
+    for (unsigned int i = 0; i + 1 < k; i++) {
+	steps[i].block = *enclosing[i].block;
+	steps[i].through = enclosing[i + 1].proc;
+    }
+    doc_partial_end = lexer_tokens()->tokens[end - 1].loc;
+    scope_check_block_again(doc_parts, enclosing_part, steps, k - 1, blk,
+			    doc_partial_end);
+    free(steps);
+    doc_partial_block = blk;
+    doc_partial_proc = en->proc;
+    return true;
+}
+
+// Requires: start <= end <= incremental_length()
+// Replace the characters of the file's text from start up to (not
+// including) end by the len characters of text, and compile the result;
+// its lexical and syntax errors, if any, are reported
+void incremental_edit(size_t start, size_t end, const char *text, size_t len)
+{
+    if (start > end || end > doc_len) {
+	bail_with_error("Edit from %zu to %zu is not in %s!",
+			start, end, doc_filename);
+    }
+    // the lines the edit touches (tokens do not span lines)
+    size_t line_start = start;
+    while (line_start > 0 && doc_text[line_start - 1] != '\n') {
+	line_start--;
+    }
+    // (the line at end is untouched if end starts it and the edited text
+    // before end still ends a line)
+    size_t line_end = end;
+    char before = (len > 0) ? text[len - 1]
+	: (start > 0) ? doc_text[start - 1] : '\n';
+    if (!(before == '\n' && (end == 0 || doc_text[end - 1] == '\n'))) {
+	while (line_end < doc_len && doc_text[line_end] != '\n') {
+	    line_end++;
+	}
+	if (line_end < doc_len) {
+	    line_end++;
+	}
+    }
+    unsigned int first = token_at(line_start);
+    unsigned int old_end = token_at(line_end);
+    num_enclosing = 0;
+    if (doc_parsed) {
+	find_enclosing(first, old_end);
+    }
+
+    // edit the text
+    int move = (int) len - (int) (end - start);
+    reserve_text(doc_len + len);
+    memmove(doc_text + start + len, doc_text + end, doc_len - end);
+    if (len > 0) {
+	memcpy(doc_text + start, text, len);
+    }
+    doc_len += move;
+    if (!file_location_fits(doc_file_id, doc_len)) {
+	// the text has outgrown its range of locations,
+	// so it is read again (in a larger one)
+	file_location_restart(doc_file_id, doc_len);
+	lexer_tokenize_text(doc_filename, doc_file_id, doc_text, doc_len);
+	compile_tokens();
+	return;
+    }
+
+    // lex the lines again
+    token_array ta = { NULL, 0, 0 };
+    unsigned int *lines;
+    unsigned int num_lines;
+    parallel_lex_region(doc_text, line_start, line_end + move, doc_file_id,
+			&ta, &lines, &num_lines);
+    const token_array *tokens = lexer_tokens();
+    doc_lexical_errors -= count_lexical_errors(tokens->tokens, first,
+					       old_end);
+    doc_lexical_errors += count_lexical_errors(ta.tokens, 0, ta.count);
+    file_location from = file_location_make(doc_file_id,
+					    (unsigned int) line_end);
+    int delta = (int) ta.count - (int) (old_end - first);
+    lexer_splice_tokens(first, old_end, &ta, move);
+    file_location_replace_lines(doc_file_id, (unsigned int) line_start,
+				(unsigned int) line_end,
+				(unsigned int) (line_end + move),
+				lines, num_lines);
+    token_array_clear(&ta);
+    free(lines);
+
+    doc_partial = compile_partially(delta, from, move);
+    if (!doc_partial) {
+	compile_all();
+    }
+}
+
+// Read the file again, and if its text has changed, then compile the
+// change as one edit (of the text from the first character that changed
+// up to the last) and return true, otherwise return false
+bool incremental_reload()
+{
+    FILE *f = fopen(doc_filename, "rb");
+    if (f == NULL) {
+	bail_with_error("Cannot open %s", doc_filename);
+    }
+    size_t len = 0;
+    size_t n;
+    do {
+	if (len == reload_size) {
+	    reload_size = (reload_size == 0) ? 8192 : 2 * reload_size;
+	    reload_text = (char *) realloc(reload_text, reload_size);
+	    if (reload_text == NULL) {
+		bail_with_error("No space for the text of %s!", doc_filename);
+	    }
+	}
+	n = fread(reload_text + len, 1, reload_size - len, f);
+	len += n;
+    } while (n > 0);
+    fclose(f);
+    const char *text = reload_text;
+
+    size_t prefix = 0;
+    while (prefix < len && prefix < doc_len
+	   && text[prefix] == doc_text[prefix]) {
+	prefix++;
+    }
+    if (prefix == len && len == doc_len) {
+	return false;
+    }
+    size_t suffix = 0;
+    while (suffix < len - prefix && suffix < doc_len - prefix
+	   && text[len - 1 - suffix] == doc_text[doc_len - 1 - suffix]) {
+	suffix++;
+    }
+    incremental_edit(prefix, doc_len - suffix, text + prefix,
+		     len - prefix - suffix);
+    return true;
+}
+
+// Was the last edit (or the opening) compiled by parsing only
+// one of the blocks it was in?
+bool incremental_was_partial()
+{
+    return doc_partial;
+}
+
+// If the current text has no syntax errors, then set *prog to its AST
+// and return true, otherwise return false
+bool incremental_program(block_t *prog)
+{
+    if (doc_parsed) {
+	*prog = doc_program;
+    }
+    return doc_parsed;
+}
+
+// Print what the compiler prints for the current text after parsing it:
+// the unparsed program (if unparse is true) and the declaration errors,
+// if it has no syntax errors (otherwise nothing more is printed)
+void incremental_print(bool unparse)
+{
+    if (!doc_parsed) {
+	return;
+    }
+    if (unparse) {
+	unparseProgram(stdout, doc_program);
+    }
+    scope_parts_print_errors(doc_parts);
+    fflush(stdout);
+}
+
+// If the current text has no syntax errors, then call f for each of its
+// declaration errors (in the order incremental_print prints them)
+void incremental_for_each_error(scope_error_fn f, void *data)
+{
+    if (doc_parsed) {
+	scope_parts_for_each_error(doc_parts, f, data);
+    }
+}
+
+// Read the next edit from f into *start, *end, and the text in buf
+// (of size *size, which is made larger as needed), setting *len to the
+// length of the text; return false if there is none
+static bool read_edit(FILE *f, size_t *start, size_t *end,
+		      char **buf, size_t *size, size_t *len)
+{
+    if (fscanf(f, "%zu %zu", start, end) != 2) {
+	return false;
+    }
+    int c = getc(f);
+    *len = 0;
+    if (c == ' ') {
+	c = getc(f);
+    }
+    while (c != '\n' && c != EOF) {
+	if (c == '\\') {
+	    c = getc(f);
+	    c = (c == 'n') ? '\n' : c;
+	}
+	if (*len == *size) {
+	    *size = (*size == 0) ? 256 : 2 * *size;
+	    *buf = (char *) realloc(*buf, *size);
+	    if (*buf == NULL) {
+		bail_with_error("No space for an edit!");
+	    }
+	}
+	(*buf)[(*len)++] = (char) c;
+	c = getc(f);
+    }
+    return true;
+}
+
+// If the last edit was compiled by parsing only one block again,
+// return that block, otherwise return NULL
+const block_t *incremental_partial_block()
+{
+    return doc_partial ? doc_partial_block : NULL;
+}
+
+// Requires: incremental_partial_block() != NULL
+// Return the location of the "end" of the block that the last edit
+// was compiled by parsing again
+file_location incremental_partial_end()
+{
+    return doc_partial_end;
+}
+
+// If the last edit was compiled by parsing only the body of a procedure,
+// return the procedure's name, otherwise return NULL
+const char *incremental_partial_proc()
+{
+    return (doc_partial && doc_partial_proc != NULL)
+	? doc_partial_proc->name : NULL;
+}
+
+// Apply the edits in the file named script, printing (as incremental_print
+// does) after each one, preceded by a line "% after edit N" (and followed
+// by a line naming the procedure, or the line of the block statement,
+// if only its block was parsed again)
+void incremental_replay(const char *script, bool unparse)
+{
+    FILE *f = fopen(script, "r");
+    if (f == NULL) {
+	bail_with_error("Cannot open %s", script);
+    }
+    size_t start, end, len;
+    char *buf = NULL;
+    size_t size = 0;
+    unsigned int n = 0;
+    while (read_edit(f, &start, &end, &buf, &size, &len)) {
+	// errors are reported (on stderr) as the edit is compiled
+	printf("%% after edit %u\n", ++n);
+	fflush(stdout);
+	incremental_edit(start, end, buf, len);
+	incremental_print(unparse);
+	if (doc_partial && doc_partial_proc != NULL) {
+	    printf("%% only the body of %s was parsed again\n",
+		   doc_partial_proc->name);
+	} else if (doc_partial) {
+	    printf("%% only the block on line %u was parsed again\n",
+		   file_location_line(doc_partial_block->file_loc));
+	}
+	fflush(stdout);
+    }
+    free(buf);
+    fclose(f);
+}
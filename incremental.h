@@ -0,0 +1,106 @@
+#ifndef _INCREMENTAL_H
+#define _INCREMENTAL_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
+#include "scope_check.h"
+
+// Incremental compilation of one SPL file that is being edited.
+// The file's text, tokens, AST, and the results of scope checking it
+// are kept, and after an edit only the lines it touches are lexed again.
+// If the edit is inside the body of a procedure, or the block of a block
+// statement (and leaves the block's begin/end structure alone), only the
+// innermost such block is parsed and scope checked again (in the scopes
+// around it); otherwise the whole program is parsed and checked again,
+// from its tokens.
+// Either way, the results are those of compiling the edited text.
+// (As the lexer, parser, and symbol table each have only one state,
+// there can only be one such file at a time; opening another replaces it,
+// and opening it again, e.g., from its saved text, compiles it anew.)
+
+// Requires: filename is the name of a readable file
+// Start compiling the file named filename incrementally
+// (in place of the file that was being compiled, if any);
+// its lexical and syntax errors, if any, are reported
+extern void incremental_open(char *filename);
+
+// Start compiling the len characters of text incrementally, as the text
+// of the file named filename (which need not exist), as incremental_open
+// would (and in the requirements below, this counts as calling it);
+// its lexical and syntax errors, if any, are reported
+extern void incremental_open_text(char *filename, const char *text,
+				  size_t len);
+
+// Requires: incremental_open has been called
+// Return the name of the file being compiled
+extern const char *incremental_filename();
+
+// Requires: incremental_open has been called
+// Return the current text of the file (which has incremental_length bytes)
+extern const char *incremental_text();
+
+// Requires: incremental_open has been called
+// Return the length of the current text of the file
+extern size_t incremental_length();
+
+// Requires: incremental_open has been called,
+//           and start <= end <= incremental_length()
+// Replace the characters of the file's text from start up to (not
+// including) end by the len characters of text, and compile the result;
+// its lexical and syntax errors, if any, are reported
+extern void incremental_edit(size_t start, size_t end,
+			     const char *text, size_t len);
+
+// Requires: incremental_open has been called
+// Read the file again, and if its text has changed, then compile the
+// change as one edit (of the text from the first character that changed
+// up to the last) and return true, otherwise return false
+extern bool incremental_reload();
+
+// Requires: incremental_open has been called
+// Was the last edit (or the opening) compiled by parsing only
+// one of the blocks it was in?
+extern bool incremental_was_partial();
+
+// Requires: incremental_open has been called
+// If the last edit was compiled by parsing only one block again,
+// return that block, otherwise return NULL
+extern const block_t *incremental_partial_block();
+
+// Requires: incremental_partial_block() != NULL
+// Return the location of the "end" of the block that the last edit
+// was compiled by parsing again
+extern file_location incremental_partial_end();
+
+// Requires: incremental_open has been called
+// If the last edit was compiled by parsing only the body of a procedure,
+// return the procedure's name, otherwise return NULL
+extern const char *incremental_partial_proc();
+
+// Requires: incremental_open has been called
+// If the current text has no syntax errors, then set *prog to its AST
+// and return true, otherwise return false
+extern bool incremental_program(block_t *prog);
+
+// Requires: incremental_open has been called
+// Print what the compiler prints for the current text after parsing it:
+// the unparsed program (if unparse is true) and the declaration errors,
+// if it has no syntax errors (otherwise nothing more is printed)
+extern void incremental_print(bool unparse);
+
+// Requires: incremental_open has been called
+// If the current text has no syntax errors, then call f for each of its
+// declaration errors (in the order incremental_print prints them)
+extern void incremental_for_each_error(scope_error_fn f, void *data);
+
+// Requires: incremental_open has been called
+// Apply the edits in the file named script, printing (as incremental_print
+// does) after each one, preceded by a line "% after edit N" (and followed
+// by a line naming the procedure, or the line of the block statement,
+// if only its block was parsed again).
+// Each line of the script is an edit: the start and end offsets
+// and then (after a space) the new text, in which "\n" stands for
+// a newline and "\\" for a backslash.
+extern void incremental_replay(const char *script, bool unparse);
+
+#endif
@@ -0,0 +1,39 @@
+#include "instruction.h"
+
+// Return the instruction in the register format with the given fields
+word_type instruction_reg_form(func_code func, reg_num_type rs,
+			       reg_num_type rt, reg_num_type rd,
+			       shift_type shift)
+{
+    return (word_type) (((unsigned int) REG_O << OP_SHIFT)
+			| ((rs & 0x1Fu) << RS_SHIFT)
+			| ((rt & 0x1Fu) << RT_SHIFT)
+			| ((rd & 0x1Fu) << RD_SHIFT)
+			| ((shift & 0x1Fu) << SHIFT_SHIFT)
+			| (func & 0x3Fu));
+}
+
+// Return the system call instruction for code
+word_type instruction_syscall_form(syscall_code code)
+{
+    return (word_type) (((unsigned int) REG_O << OP_SHIFT)
+			| (((unsigned int) code & 0xFFFFFu) << CODE_SHIFT)
+			| SYSCALL_F);
+}
+
+// Return the instruction in the immediate format with the given fields
+word_type instruction_immed_form(op_code op, reg_num_type rs,
+				 reg_num_type rt, immediate_type immed)
+{
+    return (word_type) (((unsigned int) op << OP_SHIFT)
+			| ((rs & 0x1Fu) << RS_SHIFT)
+			| ((rt & 0x1Fu) << RT_SHIFT)
+			| (immed & 0xFFFFu));
+}
+
+// Return the instruction in the jump format with the given fields
+word_type instruction_jump_form(op_code op, address_type addr)
+{
+    return (word_type) (((unsigned int) op << OP_SHIFT)
+			| (addr & 0x3FFFFFFu));
+}
@@ -0,0 +1,107 @@
+#ifndef _INSTRUCTION_H
+#define _INSTRUCTION_H
+#include "machine_types.h"
+
+// The instructions of the Simplified RISC Machine (SRM)
+// and their binary forms (each instruction is one word).
+//
+// The SRM has 32 general purpose registers (GPR[0] is always 0),
+// the registers HI and LO (for the results of MUL and DIV), and the PC.
+// Memory is addressed in bytes, and words are aligned on multiples of
+// BYTES_PER_WORD. Each instruction is fetched from the word at PC,
+// then PC is advanced past it, and then the instruction is executed.
+//
+// The formats (with the number of bits in each field, high bits first):
+//   register:     op (6) = 0   rs (5)  rt (5)  rd (5)  shift (5)  func (6)
+//   system call:  op (6) = 0   code (20)                  func (6) = SYSCALL
+//   immediate:    op (6)       rs (5)  rt (5)  immed (16)
+//   jump:         op (6)       addr (26)
+//
+// The instructions, with s, t and d their rs, rt and rd registers,
+// h their shift, i and o their immed, and a their addr:
+//   ADD d,s,t    GPR[d] = GPR[s] + GPR[t]   (all arithmetic wraps around)
+//   SUB d,s,t    GPR[d] = GPR[s] - GPR[t]
+//   AND, BOR, NOR, XOR d,s,t    GPR[d] = the bitwise and, or, ...
+//   MUL s,t      (HI, LO) = the 64 bit product of GPR[s] and GPR[t]
+//   DIV s,t      HI = GPR[s] % GPR[t], LO = GPR[s] / GPR[t]
+//                (truncated toward 0; the most negative word divided by -1
+//                is itself; dividing by 0 is a machine error)
+//   MFHI d, MFLO d   GPR[d] = HI, GPR[d] = LO
+//   SLL d,t,h    GPR[d] = GPR[t] << h  (SRL shifts right, filling with 0s)
+//   JR s         PC = GPR[s]
+//   SYSCALL code (see syscall_code)
+//   ADDI t,s,i   GPR[t] = GPR[s] + machine_types_sgnExt(i)
+//   ANDI, BORI, XORI t,s,i   GPR[t] = GPR[s] and, or, xor
+//                             machine_types_zeroExt(i)
+//   BEQ s,t,o    if GPR[s] == GPR[t], PC = PC + machine_types_formOffset(o)
+//   BNE s,t,o    likewise if GPR[s] != GPR[t]
+//   BGEZ, BGTZ, BLEZ, BLTZ s,o   likewise if GPR[s] >= 0, > 0, <= 0, < 0
+//   LW t,o(s)    GPR[t] = the word at GPR[s] + machine_types_formOffset(o)
+//   SW t,o(s)    the word at GPR[s] + machine_types_formOffset(o) = GPR[t]
+//   LBU t,o(s)   GPR[t] = the byte at GPR[s] + machine_types_sgnExt(o)
+//   SB t,o(s)    the byte at GPR[s] + machine_types_sgnExt(o) = GPR[t]'s
+//                low byte
+//   JMP a        PC = machine_types_formAddress(PC, a)
+//   JAL a        GPR[RA] = PC, then PC = machine_types_formAddress(PC, a)
+
+// The number of registers
+#define NUM_REGISTERS 32
+
+// The positions of the fields (of their lowest bits) in an instruction
+#define OP_SHIFT 26
+#define RS_SHIFT 21
+#define RT_SHIFT 16
+#define RD_SHIFT 11
+#define SHIFT_SHIFT 6
+#define CODE_SHIFT 6
+
+// The registers with uses given by convention
+typedef enum {
+    ZERO = 0, AT = 1, V0 = 2, A0 = 4, T0 = 8, T1 = 9, T2 = 10, S0 = 16,
+    GP = 28, SP = 29, FP = 30, RA = 31
+} reg_name;
+
+// The opcodes
+typedef enum {
+    REG_O = 0, BGEZ_O = 1, JMP_O = 2, JAL_O = 3, BEQ_O = 4, BNE_O = 5,
+    BLEZ_O = 6, BGTZ_O = 7, BLTZ_O = 8, ADDI_O = 9, ANDI_O = 12,
+    BORI_O = 13, XORI_O = 14, LW_O = 35, LBU_O = 36, SB_O = 40, SW_O = 43
+} op_code;
+
+// The functions of the instructions in the register format (op REG_O)
+typedef enum {
+    SLL_F = 0, SRL_F = 3, JR_F = 8, SYSCALL_F = 12, MFHI_F = 16,
+    MFLO_F = 18, MUL_F = 25, DIV_F = 27, ADD_F = 33, SUB_F = 35,
+    AND_F = 36, BOR_F = 37, XOR_F = 38, NOR_F = 39
+} func_code;
+
+// The system calls
+typedef enum {
+    print_int_sc = 1,   // print GPR[A0] in decimal on stdout
+    print_str_sc = 4,   // print the string (ended by a 0 byte)
+                        // at address GPR[A0] on stdout
+    exit_sc = 10,       // stop, with exit code GPR[A0]
+    print_char_sc = 11, // print GPR[A0] as a character on stdout
+    read_char_sc = 12,  // GPR[V0] = a character read from stdin
+                        // (-1 at the end of the input)
+    fail_sc = 13        // print the string at address GPR[A0] and a newline
+                        // on stderr (after what was printed on stdout)
+                        // and stop, with a failure exit code
+} syscall_code;
+
+// Return the instruction in the register format with the given fields
+extern word_type instruction_reg_form(func_code func, reg_num_type rs,
+				      reg_num_type rt, reg_num_type rd,
+				      shift_type shift);
+
+// Return the system call instruction for code
+extern word_type instruction_syscall_form(syscall_code code);
+
+// Return the instruction in the immediate format with the given fields
+extern word_type instruction_immed_form(op_code op, reg_num_type rs,
+					reg_num_type rt, immediate_type immed);
+
+// Return the instruction in the jump format with the given fields
+extern word_type instruction_jump_form(op_code op, address_type addr);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "intern.h"
+#include "utilities.h"
+
+// Size of each block that texts are copied into
+// (longer texts get a block of their own)
+#define TEXT_BLOCK_SIZE 65536
+
+// The texts, by id
+static const char **texts = NULL;
+static unsigned int num_texts = 0;
+static unsigned int texts_capacity = 0;
+
+// Open addressing hash table of ids (+ 1, so that 0 means empty);
+// its size is a power of 2 that is kept over twice num_texts
+static unsigned int *table = NULL;
+static size_t table_size = 0;
+
+// The block that new texts are copied into
+static char *block = NULL;
+static size_t block_left = 0;
+
+// Return the FNV-1a hash of the len characters at text
+static uint32_t hash(const char *text, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+	h = (h ^ (unsigned char) text[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Return a null-terminated copy of the len characters at text,
+// which is never freed
+static const char *save_text(const char *text, size_t len)
+{
+    if (len + 1 > block_left) {
+	size_t size = (len + 1 > TEXT_BLOCK_SIZE) ? len + 1 : TEXT_BLOCK_SIZE;
+	block = (char *) malloc(size);
+	if (block == NULL) {
+	    bail_with_error("No space to intern text!");
+	}
+	block_left = size;
+    }
+    char *ret = block;
+    memcpy(ret, text, len);
+    ret[len] = '\0';
+    block += len + 1;
+    block_left -= len + 1;
+    return ret;
+}
+
+// Make the hash table twice as big (or give it its initial size)
+static void grow_table(void)
+{
+    size_t new_size = (table_size == 0) ? 1024 : 2 * table_size;
+    unsigned int *new_table = (unsigned int *)
+	calloc(new_size, sizeof(unsigned int));
+    if (new_table == NULL) {
+	bail_with_error("No space for the table of interned texts!");
+    }
+    for (unsigned int id = 0; id < num_texts; id++) {
+	size_t i = hash(texts[id], strlen(texts[id])) & (new_size - 1);
+	while (new_table[i] != 0) {
+	    i = (i + 1) & (new_size - 1);
+	}
+	new_table[i] = id + 1;
+    }
+    free(table);
+    table = new_table;
+    table_size = new_size;
+}
+
+// Return the id of the text made of the len characters starting at text
+// (which need not be null-terminated), storing a copy of it if it is new
+unsigned int intern(const char *text, size_t len)
+{
+    if (2 * (num_texts + 1) > table_size) {
+	grow_table();
+    }
+    size_t i = hash(text, len) & (table_size - 1);
+    while (table[i] != 0) {
+	const char *t = texts[table[i] - 1];
+	if (strncmp(t, text, len) == 0 && t[len] == '\0') {
+	    return table[i] - 1;
+	}
+	i = (i + 1) & (table_size - 1);
+    }
+    if (num_texts == texts_capacity) {
+	texts_capacity = (texts_capacity == 0) ? 1024 : 2 * texts_capacity;
+	texts = (const char **)
+	    realloc(texts, texts_capacity * sizeof(const char *));
+	if (texts == NULL) {
+	    bail_with_error("No space for the interned texts!");
+	}
+    }
+    texts[num_texts] = save_text(text, len);
+    table[i] = num_texts + 1;
+    return num_texts++;
+}
+
+// Requires: id was returned by intern
+// Return the (null-terminated) text with the given id,
+// which lasts until the program exits
+const char *intern_text(unsigned int id)
+{
+    return texts[id];
+}
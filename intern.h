@@ -0,0 +1,17 @@
+#ifndef _INTERN_H
+#define _INTERN_H
+#include <stddef.h>
+
+// Interned strings: each distinct text is stored once, and is named
+// by a small id (numbered from 0 in the order the texts were first seen).
+
+// Return the id of the text made of the len characters starting at text
+// (which need not be null-terminated), storing a copy of it if it is new
+extern unsigned int intern(const char *text, size_t len);
+
+// Requires: id was returned by intern
+// Return the (null-terminated) text with the given id,
+// which lasts until the program exits
+extern const char *intern_text(unsigned int id);
+
+#endif
@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "interpreter.h"
+#include "ast_walk.h"
+#include "parser.h"
+#include "ptr_map.h"
+#include "utilities.h"
+#include "spl.tab.h"
+
+// The most words that the run-time stack may hold,
+// and the most statements (calls, blocks, loops, and the statements
+// waiting for an if's branch to finish) that may be active at once
+#define MAX_STACK_WORDS (1u << 24)
+#define MAX_CONTROL (1u << 22)
+
+// Expressions are evaluated by recursing on their depth up to this many
+// levels; deeper subexpressions are evaluated with an explicit stack
+#define MAX_EVAL_DEPTH 256
+
+// What is bound to a block before running: the size of its activation
+// records, which hold the static link and then one word for each
+// constant and variable declared in the block (at its offset_count)
+typedef struct {
+    block_t *block;
+    unsigned int size;  // the number of its constants and variables
+} frame_info;
+
+// The bindings, which map each block, and the id_attrs of each
+// procedure's declaration, to its block's frame_info
+static ptr_map bindings;
+
+// The run-time stack: the activation record in use starts at fp
+// (with its static link, the start of the record it is nested in),
+// and the next one goes at sp
+static word_type *stack = NULL;
+static size_t stack_size = 0;
+static size_t sp = 0;
+static size_t fp = 0;
+
+// What to do when the statements being run run out
+typedef enum {
+    ctl_continue, // go on with stmt
+    ctl_loop,     // check stmt's (a while statement's) condition again
+    ctl_return    // leave the activation record, then go on with stmt
+} ctl_kind;
+
+// An entry in the control stack
+typedef struct {
+    ctl_kind kind;
+    stmt_t *stmt;
+    size_t fp;    // for ctl_return, the activation record to go back to
+} ctl_entry;
+
+static ctl_entry *control = NULL;
+static size_t control_size = 0;
+static size_t control_top = 0;
+
+// The work and value stacks of eval_deep
+typedef struct {
+    expr_t *expr;
+    bool apply;   // are expr's operands on the value stack?
+} eval_item;
+
+static eval_item *eval_work = NULL;
+static size_t eval_work_size = 0;
+static word_type *eval_values = NULL;
+static size_t eval_values_size = 0;
+
+// Make the array *items (of *size elements of elem_size bytes) hold
+// at least need elements, but not more than max (reporting a run-time
+// error at loc if it would have to); what says what the array is for
+static void grow(void **items, size_t *size, size_t elem_size, size_t need,
+		 size_t max, file_location loc, const char *what)
+{
+    if (need <= *size) {
+	return;
+    }
+    if (need > max) {
+	errno = 0;
+	bail_with_prog_error(loc, "the %s is full (too many nested calls)!",
+			     what);
+    }
+    size_t new_size = (*size == 0) ? 1024 : 2 * *size;
+    while (new_size < need) {
+	new_size *= 2;
+    }
+    if (new_size > max) {
+	new_size = max;
+    }
+    *items = realloc(*items, new_size * elem_size);
+    if (*items == NULL) {
+	bail_with_error("No space for the %s!", what);
+    }
+    *size = new_size;
+}
+
+// Return the frame_info of block, binding it first if it is not bound
+static frame_info *block_frame(block_t *block)
+{
+    frame_info *info = (frame_info *) ptr_map_get(&bindings, block);
+    if (info != NULL) {
+	return info;
+    }
+    info = (frame_info *) malloc(sizeof(frame_info));
+    if (info == NULL) {
+	bail_with_error("No space to bind the program's blocks!");
+    }
+    info->block = block;
+    info->size = block->frame_size;
+    ptr_map_put(&bindings, block, info);
+    return info;
+}
+
+// The walk's pre callback for binding: bind each block, and each
+// procedure's declaration (to its block); only statements hold blocks
+static bool bind_pre(void *node, AST_type t, void *data)
+{
+    switch (t) {
+    case block_ast:
+	block_frame((block_t *) node);
+	return true;
+    case proc_decl_ast: {
+	proc_decl_t *pd = (proc_decl_t *) node;
+	ptr_map_put(&bindings, pd->idu->attrs,
+		    block_frame(parser_proc_body(pd)));
+	return true;
+    }
+    case const_decls_ast: case var_decls_ast:
+    case condition_ast: case expr_ast:
+	return false;
+    default:
+	return true;
+    }
+}
+
+// Return the start of the activation record levels static links out
+// from the one in use
+static inline size_t frame_out(unsigned int levels)
+{
+    size_t f = fp;
+    for (; levels > 0; levels--) {
+	f = (size_t) stack[f];
+    }
+    return f;
+}
+
+// Return the address of the slot for the constant or variable of idu
+static inline word_type *slot(const id_use *idu)
+{
+    return &stack[frame_out(idu->levelsOutward) + 1
+		  + idu->attrs->offset_count];
+}
+
+// Return -v (wrapping around)
+static inline word_type negate(word_type v)
+{
+    return (word_type) (0u - (unsigned int) v);
+}
+
+// Return the result of applying the arithmetic operator op to a and b
+static inline word_type arith(const token_t *op, word_type a, word_type b)
+{
+    switch (op->code) {
+    case plussym:
+	return (word_type) ((unsigned int) a + (unsigned int) b);
+    case minussym:
+	return (word_type) ((unsigned int) a - (unsigned int) b);
+    case multsym:
+	return (word_type) ((unsigned int) a * (unsigned int) b);
+    default:
+	if (b == 0) {
+	    errno = 0;
+	    bail_with_prog_error(op->file_loc, "division by zero!");
+	}
+	// (the most negative word divided by -1 wraps around to itself)
+	return (b == -1) ? negate(a) : a / b;
+    }
+}
+
+// Return the value of e, evaluated with explicit stacks
+static word_type eval_deep(expr_t *e)
+{
+    size_t work_top = 0, values_top = 0;
+    grow((void **) &eval_work, &eval_work_size, sizeof(eval_item), 1,
+	 SIZE_MAX, e->file_loc, "expression stack");
+    eval_work[work_top++] = (eval_item) { e, false };
+    while (work_top > 0) {
+	eval_item it = eval_work[--work_top];
+	expr_t *x = it.expr;
+	if (it.apply) {
+	    word_type *v = &eval_values[values_top - 1];
+	    if (x->expr_kind == expr_negated) {
+		*v = negate(*v);
+	    } else {
+		values_top--;
+		v[-1] = arith(&x->data.binary.arith_op, v[-1], v[0]);
+	    }
+	    continue;
+	}
+	switch (x->expr_kind) {
+	case expr_number: case expr_ident:
+	    grow((void **) &eval_values, &eval_values_size, sizeof(word_type),
+		 values_top + 1, SIZE_MAX, x->file_loc, "expression stack");
+	    eval_values[values_top++] = (x->expr_kind == expr_number)
+		? x->data.number.value : *slot(x->data.ident.idu);
+	    break;
+	case expr_negated:
+	    grow((void **) &eval_work, &eval_work_size, sizeof(eval_item),
+		 work_top + 2, SIZE_MAX, x->file_loc, "expression stack");
+	    eval_work[work_top++] = (eval_item) { x, true };
+	    eval_work[work_top++] = (eval_item) { x->data.negated.expr, false };
+	    break;
+	case expr_bin:
+	    grow((void **) &eval_work, &eval_work_size, sizeof(eval_item),
+		 work_top + 3, SIZE_MAX, x->file_loc, "expression stack");
+	    eval_work[work_top++] = (eval_item) { x, true };
+	    eval_work[work_top++] = (eval_item) { x->data.binary.expr2, false };
+	    eval_work[work_top++] = (eval_item) { x->data.binary.expr1, false };
+	    break;
+	}
+    }
+    return eval_values[0];
+}
+
+static word_type eval(expr_t *e, unsigned int depth);
+
+// Return the value of e, which is depth levels inside the expression
+// being evaluated (without a call, if e is a name or a number)
+static inline word_type operand(expr_t *e, unsigned int depth)
+{
+    switch (e->expr_kind) {
+    case expr_number:
+	return e->data.number.value;
+    case expr_ident:
+	return *slot(e->data.ident.idu);
+    default:
+	return eval(e, depth);
+    }
+}
+
+// Requires: e is a binary or negated expression
+// Return the value of e, which is depth levels inside the expression
+// being evaluated
+static word_type eval(expr_t *e, unsigned int depth)
+{
+    if (depth >= MAX_EVAL_DEPTH) {
+	return eval_deep(e);
+    }
+    if (e->expr_kind == expr_negated) {
+	return negate(operand(e->data.negated.expr, depth + 1));
+    }
+    word_type a = operand(e->data.binary.expr1, depth + 1);
+    word_type b = operand(e->data.binary.expr2, depth + 1);
+    return arith(&e->data.binary.arith_op, a, b);
+}
+
+// Does the condition c hold?
+static bool holds(condition_t *c)
+{
+    if (c->cond_kind == ck_db) {
+	db_condition_t *db = &c->data.db_cond;
+	word_type dividend = operand(&db->dividend, 0);
+	word_type divisor = operand(&db->divisor, 0);
+	if (divisor == 0) {
+	    errno = 0;
+	    bail_with_prog_error(db->divisor.file_loc, "division by zero!");
+	}
+	return divisor == -1 || dividend % divisor == 0;
+    }
+    rel_op_condition_t *rel = &c->data.rel_op_cond;
+    word_type a = operand(&rel->expr1, 0);
+    word_type b = operand(&rel->expr2, 0);
+    switch (rel->rel_op.code) {
+    case eqsym:
+	return a == b;
+    case neqsym:
+	return a != b;
+    case ltsym:
+	return a < b;
+    case leqsym:
+	return a <= b;
+    case gtsym:
+	return a > b;
+    default:
+	return a >= b;
+    }
+}
+
+// Return the first of the statements in s (NULL if there are none)
+static inline stmt_t *first_stmt(stmts_t *s)
+{
+    return (s->stmts_kind == empty_stmts_e) ? NULL : s->stmt_list.start;
+}
+
+// Push an entry on the control stack (loc is where the statement is
+// that needs it)
+static inline void push_control(ctl_kind kind, stmt_t *stmt,
+				file_location loc)
+{
+    if (control_top == control_size) {
+	grow((void **) &control, &control_size, sizeof(ctl_entry),
+	     control_top + 1, MAX_CONTROL, loc, "control stack");
+    }
+    control[control_top++] = (ctl_entry) { kind, stmt, fp };
+}
+
+// Start an activation record for info's block, with the given static
+// link, and make it the one in use (loc is where the block is entered)
+static void enter_frame(frame_info *info, size_t static_link,
+			file_location loc)
+{
+    size_t need = sp + 1 + info->size;
+    grow((void **) &stack, &stack_size, sizeof(word_type), need,
+	 MAX_STACK_WORDS, loc, "run-time stack");
+    stack[sp] = (word_type) static_link;
+    memset(&stack[sp + 1], 0, info->size * sizeof(word_type));
+    for (const_decl_t *cd = info->block->const_decls.start; cd != NULL;
+	 cd = cd->next) {
+	for (const_def_t *def = cd->const_def_list.start; def != NULL;
+	     def = def->next) {
+	    stack[sp + 1 + def->ident.idu->attrs->offset_count]
+		= def->number.value;
+	}
+    }
+    fp = sp;
+    sp = need;
+}
+
+// Requires: prog has been scope checked without errors
+// Run prog, reporting a run-time error (on stderr, with its location)
+// and exiting with a failure code if one happens
+void interpreter_run(block_t *prog)
+{
+    ast_visitor v = { bind_pre, NULL, NULL, NULL };
+    ast_walk(prog, block_ast, &v);
+
+    sp = 0;
+    control_top = 0;
+    enter_frame((frame_info *) ptr_map_get(&bindings, prog), 0,
+		prog->file_loc);
+    stmt_t *stmt = first_stmt(&prog->stmts);
+    for (;;) {
+	// when the statements run out, go on with what the control says
+	while (stmt == NULL) {
+	    if (control_top == 0) {
+		fflush(stdout);
+		return;
+	    }
+	    ctl_entry *c = &control[control_top - 1];
+	    switch (c->kind) {
+	    case ctl_continue:
+		stmt = c->stmt;
+		control_top--;
+		break;
+	    case ctl_loop:
+		if (holds(&c->stmt->data.while_stmt.condition)) {
+		    stmt = first_stmt(c->stmt->data.while_stmt.body);
+		} else {
+		    stmt = c->stmt->next;
+		    control_top--;
+		}
+		break;
+	    case ctl_return:
+		sp = fp;
+		fp = c->fp;
+		stmt = c->stmt;
+		control_top--;
+		break;
+	    }
+	}
+
+	switch (stmt->stmt_kind) {
+	case assign_stmt: {
+	    assign_stmt_t *as = &stmt->data.assign_stmt;
+	    if (as->idu->attrs->kind != variable_idk) {
+		errno = 0;
+		bail_with_prog_error(stmt->file_loc,
+				     "cannot assign to constant \"%s\"!",
+				     as->name);
+	    }
+	    word_type val = operand(as->expr, 0);
+	    *slot(as->idu) = val;
+	    stmt = stmt->next;
+	    break;
+	}
+	case call_stmt: {
+	    call_stmt_t *cs = &stmt->data.call_stmt;
+	    size_t link = frame_out(cs->idu->levelsOutward);
+	    frame_info *info
+		= (frame_info *) ptr_map_get(&bindings, cs->idu->attrs);
+	    push_control(ctl_return, stmt->next, stmt->file_loc);
+	    enter_frame(info, link, stmt->file_loc);
+	    stmt = first_stmt(&info->block->stmts);
+	    break;
+	}
+	case block_stmt: {
+	    frame_info *info = (frame_info *)
+		ptr_map_get(&bindings, stmt->data.block_stmt.block);
+	    push_control(ctl_return, stmt->next, stmt->file_loc);
+	    enter_frame(info, fp, stmt->file_loc);
+	    stmt = first_stmt(&info->block->stmts);
+	    break;
+	}
+	case if_stmt: {
+	    if_stmt_t *is = &stmt->data.if_stmt;
+	    stmts_t *branch = holds(&is->condition)
+		? is->then_stmts : is->else_stmts;
+	    stmt_t *first = (branch == NULL) ? NULL : first_stmt(branch);
+	    if (first == NULL) {
+		stmt = stmt->next;
+	    } else {
+		// (the control stack only grows if there is more to do)
+		if (stmt->next != NULL) {
+		    push_control(ctl_continue, stmt->next, stmt->file_loc);
+		}
+		stmt = first;
+	    }
+	    break;
+	}
+	case while_stmt: {
+	    while_stmt_t *ws = &stmt->data.while_stmt;
+	    if (holds(&ws->condition)) {
+		push_control(ctl_loop, stmt, stmt->file_loc);
+		stmt = first_stmt(ws->body);
+	    } else {
+		stmt = stmt->next;
+	    }
+	    break;
+	}
+	case read_stmt: {
+	    int ch = getchar();
+	    *slot(stmt->data.read_stmt.idu) = (ch == EOF) ? -1 : ch;
+	    stmt = stmt->next;
+	    break;
+	}
+	case print_stmt:
+	    printf("%d\n", operand(&stmt->data.print_stmt.expr, 0));
+	    stmt = stmt->next;
+	    break;
+	}
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef _INTERPRETER_H
+#define _INTERPRETER_H
+#include "ast.h"
+
+// Running a scope checked SPL program by walking its AST.
+//
+// Before running, each block of the program is bound to the size of its
+// activation record (one word for each of its constants and variables),
+// so that each name used is found through its id_use: the number of
+// static links to follow (levelsOutward) and the slot in that activation
+// record (its declaration's offset_count), without looking up any names.
+//
+// Values are word_type, and + - * / wrap around as in two's complement;
+// division truncates toward zero, and dividing by zero is a run-time error
+// (as is "divisible ... by 0"). The statement "read x" reads a character
+// from stdin into x (-1 at the end of the input), and "print e" prints
+// the value of e (in decimal, followed by a newline) on stdout.
+// Neither the statements nor the expressions are run by recursing on
+// the depth of the AST, so deeply nested programs (and deep recursion
+// in the program) do not overflow the C stack.
+
+// Requires: prog has been scope checked without errors
+// Run prog, reporting a run-time error (on stderr, with its location)
+// and exiting with a failure code if one happens
+extern void interpreter_run(block_t *prog);
+
+#endif
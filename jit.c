@@ -0,0 +1,686 @@
+// (for MAP_ANONYMOUS and MAP_NORESERVE)
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "jit.h"
+#include "utilities.h"
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(JIT_DISABLED)
+#define JIT_X86_64
+#endif
+
+#ifndef JIT_X86_64
+
+// Return true if programs can be run by jit_run
+bool jit_available(void)
+{
+    return false;
+}
+
+// Requires: bc was returned by bytecode_compile
+// Run bc as machine code, reporting a run-time error (on stderr, with its
+// location) and exiting with a failure code if one happens;
+// return false (without running any of bc) if the JIT is not available
+// or there is no space for bc's machine code
+bool jit_run(const bytecode *bc)
+{
+    return false;
+}
+
+#else
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+// The machine code uses the registers:
+//   eax  the value on top of the expression stack (if it isn't empty)
+//   rbx  the start of the stack of activation records
+//   rbp  the end of the stack of activation records
+//   r12  the start of the record in use
+//   r13  where the next value pushed below eax goes
+//        (the rest of the expression stack is just below it)
+//   r14  where the next record goes
+//   r15  the start of the machine code
+// Records have the vm's layout; their static and dynamic links are the
+// offsets (in bytes) of records from rbx, and their return addresses
+// are offsets in the machine code.
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+#define NO_INDEX (-1)
+
+// The condition codes (in the low nibble of the jcc opcodes)
+#define CC_A 0x7
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G 0xF
+
+// The layout of activation records (the same as the vm's)
+#define HEADER_WORDS 3
+#define STATIC_LINK 0
+#define DYNAMIC_LINK 1
+#define RETURN_ADDRESS 2
+#define MAX_STACK_WORDS (1u << 24)
+
+// Records with at most this many slots have them zeroed one at a time
+#define MAX_UNROLLED_ZEROING 8
+
+// A jump (or call) whose 32-bit displacement (at pos in the code)
+// goes to the code for the bytecode instruction at target
+typedef struct {
+    size_t pos;
+    unsigned int target;
+} fixup;
+
+// The state of the JIT (which translates one program)
+typedef struct {
+    const bytecode *bc;
+    unsigned char *code;
+    size_t length;
+    size_t size;
+    size_t *addrs;              // where the code for each bytecode pc is
+    fixup *fixups;
+    size_t num_fixups;
+    size_t fixups_size;
+} jit;
+
+// The bytecode being run (for reporting run-time errors)
+static const bytecode *running;
+
+// Report the run-time error of the bytecode instruction at pc
+// in the program being run, and exit
+static void jit_error(unsigned int pc)
+{
+    const bytecode_loc *l = bytecode_location(running, pc);
+    fflush(stdout);
+    errno = 0;
+    switch ((bytecode_op) running->code[pc]) {
+    case op_div: case op_jump_unless_divisible:
+	bail_with_prog_error(l->loc, "division by zero!");
+	break;
+    case op_assign_constant:
+	bail_with_prog_error(l->loc, "cannot assign to constant \"%s\"!",
+			     l->name);
+	break;
+    default:
+	bail_with_prog_error(l->loc, "the run-time stack is full"
+			     " (too many nested calls)!");
+	break;
+    }
+}
+
+// Print v (and a newline)
+static void jit_print(word_type v)
+{
+    printf("%d\n", v);
+}
+
+// Return the character read, or -1 at the end of the input
+static word_type jit_read(void)
+{
+    int ch = getchar();
+    return (ch == EOF) ? -1 : ch;
+}
+
+// Append the byte b
+static void emit_byte(jit *j, unsigned int b)
+{
+    if (j->length == j->size) {
+	j->size = (j->size == 0) ? 4096 : 2 * j->size;
+	j->code = (unsigned char *) realloc(j->code, j->size);
+	if (j->code == NULL) {
+	    bail_with_error("No space to compile the program's code!");
+	}
+    }
+    j->code[j->length++] = (unsigned char) b;
+}
+
+// Append the n bytes of s
+static void emit_bytes(jit *j, const char *s, int n)
+{
+    for (int i = 0; i < n; i++) {
+	emit_byte(j, (unsigned char) s[i]);
+    }
+}
+
+// Append v as 4 (little-endian) bytes
+static void emit32(jit *j, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+	emit_byte(j, (v >> (8 * i)) & 0xFF);
+    }
+}
+
+// Put v as 4 bytes at pos in the code
+static void patch32(jit *j, size_t pos, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+	j->code[pos + i] = (unsigned char) ((v >> (8 * i)) & 0xFF);
+    }
+}
+
+// Append the REX prefix needed (if any) for the operand size (wide for
+// 64 bits) and the registers in the ModRM reg, SIB index and rm fields
+static void emit_rex(jit *j, bool wide, int reg, int index, int rm)
+{
+    unsigned int rex = (wide ? 8 : 0) | ((reg & 8) ? 4 : 0)
+	| ((index != NO_INDEX && (index & 8)) ? 2 : 0) | ((rm & 8) ? 1 : 0);
+    if (rex != 0) {
+	emit_byte(j, 0x40 | rex);
+    }
+}
+
+// Append the instruction with the n opcode bytes op, whose operands are
+// reg (a register, or an opcode extension) and [base + index + disp]
+static void emit_mem(jit *j, bool wide, const char *op, int n, int reg,
+		     int base, int index, int32_t disp)
+{
+    emit_rex(j, wide, reg, index, base);
+    emit_bytes(j, op, n);
+    // (with mod 0, a base of rbp or r13 would mean no base at all)
+    unsigned int mod = (disp == 0 && (base & 7) != RBP) ? 0
+	: (disp >= -128 && disp <= 127) ? 1 : 2;
+    if (index == NO_INDEX && (base & 7) != RSP) {
+	emit_byte(j, (mod << 6) | ((reg & 7) << 3) | (base & 7));
+    } else {
+	// (a SIB byte, also needed for a base of rsp or r12)
+	emit_byte(j, (mod << 6) | ((reg & 7) << 3) | RSP);
+	emit_byte(j, (((index == NO_INDEX) ? RSP : index & 7) << 3)
+		  | (base & 7));
+    }
+    if (mod == 1) {
+	emit_byte(j, (unsigned int) disp & 0xFF);
+    } else if (mod == 2) {
+	emit32(j, (uint32_t) disp);
+    }
+}
+
+// Append the instruction with the n opcode bytes op, whose operands are
+// the registers (or opcode extension) reg and rm
+static void emit_rr(jit *j, bool wide, const char *op, int n, int reg,
+		    int rm)
+{
+    emit_rex(j, wide, reg, NO_INDEX, rm);
+    emit_bytes(j, op, n);
+    emit_byte(j, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// Append a jcc (or, if cc < 0, a jmp) with a 32-bit displacement
+// to the code for the bytecode instruction at target
+static void emit_jump(jit *j, int cc, unsigned int target)
+{
+    if (cc < 0) {
+	emit_byte(j, 0xE9);
+    } else {
+	emit_byte(j, 0x0F);
+	emit_byte(j, 0x80 | cc);
+    }
+    if (j->num_fixups == j->fixups_size) {
+	j->fixups_size = (j->fixups_size == 0) ? 256 : 2 * j->fixups_size;
+	j->fixups = (fixup *) realloc(j->fixups,
+				      j->fixups_size * sizeof(fixup));
+	if (j->fixups == NULL) {
+	    bail_with_error("No space to compile the program's code!");
+	}
+    }
+    j->fixups[j->num_fixups].pos = j->length;
+    j->fixups[j->num_fixups].target = target;
+    j->num_fixups++;
+    emit32(j, 0);
+}
+
+// Append a jcc with an 8-bit displacement, to be set by land,
+// returning where the displacement is
+static size_t emit_short_jump(jit *j, int cc)
+{
+    emit_byte(j, 0x70 | cc);
+    emit_byte(j, 0);
+    return j->length - 1;
+}
+
+// Make the short jump whose displacement is at pos go to here
+static void land(jit *j, size_t pos)
+{
+    j->code[pos] = (unsigned char) (j->length - (pos + 1));
+}
+
+// Append a call of the function f
+static void emit_call(jit *j, const void *f)
+{
+    emit_byte(j, 0x48);                         // mov rax, f
+    emit_byte(j, 0xB8);
+    uint64_t a = (uint64_t) (uintptr_t) f;
+    emit32(j, (uint32_t) a);
+    emit32(j, (uint32_t) (a >> 32));
+    emit_rr(j, false, "\xFF", 1, 2, RAX);       // call rax
+}
+
+// Append the code that reports the run-time error of the bytecode
+// instruction at pc
+static void emit_error(jit *j, unsigned int pc)
+{
+    // (the stack may not be aligned as calls need it to be)
+    emit_rr(j, true, "\x83", 1, 4, RSP);        // and rsp, -16
+    emit_byte(j, 0xF0);
+    emit_byte(j, 0xB8 | RDI);                   // mov edi, pc
+    emit32(j, pc);
+    emit_call(j, (const void *) jit_error);
+}
+
+// Append the code that pushes eax below the top of the expression stack
+// (so a new value can go in eax)
+static void emit_spill(jit *j)
+{
+    emit_mem(j, false, "\x89", 1, RAX, R13, NO_INDEX, 0);
+    emit_mem(j, true, "\x8D", 1, R13, R13, NO_INDEX, 4);
+}
+
+// Append the code that pops the expression stack, into eax
+static void emit_pop(jit *j)
+{
+    emit_mem(j, false, "\x8B", 1, RAX, R13, NO_INDEX, -4);
+    emit_mem(j, true, "\x8D", 1, R13, R13, NO_INDEX, -4);
+}
+
+// Append the code that puts the offset from rbx of the start of
+// the record levels static links out from the one in use in ecx
+static void emit_outer(jit *j, unsigned int levels)
+{
+    if (levels == 0) {
+	emit_rr(j, true, "\x89", 1, R12, RCX);  // mov rcx, r12
+	emit_rr(j, true, "\x29", 1, RBX, RCX);  // sub rcx, rbx
+	return;
+    }
+    emit_mem(j, false, "\x8B", 1, RCX, R12, NO_INDEX,
+	     STATIC_LINK * BYTES_PER_WORD);
+    for (unsigned int l = 1; l < levels; l++) {
+	emit_mem(j, false, "\x8B", 1, RCX, RBX, RCX,
+		 STATIC_LINK * BYTES_PER_WORD);
+    }
+}
+
+// Return the offset of slot off in a record
+static int32_t slot(word_type off)
+{
+    return (HEADER_WORDS + off) * BYTES_PER_WORD;
+}
+
+// Append the code that checks that there is space for a record of size
+// slots at r14, for the bytecode instruction at pc, leaving the end of
+// the record in rax
+static void emit_stack_check(jit *j, word_type size, unsigned int pc)
+{
+    emit_mem(j, true, "\x8D", 1, RAX, R14, NO_INDEX, slot(size));
+    emit_rr(j, true, "\x39", 1, RBP, RAX);      // cmp rax, rbp
+    size_t ok = emit_short_jump(j, CC_A ^ 1);   // jbe ok
+    emit_error(j, pc);
+    land(j, ok);
+}
+
+// Append the code that zeroes the size slots of the record at r12
+static void emit_zero_slots(jit *j, word_type size)
+{
+    if (size <= MAX_UNROLLED_ZEROING) {
+	for (word_type i = 0; i < size; i++) {
+	    emit_mem(j, false, "\xC7", 1, 0, R12, NO_INDEX, slot(i));
+	    emit32(j, 0);
+	}
+	return;
+    }
+    emit_mem(j, true, "\x8D", 1, RDI, R12, NO_INDEX, slot(0));
+    emit_byte(j, 0xB8 | RCX);                   // mov ecx, size
+    emit32(j, (uint32_t) size);
+    emit_rr(j, false, "\x31", 1, RAX, RAX);     // xor eax, eax
+    emit_byte(j, 0xF3);                         // rep stosd
+    emit_byte(j, 0xAB);
+}
+
+// Append the code that leaves the record in use (for the one before it)
+static void emit_leave(jit *j)
+{
+    emit_rr(j, true, "\x89", 1, R12, R14);      // mov r14, r12
+    emit_mem(j, false, "\x8B", 1, RCX, R12, NO_INDEX,
+	     DYNAMIC_LINK * BYTES_PER_WORD);
+    emit_mem(j, true, "\x8D", 1, R12, RBX, RCX, 0);
+}
+
+// Append the code for the bytecode instruction at pc
+static void translate(jit *j, unsigned int pc)
+{
+    const word_type *code = j->bc->code;
+    const word_type *in = &code[pc];
+    switch ((bytecode_op) in[0]) {
+    case op_halt:
+	emit_rr(j, true, "\x83", 1, 0, RSP);    // add rsp, 8
+	emit_byte(j, 8);
+	emit_bytes(j, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5D\x5B", 10);
+	emit_byte(j, 0xC3);                     // ret
+	break;
+    case op_push:
+	emit_spill(j);
+	emit_byte(j, 0xB8 | RAX);
+	emit32(j, (uint32_t) in[1]);
+	break;
+    case op_load:
+	emit_spill(j);
+	emit_mem(j, false, "\x8B", 1, RAX, R12, NO_INDEX, slot(in[1]));
+	break;
+    case op_load_outer:
+	emit_spill(j);
+	emit_outer(j, in[1]);
+	emit_mem(j, false, "\x8B", 1, RAX, RBX, RCX, slot(in[2]));
+	break;
+    case op_store:
+	emit_mem(j, false, "\x89", 1, RAX, R12, NO_INDEX, slot(in[1]));
+	emit_pop(j);
+	break;
+    case op_store_outer:
+	emit_outer(j, in[1]);
+	emit_mem(j, false, "\x89", 1, RAX, RBX, RCX, slot(in[2]));
+	emit_pop(j);
+	break;
+    case op_read:
+	emit_call(j, (const void *) jit_read);
+	emit_outer(j, in[1]);
+	emit_mem(j, false, "\x89", 1, RAX, RBX, RCX, slot(in[2]));
+	break;
+    case op_print:
+	emit_rr(j, false, "\x89", 1, RAX, RDI); // mov edi, eax
+	emit_call(j, (const void *) jit_print);
+	emit_pop(j);
+	break;
+    case op_add:
+	emit_mem(j, false, "\x03", 1, RAX, R13, NO_INDEX, -4);
+	emit_mem(j, true, "\x8D", 1, R13, R13, NO_INDEX, -4);
+	break;
+    case op_sub:
+	emit_rr(j, false, "\x89", 1, RAX, RCX); // mov ecx, eax
+	emit_pop(j);
+	emit_rr(j, false, "\x29", 1, RCX, RAX); // sub eax, ecx
+	break;
+    case op_mul:
+	emit_mem(j, false, "\x0F\xAF", 2, RAX, R13, NO_INDEX, -4);
+	emit_mem(j, true, "\x8D", 1, R13, R13, NO_INDEX, -4);
+	break;
+    case op_div: {
+	emit_rr(j, false, "\x89", 1, RAX, RCX); // mov ecx, eax
+	emit_pop(j);
+	emit_rr(j, false, "\x85", 1, RCX, RCX); // test ecx, ecx
+	size_t ok = emit_short_jump(j, CC_NE);
+	emit_error(j, pc);
+	land(j, ok);
+	// (the most negative word divided by -1 wraps around to itself,
+	// where idiv would trap)
+	emit_rr(j, false, "\x83", 1, 7, RCX);   // cmp ecx, -1
+	emit_byte(j, 0xFF);
+	size_t divide = emit_short_jump(j, CC_NE);
+	emit_rr(j, false, "\xF7", 1, 3, RAX);   // neg eax
+	emit_byte(j, 0xEB);                     // jmp done
+	emit_byte(j, 0);
+	size_t done = j->length - 1;
+	land(j, divide);
+	emit_byte(j, 0x99);                     // cdq
+	emit_rr(j, false, "\xF7", 1, 7, RCX);   // idiv ecx
+	land(j, done);
+	break;
+    }
+    case op_div_const: {
+	const bytecode_divisor *d = &j->bc->divisors[in[1]];
+	if (d->multiplier == 0 && d->shift > 0) {
+	    // (a negative dividend is rounded toward 0 by adding
+	    // the divisor - 1 before the shift)
+	    emit_rr(j, false, "\x89", 1, RAX, RCX); // mov ecx, eax
+	    emit_rr(j, false, "\xC1", 1, 7, RCX);   // sar ecx, 31
+	    emit_byte(j, 31);
+	    emit_rr(j, false, "\xC1", 1, 5, RCX);   // shr ecx, 32 - shift
+	    emit_byte(j, 32 - d->shift);
+	    emit_rr(j, false, "\x01", 1, RCX, RAX); // add eax, ecx
+	    emit_rr(j, false, "\xC1", 1, 7, RAX);   // sar eax, shift
+	    emit_byte(j, d->shift);
+	} else if (d->multiplier != 0) {
+	    // (the 64-bit product, shifted, rounds down, so 1 is added
+	    // to the quotient of a negative dividend)
+	    emit_rr(j, true, "\x63", 1, RCX, RAX);  // movsxd rcx, eax
+	    emit_byte(j, 0xB8 | RDX);                // mov edx, multiplier
+	    emit32(j, d->multiplier);
+	    emit_rr(j, true, "\x0F\xAF", 2, RCX, RDX); // imul rcx, rdx
+	    emit_rr(j, true, "\xC1", 1, 7, RCX);    // sar rcx, 32 + shift
+	    emit_byte(j, 32 + d->shift);
+	    emit_rr(j, false, "\xC1", 1, 7, RAX);   // sar eax, 31
+	    emit_byte(j, 31);
+	    emit_rr(j, false, "\x29", 1, RAX, RCX); // sub ecx, eax
+	    emit_rr(j, false, "\x89", 1, RCX, RAX); // mov eax, ecx
+	}
+	if (d->divisor < 0) {
+	    emit_rr(j, false, "\xF7", 1, 3, RAX);   // neg eax
+	}
+	break;
+    }
+    case op_neg:
+	emit_rr(j, false, "\xF7", 1, 3, RAX);   // neg eax
+	break;
+    case op_jump:
+	emit_jump(j, -1, in[1]);
+	break;
+    case op_jump_unless_eq: case op_jump_unless_ne: case op_jump_unless_lt:
+    case op_jump_unless_le: case op_jump_unless_gt: case op_jump_unless_ge: {
+	int cc = (in[0] == op_jump_unless_eq) ? CC_NE
+	    : (in[0] == op_jump_unless_ne) ? CC_E
+	    : (in[0] == op_jump_unless_lt) ? CC_GE
+	    : (in[0] == op_jump_unless_le) ? CC_G
+	    : (in[0] == op_jump_unless_gt) ? CC_LE : CC_L;
+	emit_mem(j, false, "\x8B", 1, RCX, R13, NO_INDEX, -4);
+	emit_rr(j, false, "\x39", 1, RAX, RCX); // cmp ecx, eax
+	// (mov and lea leave the flags alone)
+	emit_mem(j, false, "\x8B", 1, RAX, R13, NO_INDEX, -8);
+	emit_mem(j, true, "\x8D", 1, R13, R13, NO_INDEX, -8);
+	emit_jump(j, cc, in[1]);
+	break;
+    }
+    case op_jump_unless_divisible: {
+	emit_rr(j, false, "\x85", 1, RAX, RAX); // test eax, eax
+	size_t ok = emit_short_jump(j, CC_NE);
+	emit_error(j, pc);
+	land(j, ok);
+	// (everything is divisible by -1, where idiv could trap)
+	emit_rr(j, false, "\x31", 1, RDX, RDX); // xor edx, edx
+	emit_rr(j, false, "\x83", 1, 7, RAX);   // cmp eax, -1
+	emit_byte(j, 0xFF);
+	size_t done = emit_short_jump(j, CC_E);
+	emit_rr(j, false, "\x89", 1, RAX, RCX); // mov ecx, eax
+	emit_mem(j, false, "\x8B", 1, RAX, R13, NO_INDEX, -4);
+	emit_byte(j, 0x99);                     // cdq
+	emit_rr(j, false, "\xF7", 1, 7, RCX);   // idiv ecx
+	land(j, done);
+	emit_mem(j, false, "\x8B", 1, RAX, R13, NO_INDEX, -8);
+	emit_mem(j, true, "\x8D", 1, R13, R13, NO_INDEX, -8);
+	emit_rr(j, false, "\x85", 1, RDX, RDX); // test edx, edx
+	emit_jump(j, CC_NE, in[1]);
+	break;
+    }
+    case op_jump_unless_divisible_const: {
+	const bytecode_divisor *d = &j->bc->divisors[in[1]];
+	if (d->multiplier == 0) {
+	    if (d->shift == 0) {
+		// (everything is divisible by 1 and -1)
+		emit_pop(j);
+		break;
+	    }
+	    emit_byte(j, 0xA9);                      // test eax, low bits
+	    emit32(j, (1u << d->shift) - 1);
+	} else {
+	    emit_rr(j, false, "\x69", 1, RAX, RAX); // imul eax, eax, inverse
+	    emit32(j, d->inverse);
+	    emit_byte(j, 0x05);                      // add eax, bias
+	    emit32(j, d->bias);
+	    if (d->zeros > 0) {
+		emit_rr(j, false, "\xC1", 1, 1, RAX); // ror eax, zeros
+		emit_byte(j, d->zeros);
+	    }
+	    emit_byte(j, 0x3D);                      // cmp eax, limit
+	    emit32(j, d->limit);
+	}
+	// (mov and lea leave the flags alone)
+	emit_pop(j);
+	emit_jump(j, (d->multiplier == 0) ? CC_NE : CC_A, in[2]);
+	break;
+    }
+    case op_call: {
+	// (the callee's code starts with op_enter, giving its record's size)
+	emit_stack_check(j, code[in[2] + 1], pc);
+	emit_outer(j, in[1]);
+	emit_mem(j, false, "\x89", 1, RCX, R14, NO_INDEX,
+		 STATIC_LINK * BYTES_PER_WORD);
+	emit_rr(j, true, "\x89", 1, R12, RDX);  // mov rdx, r12
+	emit_rr(j, true, "\x29", 1, RBX, RDX);  // sub rdx, rbx
+	emit_mem(j, false, "\x89", 1, RDX, R14, NO_INDEX,
+		 DYNAMIC_LINK * BYTES_PER_WORD);
+	// the return address: lea rax, [rip + (the end of the jmp)]
+	emit_bytes(j, "\x48\x8D\x05", 3);
+	size_t ret = j->length;
+	emit32(j, 0);
+	emit_rr(j, true, "\x29", 1, R15, RAX);  // sub rax, r15
+	emit_mem(j, false, "\x89", 1, RAX, R14, NO_INDEX,
+		 RETURN_ADDRESS * BYTES_PER_WORD);
+	emit_rr(j, true, "\x89", 1, R14, R12);  // mov r12, r14
+	emit_rr(j, true, "\x83", 1, 0, R14);    // add r14, header
+	emit_byte(j, HEADER_WORDS * BYTES_PER_WORD);
+	emit_jump(j, -1, in[2]);
+	patch32(j, ret, (uint32_t) (j->length - (ret + 4)));
+	break;
+    }
+    case op_enter:
+	emit_zero_slots(j, in[1]);
+	emit_mem(j, true, "\x8D", 1, R14, R14, NO_INDEX,
+		 in[1] * BYTES_PER_WORD);
+	break;
+    case op_return:
+	emit_mem(j, false, "\x8B", 1, RAX, R12, NO_INDEX,
+		 RETURN_ADDRESS * BYTES_PER_WORD);
+	emit_leave(j);
+	emit_rr(j, true, "\x01", 1, R15, RAX);  // add rax, r15
+	emit_rr(j, false, "\xFF", 1, 4, RAX);   // jmp rax
+	break;
+    case op_block:
+	emit_stack_check(j, in[1], pc);
+	emit_outer(j, 0);
+	emit_mem(j, false, "\x89", 1, RCX, R14, NO_INDEX,
+		 STATIC_LINK * BYTES_PER_WORD);
+	emit_mem(j, false, "\x89", 1, RCX, R14, NO_INDEX,
+		 DYNAMIC_LINK * BYTES_PER_WORD);
+	emit_mem(j, false, "\xC7", 1, 0, R14, NO_INDEX,
+		 RETURN_ADDRESS * BYTES_PER_WORD);
+	emit32(j, 0);
+	emit_rr(j, true, "\x89", 1, R14, R12);  // mov r12, r14
+	emit_rr(j, true, "\x89", 1, RAX, R14);  // mov r14, rax
+	emit_zero_slots(j, in[1]);
+	break;
+    case op_leave:
+	emit_leave(j);
+	break;
+    case op_assign_constant:
+	emit_error(j, pc);
+	break;
+    }
+}
+
+// Translate bc into j's code, returning the offset of its entry point,
+// a function called with the start and end of the records' stack,
+// the expression stack, and the start of the code
+static size_t translate_all(jit *j, const bytecode *bc)
+{
+    j->bc = bc;
+    j->addrs = (size_t *) calloc(bc->length + 1, sizeof(size_t));
+    if (j->addrs == NULL) {
+	bail_with_error("No space to compile the program's code!");
+    }
+    // the code starts with the bytecode, as the program starts there
+    for (unsigned int pc = 0; pc < bc->length;
+	 pc += 1 + bytecode_num_operands(bc->code[pc])) {
+	j->addrs[pc] = j->length;
+	translate(j, pc);
+    }
+    // the entry point saves the registers the code uses (and aligns the
+    // stack for calls), sets them up, and goes to the first instruction
+    size_t entry = j->length;
+    emit_bytes(j, "\x53\x55\x41\x54\x41\x55\x41\x56\x41\x57", 10);
+    emit_rr(j, true, "\x83", 1, 5, RSP);        // sub rsp, 8
+    emit_byte(j, 8);
+    emit_rr(j, true, "\x89", 1, RDI, RBX);      // mov rbx, rdi
+    emit_rr(j, true, "\x89", 1, RSI, RBP);      // mov rbp, rsi
+    emit_rr(j, true, "\x89", 1, RDX, R13);      // mov r13, rdx
+    emit_rr(j, true, "\x89", 1, RCX, R15);      // mov r15, rcx
+    emit_rr(j, true, "\x89", 1, RBX, R12);      // mov r12, rbx
+    emit_rr(j, true, "\x89", 1, RBX, R14);      // mov r14, rbx
+    emit_jump(j, -1, 0);
+    for (size_t i = 0; i < j->num_fixups; i++) {
+	size_t pos = j->fixups[i].pos;
+	patch32(j, pos, (uint32_t) (j->addrs[j->fixups[i].target]
+				    - (pos + 4)));
+    }
+    return entry;
+}
+
+// Return true if programs can be run by jit_run
+bool jit_available(void)
+{
+    return true;
+}
+
+// Requires: bc was returned by bytecode_compile
+// Run bc as machine code, reporting a run-time error (on stderr, with its
+// location) and exiting with a failure code if one happens;
+// return false (without running any of bc) if the JIT is not available
+// or there is no space for bc's machine code
+bool jit_run(const bytecode *bc)
+{
+    jit j = { 0 };
+    size_t entry = translate_all(&j, bc);
+    // the code is written, then made executable (but not writable)
+    void *exec = mmap(NULL, j.length, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (exec == MAP_FAILED) {
+	free(j.code);
+	free(j.addrs);
+	free(j.fixups);
+	return false;
+    }
+    memcpy(exec, j.code, j.length);
+    free(j.code);
+    free(j.addrs);
+    free(j.fixups);
+    size_t stack_bytes = (size_t) MAX_STACK_WORDS * sizeof(word_type);
+    // (the pages of the stack are only given memory as they are used)
+    word_type *stack = (word_type *)
+	mmap(NULL, stack_bytes, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    word_type *operands = (word_type *)
+	malloc((bc->max_depth + 1) * sizeof(word_type));
+    if (mprotect(exec, j.length, PROT_READ | PROT_EXEC) != 0
+	|| stack == MAP_FAILED || operands == NULL) {
+	munmap(exec, j.length);
+	if (stack != MAP_FAILED) {
+	    munmap(stack, stack_bytes);
+	}
+	free(operands);
+	return false;
+    }
+    running = bc;
+    void (*run)(word_type *, word_type *, word_type *, unsigned char *) =
+	(void (*)(word_type *, word_type *, word_type *, unsigned char *))
+	((unsigned char *) exec + entry);
+    run(stack, stack + MAX_STACK_WORDS, operands, (unsigned char *) exec);
+    fflush(stdout);
+    munmap(exec, j.length);
+    munmap(stack, stack_bytes);
+    free(operands);
+    return true;
+}
+
+#endif
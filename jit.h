@@ -0,0 +1,29 @@
+#ifndef _JIT_H
+#define _JIT_H
+#include <stdbool.h>
+#include "bytecode.h"
+
+// A just-in-time compiler that translates the bytecode of SPL programs
+// (see bytecode.h) into x86-64 machine code and runs it, with the same
+// results (and run-time errors) as the virtual machine (see vm.h).
+// Each bytecode instruction is translated by a template: a fixed
+// sequence of machine instructions, filled in with its operands (such
+// as the offsets in activation records, which follow the layout of the
+// vm's records). The top of the expression stack is kept in a
+// register, print and read call helper functions, and the code is
+// written into pages that are made executable before it runs.
+//
+// The JIT is only built on Linux for x86-64, and not at all if
+// JIT_DISABLED is defined; elsewhere jit_available returns false.
+
+// Return true if programs can be run by jit_run
+extern bool jit_available(void);
+
+// Requires: bc was returned by bytecode_compile
+// Run bc as machine code, reporting a run-time error (on stderr, with its
+// location) and exiting with a failure code if one happens;
+// return false (without running any of bc) if the JIT is not available
+// or there is no space for bc's machine code
+extern bool jit_run(const bytecode *bc);
+
+#endif
@@ -0,0 +1,393 @@
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+#include "utilities.h"
+
+// The deepest nesting of arrays and objects that is parsed
+#define MAX_DEPTH 256
+
+// The state of a parse: the text and the position in it
+typedef struct {
+    const char *text;
+    size_t len;
+    size_t pos;
+} parse_state;
+
+static bool parse_value(parse_state *ps, json_value *v, unsigned int depth);
+
+// Skip the white space at ps's position
+static void skip_space(parse_state *ps)
+{
+    while (ps->pos < ps->len
+	   && (ps->text[ps->pos] == ' ' || ps->text[ps->pos] == '\t'
+	       || ps->text[ps->pos] == '\n' || ps->text[ps->pos] == '\r')) {
+	ps->pos++;
+    }
+}
+
+// If the text at ps's position is word, then move past it and return true,
+// otherwise return false
+static bool skip_word(parse_state *ps, const char *word)
+{
+    size_t n = strlen(word);
+    if (ps->len - ps->pos < n || strncmp(ps->text + ps->pos, word, n) != 0) {
+	return false;
+    }
+    ps->pos += n;
+    return true;
+}
+
+// Return a pointer to room for one more of the count elements of size size
+// in *a (which has room for *capacity elements)
+static void *grow(void *a, unsigned int count, unsigned int *capacity,
+		  size_t size)
+{
+    if (count == *capacity) {
+	*capacity = (*capacity == 0) ? 4 : 2 * *capacity;
+	a = realloc(a, *capacity * size);
+	if (a == NULL) {
+	    bail_with_error("No space for a JSON value!");
+	}
+    }
+    return a;
+}
+
+// Append the UTF-8 encoding of the code point c to s (of length *len)
+static void put_utf8(char *s, size_t *len, unsigned long c)
+{
+    if (c < 0x80) {
+	s[(*len)++] = (char) c;
+    } else if (c < 0x800) {
+	s[(*len)++] = (char) (0xC0 | (c >> 6));
+	s[(*len)++] = (char) (0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+	s[(*len)++] = (char) (0xE0 | (c >> 12));
+	s[(*len)++] = (char) (0x80 | ((c >> 6) & 0x3F));
+	s[(*len)++] = (char) (0x80 | (c & 0x3F));
+    } else {
+	s[(*len)++] = (char) (0xF0 | (c >> 18));
+	s[(*len)++] = (char) (0x80 | ((c >> 12) & 0x3F));
+	s[(*len)++] = (char) (0x80 | ((c >> 6) & 0x3F));
+	s[(*len)++] = (char) (0x80 | (c & 0x3F));
+    }
+}
+
+// Read the 4 hex digits at ps's position into *c; return false if there
+// are none
+static bool parse_hex4(parse_state *ps, unsigned long *c)
+{
+    if (ps->len - ps->pos < 4) {
+	return false;
+    }
+    *c = 0;
+    for (int i = 0; i < 4; i++) {
+	char h = ps->text[ps->pos++];
+	int d = (h >= '0' && h <= '9') ? h - '0'
+	    : (h >= 'a' && h <= 'f') ? h - 'a' + 10
+	    : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+	if (d < 0) {
+	    return false;
+	}
+	*c = (*c << 4) | (unsigned long) d;
+    }
+    return true;
+}
+
+// Parse the string at ps's position (just after its opening quote)
+// into a newly allocated *s, of length *len
+static bool parse_string(parse_state *ps, char **s, size_t *len)
+{
+    // the string is no longer than its text
+    size_t end = ps->pos;
+    while (end < ps->len && ps->text[end] != '"') {
+	end += (ps->text[end] == '\\') ? 2 : 1;
+    }
+    if (end >= ps->len) {
+	return false;
+    }
+    char *r = (char *) malloc(end - ps->pos + 1);
+    if (r == NULL) {
+	bail_with_error("No space for a JSON string!");
+    }
+    size_t n = 0;
+    while (ps->text[ps->pos] != '"') {
+	char ch = ps->text[ps->pos++];
+	if ((unsigned char) ch < 0x20) {
+	    free(r);
+	    return false;
+	} else if (ch != '\\') {
+	    r[n++] = ch;
+	    continue;
+	}
+	unsigned long c;
+	switch (ps->text[ps->pos++]) {
+	case '"': r[n++] = '"'; break;
+	case '\\': r[n++] = '\\'; break;
+	case '/': r[n++] = '/'; break;
+	case 'b': r[n++] = '\b'; break;
+	case 'f': r[n++] = '\f'; break;
+	case 'n': r[n++] = '\n'; break;
+	case 'r': r[n++] = '\r'; break;
+	case 't': r[n++] = '\t'; break;
+	case 'u':
+	    if (!parse_hex4(ps, &c)) {
+		free(r);
+		return false;
+	    }
+	    if (c >= 0xD800 && c < 0xDC00 && skip_word(ps, "\\u")) {
+		// a surrogate pair (6 more characters, giving 4 bytes)
+		unsigned long low;
+		if (!parse_hex4(ps, &low) || low < 0xDC00 || low >= 0xE000) {
+		    free(r);
+		    return false;
+		}
+		c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+	    }
+	    put_utf8(r, &n, c);
+	    break;
+	default:
+	    free(r);
+	    return false;
+	}
+    }
+    ps->pos++;
+    r[n] = '\0';
+    *s = r;
+    *len = n;
+    return true;
+}
+
+// Parse the number at ps's position into v
+static bool parse_number(parse_state *ps, json_value *v)
+{
+    // strtod needs a terminated string, and JSON numbers are short
+    char buf[64];
+    size_t n = 0;
+    while (ps->pos < ps->len && n < sizeof(buf) - 1
+	   && strchr("+-0123456789.eE", ps->text[ps->pos]) != NULL) {
+	buf[n++] = ps->text[ps->pos++];
+    }
+    buf[n] = '\0';
+    char *end;
+    v->number = strtod(buf, &end);
+    v->kind = json_number;
+    return n > 0 && *end == '\0';
+}
+
+// Parse the elements of the array at ps's position (after its "[") into v
+static bool parse_array(parse_state *ps, json_value *v, unsigned int depth)
+{
+    unsigned int capacity = 0;
+    v->kind = json_array;
+    skip_space(ps);
+    if (skip_word(ps, "]")) {
+	return true;
+    }
+    do {
+	v->elements = (json_value *)
+	    grow(v->elements, v->count, &capacity, sizeof(json_value));
+	// (counted even if it is not parsed, so it is freed)
+	bool ok = parse_value(ps, &v->elements[v->count++], depth + 1);
+	if (!ok) {
+	    return false;
+	}
+	skip_space(ps);
+    } while (skip_word(ps, ","));
+    return skip_word(ps, "]");
+}
+
+// Parse the members of the object at ps's position (after its "{") into v
+static bool parse_object(parse_state *ps, json_value *v, unsigned int depth)
+{
+    unsigned int capacity = 0;
+    v->kind = json_object;
+    skip_space(ps);
+    if (skip_word(ps, "}")) {
+	return true;
+    }
+    do {
+	unsigned int keys_capacity = capacity;
+	v->elements = (json_value *)
+	    grow(v->elements, v->count, &capacity, sizeof(json_value));
+	v->keys = (char **)
+	    grow(v->keys, v->count, &keys_capacity, sizeof(char *));
+	// (counted before it is parsed, so what was parsed is freed)
+	json_value *member = &v->elements[v->count];
+	char **key = &v->keys[v->count++];
+	memset(member, 0, sizeof(json_value));
+	*key = NULL;
+	size_t len;
+	skip_space(ps);
+	if (!skip_word(ps, "\"") || !parse_string(ps, key, &len)) {
+	    return false;
+	}
+	skip_space(ps);
+	if (!skip_word(ps, ":") || !parse_value(ps, member, depth + 1)) {
+	    return false;
+	}
+	skip_space(ps);
+    } while (skip_word(ps, ","));
+    return skip_word(ps, "}");
+}
+
+// Parse the value at ps's position into v,
+// which has depth arrays and objects around it;
+// if that does not work, v may need to be freed (by free_value)
+static bool parse_value(parse_state *ps, json_value *v, unsigned int depth)
+{
+    memset(v, 0, sizeof(json_value));
+    if (depth > MAX_DEPTH) {
+	return false;
+    }
+    skip_space(ps);
+    if (ps->pos == ps->len) {
+	return false;
+    } else if (skip_word(ps, "{")) {
+	return parse_object(ps, v, depth);
+    } else if (skip_word(ps, "[")) {
+	return parse_array(ps, v, depth);
+    } else if (skip_word(ps, "\"")) {
+	v->kind = json_string;
+	return parse_string(ps, &v->string, &v->length);
+    } else if (skip_word(ps, "true")) {
+	v->kind = json_bool;
+	v->boolean = true;
+	return true;
+    } else if (skip_word(ps, "false")) {
+	v->kind = json_bool;
+	return true;
+    } else if (skip_word(ps, "null")) {
+	v->kind = json_null;
+	return true;
+    }
+    return parse_number(ps, v);
+}
+
+// Free what v points to (but not v itself)
+static void free_value(json_value *v)
+{
+    free(v->string);
+    for (unsigned int i = 0; i < v->count; i++) {
+	free_value(&v->elements[i]);
+	if (v->keys != NULL) {
+	    free(v->keys[i]);
+	}
+    }
+    free(v->elements);
+    free(v->keys);
+}
+
+// Return the JSON value in the len characters of text,
+// or NULL if they are not one (in which case nothing needs to be freed)
+json_value *json_parse(const char *text, size_t len)
+{
+    json_value *v = (json_value *) malloc(sizeof(json_value));
+    if (v == NULL) {
+	bail_with_error("No space for a JSON value!");
+    }
+    parse_state ps = { text, len, 0 };
+    bool ok = parse_value(&ps, v, 0);
+    skip_space(&ps);
+    if (!ok || ps.pos != len) {
+	json_free(v);
+	return NULL;
+    }
+    return v;
+}
+
+// Free the value v returned by json_parse
+void json_free(json_value *v)
+{
+    if (v != NULL) {
+	free_value(v);
+	free(v);
+    }
+}
+
+// Return the member of v named key,
+// or NULL if v is NULL, not an object, or has no such member
+const json_value *json_member(const json_value *v, const char *key)
+{
+    if (v == NULL || v->kind != json_object) {
+	return NULL;
+    }
+    for (unsigned int i = 0; i < v->count; i++) {
+	if (strcmp(v->keys[i], key) == 0) {
+	    return &v->elements[i];
+	}
+    }
+    return NULL;
+}
+
+// Return the string of v if it is a string, otherwise NULL
+const char *json_string_of(const json_value *v)
+{
+    return (v != NULL && v->kind == json_string) ? v->string : NULL;
+}
+
+// Put the number of v in *n and return true if v is an integer that fits,
+// otherwise return false
+bool json_uint_of(const json_value *v, unsigned int *n)
+{
+    if (v == NULL || v->kind != json_number || v->number < 0
+	|| v->number > 4294967295.0
+	|| v->number != (double) (unsigned int) v->number) {
+	return false;
+    }
+    *n = (unsigned int) v->number;
+    return true;
+}
+
+// Print the len characters of s on out as a JSON string
+void json_print_string(FILE *out, const char *s, size_t len)
+{
+    putc('"', out);
+    for (size_t i = 0; i < len; i++) {
+	unsigned char c = (unsigned char) s[i];
+	if (c == '"' || c == '\\') {
+	    putc('\\', out);
+	    putc(c, out);
+	} else if (c == '\n') {
+	    fputs("\\n", out);
+	} else if (c < 0x20) {
+	    fprintf(out, "\\u%04x", c);
+	} else {
+	    putc(c, out);
+	}
+    }
+    putc('"', out);
+}
+
+// Print v on out as JSON
+void json_print(FILE *out, const json_value *v)
+{
+    switch (v->kind) {
+    case json_null:
+	fputs("null", out);
+	break;
+    case json_bool:
+	fputs(v->boolean ? "true" : "false", out);
+	break;
+    case json_number:
+	fprintf(out, "%.17g", v->number);
+	break;
+    case json_string:
+	json_print_string(out, v->string, v->length);
+	break;
+    case json_array:
+    case json_object:
+	putc(v->kind == json_array ? '[' : '{', out);
+	for (unsigned int i = 0; i < v->count; i++) {
+	    if (i > 0) {
+		putc(',', out);
+	    }
+	    if (v->kind == json_object) {
+		json_print_string(out, v->keys[i], strlen(v->keys[i]));
+		putc(':', out);
+	    }
+	    json_print(out, &v->elements[i]);
+	}
+	putc(v->kind == json_array ? ']' : '}', out);
+	break;
+    }
+}
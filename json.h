@@ -0,0 +1,50 @@
+#ifndef _JSON_H
+#define _JSON_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// JSON values, as read by json_parse (for the language server)
+
+// kinds of JSON values
+typedef enum { json_null, json_bool, json_number, json_string,
+	       json_array, json_object } json_kind;
+
+typedef struct json_value_s {
+    json_kind kind;
+    bool boolean;   // for json_bool
+    double number;  // for json_number
+    char *string;   // for json_string (null terminated, in UTF-8)
+    size_t length;  // the length of string
+    // for json_array and json_object: the count elements (or members)
+    // and, for json_object, the key of each member
+    unsigned int count;
+    struct json_value_s *elements;
+    char **keys;
+} json_value;
+
+// Return the JSON value in the len characters of text,
+// or NULL if they are not one (in which case nothing needs to be freed)
+extern json_value *json_parse(const char *text, size_t len);
+
+// Free the value v returned by json_parse
+extern void json_free(json_value *v);
+
+// Return the member of v named key,
+// or NULL if v is NULL, not an object, or has no such member
+extern const json_value *json_member(const json_value *v, const char *key);
+
+// Return the string of v if it is a string, otherwise NULL
+extern const char *json_string_of(const json_value *v);
+
+// Put the number of v in *n and return true if v is an integer that fits,
+// otherwise return false
+extern bool json_uint_of(const json_value *v, unsigned int *n);
+
+// Print the len characters of s on out as a JSON string
+extern void json_print_string(FILE *out, const char *s, size_t len);
+
+// Print v on out as JSON
+extern void json_print(FILE *out, const json_value *v);
+
+#endif
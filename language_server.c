@@ -0,0 +1,970 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "language_server.h"
+#include "incremental.h"
+#include "json.h"
+#include "lexer.h"
+#include "parser.h"
+#include "scope_check.h"
+#include "ast_walk.h"
+#include "id_attrs.h"
+#include "intern.h"
+#include "utilities.h"
+
+// JSON-RPC error codes
+#define PARSE_ERROR (-32700)
+#define INVALID_REQUEST (-32600)
+#define METHOD_NOT_FOUND (-32601)
+
+// Where messages are read from and written to
+static FILE *in;
+static FILE *out;
+
+// The message being written (see begin_message and end_message)
+static FILE *message;
+static char *message_text;
+static size_t message_length;
+
+// Has the client asked the server to shut down?
+static bool shut_down = false;
+
+// A declared name's occurrence in a document
+typedef struct {
+    unsigned int offset;      // where it starts
+    unsigned int length;
+    unsigned int decl_offset; // where its declaration's name is
+    const char *name;
+    id_kind kind;             // its declaration's kind
+    bool is_decl;             // is it the declaration itself?
+    bool has_value;           // for a constant's declaration, its value
+    word_type value;
+} occurrence_t;
+
+// A document that the client has open
+typedef struct {
+    char *uri;
+    char *name;               // its file's name (or its URI, if not a file)
+    unsigned int file_id;     // its id for file_locations
+    char *text;               // its text, while another document is being
+    size_t length;            // compiled (see compile_document)
+    // the index of its names: their occurrences, in order of offset
+    occurrence_t *occs;
+    unsigned int num_occs;
+    unsigned int occs_capacity;
+    // the indexes in occs of the occurrences, in order of the offsets
+    // of their declarations (then of their offsets), so that those of
+    // each declaration are together
+    unsigned int *by_decl;
+} document_t;
+
+// The open documents, and the one being compiled incrementally (or NULL)
+static document_t **docs = NULL;
+static unsigned int num_docs = 0;
+static unsigned int docs_capacity = 0;
+static document_t *active = NULL;
+
+// An error in the document: where it is and its message
+typedef struct {
+    unsigned int offset;
+    char *message;
+} diagnostic_t;
+
+// The errors found by the document's last compilation
+static diagnostic_t *diags = NULL;
+static unsigned int num_diags = 0;
+static unsigned int diags_capacity = 0;
+
+// The occurrences found by walking (part of) the document's AST,
+// to be put in its index (see replace_occurrences)
+static occurrence_t *found = NULL;
+static unsigned int num_found = 0;
+static unsigned int found_capacity = 0;
+
+// Make sure that *a (of elements of size size) has room for count + 1
+static void *reserve(void *a, unsigned int count, unsigned int *capacity,
+		     size_t size)
+{
+    if (count == *capacity) {
+	*capacity = (*capacity == 0) ? 256 : 2 * *capacity;
+	a = realloc(a, *capacity * size);
+	if (a == NULL) {
+	    bail_with_error("No space for the language server's index!");
+	}
+    }
+    return a;
+}
+
+// Return the byte offset of fl in its file
+static unsigned int offset_of(file_location fl)
+{
+    return file_location_offset(fl);
+}
+
+// Return the index in the lexer's tokens of the first one at or after fl
+static unsigned int token_at(file_location fl)
+{
+    const token_array *ta = lexer_tokens();
+    unsigned int lo = 0;
+    unsigned int hi = ta->count - 1;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (ta->tokens[mid].loc < fl) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+// Return the length of the token that starts at offset,
+// or 1 if there is none (e.g., at an invalid character)
+static unsigned int token_length(unsigned int offset)
+{
+    const token_array *ta = lexer_tokens();
+    file_location fl = file_location_make(
+	file_location_file_id(ta->tokens[ta->count - 1].loc), offset);
+    for (unsigned int i = token_at(fl);
+	 i < ta->count && ta->tokens[i].loc == fl; i++) {
+	if (ta->tokens[i].kind != TOKEN_LEXICAL_ERROR) {
+	    return (unsigned int) strlen(intern_text(ta->tokens[i].text));
+	}
+    }
+    return 1;
+}
+
+// Add an occurrence of a name declared with the given attributes (if any,
+// as there are none for a duplicate declaration) to those found
+static void add_occurrence(id_use *idu, const char *name, file_location fl,
+			   bool is_decl, bool has_value, word_type value)
+{
+    if (idu == NULL) {
+	return;
+    }
+    found = (occurrence_t *) reserve(found, num_found, &found_capacity,
+				     sizeof(occurrence_t));
+    occurrence_t *o = &found[num_found++];
+    o->offset = offset_of(fl);
+    o->length = (unsigned int) strlen(name);
+    o->decl_offset = offset_of(idu->attrs->file_loc);
+    o->name = name;
+    o->kind = idu->attrs->kind;
+    o->is_decl = is_decl;
+    o->has_value = has_value;
+    o->value = value;
+}
+
+// The walk's pre callback for indexing: add the declarations and
+// other occurrences of names in node to those found
+static bool index_pre(void *node, AST_type t, void *data)
+{
+    (void) data;
+    switch (t) {
+    case const_def_ast: {
+	ident_t *id = &((const_def_t *) node)->ident;
+	add_occurrence(id->idu, id->name, id->file_loc, true, true,
+		       ((const_def_t *) node)->number.value);
+	break;
+    }
+    case ident_ast: {
+	// only the identifiers declared as variables are visited
+	ident_t *id = (ident_t *) node;
+	add_occurrence(id->idu, id->name, id->file_loc, true, false, 0);
+	break;
+    }
+    case proc_decl_ast: {
+	proc_decl_t *pd = (proc_decl_t *) node;
+	add_occurrence(pd->idu, pd->name, pd->file_loc, true, false, 0);
+	break;
+    }
+    case stmt_ast: {
+	// (the locations of these statements are those of their names)
+	stmt_t *s = (stmt_t *) node;
+	if (s->stmt_kind == assign_stmt) {
+	    assign_stmt_t *a = &s->data.assign_stmt;
+	    add_occurrence(a->idu, a->name, a->file_loc, false, false, 0);
+	} else if (s->stmt_kind == call_stmt) {
+	    call_stmt_t *c = &s->data.call_stmt;
+	    add_occurrence(c->idu, c->name, c->file_loc, false, false, 0);
+	} else if (s->stmt_kind == read_stmt) {
+	    read_stmt_t *r = &s->data.read_stmt;
+	    add_occurrence(r->idu, r->name, r->file_loc, false, false, 0);
+	}
+	break;
+    }
+    case expr_ast: {
+	expr_t *e = (expr_t *) node;
+	if (e->expr_kind == expr_ident) {
+	    ident_t *id = &e->data.ident;
+	    add_occurrence(id->idu, id->name, id->file_loc, false, false, 0);
+	}
+	break;
+    }
+    default:
+	break;
+    }
+    return true;
+}
+
+// Compare occurrences by offset (for qsort)
+static int compare_occurrences(const void *a, const void *b)
+{
+    unsigned int x = ((const occurrence_t *) a)->offset;
+    unsigned int y = ((const occurrence_t *) b)->offset;
+    return (x > y) - (x < y);
+}
+
+// Is the occurrence x before y in the order of by_decl?
+static bool before_by_decl(const occurrence_t *x, const occurrence_t *y)
+{
+    return x->decl_offset < y->decl_offset
+	|| (x->decl_offset == y->decl_offset && x->offset < y->offset);
+}
+
+// Compare the occurrences whose indexes in found are a and b
+// in the order of by_decl (for qsort)
+static int compare_found_by_decl(const void *a, const void *b)
+{
+    const occurrence_t *x = &found[*(const unsigned int *) a];
+    const occurrence_t *y = &found[*(const unsigned int *) b];
+    return before_by_decl(y, x) - before_by_decl(x, y);
+}
+
+// Return the index of the first of d's occurrences at or after offset
+static unsigned int first_occurrence(const document_t *d, unsigned int offset)
+{
+    unsigned int lo = 0;
+    unsigned int hi = d->num_occs;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (d->occs[mid].offset < offset) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+// Replace d's occurrences from offset start up to end by those found,
+// moving the later ones (and the later declarations) by move bytes
+// (which keeps the order of by_decl for those left, as the declarations
+// of those outside of start to end are not between start and end)
+static void replace_occurrences(document_t *d, unsigned int start,
+				unsigned int end, int move)
+{
+    qsort(found, num_found, sizeof(occurrence_t), compare_occurrences);
+    unsigned int *fresh = (unsigned int *)
+	malloc((num_found + 1) * sizeof(unsigned int));
+    if (fresh == NULL) {
+	bail_with_error("No space for the language server's index!");
+    }
+    for (unsigned int j = 0; j < num_found; j++) {
+	fresh[j] = j;
+    }
+    qsort(fresh, num_found, sizeof(unsigned int), compare_found_by_decl);
+    unsigned int old_count = d->num_occs;
+    unsigned int first = first_occurrence(d, start);
+    unsigned int last = first_occurrence(d, end);
+    for (unsigned int i = last; i < d->num_occs; i++) {
+	d->occs[i].offset += move;
+    }
+    for (unsigned int i = 0; i < d->num_occs; i++) {
+	if (d->occs[i].decl_offset >= end) {
+	    d->occs[i].decl_offset += move;
+	}
+    }
+    unsigned int count = d->num_occs - (last - first) + num_found;
+    if (count > d->occs_capacity) {
+	d->occs_capacity = (count > 2 * d->occs_capacity) ? count
+	    : 2 * d->occs_capacity;
+	d->occs = (occurrence_t *)
+	    realloc(d->occs, d->occs_capacity * sizeof(occurrence_t));
+	if (d->occs == NULL) {
+	    bail_with_error("No space for the language server's index!");
+	}
+    }
+    memmove(&d->occs[first + num_found], &d->occs[last],
+	    (d->num_occs - last) * sizeof(occurrence_t));
+    memcpy(&d->occs[first], found, num_found * sizeof(occurrence_t));
+    d->num_occs = count;
+
+    // merge the new occurrences into by_decl, in place of the old ones
+    unsigned int *by_decl = (unsigned int *)
+	malloc((d->occs_capacity + 1) * sizeof(unsigned int));
+    if (by_decl == NULL) {
+	bail_with_error("No space for the language server's index!");
+    }
+    unsigned int n = 0;
+    unsigned int j = 0;
+    for (unsigned int i = 0; i < old_count; i++) {
+	unsigned int k = d->by_decl[i];
+	if (k >= first && k < last) {
+	    continue;
+	}
+	if (k >= last) {
+	    k = k - (last - first) + num_found;
+	}
+	while (j < num_found
+	       && before_by_decl(&found[fresh[j]], &d->occs[k])) {
+	    by_decl[n++] = first + fresh[j++];
+	}
+	by_decl[n++] = k;
+    }
+    while (j < num_found) {
+	by_decl[n++] = first + fresh[j++];
+    }
+    free(d->by_decl);
+    d->by_decl = by_decl;
+    free(fresh);
+    num_found = 0;
+}
+
+// Bring the index of d (the document being compiled) up to date after
+// it was compiled, when the text after the edit (if any) moved by move
+// bytes: if only one block was parsed again, then only its names are
+// indexed again, otherwise (or if it was just opened) all of them are
+static void update_index(document_t *d, int move)
+{
+    ast_visitor v = { index_pre, NULL, NULL, NULL };
+    const block_t *blk = incremental_partial_block();
+    if (blk == NULL) {
+	d->num_occs = 0;
+	block_t prog;
+	if (incremental_program(&prog)) {
+	    ast_walk(&prog, block_ast, &v);
+	}
+	replace_occurrences(d, 0, 0, 0);
+	return;
+    }
+    // (the edit was inside the block, so its "end" is what moved)
+    ast_walk((void *) blk, block_ast, &v);
+    replace_occurrences(d, offset_of(blk->file_loc),
+			offset_of(incremental_partial_end()) - move, move);
+}
+
+// Return d's occurrence at (or just after) offset,
+// or NULL if there is none
+static const occurrence_t *occurrence_at(const document_t *d,
+					 unsigned int offset)
+{
+    // find the last occurrence starting at or before offset
+    unsigned int lo = 0;
+    unsigned int hi = d->num_occs;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (d->occs[mid].offset <= offset) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    if (lo == 0) {
+	return NULL;
+    }
+    const occurrence_t *o = &d->occs[lo - 1];
+    if (offset > o->offset + o->length) {
+	return NULL;
+    }
+    return o;
+}
+
+// Start writing a message (to message)
+static void begin_message()
+{
+    message = open_memstream(&message_text, &message_length);
+    if (message == NULL) {
+	bail_with_error("No space for a message!");
+    }
+    fputs("{\"jsonrpc\":\"2.0\",", message);
+}
+
+// Finish writing the message, and send it
+static void end_message()
+{
+    fputs("}", message);
+    fclose(message);
+    fprintf(out, "Content-Length: %zu\r\n\r\n", message_length);
+    fwrite(message_text, 1, message_length, out);
+    fflush(out);
+    free(message_text);
+}
+
+// Start writing the response to the request with the given id,
+// up to its result
+static void begin_response(const json_value *id)
+{
+    begin_message();
+    fputs("\"id\":", message);
+    json_print(message, id);
+    fputs(",\"result\":", message);
+}
+
+// Send an error response to the request with the given id
+// (which is NULL if the request's id is not known)
+static void send_error(const json_value *id, int code, const char *msg)
+{
+    begin_message();
+    fputs("\"id\":", message);
+    if (id == NULL) {
+	fputs("null", message);
+    } else {
+	json_print(message, id);
+    }
+    fprintf(message, ",\"error\":{\"code\":%d,\"message\":", code);
+    json_print_string(message, msg, strlen(msg));
+    fputs("}", message);
+    end_message();
+}
+
+// Send a null result for the request with the given id
+static void send_null(const json_value *id)
+{
+    begin_response(id);
+    fputs("null", message);
+    end_message();
+}
+
+// Return the id of the file of the document being compiled
+static unsigned int doc_file_id()
+{
+    const token_array *ta = lexer_tokens();
+    return file_location_file_id(ta->tokens[ta->count - 1].loc);
+}
+
+// Return the length of d's text
+static size_t doc_length(const document_t *d)
+{
+    return (d == active) ? incremental_length() : d->length;
+}
+
+// Print the (LSP) position of offset in d on message
+static void print_position(const document_t *d, unsigned int offset)
+{
+    unsigned int num_lines;
+    const unsigned int *starts =
+	file_location_line_starts(d->file_id, &num_lines);
+    // find the last line starting at or before offset
+    unsigned int lo = 0;
+    unsigned int hi = num_lines;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (starts[mid] <= offset) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    unsigned int line = (lo == 0) ? 0 : lo - 1;
+    fprintf(message, "{\"line\":%u,\"character\":%u}", line,
+	    offset - starts[line]);
+}
+
+// Print the range from start to end in d on message
+static void print_range(const document_t *d, unsigned int start,
+			unsigned int end)
+{
+    fputs("{\"start\":", message);
+    print_position(d, start);
+    fputs(",\"end\":", message);
+    print_position(d, end);
+    fputs("}", message);
+}
+
+// Print the location (in d) of the length bytes at offset on message
+static void print_location(const document_t *d, unsigned int offset,
+			   unsigned int length)
+{
+    fputs("{\"uri\":", message);
+    json_print_string(message, d->uri, strlen(d->uri));
+    fputs(",\"range\":", message);
+    print_range(d, offset, offset + length);
+    fputs("}", message);
+}
+
+// Put the offset in d of the (LSP) position pos in *offset;
+// return false if pos is not a position
+static bool position_offset(const document_t *d, const json_value *pos,
+			    size_t *offset)
+{
+    unsigned int line, character;
+    if (!json_uint_of(json_member(pos, "line"), &line)
+	|| !json_uint_of(json_member(pos, "character"), &character)) {
+	return false;
+    }
+    unsigned int num_lines;
+    const unsigned int *starts =
+	file_location_line_starts(d->file_id, &num_lines);
+    size_t len = doc_length(d);
+    if (line >= num_lines) {
+	*offset = len;
+	return true;
+    }
+    // (positions past the end of a line are at its end)
+    size_t end = (line + 1 < num_lines) ? starts[line + 1] - 1 : len;
+    *offset = starts[line] + character;
+    if (*offset > end) {
+	*offset = end;
+    }
+    return true;
+}
+
+// Note an error (reported by the lexer or parser) in the document
+static void note_error(file_location fl, const char *msg)
+{
+    diags = (diagnostic_t *) reserve(diags, num_diags, &diags_capacity,
+				     sizeof(diagnostic_t));
+    diags[num_diags].offset = offset_of(fl);
+    diags[num_diags].message = strdup(msg);
+    if (diags[num_diags].message == NULL) {
+	bail_with_error("No space for an error message!");
+    }
+    num_diags++;
+}
+
+// Note a declaration error in the document (for incremental_for_each_error)
+static void note_declaration_error(file_location fl, const char *msg,
+				   size_t len, void *data)
+{
+    (void) data;
+    diags = (diagnostic_t *) reserve(diags, num_diags, &diags_capacity,
+				     sizeof(diagnostic_t));
+    diags[num_diags].offset = offset_of(fl);
+    diags[num_diags].message = strndup(msg, len);
+    if (diags[num_diags].message == NULL) {
+	bail_with_error("No space for an error message!");
+    }
+    num_diags++;
+}
+
+// Forget the errors noted
+static void clear_errors()
+{
+    for (unsigned int i = 0; i < num_diags; i++) {
+	free(diags[i].message);
+    }
+    num_diags = 0;
+}
+
+// Send the diagnostics noted for d (the document being compiled),
+// which are its errors if d has just been compiled, to the client
+static void send_diagnostics(const document_t *d)
+{
+    begin_message();
+    fputs("\"method\":\"textDocument/publishDiagnostics\",\"params\":"
+	  "{\"uri\":", message);
+    json_print_string(message, d->uri, strlen(d->uri));
+    fputs(",\"diagnostics\":[", message);
+    for (unsigned int i = 0; i < num_diags; i++) {
+	fputs(i > 0 ? ",{\"range\":" : "{\"range\":", message);
+	unsigned int offset = diags[i].offset;
+	print_range(d, offset, offset + token_length(offset));
+	fputs(",\"severity\":1,\"source\":\"spl\",\"message\":", message);
+	json_print_string(message, diags[i].message,
+			  strlen(diags[i].message));
+	fputs("}", message);
+    }
+    fputs("]}", message);
+    end_message();
+    clear_errors();
+}
+
+// Send the errors noted (and the declaration errors) of d,
+// the document being compiled, to the client
+static void publish_errors(const document_t *d)
+{
+    incremental_for_each_error(note_declaration_error, NULL);
+    send_diagnostics(d);
+}
+
+// Return the name of the file that uri (a "file:" URI) names, newly
+// allocated, or NULL if it does not name a file
+static char *uri_path(const char *uri)
+{
+    const char *p;
+    if (strncmp(uri, "file://", 7) == 0) {
+	p = uri + 7;
+    } else if (strncmp(uri, "file:", 5) == 0) {
+	p = uri + 5;
+    } else {
+	return NULL;
+    }
+    char *path = (char *) malloc(strlen(p) + 1);
+    if (path == NULL) {
+	bail_with_error("No space for a file name!");
+    }
+    size_t n = 0;
+    while (*p != '\0') {
+	unsigned int c;
+	if (p[0] == '%' && sscanf(p + 1, "%2x", &c) == 1) {
+	    path[n++] = (char) c;
+	    p += 3;
+	} else {
+	    path[n++] = *p++;
+	}
+    }
+    path[n] = '\0';
+    return path;
+}
+
+// Return the index in docs of the open document with the given uri
+// (which may be NULL), or num_docs if there is none
+static unsigned int find_document(const char *uri)
+{
+    unsigned int i = 0;
+    while (uri != NULL && i < num_docs && strcmp(docs[i]->uri, uri) != 0) {
+	i++;
+    }
+    return (uri == NULL) ? num_docs : i;
+}
+
+// Return the URI of the text document in params (or NULL)
+static const char *params_uri(const json_value *params)
+{
+    return json_string_of(json_member(json_member(params, "textDocument"),
+				      "uri"));
+}
+
+// Return the open document that params are about (or NULL)
+static document_t *params_document(const json_value *params)
+{
+    unsigned int i = find_document(params_uri(params));
+    return (i < num_docs) ? docs[i] : NULL;
+}
+
+// Add a document with the given uri (and no text yet) to those open,
+// and return it
+static document_t *add_document(const char *uri)
+{
+    docs = (document_t **) reserve(docs, num_docs, &docs_capacity,
+				   sizeof(document_t *));
+    document_t *d = (document_t *) calloc(1, sizeof(document_t));
+    if (d == NULL) {
+	bail_with_error("No space for the document %s!", uri);
+    }
+    d->uri = strdup(uri);
+    // a document that is not a file (e.g., an untitled one)
+    // is compiled as if its URI were its file's name
+    d->name = uri_path(uri);
+    if (d->name == NULL) {
+	d->name = strdup(uri);
+    }
+    if (d->uri == NULL || d->name == NULL) {
+	bail_with_error("No space for the document %s!", uri);
+    }
+    docs[num_docs++] = d;
+    return d;
+}
+
+// Compile the len characters of text as the text of d, in place of
+// the document being compiled (if any), whose text is kept until it is
+// compiled again; the errors noted are d's
+static void compile_document(document_t *d, const char *text, size_t len)
+{
+    if (active != NULL && active != d) {
+	active->length = incremental_length();
+	active->text = (char *) malloc(active->length + 1);
+	if (active->text == NULL) {
+	    bail_with_error("No space for the text of %s!", active->uri);
+	}
+	memcpy(active->text, incremental_text(), active->length);
+    }
+    active = d;
+    clear_errors();
+    incremental_open_text(d->name, text, len);
+    d->file_id = doc_file_id();
+}
+
+// Handle the notification that a document was opened
+static void did_open(const json_value *params)
+{
+    const char *uri = params_uri(params);
+    const json_value *text =
+	json_member(json_member(params, "textDocument"), "text");
+    if (uri == NULL || text == NULL || text->kind != json_string) {
+	return;
+    }
+    document_t *d = params_document(params);
+    if (d == NULL) {
+	d = add_document(uri);
+    }
+    // the client's text is the document's, even if it has not been saved
+    // (or there is no file)
+    free(d->text);
+    d->text = NULL;
+    compile_document(d, text->string, text->length);
+    update_index(d, 0);
+    publish_errors(d);
+}
+
+// Handle the notification that a document was changed
+static void did_change(const json_value *params)
+{
+    document_t *d = params_document(params);
+    const json_value *changes = json_member(params, "contentChanges");
+    if (d == NULL || changes == NULL || changes->kind != json_array) {
+	return;
+    }
+    if (d != active) {
+	// its index is still that of its text
+	char *text = d->text;
+	d->text = NULL;
+	compile_document(d, text, d->length);
+	free(text);
+    }
+    for (unsigned int i = 0; i < changes->count; i++) {
+	const json_value *change = &changes->elements[i];
+	const json_value *text = json_member(change, "text");
+	const json_value *range = json_member(change, "range");
+	if (text == NULL || text->kind != json_string) {
+	    continue;
+	}
+	size_t start = 0;
+	size_t end = incremental_length();
+	if (range != NULL
+	    && (!position_offset(d, json_member(range, "start"), &start)
+		|| !position_offset(d, json_member(range, "end"), &end)
+		|| start > end)) {
+	    continue;
+	}
+	// only the errors found after the last change are current
+	clear_errors();
+	incremental_edit(start, end, text->string, text->length);
+	update_index(d, (int) (text->length - (end - start)));
+    }
+    publish_errors(d);
+}
+
+// Handle the notification that a document was closed
+static void did_close(const json_value *params)
+{
+    unsigned int i = find_document(params_uri(params));
+    if (i == num_docs) {
+	return;
+    }
+    document_t *d = docs[i];
+    // the client shows no errors for a closed document
+    clear_errors();
+    send_diagnostics(d);
+    if (d == active) {
+	active = NULL;
+    }
+    free(d->uri);
+    free(d->name);
+    free(d->text);
+    free(d->occs);
+    free(d->by_decl);
+    free(d);
+    docs[i] = docs[--num_docs];
+}
+
+// Put the open document that params are about in *d, and return
+// the occurrence of a name at the position in params (or NULL)
+static const occurrence_t *params_occurrence(const json_value *params,
+					     const document_t **d)
+{
+    size_t offset;
+    *d = params_document(params);
+    if (*d == NULL
+	|| !position_offset(*d, json_member(params, "position"), &offset)) {
+	return NULL;
+    }
+    return occurrence_at(*d, (unsigned int) offset);
+}
+
+// Answer the request (with the given id) for the definition of a name
+static void definition(const json_value *id, const json_value *params)
+{
+    const document_t *d;
+    const occurrence_t *o = params_occurrence(params, &d);
+    if (o == NULL) {
+	send_null(id);
+	return;
+    }
+    begin_response(id);
+    print_location(d, o->decl_offset, o->length);
+    end_message();
+}
+
+// Answer the request (with the given id) for the references to a name
+static void references(const json_value *id, const json_value *params)
+{
+    const document_t *d;
+    const occurrence_t *o = params_occurrence(params, &d);
+    if (o == NULL) {
+	send_null(id);
+	return;
+    }
+    const json_value *incl =
+	json_member(json_member(params, "context"), "includeDeclaration");
+    bool include_decl = incl != NULL && incl->kind == json_bool
+	&& incl->boolean;
+    unsigned int decl_offset = o->decl_offset;
+    // find the first of the declaration's occurrences in by_decl
+    unsigned int lo = 0;
+    unsigned int hi = d->num_occs;
+    while (lo < hi) {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if (d->occs[d->by_decl[mid]].decl_offset < decl_offset) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    begin_response(id);
+    fputs("[", message);
+    bool first = true;
+    for (unsigned int i = lo; i < d->num_occs
+	     && d->occs[d->by_decl[i]].decl_offset == decl_offset; i++) {
+	const occurrence_t *r = &d->occs[d->by_decl[i]];
+	if (r->is_decl && !include_decl) {
+	    continue;
+	}
+	if (!first) {
+	    fputs(",", message);
+	}
+	first = false;
+	print_location(d, r->offset, r->length);
+    }
+    fputs("]", message);
+    end_message();
+}
+
+// Answer the request (with the given id) for information about a name
+static void hover(const json_value *id, const json_value *params)
+{
+    const document_t *d;
+    const occurrence_t *o = params_occurrence(params, &d);
+    if (o == NULL) {
+	send_null(id);
+	return;
+    }
+    // (a constant's value is noted at its declaration)
+    const occurrence_t *decl = occurrence_at(d, o->decl_offset);
+    char text[512];
+    if (decl != NULL && decl->has_value) {
+	snprintf(text, sizeof(text), "%s %s = %d", kind2str(o->kind),
+		 o->name, decl->value);
+    } else {
+	snprintf(text, sizeof(text), "%s %s", kind2str(o->kind), o->name);
+    }
+    begin_response(id);
+    fputs("{\"contents\":{\"kind\":\"plaintext\",\"value\":", message);
+    json_print_string(message, text, strlen(text));
+    fputs("},\"range\":", message);
+    print_range(d, o->offset, o->offset + o->length);
+    fputs("}", message);
+    end_message();
+}
+
+// Answer the initialize request (with the given id)
+static void initialize(const json_value *id)
+{
+    begin_response(id);
+    fputs("{\"capabilities\":{"
+	  "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+	  "\"definitionProvider\":true,\"referencesProvider\":true,"
+	  "\"hoverProvider\":true},"
+	  "\"serverInfo\":{\"name\":\"spl\"}}", message);
+    end_message();
+}
+
+// Read the next message into a newly allocated buffer, and set *len to
+// its length; return NULL at the end of the input
+static char *read_message(size_t *len)
+{
+    char line[1024];
+    bool have_length = false;
+    while (fgets(line, sizeof(line), in) != NULL) {
+	if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) {
+	    if (have_length) {
+		break;
+	    }
+	} else if (strncasecmp(line, "Content-Length:", 15) == 0) {
+	    *len = strtoul(line + 15, NULL, 10);
+	    have_length = true;
+	}
+    }
+    if (!have_length) {
+	return NULL;
+    }
+    char *buf = (char *) malloc(*len + 1);
+    if (buf == NULL) {
+	bail_with_error("No space for a message!");
+    }
+    if (fread(buf, 1, *len, in) != *len) {
+	free(buf);
+	return NULL;
+    }
+    buf[*len] = '\0';
+    return buf;
+}
+
+// Handle the message msg; return false if the server should exit
+static bool handle(const json_value *msg)
+{
+    const char *method = json_string_of(json_member(msg, "method"));
+    const json_value *id = json_member(msg, "id");
+    const json_value *params = json_member(msg, "params");
+    if (method == NULL) {
+	if (id != NULL) {
+	    send_error(id, INVALID_REQUEST, "A request needs a method");
+	}
+	// (responses to the server's requests are not expected)
+	return true;
+    }
+    if (strcmp(method, "exit") == 0) {
+	return false;
+    } else if (strcmp(method, "textDocument/didOpen") == 0) {
+	did_open(params);
+    } else if (strcmp(method, "textDocument/didChange") == 0) {
+	did_change(params);
+    } else if (strcmp(method, "textDocument/didClose") == 0) {
+	did_close(params);
+    } else if (id == NULL) {
+	// other notifications (e.g., "initialized") need nothing done
+    } else if (strcmp(method, "initialize") == 0) {
+	initialize(id);
+    } else if (strcmp(method, "shutdown") == 0) {
+	shut_down = true;
+	send_null(id);
+    } else if (strcmp(method, "textDocument/definition") == 0) {
+	definition(id, params);
+    } else if (strcmp(method, "textDocument/references") == 0) {
+	references(id, params);
+    } else if (strcmp(method, "textDocument/hover") == 0) {
+	hover(id, params);
+    } else {
+	send_error(id, METHOD_NOT_FOUND, "Method not supported");
+    }
+    return true;
+}
+
+// Serve the requests read from in, writing responses and notifications
+// to out, until the client says to exit; return the exit code
+// (EXIT_SUCCESS if the client asked the server to shut down first)
+int language_server_run(FILE *input, FILE *output)
+{
+    in = input;
+    out = output;
+    // all the errors are found, and noted instead of printed
+    parser_set_error_limit(0);
+    scope_check_set_error_limit(0);
+    lexer_set_error_handler(note_error);
+    size_t len;
+    char *text;
+    bool go_on = true;
+    while (go_on && (text = read_message(&len)) != NULL) {
+	json_value *msg = json_parse(text, len);
+	if (msg == NULL) {
+	    send_error(NULL, PARSE_ERROR, "The message is not JSON");
+	} else {
+	    go_on = handle(msg);
+	    json_free(msg);
+	}
+	free(text);
+    }
+    return shut_down ? EXIT_SUCCESS : EXIT_FAILURE;
+}
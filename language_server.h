@@ -0,0 +1,24 @@
+#ifndef _LANGUAGE_SERVER_H
+#define _LANGUAGE_SERVER_H
+#include <stdio.h>
+
+// A language server for SPL, which speaks the Language Server Protocol
+// (JSON-RPC messages, each after a Content-Length header).
+// It keeps each open document's text and an index of its identifiers,
+// and compiles the document that was last changed incrementally
+// (see incremental.h; as only one file can be compiled that way,
+// changing another document compiles it anew from its text).
+// It publishes a document's lexical, syntax, and declaration errors
+// after each change, and answers go-to-definition, find-references,
+// and hover requests from the document's index, so that a request takes
+// a search and not a compilation.  After an edit that is compiled by
+// parsing only one block again, only that block's identifiers are
+// indexed again.  A document need not be a file: its text is the one
+// the client opened it with.
+
+// Serve the requests read from in, writing responses and notifications
+// to out, until the client says to exit; return the exit code
+// (EXIT_SUCCESS if the client asked the server to shut down first)
+extern int language_server_run(FILE *in, FILE *out);
+
+#endif
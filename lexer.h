@@ -2,6 +2,8 @@
 #ifndef _LEXER_H
 #define _LEXER_H
 #include <stdbool.h>
+#include "file_location.h"
+#include "token_array.h"
 
 // Requires: fname != NULL
 // Requires: fname is the name of a readable file
@@ -9,15 +11,96 @@
 // from the given file name
 extern void lexer_init(char *fname);
 
+// Requires: fname is the name of a readable file
+//           that was read before, with the given file id
+// Initialize the lexer and start it reading the file again,
+// as lexer_init does, but keeping its file id (with its lines forgotten)
+extern void lexer_reinit(char *fname, unsigned int file_id);
+
 // Return the next token in the input
 extern int yylex();
 
+// Read all the tokens from the input file into an array,
+// from which yylex then returns them
+// (lexical errors are reported when yylex reaches them)
+extern void lexer_tokenize_all();
+
+// Read all the tokens from the input file into an array,
+// as lexer_tokenize_all does, but lexing parts of a large file
+// on up to jobs threads (0 means one per processor) at the same time
+extern void lexer_tokenize_all_parallel(unsigned int jobs);
+
+// Requires: file_id was returned by file_location_register for fname,
+//           and no lines (after the first) have been added for it
+// Read all the tokens from text (of length len), the text of the file
+// named fname (which need not have been saved), into an array,
+// as lexer_tokenize_all does, in place of the input file
+extern void lexer_tokenize_text(char *fname, unsigned int file_id,
+				const char *text, size_t len);
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called
+// Start returning the tokens read by lexer_tokenize_all from the first one
+extern void lexer_rewind();
+
 // Return the name of the current file
 extern const char *lexer_filename();
 
 // Return the line number of the next token
 extern unsigned int lexer_line();
 
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called
+// Set whether yylex skips the body of each procedure declared in the
+// program's outermost block; the body's tokens are recorded,
+// and the parser is given just its "begin" and matching "end"
+extern void lexer_set_lazy_procs(bool lazy);
+
+// If the procedure body that starts (with "begin") at loc was skipped,
+// then set *first and *end to the range of its tokens and return true,
+// otherwise return false
+extern bool lexer_skipped_body(file_location loc, unsigned int *first,
+			       unsigned int *end);
+
+// Requires: first and end were set by lexer_skipped_body
+// Make yylex return the tokens from first up to (not including) end,
+// then a period (so they can be parsed as a program), and then the end of file
+extern void lexer_parse_range(unsigned int first, unsigned int end);
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called
+// Return the tokens read (which end with the end of file token)
+extern const token_array *lexer_tokens();
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called, first <= end, end < the number of tokens,
+//           and the tokens in ta are from the same file
+// Replace the tokens from first up to (not including) end by those in ta,
+// and move the locations of the tokens after them by delta bytes
+// (e.g., after the text that the replaced tokens were read from
+// was edited, and ta was read from the new text)
+extern void lexer_splice_tokens(unsigned int first, unsigned int end,
+				const token_array *ta, int delta);
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called
+// Return the index of the "end" matching the "begin" at index first
+// of the tokens (counting "if" and "while" as also needing an "end"),
+// or 0 if there is none
+extern unsigned int lexer_matching_end(unsigned int first);
+
+// Set whether errors (including the parser's) are only noted
+// (see lexer_has_errors) instead of being reported
+extern void lexer_set_quiet(bool quiet);
+
+// The type of the function given to lexer_set_error_handler
+typedef void (*lexer_error_fn)(file_location loc, const char *msg);
+
+// Set the function that is given the location (of the token being read)
+// and message of each error (including the parser's) that is reported,
+// instead of it being printed on stderr; NULL means print them
+extern void lexer_set_error_handler(lexer_error_fn handler);
+
 // On standard output:
 // Print a message about the file name of the lexer's input
 // and then print a heading for the lexer's output.
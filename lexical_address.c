@@ -0,0 +1,19 @@
+#include <stdlib.h>
+#include "lexical_address.h"
+#include "utilities.h"
+
+// Return a (pointer to a fresh) lexical_address with the given levels
+// outward and offset in the activation record.
+// If there is no space, bail with an error message,
+// so this should never return NULL.
+lexical_address *lexical_address_create(unsigned int levelsOut,
+					 unsigned int offset)
+{
+    lexical_address *ret = (lexical_address *)malloc(sizeof(lexical_address));
+    if (ret == NULL) {
+	bail_with_error("No space to allocate lexical_address!");
+    }
+    ret->levelsOutward = levelsOut;
+    ret->offsetInAR = offset;
+    return ret;
+}
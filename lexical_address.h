@@ -0,0 +1,20 @@
+#ifndef _LEXICAL_ADDRESS_H
+#define _LEXICAL_ADDRESS_H
+
+// A lexical address gives the location of a constant or variable
+// in the run-time stack: the number of static links to follow
+// (levels outward from the scope of the use)
+// and the offset (in bytes) from the base of that activation record.
+typedef struct {
+    unsigned int levelsOutward;
+    unsigned int offsetInAR;
+} lexical_address;
+
+// Return a (pointer to a fresh) lexical_address with the given levels
+// outward and offset in the activation record.
+// If there is no space, bail with an error message,
+// so this should never return NULL.
+extern lexical_address *lexical_address_create(unsigned int levelsOut,
+					       unsigned int offset);
+
+#endif
@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "optimizer.h"
+#include "ast_walk.h"
+#include "ptr_map.h"
+#include "utilities.h"
+#include "spl.tab.h"
+
+// The state of the optimizer (which simplifies one program at a time)
+typedef struct {
+    ptr_map constants;          // the id_attrs of each constant -> its def
+    // the statements (and lists of them) that never finish running,
+    // as they fail or loop forever (each maps to itself)
+    ptr_map endless;
+    bool fails;                 // will the expressions so far fail?
+    unsigned int removed;       // the statements removed
+    // for each value on the operand stack here (innermost last),
+    // whether computing it may fail (by dividing by 0)
+    bool *may_fail;
+    unsigned int depth;
+    unsigned int size;
+} optimizer;
+
+// Push (onto the optimizer's stack) whether computing a value may fail
+static void push_may_fail(optimizer *o, bool may_fail)
+{
+    if (o->depth == o->size) {
+	o->size = (o->size == 0) ? 64 : 2 * o->size;
+	o->may_fail = (bool *) realloc(o->may_fail, o->size * sizeof(bool));
+	if (o->may_fail == NULL) {
+	    bail_with_error("No space to optimize the program!");
+	}
+    }
+    o->may_fail[o->depth++] = may_fail;
+}
+
+// Make expr the number v (keeping its location)
+static void make_number(expr_t *expr, word_type v)
+{
+    expr->type_tag = expr_ast;
+    expr->expr_kind = expr_number;
+    expr->data.number.file_loc = expr->file_loc;
+    expr->data.number.type_tag = number_ast;
+    expr->data.number.text = NULL;
+    expr->data.number.value = v;
+}
+
+// Return true if expr is the number v
+static bool is_number(const expr_t *expr, word_type v)
+{
+    return expr->expr_kind == expr_number && expr->data.number.value == v;
+}
+
+// Return -v, wrapping around as words do
+static word_type negate(word_type v)
+{
+    return (word_type) (0u - (unsigned int) v);
+}
+
+// Return the value of a op b (where op is an arithmetic operator's code,
+// and if op is division, b is not 0), wrapping around as words do
+static word_type fold(int op, word_type a, word_type b)
+{
+    switch (op) {
+    case plussym:
+	return (word_type) ((unsigned int) a + (unsigned int) b);
+    case minussym:
+	return (word_type) ((unsigned int) a - (unsigned int) b);
+    case multsym:
+	return (word_type) ((unsigned int) a * (unsigned int) b);
+    default:
+	// (the most negative word divided by -1 wraps around to itself)
+	return (b == -1) ? negate(a) : a / b;
+    }
+}
+
+// Return true if a and b are uses of the same variable
+static bool same_variable(const expr_t *a, const expr_t *b)
+{
+    return a->expr_kind == expr_ident && b->expr_kind == expr_ident
+	&& a->data.ident.idu->attrs->kind == variable_idk
+	&& a->data.ident.idu->attrs == b->data.ident.idu->attrs;
+}
+
+// Simplify the binary expression expr (whose operands are simplified),
+// which may fail if a_fails (its first operand may) or b_fails,
+// and return whether the result may fail
+static bool simplify_binary(expr_t *expr, bool a_fails, bool b_fails)
+{
+    binary_op_expr_t *bin = &expr->data.binary;
+    expr_t *a = bin->expr1;
+    expr_t *b = bin->expr2;
+    int op = bin->arith_op.code;
+    if (op == divsym && !(b->expr_kind == expr_number
+			  && b->data.number.value != 0)) {
+	// (this division may fail, so it stays)
+	return true;
+    }
+    if (a->expr_kind == expr_number && b->expr_kind == expr_number) {
+	make_number(expr, fold(op, a->data.number.value,
+			       b->data.number.value));
+	return false;
+    }
+    switch (op) {
+    case plussym:
+	if (is_number(b, 0)) {
+	    *expr = *a;
+	    return a_fails;
+	} else if (is_number(a, 0)) {
+	    *expr = *b;
+	    return b_fails;
+	}
+	break;
+    case minussym:
+	if (is_number(b, 0)) {
+	    *expr = *a;
+	    return a_fails;
+	} else if (same_variable(a, b)) {
+	    make_number(expr, 0);
+	    return false;
+	}
+	break;
+    case multsym:
+	if (is_number(b, 1)) {
+	    *expr = *a;
+	    return a_fails;
+	} else if (is_number(a, 1)) {
+	    *expr = *b;
+	    return b_fails;
+	} else if ((is_number(b, 0) && !a_fails)
+		   || (is_number(a, 0) && !b_fails)) {
+	    make_number(expr, 0);
+	    return false;
+	}
+	break;
+    default:
+	if (is_number(b, 1)) {
+	    *expr = *a;
+	    return a_fails;
+	}
+	break;
+    }
+    return a_fails || b_fails;
+}
+
+// Simplify the negated expression expr (whose operand is simplified)
+static void simplify_negated(expr_t *expr)
+{
+    expr_t *e = expr->data.negated.expr;
+    if (e->expr_kind == expr_number) {
+	make_number(expr, negate(e->data.number.value));
+    } else if (e->expr_kind == expr_negated) {
+	*expr = *e->data.negated.expr;
+    }
+}
+
+// Return true if cond's value is known (as its expressions are numbers,
+// and it does not divide by 0), putting that value in *holds
+static bool decide(const condition_t *cond, bool *holds)
+{
+    const expr_t *a, *b;
+    if (cond->cond_kind == ck_db) {
+	a = &cond->data.db_cond.dividend;
+	b = &cond->data.db_cond.divisor;
+    } else {
+	a = &cond->data.rel_op_cond.expr1;
+	b = &cond->data.rel_op_cond.expr2;
+    }
+    if (a->expr_kind != expr_number || b->expr_kind != expr_number
+	|| (cond->cond_kind == ck_db && b->data.number.value == 0)) {
+	return false;
+    }
+    word_type x = a->data.number.value;
+    word_type y = b->data.number.value;
+    if (cond->cond_kind == ck_db) {
+	*holds = (y == -1 || x % y == 0);
+	return true;
+    }
+    switch (cond->data.rel_op_cond.rel_op.code) {
+    case eqsym:
+	*holds = (x == y);
+	break;
+    case neqsym:
+	*holds = (x != y);
+	break;
+    case ltsym:
+	*holds = (x < y);
+	break;
+    case leqsym:
+	*holds = (x <= y);
+	break;
+    case gtsym:
+	*holds = (x > y);
+	break;
+    default:
+	*holds = (x >= y);
+	break;
+    }
+    return true;
+}
+
+// The counting walk's pre callback: count the statements
+static bool count_pre(void *node, AST_type t, void *data)
+{
+    (void) node;
+    if (t == stmt_ast) {
+	(*(unsigned int *) data)++;
+    }
+    return true;
+}
+
+// Note (in o) that stmt and the statements in it are removed
+static void note_removed(optimizer *o, stmt_t *stmt)
+{
+    ast_visitor v = { count_pre, NULL, NULL, &o->removed };
+    ast_walk(stmt, stmt_ast, &v);
+}
+
+// Note (in o) that the statements in stmts (if any) are removed
+static void note_removed_stmts(optimizer *o, stmts_t *stmts)
+{
+    if (stmts != NULL) {
+	ast_visitor v = { count_pre, NULL, NULL, &o->removed };
+	ast_walk(stmts, stmts_ast, &v);
+    }
+}
+
+// Return the last of the statements in the list that starts with first
+static stmt_t *last_stmt(stmt_t *first)
+{
+    while (first->next != NULL) {
+	first = first->next;
+    }
+    return first;
+}
+
+// Remove the statements of stmts that never run: replace each if
+// whose condition is known with the statements of the branch it takes,
+// remove each while whose condition is known not to hold, and remove
+// the statements after one that never finishes
+static void remove_dead_stmts(optimizer *o, stmts_t *stmts)
+{
+    if (stmts->stmts_kind == empty_stmts_e) {
+	return;
+    }
+    stmt_t **link = &stmts->stmt_list.start;
+    while (*link != NULL) {
+	stmt_t *s = *link;
+	bool holds;
+	if (s->stmt_kind == if_stmt && decide(&s->data.if_stmt.condition,
+					      &holds)) {
+	    if_stmt_t *is = &s->data.if_stmt;
+	    stmts_t *taken = holds ? is->then_stmts : is->else_stmts;
+	    note_removed_stmts(o, holds ? is->else_stmts : is->then_stmts);
+	    o->removed++;
+	    if (taken != NULL && taken->stmts_kind != empty_stmts_e) {
+		// (its statements were already simplified, as a list)
+		last_stmt(taken->stmt_list.start)->next = s->next;
+		*link = taken->stmt_list.start;
+	    } else {
+		*link = s->next;
+	    }
+	    continue;
+	}
+	if (s->stmt_kind == while_stmt
+	    && decide(&s->data.while_stmt.condition, &holds)) {
+	    if (!holds) {
+		note_removed(o, s);
+		*link = s->next;
+		continue;
+	    }
+	    ptr_map_put(&o->endless, s, s);
+	}
+	if (ptr_map_get(&o->endless, s) != NULL) {
+	    for (stmt_t *dead = s->next; dead != NULL; dead = dead->next) {
+		note_removed(o, dead);
+	    }
+	    s->next = NULL;
+	    ptr_map_put(&o->endless, stmts, stmts);
+	    break;
+	}
+	link = &s->next;
+    }
+    if (stmts->stmt_list.start == NULL) {
+	stmts->stmts_kind = empty_stmts_e;
+    }
+}
+
+// The walk's pre callback
+static bool optimize_pre(void *node, AST_type t, void *data)
+{
+    optimizer *o = (optimizer *) data;
+    if (t == const_def_ast) {
+	const_def_t *def = (const_def_t *) node;
+	ptr_map_put(&o->constants, def->ident.idu->attrs, def);
+    } else if (t == stmt_ast) {
+	o->fails = false;
+    }
+    return true;
+}
+
+// The walk's between callback
+static void optimize_between(void *node, AST_type t, int i, void *data)
+{
+    optimizer *o = (optimizer *) data;
+    if (t == stmt_ast && i == 0 && o->fails) {
+	// (after the condition of an if or while, which always fails)
+	ptr_map_put(&o->endless, node, node);
+    }
+}
+
+// The walk's post callback
+static void optimize_post(void *node, AST_type t, void *data)
+{
+    optimizer *o = (optimizer *) data;
+    switch (t) {
+    case expr_ast: {
+	expr_t *expr = (expr_t *) node;
+	switch (expr->expr_kind) {
+	case expr_ident: {
+	    id_use *idu = expr->data.ident.idu;
+	    if (idu->attrs->kind == constant_idk) {
+		const_def_t *def = (const_def_t *)
+		    ptr_map_get(&o->constants, idu->attrs);
+		make_number(expr, def->number.value);
+	    }
+	    push_may_fail(o, false);
+	    break;
+	}
+	case expr_number:
+	    push_may_fail(o, false);
+	    break;
+	case expr_negated:
+	    simplify_negated(expr);
+	    break;
+	case expr_bin: {
+	    bool b_fails = o->may_fail[--o->depth];
+	    bool a_fails = o->may_fail[--o->depth];
+	    push_may_fail(o, simplify_binary(expr, a_fails, b_fails));
+	    if (expr->expr_kind == expr_bin
+		&& expr->data.binary.arith_op.code == divsym
+		&& is_number(expr->data.binary.expr2, 0)) {
+		o->fails = true;
+	    }
+	    break;
+	}
+	}
+	break;
+    }
+    case condition_ast: {
+	condition_t *cond = (condition_t *) node;
+	if (cond->cond_kind == ck_db
+	    && is_number(&cond->data.db_cond.divisor, 0)) {
+	    o->fails = true;
+	}
+	// (no values are on the stack between statements)
+	o->depth = 0;
+	break;
+    }
+    case stmts_ast:
+	remove_dead_stmts(o, (stmts_t *) node);
+	break;
+    case stmt_ast: {
+	stmt_t *stmt = (stmt_t *) node;
+	o->depth = 0;
+	if ((stmt->stmt_kind == assign_stmt
+	     && (o->fails
+		 || stmt->data.assign_stmt.idu->attrs->kind != variable_idk))
+	    || (stmt->stmt_kind == print_stmt && o->fails)
+	    || (stmt->stmt_kind == block_stmt
+		&& ptr_map_get(&o->endless,
+			       &stmt->data.block_stmt.block->stmts) != NULL)) {
+	    // (assigning to a constant fails)
+	    ptr_map_put(&o->endless, stmt, stmt);
+	}
+	break;
+    }
+    default:
+	break;
+    }
+}
+
+// Requires: prog has been scope checked without errors
+// Simplify prog (in place), returning the number of statements removed
+unsigned int optimize_program(block_t *prog)
+{
+    optimizer o = { 0 };
+    ast_visitor v = { optimize_pre, optimize_between, optimize_post, &o };
+    ast_walk(prog, block_ast, &v);
+    ptr_map_free(&o.constants);
+    ptr_map_free(&o.endless);
+    free(o.may_fail);
+    return o.removed;
+}
@@ -0,0 +1,31 @@
+#ifndef _OPTIMIZER_H
+#define _OPTIMIZER_H
+#include "ast.h"
+
+// Simplifying the ASTs of checked programs, before they are run or
+// compiled, without changing what they do.
+//
+// Each expression is simplified after its subexpressions (so the walk
+// does not recurse): a name declared as a constant becomes its number,
+// an operation on numbers becomes its result (wrapping around as words
+// do, and leaving a division by 0 to fail when it runs), and these
+// identities are applied (and those with the operands swapped):
+//   x + 0 = x,  x - 0 = x,  x * 1 = x,  x / 1 = x,  -(-x) = x,
+//   x * 0 = 0,  x - x = 0 (for a variable x)
+// where x * 0 is only simplified if x has no division that may fail.
+// The simplified expressions reuse the nodes of the program's AST.
+//
+// Then the statements that never run are removed from each list of
+// statements (after those in its statements): an if whose condition is
+// known (as its expressions are numbers) is replaced by the statements
+// of the branch it takes, a while whose condition is known not to hold
+// is removed, and so are the statements after one that never finishes
+// (a while whose condition is known to hold, or a statement that is
+// certain to fail, by dividing by 0 or assigning to a constant).
+
+// Requires: prog has been scope checked without errors
+// Simplify prog (in place), returning the number of statements removed
+// (counting those nested in them)
+extern unsigned int optimize_program(block_t *prog);
+
+#endif
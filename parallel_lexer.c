@@ -0,0 +1,367 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "parallel_lexer.h"
+#include "parser_types.h"
+#include "intern.h"
+#include "utilities.h"
+#include "spl.tab.h"
+
+// The scanner here follows the rules in spl_lexer.l
+// (which SPL's simple lexical grammar makes easy to do by hand),
+// but keeps all of its state in a chunk_t, so chunks can be lexed at once.
+// Chunks always start at the beginning of a line: no token
+// (or comment) in SPL spans a newline, so a newline always ends a token.
+
+// A part of the file and the results of lexing it
+typedef struct {
+    const char *text;          // the whole file
+    size_t start;              // offset of the chunk's first character
+    size_t end;                // offset just past its last character
+    unsigned int file_id;
+    token_array tokens;        // the text of a token is its length here,
+                               // and that of an error is its index in msgs
+    char **msgs;               // the messages for lexical errors
+    unsigned int num_msgs;
+    unsigned int *line_starts; // offsets of the lines starting in the chunk
+    unsigned int num_lines;
+    unsigned int lines_capacity;
+} chunk_t;
+
+// The reserved words, and their token codes
+static const struct {
+    const char *word;
+    int code;
+} reserved[] = {
+    { "const", constsym }, { "var", varsym }, { "proc", procsym },
+    { "call", callsym }, { "begin", beginsym }, { "end", endsym },
+    { "if", ifsym }, { "then", thensym }, { "else", elsesym },
+    { "while", whilesym }, { "do", dosym }, { "read", readsym },
+    { "print", printsym }, { "divisible", divisiblesym }, { "by", bysym },
+};
+
+// Return the token code for the identifier or reserved word
+// made of the len characters at s
+static int word_code(const char *s, size_t len)
+{
+    for (size_t i = 0; i < sizeof(reserved) / sizeof(reserved[0]); i++) {
+	if (strncmp(reserved[i].word, s, len) == 0
+	    && reserved[i].word[len] == '\0') {
+	    return reserved[i].code;
+	}
+    }
+    return identsym;
+}
+
+// Add a token of the given kind and length at offset to the chunk
+static void add_token(chunk_t *c, int kind, size_t offset, size_t len)
+{
+    token_array_add(&c->tokens, kind,
+		    file_location_make(c->file_id, (unsigned int) offset),
+		    (unsigned int) len);
+}
+
+// Add a lexical error (with the message msg) at offset to the chunk
+static void add_error(chunk_t *c, size_t offset, const char *msg)
+{
+    char **msgs = (char **) realloc(c->msgs,
+				   (c->num_msgs + 1) * sizeof(char *));
+    char *copy = (char *) malloc(strlen(msg) + 1);
+    if (msgs == NULL || copy == NULL) {
+	bail_with_error("No space for lexical error messages!");
+    }
+    strcpy(copy, msg);
+    c->msgs = msgs;
+    c->msgs[c->num_msgs] = copy;
+    token_array_add(&c->tokens, TOKEN_LEXICAL_ERROR,
+		    file_location_make(c->file_id, (unsigned int) offset),
+		    c->num_msgs++);
+}
+
+// Note that a line starts at offset in the chunk
+static void add_line(chunk_t *c, size_t offset)
+{
+    if (c->num_lines == c->lines_capacity) {
+	c->lines_capacity = (c->lines_capacity == 0) ? 1024
+	                                             : 2 * c->lines_capacity;
+	c->line_starts = (unsigned int *)
+	    realloc(c->line_starts, c->lines_capacity * sizeof(unsigned int));
+	if (c->line_starts == NULL) {
+	    bail_with_error("No space for line starts!");
+	}
+    }
+    c->line_starts[c->num_lines++] = (unsigned int) offset;
+}
+
+// Check the number made of the len digits at s, as the lexer does,
+// adding an error to c (at offset) if it is too large
+static void check_number(chunk_t *c, size_t offset, const char *s, size_t len)
+{
+    char *yytext = (char *) malloc(len + 1);
+    if (yytext == NULL) {
+	bail_with_error("No space for a number's text!");
+    }
+    memcpy(yytext, s, len);
+    yytext[len] = '\0';
+    unsigned long lval = strtoul(yytext, NULL, 10);
+    if (INT_MAX < lval) {
+	char msgbuf[512];
+	if (strlen(yytext) >= 300) {
+	    snprintf(msgbuf, 327, "Number (%s...) is too large!", yytext);
+	} else {
+	    sprintf(msgbuf, "Number (%s) is too large!", yytext);
+	}
+	add_error(c, offset, msgbuf);
+    }
+    free(yytext);
+}
+
+// Lex the chunk c
+static void lex_chunk(chunk_t *c)
+{
+    const char *s = c->text;
+    size_t i = c->start;
+    while (i < c->end) {
+	size_t begin = i;
+	char ch = s[i];
+	int kind;
+	switch (ch) {
+	case ' ': case '\t': case '\v': case '\f': case '\r':
+	    i++;
+	    continue;
+	case '\n':
+	    i++;
+	    add_line(c, i);
+	    continue;
+	case '%':
+	    // a comment runs to the end of the line
+	    while (i < c->end && s[i] != '\n') {
+		i++;
+	    }
+	    continue;
+	case '+': kind = plussym; i++; break;
+	case '-': kind = minussym; i++; break;
+	case '*': kind = multsym; i++; break;
+	case '/': kind = divsym; i++; break;
+	case '.': kind = periodsym; i++; break;
+	case ';': kind = semisym; i++; break;
+	case ',': kind = commasym; i++; break;
+	case '(': kind = lparensym; i++; break;
+	case ')': kind = rparensym; i++; break;
+	case '=': case '<': case '>':
+	    if (i + 1 < c->end && s[i + 1] == '=') {
+		kind = (ch == '=') ? eqeqsym : (ch == '<') ? leqsym : geqsym;
+		i += 2;
+	    } else {
+		kind = (ch == '=') ? eqsym : (ch == '<') ? ltsym : gtsym;
+		i++;
+	    }
+	    break;
+	case ':': case '!':
+	    if (i + 1 < c->end && s[i + 1] == '=') {
+		kind = (ch == ':') ? becomessym : neqsym;
+		i += 2;
+		break;
+	    }
+	    // (these are invalid by themselves)
+	    // fall through
+	default:
+	    if ('0' <= ch && ch <= '9') {
+		while (i < c->end && '0' <= s[i] && s[i] <= '9') {
+		    i++;
+		}
+		check_number(c, begin, s + begin, i - begin);
+		kind = numbersym;
+	    } else if (('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z')) {
+		while (i < c->end
+		       && (('a' <= s[i] && s[i] <= 'z')
+			   || ('A' <= s[i] && s[i] <= 'Z')
+			   || ('0' <= s[i] && s[i] <= '9'))) {
+		    i++;
+		}
+		kind = word_code(s + begin, i - begin);
+	    } else {
+		char msgbuf[512];
+		sprintf(msgbuf, "invalid character: '%c' ('\\0%o')", ch, ch);
+		add_error(c, begin, msgbuf);
+		i++;
+		continue;
+	    }
+	    break;
+	}
+	add_token(c, kind, begin, i - begin);
+    }
+}
+
+// A worker thread's main function: lex the chunk arg
+static void *lex_chunk_thread(void *arg)
+{
+    lex_chunk((chunk_t *) arg);
+    return NULL;
+}
+
+// Add the tokens (and lexical errors) of the chunk c to ta,
+// with their texts interned, and free them in c
+static void append_tokens(chunk_t *c, token_array *ta)
+{
+    file_location base = file_location_make(c->file_id, 0);
+    for (unsigned int t = 0; t < c->tokens.count; t++) {
+	token_rec *tr = &c->tokens.tokens[t];
+	unsigned int text_id;
+	if (tr->kind == TOKEN_LEXICAL_ERROR) {
+	    text_id = intern(c->msgs[tr->text], strlen(c->msgs[tr->text]));
+	    free(c->msgs[tr->text]);
+	} else {
+	    text_id = intern(c->text + (tr->loc - base), tr->text);
+	}
+	token_array_add(ta, tr->kind, tr->loc, text_id);
+    }
+    token_array_clear(&c->tokens);
+    free(c->msgs);
+}
+
+// Split the len characters of text into at most max_chunks chunks,
+// each starting at the beginning of a line and (except the last)
+// at least PARALLEL_LEX_MIN_CHUNK long, putting them in chunks;
+// return the number of chunks
+static unsigned int split_chunks(const char *text, size_t len,
+				 unsigned int max_chunks, chunk_t *chunks)
+{
+    unsigned int n = 0;
+    size_t start = 0;
+    size_t size = len / max_chunks;
+    if (size < PARALLEL_LEX_MIN_CHUNK) {
+	size = PARALLEL_LEX_MIN_CHUNK;
+    }
+    while (start < len) {
+	size_t end = len;
+	if (n + 1 < max_chunks && len - start > size) {
+	    // end just after the first newline past the chunk's size
+	    const char *nl = memchr(text + start + size, '\n',
+				    len - start - size);
+	    if (nl != NULL) {
+		end = (nl - text) + 1;
+	    }
+	}
+	memset(&chunks[n], 0, sizeof(chunk_t));
+	chunks[n].text = text;
+	chunks[n].start = start;
+	chunks[n].end = end;
+	n++;
+	start = end;
+    }
+    return n;
+}
+
+// Requires: file_id was returned by file_location_register for filename,
+//           and no lines (after the first) have been added for it
+// Read the tokens of the file named filename (and the lexical errors,
+// just as lexer_tokenize_all would) into ta, also adding its line starts,
+// using up to jobs threads (0 means one per processor).
+// The file is split at newlines into chunks that are lexed at the same time.
+// Return true if that was done; return false, doing nothing,
+// if the file cannot be split into at least two chunks
+// (e.g., if it is small or has no newlines), so it should be lexed
+// sequentially instead.
+bool parallel_lex_file(const char *filename, unsigned int file_id,
+		       unsigned int jobs, token_array *ta)
+{
+    if (jobs == 0) {
+	long procs = sysconf(_SC_NPROCESSORS_ONLN);
+	jobs = (procs > 0) ? (unsigned int) procs : 1;
+    }
+    if (jobs < 2) {
+	return false;
+    }
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+	bail_with_error("Cannot open %s", filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+	bail_with_error("Cannot find the size of %s", filename);
+    }
+    size_t len = (size_t) st.st_size;
+    if (len < 2 * PARALLEL_LEX_MIN_CHUNK) {
+	close(fd);
+	return false;
+    }
+    const char *text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+	return false;
+    }
+
+    chunk_t *chunks = (chunk_t *) malloc(jobs * sizeof(chunk_t));
+    if (chunks == NULL) {
+	bail_with_error("No space for the chunks of %s!", filename);
+    }
+    unsigned int n = split_chunks(text, len, jobs, chunks);
+    if (n < 2) {
+	// the file has no newlines where it could be split
+	free(chunks);
+	munmap((void *) text, len);
+	return false;
+    }
+
+    pthread_t *threads = (pthread_t *) malloc(n * sizeof(pthread_t));
+    if (threads == NULL) {
+	bail_with_error("No space for threads!");
+    }
+    for (unsigned int i = 0; i < n; i++) {
+	chunks[i].file_id = file_id;
+	if (pthread_create(&threads[i], NULL, lex_chunk_thread,
+			   &chunks[i]) != 0) {
+	    bail_with_error("Cannot create a thread to lex %s!", filename);
+	}
+    }
+    for (unsigned int i = 0; i < n; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    // stitch the chunks' results together, in order
+    for (unsigned int i = 0; i < n; i++) {
+	chunk_t *c = &chunks[i];
+	for (unsigned int l = 0; l < c->num_lines; l++) {
+	    file_location_add_line(file_id, c->line_starts[l]);
+	}
+	free(c->line_starts);
+	append_tokens(c, ta);
+    }
+    token_array_add(ta, YYEOF, file_location_make(file_id, (unsigned int) len),
+		    intern("", 0));
+    free(chunks);
+    munmap((void *) text, len);
+    return true;
+}
+
+// Requires: file_id was returned by file_location_register,
+//           start is 0 or just after a newline in text,
+//           and end is the length of text or just after a newline in it
+// Add the tokens (and lexical errors) of text from start up to end to ta,
+// as lexer_tokenize_all would (but without an end of file token),
+// put the offsets of the lines that start after start, up to end,
+// in *lines (a newly allocated array), and their number in *num_lines
+void parallel_lex_region(const char *text, size_t start, size_t end,
+			 unsigned int file_id, token_array *ta,
+			 unsigned int **lines, unsigned int *num_lines)
+{
+    chunk_t c;
+    memset(&c, 0, sizeof(chunk_t));
+    c.text = text;
+    c.start = start;
+    c.end = end;
+    c.file_id = file_id;
+    lex_chunk(&c);
+    append_tokens(&c, ta);
+    *lines = c.line_starts;
+    *num_lines = c.num_lines;
+}
@@ -0,0 +1,34 @@
+#ifndef _PARALLEL_LEXER_H
+#define _PARALLEL_LEXER_H
+#include <stdbool.h>
+#include "token_array.h"
+
+// Smallest chunk of a file that is worth lexing on a thread of its own
+#define PARALLEL_LEX_MIN_CHUNK 65536
+
+// Requires: file_id was returned by file_location_register for filename,
+//           and no lines (after the first) have been added for it
+// Read the tokens of the file named filename (and the lexical errors,
+// just as lexer_tokenize_all would) into ta, also adding its line starts,
+// using up to jobs threads (0 means one per processor).
+// The file is split at newlines into chunks that are lexed at the same time.
+// Return true if that was done; return false, doing nothing,
+// if the file cannot be split into at least two chunks
+// (e.g., if it is small or has no newlines), so it should be lexed
+// sequentially instead.
+extern bool parallel_lex_file(const char *filename, unsigned int file_id,
+			      unsigned int jobs, token_array *ta);
+
+// Requires: file_id was returned by file_location_register,
+//           start is 0 or just after a newline in text,
+//           and end is the length of text or just after a newline in it
+// Add the tokens (and lexical errors) of text from start up to end to ta,
+// as lexer_tokenize_all would (but without an end of file token),
+// put the offsets of the lines that start after start, up to end,
+// in *lines (a newly allocated array), and their number in *num_lines
+extern void parallel_lex_region(const char *text, size_t start, size_t end,
+				unsigned int file_id, token_array *ta,
+				unsigned int **lines,
+				unsigned int *num_lines);
+
+#endif
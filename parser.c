@@ -2,19 +2,184 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "parser.h"
+#include "lexer.h"
 #include "utilities.h"
 
+// The number of syntax errors after which parsing stops
+// (0 means that there is no limit)
+static unsigned int error_limit = 1;
+
+// The name of the file being parsed (for parsing skipped bodies)
+static char const *parsed_file_name = NULL;
+
+// Is a block being parsed alone (by parser_proc_body or parser_try_block)?
+static bool parsing_proc_body = false;
+
+// Are the bodies of the program's procedures skipped when it is parsed?
+static bool lazy_procs = false;
+
+// Have syntax errors been found in a skipped body (by parser_proc_body)?
+static bool proc_body_errors = false;
+
+// Set the number of syntax errors after which the parser stops,
+// 0 means report all syntax errors in the input.
+void parser_set_error_limit(unsigned int limit)
+{
+    error_limit = limit;
+}
+
+// Has the parser, having seen nerrs syntax errors, reached the error limit?
+bool parser_error_limit_reached(int nerrs)
+{
+    return error_limit != 0 && (unsigned int) nerrs >= error_limit;
+}
+
 // Parse a PL/0 program from the given file,
-// putting the AST into progast
-extern int yyparse (char const *file_name);
+// putting the AST into *parsed
+extern int yyparse (char const *file_name, block_t *parsed);
+
+// The number of syntax errors found by yyparse
+extern int yynerrs;
+
+// Parse a program using the tokens from the lexer, putting its AST in *prog;
+// return 0 if that worked, otherwise the exit code for the errors found
+static int parse(char const *file_name, block_t *prog)
+{
+    parsed_file_name = file_name;
+    // (yyparse does not reset the count, which parsing a body again needs)
+    yynerrs = 0;
+    block_t parsed;
+    int rc;
+    if (lazy_procs && !parsing_proc_body) {
+	// a misplaced "end" in a skipped body can make the program's errors
+	// show up elsewhere, so if there are any, it is parsed again
+	// without skipping, which reports them where they are
+	lexer_set_quiet(true);
+	rc = yyparse(file_name, &parsed);
+	lexer_set_quiet(false);
+	if (rc != 0 || yynerrs != 0 || lexer_has_errors()) {
+	    lexer_set_lazy_procs(false);
+	    lexer_rewind();
+	    yynerrs = 0;
+	    rc = yyparse(file_name, &parsed);
+	    lexer_set_lazy_procs(true);
+	}
+    } else {
+	rc = yyparse(file_name, &parsed);
+    }
+    if (rc != 0) {
+	return rc;
+    }
+    if (yynerrs != 0) {
+	// all errors were recovered from, but the AST is not usable
+	return EXIT_FAILURE;
+    }
+    // the lexer gave each skipped body to the parser as "begin end"
+    for (proc_decl_t *pd = parsed.proc_decls.proc_decls; pd != NULL;
+	 pd = pd->next) {
+	if (lexer_skipped_body(pd->block->file_loc,
+			       &pd->body_first, &pd->body_end)) {
+	    free(pd->block);
+	    pd->block = NULL;
+	}
+    }
+    *prog = parsed;
+    return 0;
+}
 
 // Parse a PL/0 program using the tokens from the lexer,
 // returning the program's AST
 extern block_t parseProgram(char const *file_name)
 {
-    int rc = yyparse(file_name);
+    block_t prog;
+    int rc = parse(file_name, &prog);
     if (rc != 0) {
 	exit(rc);
     }
-    return progast;
+    return prog;
+}
+
+// Like parseProgram, but if there are syntax errors,
+// return false (after reporting them) instead of exiting
+bool parser_try_program(char const *file_name, block_t *prog)
+{
+    return parse(file_name, prog) == 0;
+}
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called
+// Make parseProgram skip the bodies of the program's procedures
+// (those declared in its outermost block), leaving their blocks NULL.
+// Each body is parsed when it is first asked for by parser_proc_body;
+// syntax errors in a body are only found then.
+void parser_set_lazy_procs(bool lazy)
+{
+    lazy_procs = lazy;
+    lexer_set_lazy_procs(lazy);
+}
+
+// Requires: the tokens from first up to end are a block
+//           (from "begin" to its "end")
+// Parse the block made of those tokens, and return it (on the heap);
+// if there are syntax errors, return NULL (after reporting them)
+block_t *parser_try_block(unsigned int first, unsigned int end)
+{
+    block_t body;
+    lexer_parse_range(first, end);
+    parsing_proc_body = true;
+    int rc = parse(parsed_file_name, &body);
+    parsing_proc_body = false;
+    if (rc != 0) {
+	return NULL;
+    }
+    block_t *p = (block_t *) malloc(sizeof(block_t));
+    if (p == NULL) {
+	bail_with_error("Unable to allocate space for a %s!", "block_t");
+    }
+    *p = body;
+    return p;
+}
+
+// Return the block of pd, parsing it first if it was skipped;
+// if it has syntax errors, return NULL (after reporting them)
+block_t *parser_proc_body(proc_decl_t *pd)
+{
+    if (pd->block == NULL && pd->body_first != pd->body_end) {
+	pd->block = parser_try_block(pd->body_first, pd->body_end);
+	if (pd->block == NULL) {
+	    // (emptying its range so that they are not reported again)
+	    pd->body_end = pd->body_first;
+	    proc_body_errors = true;
+	}
+    }
+    return pd->block;
+}
+
+// Parse the skipped bodies of the procedures declared in prog's block;
+// return false if there were syntax errors (after reporting them,
+// stopping at the error limit)
+bool parser_proc_bodies(block_t *prog)
+{
+    unsigned int failed = 0;
+    for (proc_decl_t *pd = prog->proc_decls.proc_decls; pd != NULL;
+	 pd = pd->next) {
+	if (parser_proc_body(pd) == NULL
+	    && parser_error_limit_reached(++failed)) {
+	    break;
+	}
+    }
+    return failed == 0;
+}
+
+// Have syntax errors been found in a skipped body by parser_proc_body?
+bool parser_proc_body_errors(void)
+{
+    return proc_body_errors;
+}
+
+// Is a block being parsed alone (by parser_proc_body or parser_try_block)?
+// (The symbol table may then be in use, so the parse must not reset it.)
+bool parser_parsing_proc_body(void)
+{
+    return parsing_proc_body;
 }
@@ -2,12 +2,54 @@
 // This header file defines the externally-visible entry points to the parser
 #ifndef _PARSER_H
 #define _PARSER_H
+#include <stdbool.h>
 #include "ast.h"
 
-extern block_t progast;
+// Set the number of syntax errors after which the parser stops,
+// 0 means report all syntax errors in the input.
+// (The default, 1, stops at the first syntax error.)
+extern void parser_set_error_limit(unsigned int limit);
+
+// Has the parser, having seen nerrs syntax errors, reached the error limit?
+extern bool parser_error_limit_reached(int nerrs);
 
 // Parse a PL/0 program using the tokens from the lexer,
 // returning the program's AST
 extern block_t parseProgram(char const *file_name);
 
+// Like parseProgram, but if there are syntax errors,
+// return false (after reporting them) instead of exiting
+extern bool parser_try_program(char const *file_name, block_t *prog);
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called
+// Make parseProgram skip the bodies of the program's procedures
+// (those declared in its outermost block), leaving their blocks NULL.
+// Each body is parsed when it is first asked for by parser_proc_body;
+// syntax errors in a body are only found then.
+extern void parser_set_lazy_procs(bool lazy);
+
+// Return the block of pd, parsing it first if it was skipped;
+// if it has syntax errors, return NULL (after reporting them)
+extern block_t *parser_proc_body(proc_decl_t *pd);
+
+// Parse the skipped bodies of the procedures declared in prog's block;
+// return false if there were syntax errors (after reporting them,
+// stopping at the error limit)
+extern bool parser_proc_bodies(block_t *prog);
+
+// Have syntax errors been found in a skipped body by parser_proc_body?
+extern bool parser_proc_body_errors(void);
+
+// Requires: lexer_tokenize_all (or lexer_tokenize_all_parallel)
+//           has been called, and the tokens from first up to end
+//           are a block (from "begin" to its "end")
+// Parse the block made of those tokens, and return it (on the heap);
+// if there are syntax errors, return NULL (after reporting them)
+extern block_t *parser_try_block(unsigned int first, unsigned int end);
+
+// Is a block being parsed alone (by parser_proc_body or parser_try_block)?
+// (The symbol table may then be in use, so the parse must not reset it.)
+extern bool parser_parsing_proc_body(void);
+
 #endif
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "ptr_map.h"
+#include "utilities.h"
+
+// Return the index in the entries of m where key is (or would go)
+static size_t find(const ptr_map *m, const void *key)
+{
+    uint64_t h = (uint64_t) (uintptr_t) key * 0x9E3779B97F4A7C15ull;
+    size_t i = (size_t) (h >> 32) & (m->size - 1);
+    while (m->entries[i].key != NULL && m->entries[i].key != key) {
+	i = (i + 1) & (m->size - 1);
+    }
+    return i;
+}
+
+// Requires: key != NULL
+// Make key map to value in m (replacing what it mapped to, if anything)
+void ptr_map_put(ptr_map *m, const void *key, void *value)
+{
+    if (2 * (m->count + 1) > m->size) {
+	ptr_map_entry *old = m->entries;
+	size_t old_size = m->size;
+	m->size = (old_size == 0) ? 64 : 2 * old_size;
+	m->entries = (ptr_map_entry *) calloc(m->size, sizeof(ptr_map_entry));
+	if (m->entries == NULL) {
+	    bail_with_error("No space for a map of pointers!");
+	}
+	for (size_t i = 0; i < old_size; i++) {
+	    if (old[i].key != NULL) {
+		m->entries[find(m, old[i].key)] = old[i];
+	    }
+	}
+	free(old);
+    }
+    size_t i = find(m, key);
+    if (m->entries[i].key == NULL) {
+	m->count++;
+    }
+    m->entries[i].key = key;
+    m->entries[i].value = value;
+}
+
+// Return what key maps to in m (NULL if it is not in m)
+void *ptr_map_get(const ptr_map *m, const void *key)
+{
+    if (m->size == 0) {
+	return NULL;
+    }
+    return m->entries[find(m, key)].value;
+}
+
+// Remove all of the keys in m, and free its space
+void ptr_map_free(ptr_map *m)
+{
+    free(m->entries);
+    m->entries = NULL;
+    m->size = 0;
+    m->count = 0;
+}
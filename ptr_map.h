@@ -0,0 +1,31 @@
+#ifndef _PTR_MAP_H
+#define _PTR_MAP_H
+#include <stddef.h>
+
+// Maps from pointers (such as those to AST nodes, or to id_attrs)
+// to pointers, kept in open addressing hash tables.
+// A ptr_map that is all zeros (e.g., a static one) is empty.
+
+// an entry (its key is NULL if it is not in use)
+typedef struct {
+    const void *key;
+    void *value;
+} ptr_map_entry;
+
+typedef struct {
+    ptr_map_entry *entries;
+    size_t size;   // a power of 2 (or 0), kept over twice count
+    size_t count;  // the number of keys
+} ptr_map;
+
+// Requires: key != NULL
+// Make key map to value in m (replacing what it mapped to, if anything)
+extern void ptr_map_put(ptr_map *m, const void *key, void *value);
+
+// Return what key maps to in m (NULL if it is not in m)
+extern void *ptr_map_get(const ptr_map *m, const void *key);
+
+// Remove all of the keys in m, and free its space
+extern void ptr_map_free(ptr_map *m);
+
+#endif
@@ -1,301 +1,838 @@
+#define _POSIX_C_SOURCE 200809L
 #include "scope_check.h"
 #include "symtab.h"
 #include "ast.h"
+#include "id_attrs.h"
+#include "id_use.h"
+#include "ast_walk.h"
+#include "parser.h"
+#include "utilities.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* The number of errors after which checking stops (0 means no limit) */
+static unsigned int error_limit = 1;
+
+/* The number of errors reported so far */
+static unsigned int error_count = 0;
+
+/* Has a skipped procedure body turned out to have syntax errors?
+   (checking then stops, as it does at the error limit) */
+static bool syntax_errors = false;
+
+/* The number of threads that check sibling procedures (1 means no threads) */
+static unsigned int jobs = 1;
+
+/* The messages for the errors found while checking part of a program
+   on another thread (or for scope_check_program_parts); they are printed
+   (in source order) when all of the parts have been checked */
+typedef struct {
+    char *text;          /* the messages, each ending in a newline */
+    size_t len;          /* the length of text */
+    size_t size;         /* the allocated size of text */
+    file_location *locs; /* the location of each message */
+    unsigned int count;  /* the number of messages */
+    unsigned int locs_size; /* the allocated number of locs */
+} diagnostics_t;
+
+/* Where the calling thread's errors go; NULL means print them on stdout */
+static _Thread_local diagnostics_t *diagnostics = NULL;
+
+/* Is the calling thread one of those checking sibling procedures? */
+static _Thread_local bool is_worker = false;
+
+void scope_check_set_error_limit(unsigned int limit) {
+    error_limit = limit;
+}
 
-static int has_error = 0;
-
-void scope_check_program(block_t program) {
-    /* Initialize the symbol table */
-    symtab_initialize();
+void scope_check_set_jobs(unsigned int n) {
+    if (n == 0) {
+        long procs = sysconf(_SC_NPROCESSORS_ONLN);
+        n = (procs > 0) ? (unsigned int)procs : 1;
+    }
+    jobs = n;
+}
 
-    /* Reset the error flag */
-    has_error = 0;
+unsigned int scope_check_error_count(void) {
+    return error_count;
+}
 
-    /* Start scope checking from the program's block */
-    scope_check_block(&program);
+/* Has the error limit been reached?
+   (on a worker thread, counting the errors known when it started) */
+static int has_error(void) {
+    if (syntax_errors) return true;
+    unsigned int count = error_count;
+    if (diagnostics != NULL) {
+        count += diagnostics->count;
+    }
+    return error_limit != 0 && count >= error_limit;
+}
 
-    /* Finalize the symbol table */
-    symtab_finalize();
+/* Append the message given by fmt and args to the calling thread's
+   diagnostics */
+static void diagnostics_vappend(const char *fmt, va_list args) {
+    va_list args2;
+    va_copy(args2, args);
+    int n = vsnprintf(NULL, 0, fmt, args2);
+    va_end(args2);
+    if (n < 0) {
+        bail_with_error("Cannot format an error message!");
+    }
+    if (diagnostics->len + n + 1 > diagnostics->size) {
+        size_t size = 2 * diagnostics->size + n + 1;
+        diagnostics->text = realloc(diagnostics->text, size);
+        if (diagnostics->text == NULL) {
+            bail_with_error("No space for error messages!");
+        }
+        diagnostics->size = size;
+    }
+    vsnprintf(diagnostics->text + diagnostics->len, n + 1, fmt, args);
+    diagnostics->len += n;
 }
 
-void scope_check_block(block_t *block) {
-    if (has_error) return;
-    if (block == NULL) return;
+/* Append the given message to the calling thread's diagnostics */
+static void diagnostics_append(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    diagnostics_vappend(fmt, args);
+    va_end(args);
+}
 
-    /* Enter a new scope */
-    symtab_enter_scope();
+/* Print an error message for the given file location on stdout
+   (in the format "filename: line N message") and count it;
+   on a worker thread, the message is saved in its diagnostics instead
+   (and its location with it, as the line is found when it is printed) */
+static void scope_error(file_location file_loc, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (diagnostics != NULL) {
+        diagnostics_vappend(fmt, args);
+        diagnostics_append("\n");
+        if (diagnostics->count == diagnostics->locs_size) {
+            diagnostics->locs_size = 2 * diagnostics->locs_size + 8;
+            diagnostics->locs = realloc(diagnostics->locs,
+                                        diagnostics->locs_size
+                                        * sizeof(file_location));
+            if (diagnostics->locs == NULL) {
+                bail_with_error("No space for error messages!");
+            }
+        }
+        diagnostics->locs[diagnostics->count++] = file_loc;
+    } else {
+        printf("%s: line %u ", file_location_filename(file_loc),
+               file_location_line(file_loc));
+        vprintf(fmt, args);
+        printf("\n");
+        error_count++;
+    }
+    va_end(args);
+}
 
-    /* Check declarations */
-    scope_check_const_decls(&block->const_decls);
-    if (has_error) return;
-    scope_check_var_decls(&block->var_decls);
-    if (has_error) return;
-    scope_check_proc_decls(&block->proc_decls);
-    if (has_error) return;
+/* Print the messages in d on stdout (as scope_error does),
+   counting them, until the error limit is reached */
+static void diagnostics_print(diagnostics_t *d) {
+    const char *msg = d->text;
+    for (unsigned int m = 0; m < d->count && !has_error(); m++) {
+        const char *end = strchr(msg, '\n');
+        printf("%s: line %u ", file_location_filename(d->locs[m]),
+               file_location_line(d->locs[m]));
+        fwrite(msg, 1, end - msg + 1, stdout);
+        error_count++;
+        msg = end + 1;
+    }
+}
 
-    /* Check statements */
-    scope_check_stmts(&block->stmts);
+/* Remove all of the messages in d (keeping its space) */
+static void diagnostics_clear(diagnostics_t *d) {
+    d->len = 0;
+    d->count = 0;
+}
 
-    /* Exit the scope */
-    symtab_exit_scope();
+/* Return the offset in d's text of its m-th message */
+static size_t diagnostics_offset(const diagnostics_t *d, unsigned int m) {
+    const char *msg = d->text;
+    for (unsigned int i = 0; i < m; i++) {
+        msg = strchr(msg, '\n') + 1;
+    }
+    return msg - d->text;
 }
 
-void scope_check_const_decls(const_decls_t *decls) {
-    if (has_error) return;
-    if (decls == NULL || decls->start == NULL) return;
+/* Remove the messages in d after the first count of them */
+static void diagnostics_truncate(diagnostics_t *d, unsigned int count) {
+    if (count < d->count) {
+        d->len = diagnostics_offset(d, count);
+        d->count = count;
+    }
+}
 
-    const_decl_t *current_decl = decls->start;
-    while (current_decl != NULL) {
-        scope_check_const_decl(current_decl);
-        if (has_error) return;
-        current_decl = current_decl->next;
+/* Replace the messages in d whose locations are from start up to (not
+   including) end by those in with (which are all located there) */
+static void diagnostics_replace(diagnostics_t *d, file_location start,
+                                file_location end,
+                                const diagnostics_t *with) {
+    unsigned int first = 0;
+    while (first < d->count && d->locs[first] < start) {
+        first++;
     }
+    unsigned int last = first;
+    while (last < d->count && d->locs[last] < end) {
+        last++;
+    }
+    size_t from = diagnostics_offset(d, first);
+    size_t to = diagnostics_offset(d, last);
+    size_t len = d->len - (to - from) + with->len;
+    if (len + 1 > d->size) {
+        d->size = 2 * d->size + with->len + 1;
+        d->text = realloc(d->text, d->size);
+        if (d->text == NULL) {
+            bail_with_error("No space for error messages!");
+        }
+    }
+    unsigned int count = d->count - (last - first) + with->count;
+    if (count > d->locs_size) {
+        d->locs_size = 2 * d->locs_size + with->count;
+        d->locs = realloc(d->locs, d->locs_size * sizeof(file_location));
+        if (d->locs == NULL) {
+            bail_with_error("No space for error messages!");
+        }
+    }
+    memmove(d->text + from + with->len, d->text + to, d->len - to);
+    memmove(d->locs + first + with->count, d->locs + last,
+            (d->count - last) * sizeof(file_location));
+    if (with->count > 0) {
+        memcpy(d->text + from, with->text, with->len);
+        memcpy(d->locs + first, with->locs,
+               with->count * sizeof(file_location));
+    }
+    d->len = len;
+    d->count = count;
 }
 
-void scope_check_const_decl(const_decl_t *decl) {
-    if (has_error) return;
-    if (decl == NULL) return;
+/* Free the space used by d */
+static void diagnostics_free(diagnostics_t *d) {
+    free(d->text);
+    free(d->locs);
+}
 
-    const_def_list_t *def_list = &decl->const_def_list;
-    const_def_t *def = def_list->start;
-    while (def != NULL) {
-        scope_check_const_def(def);
-        if (has_error) return;
-        def = def->next;
-    }
+/* Return the name of the given kind of symbol, as used in error messages */
+static const char *sym_kind_name(sym_kind_t kind) {
+    return kind == SYM_CONST ? "constant" :
+           kind == SYM_VAR ? "variable" : "procedure";
 }
 
-void scope_check_const_def(const_def_t *def) {
-    if (has_error) return;
-    if (def == NULL) return;
+/* Declare name, of the given kind (and value, for constants),
+   in the current scope and return the id_use for the declaration itself */
+static id_use *declare(const char *name, sym_kind_t kind, int value,
+                       file_location file_loc) {
+    id_kind k = kind == SYM_CONST ? constant_idk :
+                kind == SYM_VAR ? variable_idk : procedure_idk;
+    id_attrs *attrs = create_id_attrs(file_loc, k, symtab_scope_loc_count());
+    symtab_insert(name, kind, value, attrs);
+    return id_use_create(attrs, 0);
+}
+
+/* Look up name and return its entry, or NULL if it is not declared;
+   for a declared name, also set *idu to its resolved id_use */
+static sym_entry_t *resolve(const char *name, id_use **idu) {
+    unsigned int levels_outward;
+    sym_entry_t *entry = symtab_lookup_levels(name, &levels_outward);
+    if (entry != NULL) {
+        *idu = id_use_create(entry->attrs, levels_outward);
+    }
+    return entry;
+}
 
+/* Check the declaration of a constant */
+static void check_const_def(const_def_t *def) {
     ident_t *ident = &def->ident;
     number_t *number = &def->number;
 
-    /* Check for duplicate declarations */
+    /* Check for duplicate declarations (keeping the first one) */
     sym_entry_t *entry = symtab_lookup_current_scope(ident->name);
     if (entry != NULL) {
-        if (!has_error) {
-            printf("%s: line %u constant \"%s\" is already declared as a %s\n",
-                   ident->file_loc->filename, ident->file_loc->line, ident->name,
-                   entry->kind == SYM_CONST ? "constant" :
-                   entry->kind == SYM_VAR ? "variable" : "procedure");
-            has_error = 1;
-            return;
-        }
+        scope_error(ident->file_loc,
+                    "constant \"%s\" is already declared as a %s",
+                    ident->name, sym_kind_name(entry->kind));
     } else {
-        symtab_insert(ident->name, SYM_CONST, number->value, ident->file_loc);
+        ident->idu = declare(ident->name, SYM_CONST, number->value,
+                             ident->file_loc);
     }
 }
 
-void scope_check_var_decls(var_decls_t *decls) {
-    if (has_error) return;
-    if (decls == NULL || decls->var_decls == NULL) return;
+/* Check the declaration of a variable (an ident in a var_decl) */
+static void check_var_ident(ident_t *ident) {
+    /* Check for duplicate declarations (keeping the first one) */
+    sym_entry_t *entry = symtab_lookup_current_scope(ident->name);
+    if (entry != NULL) {
+        scope_error(ident->file_loc,
+                    "variable \"%s\" is already declared as a %s",
+                    ident->name, sym_kind_name(entry->kind));
+    } else {
+        ident->idu = declare(ident->name, SYM_VAR, 0, ident->file_loc);
+    }
+}
 
-    var_decl_t *current_decl = decls->var_decls;
-    while (current_decl != NULL) {
-        scope_check_var_decl(current_decl);
-        if (has_error) return;
-        current_decl = current_decl->next;
+/* Check the declaration of a procedure (but not its block) */
+static void check_proc_name(proc_decl_t *decl) {
+    const char *name = decl->name;
+    file_location file_loc = decl->file_loc;
+
+    /* Check for duplicate declarations (keeping the first one) */
+    sym_entry_t *entry = symtab_lookup_current_scope(name);
+    if (entry != NULL) {
+        scope_error(file_loc,
+                    "procedure \"%s\" is already declared as a %s",
+                    name, sym_kind_name(entry->kind));
+    } else {
+        decl->idu = declare(name, SYM_PROC, 0, file_loc);
     }
 }
 
-void scope_check_var_decl(var_decl_t *decl) {
-    if (has_error) return;
-    if (decl == NULL) return;
-
-    ident_list_t *idents = &decl->ident_list;
-    ident_t *ident = idents->start;
-    while (ident != NULL) {
-        /* Check for duplicate declarations */
-        sym_entry_t *entry = symtab_lookup_current_scope(ident->name);
-        if (entry != NULL) {
-            if (!has_error) {
-                printf("%s: line %u variable \"%s\" is already declared as a %s\n",
-                       ident->file_loc->filename, ident->file_loc->line, ident->name,
-                       entry->kind == SYM_CONST ? "constant" :
-                       entry->kind == SYM_VAR ? "variable" : "procedure");
-                has_error = 1;
-                return;
-            }
-        } else {
-            symtab_insert(ident->name, SYM_VAR, 0, ident->file_loc);
-        }
-        ident = ident->next;
+/* Check the name assigned to (but not the expression) */
+static void check_assign_name(assign_stmt_t *stmt) {
+    const char *name = stmt->name;
+    file_location file_loc = stmt->file_loc;
+
+    sym_entry_t *entry = resolve(name, &stmt->idu);
+    if (entry == NULL) {
+        scope_error(file_loc, "identifier \"%s\" is not declared!", name);
+    } else if (entry->kind == SYM_PROC) {
+        scope_error(file_loc, "\"%s\" has an unsupported kind.", name);
     }
+    /* Assignment to a constant is ignored?; no error is reported */
 }
 
-void scope_check_proc_decls(proc_decls_t *decls) {
-    if (has_error) return;
-    if (decls == NULL || decls->proc_decls == NULL) return;
+/* Check the name of the procedure called */
+static void check_call_name(call_stmt_t *stmt) {
+    const char *name = stmt->name;
+    file_location file_loc = stmt->file_loc;
 
-    proc_decl_t *current_decl = decls->proc_decls;
-    while (current_decl != NULL) {
-        scope_check_proc_decl(current_decl);
-        if (has_error) return;
-        current_decl = current_decl->next;
+    sym_entry_t *entry = resolve(name, &stmt->idu);
+    if (entry == NULL) {
+        scope_error(file_loc, "procedure \"%s\" is not declared!", name);
+    } else if (entry->kind != SYM_PROC) {
+        scope_error(file_loc, "\"%s\" is not a procedure", name);
     }
 }
 
-void scope_check_proc_decl(proc_decl_t *decl) {
-    if (has_error) return;
-    if (decl == NULL) return;
+/* Check the name of the variable read */
+static void check_read_name(read_stmt_t *stmt) {
+    const char *name = stmt->name;
+    file_location file_loc = stmt->file_loc;
 
-    const char *name = decl->name;
-    file_location *file_loc = decl->file_loc;
+    sym_entry_t *entry = resolve(name, &stmt->idu);
+    if (entry == NULL) {
+        scope_error(file_loc, "identifier \"%s\" is not declared!", name);
+    } else if (entry->kind != SYM_VAR) {
+        scope_error(file_loc, "\"%s\" is not a variable", name);
+    }
+}
 
-    /* Check for duplicate declarations */
-    sym_entry_t *entry = symtab_lookup_current_scope(name);
-    if (entry != NULL) {
-        if (!has_error) {
-            printf("%s: line %u procedure \"%s\" is already declared as a %s\n",
-                   file_loc->filename, file_loc->line, name,
-                   entry->kind == SYM_CONST ? "constant" :
-                   entry->kind == SYM_VAR ? "variable" : "procedure");
-            has_error = 1;
-            return;
-        }
-    } else {
-        symtab_insert(name, SYM_PROC, 0, file_loc);
+/* Check an identifier used in an expression */
+static void check_ident_use(ident_t *ident) {
+    sym_entry_t *entry = resolve(ident->name, &ident->idu);
+    if (entry == NULL) {
+        scope_error(ident->file_loc,
+                    "identifier \"%s\" is not declared!", ident->name);
     }
+}
 
-    /* Check the block within the procedure */
-    scope_check_block(decl->block);
+static void scope_check_walk(void *node, AST_type t);
+
+/* A procedure whose body is checked on a worker thread */
+typedef struct {
+    proc_decl_t *decl;
+    symtab_view_t view;     /* the scopes in effect after its declaration */
+    diagnostics_t diags;    /* the errors found in its declaration and body */
+} proc_check_t;
+
+/* The procedures shared by the worker threads */
+typedef struct {
+    proc_check_t *procs;
+    unsigned int count;
+    atomic_uint next;       /* index of the next procedure to check */
+} proc_batch_t;
+
+/* The worker threads' main function: check the bodies of the batch's
+   procedures (taking the next unchecked one until there are none left) */
+static void *check_proc_bodies(void *arg) {
+    proc_batch_t *batch = (proc_batch_t *)arg;
+    unsigned int i;
+    is_worker = true;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        proc_check_t *pc = &batch->procs[i];
+        diagnostics = &pc->diags;
+        symtab_enter_view(pc->view);
+        scope_check_walk(pc->decl->block, block_ast);
+        symtab_finalize();
+    }
+    diagnostics = NULL;
+    symtab_destroy();
+    return NULL;
 }
 
-void scope_check_stmts(stmts_t *stmts) {
-    if (has_error) return;
-    if (stmts == NULL) return;
+/* Check the sibling procedures in decls, declaring their names in the
+   current scope (in order, on this thread) and then checking their bodies
+   on worker threads, each body against a read-only view of the scopes
+   in effect after its procedure's declaration (as in a sequential check).
+   Return false if this was not done, as there are too few procedures. */
+static bool check_procs_in_parallel(proc_decls_t *decls) {
+    unsigned int count = 0;
+    for (proc_decl_t *pd = decls->proc_decls; pd != NULL; pd = pd->next) {
+        count++;
+    }
+    if (count < 2) return false;
 
-    if (stmts->stmts_kind == empty_stmts_e) {
-        return;
+    proc_batch_t batch;
+    batch.procs = calloc(count, sizeof(proc_check_t));
+    if (batch.procs == NULL) {
+        bail_with_error("No space to check procedures!");
+    }
+    batch.count = count;
+    atomic_init(&batch.next, 0);
+
+    /* Declare the names, saving any errors with the procedure's */
+    unsigned int i = 0;
+    for (proc_decl_t *pd = decls->proc_decls; pd != NULL; pd = pd->next) {
+        proc_check_t *pc = &batch.procs[i++];
+        pc->decl = pd;
+        /* bodies can only be parsed on this thread */
+        if (!syntax_errors && parser_proc_body(pd) == NULL) {
+            syntax_errors = true;
+        }
+        diagnostics = &pc->diags;
+        if (!has_error()) {
+            check_proc_name(pd);
+        }
+        pc->view = symtab_view();
+    }
+    diagnostics = NULL;
+
+    /* Check the bodies, while this thread's scopes stay unchanged */
+    unsigned int nthreads = (jobs < count) ? jobs : count;
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        bail_with_error("No space for threads!");
     }
+    for (unsigned int t = 0; t < nthreads; t++) {
+        if (pthread_create(&threads[t], NULL, check_proc_bodies, &batch) != 0) {
+            bail_with_error("Cannot create a thread to check procedures!");
+        }
+    }
+    for (unsigned int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
 
-    stmt_t *stmt = stmts->stmt_list.start;
-    while (stmt != NULL) {
-        scope_check_stmt(stmt);
-        if (has_error) break;  // Stop checking further statements after an error
-        stmt = stmt->next;
+    /* Print the errors in source order, up to the error limit */
+    for (i = 0; i < count; i++) {
+        diagnostics_print(&batch.procs[i].diags);
+        diagnostics_free(&batch.procs[i].diags);
     }
+    free(batch.procs);
+    return true;
 }
 
-void scope_check_stmt(stmt_t *stmt) {
-    if (has_error) return;
-    if (stmt == NULL) return;
+/* The walk's pre callback: check the names declared or used
+   directly in node, and say whether to go on to its children */
+static bool scope_check_pre(void *node, AST_type t, void *data) {
+    if (has_error()) return false;
 
-    switch (stmt->stmt_kind) {
-        case assign_stmt:
-            scope_check_assign_stmt(&stmt->data.assign_stmt);
+    switch (t) {
+        case block_ast:
+            symtab_enter_scope();
             break;
-        case call_stmt:
-            scope_check_call_stmt(&stmt->data.call_stmt);
+        case const_def_ast:
+            check_const_def((const_def_t *)node);
             break;
-        case block_stmt:
-            scope_check_block_stmt(&stmt->data.block_stmt);
+        case ident_ast:
+            check_var_ident((ident_t *)node);
             break;
-        case if_stmt:
-            scope_check_if_stmt(&stmt->data.if_stmt);
+        case proc_decls_ast:
+            /* sibling procedures are checked in parallel if asked for */
+            if (jobs > 1 && !is_worker && diagnostics == NULL
+                && check_procs_in_parallel((proc_decls_t *)node)) {
+                return false;
+            }
             break;
-        case while_stmt:
-            scope_check_while_stmt(&stmt->data.while_stmt);
+        case proc_decl_ast:
+            /* (parsing a skipped body here, so no more is checked
+               if it has syntax errors) */
+            if (parser_proc_body((proc_decl_t *)node) == NULL) {
+                syntax_errors = true;
+                return false;
+            }
+            check_proc_name((proc_decl_t *)node);
             break;
-        case read_stmt:
-            scope_check_read_stmt(&stmt->data.read_stmt);
+        case stmt_ast: {
+            stmt_t *stmt = (stmt_t *)node;
+            switch (stmt->stmt_kind) {
+                case assign_stmt:
+                    check_assign_name(&stmt->data.assign_stmt);
+                    break;
+                case call_stmt:
+                    check_call_name(&stmt->data.call_stmt);
+                    break;
+                case read_stmt:
+                    check_read_name(&stmt->data.read_stmt);
+                    break;
+                default:
+                    /* the other statements only have names in children */
+                    break;
+            }
             break;
-        case print_stmt:
-            scope_check_print_stmt(&stmt->data.print_stmt);
+        }
+        case expr_ast: {
+            expr_t *expr = (expr_t *)node;
+            if (expr->expr_kind == expr_ident) {
+                check_ident_use(&expr->data.ident);
+            }
             break;
+        }
         default:
-            if (!has_error) {
-                printf("Unknown statement kind.\n");
-                has_error = 1;
-            }
             break;
     }
+    return true;
 }
 
-void scope_check_assign_stmt(assign_stmt_t *stmt) {
-    if (has_error) return;
-    if (stmt == NULL) return;
+/* The walk's post callback: record the size of a block's frame,
+   and leave its scope (which is done even if the error limit
+   has been reached since, to keep the scopes balanced) */
+static void scope_check_post(void *node, AST_type t, void *data) {
+    if (t == block_ast) {
+        ((block_t *)node)->frame_size = symtab_scope_loc_count();
+        symtab_exit_scope();
+    }
+}
 
-    const char *name = stmt->name;
-    file_location *file_loc = stmt->file_loc;
+/* Scope check node, which is an AST of type t (see ast_walk.h) */
+static void scope_check_walk(void *node, AST_type t) {
+    ast_visitor v = { scope_check_pre, NULL, scope_check_post, NULL };
+    if (node == NULL) return;
+    if (!ast_walk(node, t, &v)) {
+        syntax_errors = true;
+    }
+}
 
-    sym_entry_t *entry = symtab_lookup(name);
-    if (entry == NULL) {
-        if (!has_error) {
-            printf("%s: line %u identifier \"%s\" is not declared!\n",
-                   file_loc->filename, file_loc->line, name);
-            has_error = 1;
-            return;
+block_t scope_check_program(block_t program) {
+    /* Initialize the symbol table */
+    symtab_initialize();
+
+    /* Reset the error count */
+    error_count = 0;
+    syntax_errors = false;
+
+    /* Start scope checking from the program's block */
+    scope_check_block(&program);
+
+    /* Finalize the symbol table */
+    symtab_finalize();
+
+    return program;
+}
+
+/* A procedure declared in the outermost block of a program
+   checked by scope_check_program_parts */
+typedef struct {
+    proc_decl_t *decl;
+    symtab_view_t view;       /* the scopes in effect after its declaration */
+    diagnostics_t name_diags; /* the errors found in its declaration */
+    diagnostics_t body_diags; /* and in its body */
+} part_proc_t;
+
+struct scope_parts_s {
+    block_t *program;
+    diagnostics_t decls;      /* errors in the program's own declarations
+                                 of constants and variables */
+    part_proc_t *procs;       /* its procedures, in order */
+    unsigned int count;
+    diagnostics_t stmts;      /* errors in its statements */
+};
+
+/* Check the body of the procedure parts->procs[i] on this thread,
+   against the scopes that were in effect after its declaration */
+static void check_part_proc(scope_parts_t *parts, unsigned int i) {
+    part_proc_t *pp = &parts->procs[i];
+    symtab_view_t all = symtab_set_view(pp->view);
+    diagnostics = &pp->body_diags;
+    scope_check_walk(pp->decl->block, block_ast);
+    diagnostics = NULL;
+    symtab_set_view(all);
+}
+
+scope_parts_t *scope_check_program_parts(block_t *program) {
+    scope_parts_t *parts = calloc(1, sizeof(scope_parts_t));
+    if (parts == NULL) {
+        bail_with_error("No space to check a program!");
+    }
+    parts->program = program;
+    for (proc_decl_t *pd = program->proc_decls.proc_decls; pd != NULL;
+         pd = pd->next) {
+        parts->count++;
+    }
+    parts->procs = calloc(parts->count + 1, sizeof(part_proc_t));
+    if (parts->procs == NULL) {
+        bail_with_error("No space to check a program!");
+    }
+
+    /* The program's scope stays in effect, for scope_check_block_again */
+    symtab_initialize();
+    error_count = 0;
+    syntax_errors = false;
+    symtab_enter_scope();
+    diagnostics = &parts->decls;
+    scope_check_walk(&program->const_decls, const_decls_ast);
+    scope_check_walk(&program->var_decls, var_decls_ast);
+    program->frame_size = symtab_scope_loc_count();
+
+    /* Declare the procedures' names, then check their bodies,
+       each as it would be checked right after its declaration */
+    unsigned int i = 0;
+    for (proc_decl_t *pd = program->proc_decls.proc_decls; pd != NULL;
+         pd = pd->next) {
+        part_proc_t *pp = &parts->procs[i++];
+        pp->decl = pd;
+        if (!syntax_errors && parser_proc_body(pd) == NULL) {
+            syntax_errors = true;
         }
+        diagnostics = &pp->name_diags;
+        if (!has_error()) {
+            check_proc_name(pd);
+        }
+        pp->view = symtab_view();
+    }
+    for (i = 0; i < parts->count; i++) {
+        check_part_proc(parts, i);
     }
 
-    /* If the identifier is a constant, silently ignore the assignment */
-    if (entry->kind == SYM_CONST) {
-        /* Assignment to a constant is ignored?; no error is reported */
-        scope_check_expr(stmt->expr);
-    } else if (entry->kind == SYM_VAR) {
-        /* For variables, proceed to check the expression */
-        scope_check_expr(stmt->expr);
-    } else {
-        /* Handle other kinds if necessary */
-        if (!has_error) {
-            printf("%s: line %u \"%s\" has an unsupported kind.\n",
-                   file_loc->filename, file_loc->line, name);
-            has_error = 1;
-            return;
+    diagnostics = &parts->stmts;
+    scope_check_walk(&program->stmts, stmts_ast);
+    diagnostics = NULL;
+    return parts;
+}
+
+/* Declare again, in the current scope, the constants and variables
+   declared in block, and its procedures up to through (or all of them,
+   if through is NULL), with the attributes that checking them gave */
+static void declare_again(block_t *block, proc_decl_t *through) {
+    for (const_decl_t *cd = block->const_decls.start; cd != NULL;
+         cd = cd->next) {
+        for (const_def_t *def = cd->const_def_list.start; def != NULL;
+             def = def->next) {
+            if (def->ident.idu != NULL) {
+                symtab_insert(def->ident.name, SYM_CONST, def->number.value,
+                              def->ident.idu->attrs);
+            }
+        }
+    }
+    for (var_decl_t *vd = block->var_decls.var_decls; vd != NULL;
+         vd = vd->next) {
+        for (ident_t *id = vd->ident_list.start; id != NULL; id = id->next) {
+            if (id->idu != NULL) {
+                symtab_insert(id->name, SYM_VAR, 0, id->idu->attrs);
+            }
+        }
+    }
+    for (proc_decl_t *pd = block->proc_decls.proc_decls; pd != NULL;
+         pd = pd->next) {
+        if (pd->idu != NULL) {
+            symtab_insert(pd->name, SYM_PROC, 0, pd->idu->attrs);
+        }
+        if (pd == through) {
+            break;
         }
     }
 }
 
-void scope_check_call_stmt(call_stmt_t *stmt) {
-    if (has_error) return;
-    if (stmt == NULL) return;
+void scope_check_block_again(scope_parts_t *parts, unsigned int part,
+                             const scope_step_t *steps, unsigned int count,
+                             block_t *blk, file_location end) {
+    /* (errors printed since then must not stop the walk) */
+    error_count = 0;
+    diagnostics_t *d = (part < parts->count) ? &parts->procs[part].body_diags
+                                             : &parts->stmts;
+    if (error_limit != 0 && d->count >= error_limit) {
+        /* the errors after blk may have been left out */
+        diagnostics_clear(d);
+        if (part < parts->count) {
+            check_part_proc(parts, part);
+        } else {
+            diagnostics = d;
+            scope_check_walk(&parts->program->stmts, stmts_ast);
+            diagnostics = NULL;
+        }
+        return;
+    }
 
-    const char *name = stmt->name;
-    file_location *file_loc = stmt->file_loc;
+    /* the errors before blk count towards the limit while checking it */
+    unsigned int before = 0;
+    while (before < d->count && d->locs[before] < blk->file_loc) {
+        before++;
+    }
+    symtab_view_t all = symtab_view();
+    if (part < parts->count) {
+        symtab_set_view(parts->procs[part].view);
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        symtab_enter_scope();
+        declare_again(steps[i].block, steps[i].through);
+    }
+    diagnostics_t found = { NULL, 0, 0, NULL, 0, 0 };
+    diagnostics = &found;
+    error_count = before;
+    scope_check_walk(blk, block_ast);
+    error_count = 0;
+    diagnostics = NULL;
+    for (unsigned int i = 0; i < count; i++) {
+        symtab_exit_scope();
+    }
+    symtab_set_view(all);
 
-    sym_entry_t *entry = symtab_lookup(name);
-    if (entry == NULL) {
-        if (!has_error) {
-            printf("%s: line %u procedure \"%s\" is not declared!\n",
-                   file_loc->filename, file_loc->line, name);
-            has_error = 1;
-            return;
-        }
-    } else if (entry->kind != SYM_PROC) {
-        if (!has_error) {
-            printf("%s: line %u \"%s\" is not a procedure\n",
-                   file_loc->filename, file_loc->line, name);
-            has_error = 1;
-            return;
+    diagnostics_replace(d, blk->file_loc, end, &found);
+    diagnostics_free(&found);
+    if (error_limit != 0) {
+        diagnostics_truncate(d, error_limit);
+    }
+}
+
+void scope_parts_print_errors(scope_parts_t *parts) {
+    error_count = 0;
+    diagnostics_print(&parts->decls);
+    for (unsigned int i = 0; i < parts->count; i++) {
+        diagnostics_print(&parts->procs[i].name_diags);
+        diagnostics_print(&parts->procs[i].body_diags);
+    }
+    diagnostics_print(&parts->stmts);
+}
+
+/* Call f for each of the messages in d */
+static void diagnostics_for_each(diagnostics_t *d, scope_error_fn f,
+                                 void *data) {
+    const char *msg = d->text;
+    for (unsigned int m = 0; m < d->count; m++) {
+        const char *end = strchr(msg, '\n');
+        f(d->locs[m], msg, end - msg, data);
+        msg = end + 1;
+    }
+}
+
+void scope_parts_for_each_error(scope_parts_t *parts, scope_error_fn f,
+                                void *data) {
+    diagnostics_for_each(&parts->decls, f, data);
+    for (unsigned int i = 0; i < parts->count; i++) {
+        diagnostics_for_each(&parts->procs[i].name_diags, f, data);
+        diagnostics_for_each(&parts->procs[i].body_diags, f, data);
+    }
+    diagnostics_for_each(&parts->stmts, f, data);
+}
+
+/* Move the locations in d that are at or after from by delta bytes */
+static void diagnostics_move(diagnostics_t *d, file_location from,
+                             int delta) {
+    for (unsigned int m = 0; m < d->count; m++) {
+        if (d->locs[m] >= from) {
+            d->locs[m] += delta;
         }
     }
 }
 
+void scope_parts_move_errors(scope_parts_t *parts, file_location from,
+                             int delta) {
+    diagnostics_move(&parts->decls, from, delta);
+    for (unsigned int i = 0; i < parts->count; i++) {
+        diagnostics_move(&parts->procs[i].name_diags, from, delta);
+        diagnostics_move(&parts->procs[i].body_diags, from, delta);
+    }
+    diagnostics_move(&parts->stmts, from, delta);
+}
+
+void scope_parts_destroy(scope_parts_t *parts) {
+    symtab_finalize();
+    diagnostics_free(&parts->decls);
+    for (unsigned int i = 0; i < parts->count; i++) {
+        diagnostics_free(&parts->procs[i].name_diags);
+        diagnostics_free(&parts->procs[i].body_diags);
+    }
+    diagnostics_free(&parts->stmts);
+    free(parts->procs);
+    free(parts);
+}
+
+void scope_check_block(block_t *block) {
+    scope_check_walk(block, block_ast);
+}
+
+void scope_check_const_decls(const_decls_t *decls) {
+    scope_check_walk(decls, const_decls_ast);
+}
+
+void scope_check_const_decl(const_decl_t *decl) {
+    scope_check_walk(decl, const_decl_ast);
+}
+
+void scope_check_const_def(const_def_t *def) {
+    scope_check_walk(def, const_def_ast);
+}
+
+void scope_check_var_decls(var_decls_t *decls) {
+    scope_check_walk(decls, var_decls_ast);
+}
+
+void scope_check_var_decl(var_decl_t *decl) {
+    scope_check_walk(decl, var_decl_ast);
+}
+
+void scope_check_proc_decls(proc_decls_t *decls) {
+    scope_check_walk(decls, proc_decls_ast);
+}
+
+void scope_check_proc_decl(proc_decl_t *decl) {
+    scope_check_walk(decl, proc_decl_ast);
+}
+
+void scope_check_stmts(stmts_t *stmts) {
+    scope_check_walk(stmts, stmts_ast);
+}
+
+void scope_check_stmt(stmt_t *stmt) {
+    scope_check_walk(stmt, stmt_ast);
+}
+
+void scope_check_assign_stmt(assign_stmt_t *stmt) {
+    if (has_error()) return;
+    if (stmt == NULL) return;
+
+    check_assign_name(stmt);
+    scope_check_expr(stmt->expr);
+}
+
+void scope_check_call_stmt(call_stmt_t *stmt) {
+    if (has_error()) return;
+    if (stmt == NULL) return;
+
+    check_call_name(stmt);
+}
+
 void scope_check_block_stmt(block_stmt_t *stmt) {
-    if (has_error) return;
     if (stmt == NULL) return;
 
     scope_check_block(stmt->block);
 }
 
 void scope_check_if_stmt(if_stmt_t *stmt) {
-    if (has_error) return;
     if (stmt == NULL) return;
 
     scope_check_condition(&stmt->condition);
     scope_check_stmts(stmt->then_stmts);
-    if (stmt->else_stmts != NULL && stmt->else_stmts->stmts_kind != empty_stmts_e) {
-        scope_check_stmts(stmt->else_stmts);
-    }
+    scope_check_stmts(stmt->else_stmts);
 }
 
 void scope_check_while_stmt(while_stmt_t *stmt) {
-    if (has_error) return;
     if (stmt == NULL) return;
 
     scope_check_condition(&stmt->condition);
@@ -303,92 +840,22 @@ void scope_check_while_stmt(while_stmt_t *stmt) {
 }
 
 void scope_check_read_stmt(read_stmt_t *stmt) {
-    if (has_error) return;
+    if (has_error()) return;
     if (stmt == NULL) return;
 
-    const char *name = stmt->name;
-    file_location *file_loc = stmt->file_loc;
-
-    sym_entry_t *entry = symtab_lookup(name);
-    if (entry == NULL) {
-        if (!has_error) {
-            printf("%s: line %u identifier \"%s\" is not declared!\n",
-                   file_loc->filename, file_loc->line, name);
-            has_error = 1;
-            return;
-        }
-    } else if (entry->kind != SYM_VAR) {
-        if (!has_error) {
-            printf("%s: line %u \"%s\" is not a variable\n",
-                   file_loc->filename, file_loc->line, name);
-            has_error = 1;
-            return;
-        }
-    }
+    check_read_name(stmt);
 }
 
 void scope_check_print_stmt(print_stmt_t *stmt) {
-    if (has_error) return;
     if (stmt == NULL) return;
 
     scope_check_expr(&stmt->expr);
 }
 
 void scope_check_condition(condition_t *cond) {
-    if (has_error) return;
-    if (cond == NULL) return;
-
-    switch (cond->cond_kind) {
-        case ck_rel:
-            scope_check_expr(&cond->data.rel_op_cond.expr1);
-            scope_check_expr(&cond->data.rel_op_cond.expr2);
-            break;
-        case ck_db:
-            scope_check_expr(&cond->data.db_cond.dividend);
-            scope_check_expr(&cond->data.db_cond.divisor);
-            break;
-        default:
-            if (!has_error) {
-                printf("Unknown condition kind.\n");
-                has_error = 1;
-            }
-            break;
-    }
+    scope_check_walk(cond, condition_ast);
 }
 
 void scope_check_expr(expr_t *expr) {
-    if (has_error) return;
-    if (expr == NULL) return;
-
-    switch (expr->expr_kind) {
-        case expr_ident: {
-            ident_t *ident = &expr->data.ident;
-            sym_entry_t *entry = symtab_lookup(ident->name);
-            if (entry == NULL) {
-                if (!has_error) {
-                    printf("%s: line %u identifier \"%s\" is not declared!\n",
-                           ident->file_loc->filename, ident->file_loc->line, ident->name);
-                    has_error = 1;
-                }
-            }
-            break;
-        }
-        case expr_number:
-            /* Nothing to check */
-            break;
-        case expr_bin:
-            scope_check_expr(expr->data.binary.expr1);
-            if (has_error) return;
-            scope_check_expr(expr->data.binary.expr2);
-            break;
-        case expr_negated:
-            scope_check_expr(expr->data.negated.expr);
-            break;
-        default:
-            if (!has_error) {
-                printf("Unknown expression kind.\n");
-                has_error = 1;
-            }
-            break;
-    }
+    scope_check_walk(expr, expr_ast);
 }
@@ -1,9 +1,84 @@
 #ifndef SCOPE_CHECK_H
 #define SCOPE_CHECK_H
 
+#include <stddef.h>
 #include "ast.h"
 
-void scope_check_program(block_t program);
+/* Set the number of declaration errors after which checking stops;
+   0 means report all of them. (The default, 1, stops at the first.) */
+void scope_check_set_error_limit(unsigned int limit);
+
+/* Set the number of threads used to check the bodies of sibling
+   procedures at the same time; 0 means one per processor.
+   (The default, 1, checks everything on the calling thread.)
+   The errors are reported in the same order either way. */
+void scope_check_set_jobs(unsigned int n);
+
+/* Return the number of errors found by the last scope_check_program */
+unsigned int scope_check_error_count(void);
+
+/* Check the declarations and uses of identifiers in program,
+   and return it with the id_use (levels outward and attributes,
+   including the offset) filled in for each declared or used name,
+   and the frame_size filled in for each block */
+block_t scope_check_program(block_t program);
+
+/* The results of scope_check_program_parts */
+typedef struct scope_parts_s scope_parts_t;
+
+/* Check program as scope_check_program does, but keep the errors found
+   (instead of printing them) for each part of it: its own constant and
+   variable declarations, each procedure declared in its block, and its
+   statements. The program's scope stays in effect on the calling thread
+   (which must not use the symbol table otherwise) until the results are
+   destroyed, so that a block nested in it can be checked again alone. */
+scope_parts_t *scope_check_program_parts(block_t *program);
+
+/* One of the blocks that enclose a block checked again by
+   scope_check_block_again, and the procedure declared in it whose body
+   is (or encloses) the next block inward, or NULL if that is (or is
+   nested in) a block statement among its statements */
+typedef struct {
+    block_t *block;
+    proc_decl_t *through;
+} scope_step_t;
+
+/* Check again the block blk (whose "end" is at the location end), after
+   it has replaced a block nested in the program that parts are for:
+   in the body of its part-th procedure (counting from 0), or, if part is
+   the number of those procedures, in its statements, inside the count
+   blocks in steps (from the outermost inward; the first is that body,
+   if it is not blk itself). The scopes that enclose blk are made again
+   from the declarations in those blocks; the results are the same as
+   checking the whole program again, as nothing outside of blk depends
+   on it (unless the error limit was reached in that part, which is
+   then checked again as a whole). */
+void scope_check_block_again(scope_parts_t *parts, unsigned int part,
+                             const scope_step_t *steps, unsigned int count,
+                             block_t *blk, file_location end);
+
+/* Print the errors found (as scope_check_program would have),
+   in source order and up to the error limit */
+void scope_parts_print_errors(scope_parts_t *parts);
+
+/* The type of the function given to scope_parts_for_each_error */
+typedef void (*scope_error_fn)(file_location loc, const char *msg,
+                               size_t len, void *data);
+
+/* Call f for each of the errors found, in the order they are printed
+   (but not stopping at the error limit), with its location and message
+   (which has length len and is not terminated), and the given data */
+void scope_parts_for_each_error(scope_parts_t *parts, scope_error_fn f,
+                                void *data);
+
+/* Move the locations of the errors found that are at or after from
+   by delta bytes (after an edit to the program's text) */
+void scope_parts_move_errors(scope_parts_t *parts, file_location from,
+                             int delta);
+
+/* Leave the program's scope and free the results */
+void scope_parts_destroy(scope_parts_t *parts);
+
 void scope_check_block(block_t *block);
 void scope_check_const_decls(const_decls_t *decls);
 void scope_check_const_decl(const_decl_t *decl);
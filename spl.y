@@ -2,6 +2,8 @@
 
 %code top {
 #include <stdio.h>
+/* Let the parse stack grow enough for deeply nested programs */
+#define YYMAXDEPTH 10000000
 }
 
 %code requires {
@@ -13,22 +15,31 @@
 #include "lexer.h"
 #include "file_location.h"
 #include "symtab.h"
+#include "parser.h"
 
 /* Report an error to the user on stderr */
 extern void yyerror(const char *filename, const char *msg);
 
+/* Locations are file_locations (see file_location.h), set by the lexer;
+   a rule's location is that of its first symbol, or, for an empty rule,
+   that of the symbol before it */
+#define YYLLOC_DEFAULT(Cur, Rhs, N) \
+    ((Cur) = (N) ? YYRHSLOC(Rhs, 1) : YYRHSLOC(Rhs, 0))
+
 /* Define yytokentype as int to match lexer.h */
 typedef int yytokentype;
 
 }    /* end of %code requires */
 
 %verbose
+%define api.location.type {file_location}
 %define parse.lac full
 %define parse.error detailed
 
-/* the following passes file_name to yyerror,
-   and declares it as a formal parameter of yyparse. */
-%parse-param { char const *file_name }
+/* the following passes file_name (and parsed) to yyerror,
+   and declares them as formal parameters of yyparse;
+   the program's AST is put into *parsed. */
+%parse-param { char const *file_name } { block_t *parsed }
 
 %token <ident> identsym
 %token <number> numbersym
@@ -81,6 +92,8 @@ typedef int yytokentype;
 %type <var_decl> varDecl
 %type <ident_list> identList
 
+%type <empty> syncError
+
 %type <proc_decls> procDecls
 %type <proc_decl> procDecl
 %type <ident> procHeader
@@ -106,23 +119,37 @@ typedef int yytokentype;
 %start program
 
 %initial-action {
-    symtab_initialize();
+    if (!parser_parsing_proc_body()) {
+	symtab_initialize();
+    }
 }
 
 %code {
 
 extern int yylex(void);
 
-/* The AST for the program, set by the semantic action 
-   for the nonterminal program. */
-block_t progast; 
-
-/* Set the program's ast to be t */
-void setProgAST(block_t t);
-
-/* Helper function to create a file_location* from YYLTYPE */
-static file_location* make_file_location(const char *file_name, YYLTYPE loc) {
-    return file_location_make(file_name, loc.first_line);
+/* Report an error to the user on stderr
+   (yyparse also passes where the AST goes, which is not needed) */
+static void parser_yyerror(const char *file_name, block_t *parsed,
+			   const char *msg)
+{
+    (void) parsed;
+    yyerror(file_name, msg);
+}
+#define yyerror parser_yyerror
+
+/* Return a placeholder for a statement skipped by error recovery.
+   (The AST is never used once a syntax error has been reported.) */
+static stmt_t error_stmt(empty_t err) {
+    stmt_t ret = { 0 };
+    ret.file_loc = err.file_loc;
+    ret.type_tag = stmt_ast;
+    ret.next = NULL;
+    ret.stmt_kind = block_stmt;
+    ret.data.block_stmt.file_loc = err.file_loc;
+    ret.data.block_stmt.type_tag = block_stmt_ast;
+    ret.data.block_stmt.block = NULL;
+    return ret;
 }
 
 // /* Implementation of yyerror */
@@ -137,19 +164,32 @@ static file_location* make_file_location(const char *file_name, YYLTYPE loc) {
 program:
     block periodsym
     {
-        setProgAST($1);
+        *parsed = $1;
+    }
+    | syncError periodsym
+    {
+        /* no AST, the syntax error has already been reported */
     }
     ;
 
 block:
-    beginsym
+    beginsym constDecls varDecls procDecls stmts endsym
     {
-        symtab_enter_scope();
+        $$ = ast_block($1, $2, $3, $4, $5);
     }
-    constDecls varDecls procDecls stmts endsym
+    ;
+
+/* Error recovery: after a syntax error the parser discards input
+   up to the next ";", "end" or "." that can follow the erroneous phrase.
+   Parsing stops once the error limit (see parser.h) has been reached,
+   before any further tokens are read. */
+syncError:
+    error
     {
-        $$ = ast_block($1, $3, $4, $5, $6);
-        symtab_exit_scope();
+        if (parser_error_limit_reached(yynerrs)) {
+            YYABORT;
+        }
+        $$ = ast_empty(@1);
     }
     ;
 
@@ -158,9 +198,13 @@ constDecls:
     {
         $$ = ast_const_decls($1, $2);
     }
+    | constDecls constsym syncError semisym
+    {
+        $$ = $1;
+    }
     | %empty
     {
-        $$ = ast_const_decls_empty(ast_empty(make_file_location(file_name, @$)));
+        $$ = ast_const_decls_empty(ast_empty(@$));
     }
     ;
 
@@ -195,9 +239,13 @@ varDecls:
     {
         $$ = ast_var_decls($1, $2);
     }
+    | varDecls varsym syncError semisym
+    {
+        $$ = $1;
+    }
     | %empty
     {
-        $$ = ast_var_decls_empty(ast_empty(make_file_location(file_name, @$)));
+        $$ = ast_var_decls_empty(ast_empty(@$));
     }
     ;
 
@@ -226,7 +274,7 @@ procDecls:
     }
     | %empty
     {
-        $$ = ast_proc_decls_empty(ast_empty(make_file_location(file_name, @$)));
+        $$ = ast_proc_decls_empty(ast_empty(@$));
     }
     ;
 
@@ -251,7 +299,7 @@ stmts:
     }
     | %empty
     {
-        $$ = ast_stmts_empty(ast_empty(make_file_location(file_name, @$)));
+        $$ = ast_stmts_empty(ast_empty(@$));
     }
     ;
 
@@ -295,6 +343,24 @@ stmt:
     {
         $$ = ast_stmt_print($1);
     }
+    | syncError
+    {
+        $$ = error_stmt($1);
+    }
+    /* (an error in a condition is recovered from at its "then" or "do",
+       so that the statement's "end" does not end the block around it) */
+    | ifsym syncError thensym stmts elsesym stmts endsym
+    {
+        $$ = error_stmt($2);
+    }
+    | ifsym syncError thensym stmts endsym
+    {
+        $$ = error_stmt($2);
+    }
+    | whilesym syncError dosym stmts endsym
+    {
+        $$ = error_stmt($2);
+    }
     ;
 
 assignStmt:
@@ -444,6 +510,3 @@ factor:
 %%
 
 /* User code section */
-
-/* Set the program's ast to be t */
-void setProgAST(block_t t) { progast = t; }
@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "srm.h"
+#include "instruction.h"
+#include "utilities.h"
+
+#if defined(__GNUC__) && !defined(SRM_SWITCH_DISPATCH)
+#define SRM_COMPUTED_GOTO
+#endif
+
+// The most bytes of memory a program may use
+#define MAX_MEMORY_BYTES (1u << 30)
+
+// The kinds of decoded words that are not instructions: a word that is
+// not a valid instruction, and the place just past the decoded text,
+// which the PC reaches by leaving the text
+#define INVALID SRM_NUM_KINDS
+#define OUTSIDE (SRM_NUM_KINDS + 1)
+
+// The register that writes to GPR[0] go to (so GPR[0] stays 0)
+#define DISCARD NUM_REGISTERS
+
+// The cycles each kind of instruction takes beyond the first
+// (a branch taken, or a jump, takes TAKEN_CYCLES more, for refilling
+// the pipeline)
+static const unsigned char extra_cycles[SRM_NUM_KINDS] = {
+    [srm_mul] = 3, [srm_div] = 19, [srm_lw] = 2, [srm_lbu] = 2,
+    [srm_sw] = 1, [srm_sb] = 1
+};
+#define TAKEN_CYCLES 1
+
+static const char *kind_names[SRM_NUM_KINDS] = {
+    [srm_add] = "ADD", [srm_sub] = "SUB", [srm_and] = "AND",
+    [srm_bor] = "BOR", [srm_nor] = "NOR", [srm_xor] = "XOR",
+    [srm_mul] = "MUL", [srm_div] = "DIV", [srm_mfhi] = "MFHI",
+    [srm_mflo] = "MFLO", [srm_sll] = "SLL", [srm_srl] = "SRL",
+    [srm_jr] = "JR", [srm_syscall] = "SYSCALL", [srm_addi] = "ADDI",
+    [srm_andi] = "ANDI", [srm_bori] = "BORI", [srm_xori] = "XORI",
+    [srm_beq] = "BEQ", [srm_bne] = "BNE", [srm_bgez] = "BGEZ",
+    [srm_bgtz] = "BGTZ", [srm_blez] = "BLEZ", [srm_bltz] = "BLTZ",
+    [srm_lw] = "LW", [srm_lbu] = "LBU", [srm_sw] = "SW", [srm_sb] = "SB",
+    [srm_jmp] = "JMP", [srm_jal] = "JAL"
+};
+
+// Return the name of the instructions of kind k (e.g., "ADDI")
+const char *srm_kind_name(srm_kind k)
+{
+    return kind_names[k];
+}
+
+// A word of the text, decoded
+typedef struct {
+    unsigned char kind;     // an srm_kind, INVALID or OUTSIDE
+    unsigned char s, t;     // the registers read
+    unsigned char d;        // the register written (DISCARD for GPR[0])
+    word_type imm;          // the (extended) immediate, offset in bytes,
+                            // shift or system call code
+    unsigned int target;    // the index of the branch's or jump's target
+    uint64_t count;         // the times it was executed
+} decoded;
+
+// The state of the machine
+typedef struct {
+    word_type *mem;             // the memory, from address 0
+    address_type mem_bytes;
+    address_type text_start;
+    address_type text_bytes;
+    decoded *code;              // the decoded text (and OUTSIDE after it)
+    unsigned int num_words;     // (the number of words of text)
+} machine;
+
+// Report the machine error described by what at the address of
+// the instruction ip in m, and exit
+static void machine_error(const machine *m, const decoded *ip,
+			  const char *what)
+{
+    fflush(stdout);
+    errno = 0;
+    if (ip->kind == OUTSIDE) {
+	bail_with_error("Machine error: %s!", what);
+    }
+    bail_with_error("Machine error at address %u: %s!",
+		    m->text_start
+		    + (address_type) (ip - m->code) * BYTES_PER_WORD, what);
+}
+
+// Return the index in m's text of the instruction at addr
+// (or that of the OUTSIDE entry if it is not in the text)
+static unsigned int text_index(const machine *m, address_type addr)
+{
+    address_type off = addr - m->text_start;
+    if (off >= m->text_bytes || off % BYTES_PER_WORD != 0) {
+	return m->num_words;
+    }
+    return off / BYTES_PER_WORD;
+}
+
+// Return the register written by an instruction with the field r
+static unsigned char dest(unsigned int r)
+{
+    return (r == 0) ? DISCARD : (unsigned char) r;
+}
+
+// Decode the word of text at index i in m (from memory)
+static void decode(machine *m, unsigned int i)
+{
+    address_type addr = m->text_start + i * BYTES_PER_WORD;
+    unsigned int w = (unsigned int) m->mem[addr / BYTES_PER_WORD];
+    unsigned int op = w >> OP_SHIFT;
+    unsigned int rs = (w >> RS_SHIFT) & 0x1F;
+    unsigned int rt = (w >> RT_SHIFT) & 0x1F;
+    unsigned int rd = (w >> RD_SHIFT) & 0x1F;
+    immediate_type immed = (immediate_type) (w & 0xFFFF);
+    // (the PC is advanced past an instruction before it is executed)
+    address_type next = addr + BYTES_PER_WORD;
+    decoded *ip = &m->code[i];
+    ip->kind = INVALID;
+    ip->s = (unsigned char) rs;
+    ip->t = (unsigned char) rt;
+    ip->d = DISCARD;
+    ip->imm = 0;
+    ip->target = m->num_words;
+    switch ((op_code) op) {
+    case REG_O:
+	ip->d = dest(rd);
+	switch ((func_code) (w & 0x3F)) {
+	case ADD_F: ip->kind = srm_add; break;
+	case SUB_F: ip->kind = srm_sub; break;
+	case AND_F: ip->kind = srm_and; break;
+	case BOR_F: ip->kind = srm_bor; break;
+	case NOR_F: ip->kind = srm_nor; break;
+	case XOR_F: ip->kind = srm_xor; break;
+	case MUL_F: ip->kind = srm_mul; break;
+	case DIV_F: ip->kind = srm_div; break;
+	case MFHI_F: ip->kind = srm_mfhi; break;
+	case MFLO_F: ip->kind = srm_mflo; break;
+	case SLL_F: case SRL_F:
+	    ip->kind = ((w & 0x3F) == SLL_F) ? srm_sll : srm_srl;
+	    ip->imm = (word_type) ((w >> SHIFT_SHIFT) & 0x1F);
+	    break;
+	case JR_F: ip->kind = srm_jr; break;
+	case SYSCALL_F:
+	    ip->kind = srm_syscall;
+	    ip->imm = (word_type) ((w >> CODE_SHIFT) & 0xFFFFF);
+	    break;
+	}
+	break;
+    case ADDI_O:
+	ip->kind = srm_addi;
+	ip->d = dest(rt);
+	ip->imm = machine_types_sgnExt(immed);
+	break;
+    case ANDI_O: case BORI_O: case XORI_O:
+	ip->kind = (op == ANDI_O) ? srm_andi
+	    : (op == BORI_O) ? srm_bori : srm_xori;
+	ip->d = dest(rt);
+	ip->imm = (word_type) machine_types_zeroExt(immed);
+	break;
+    case BEQ_O: case BNE_O: case BGEZ_O: case BGTZ_O: case BLEZ_O:
+    case BLTZ_O:
+	ip->kind = (op == BEQ_O) ? srm_beq : (op == BNE_O) ? srm_bne
+	    : (op == BGEZ_O) ? srm_bgez : (op == BGTZ_O) ? srm_bgtz
+	    : (op == BLEZ_O) ? srm_blez : srm_bltz;
+	ip->target = text_index(m, next + machine_types_formOffset(immed));
+	break;
+    case LW_O: case SW_O:
+	ip->kind = (op == LW_O) ? srm_lw : srm_sw;
+	ip->d = (op == LW_O) ? dest(rt) : DISCARD;
+	ip->imm = machine_types_formOffset(immed);
+	break;
+    case LBU_O: case SB_O:
+	ip->kind = (op == LBU_O) ? srm_lbu : srm_sb;
+	ip->d = (op == LBU_O) ? dest(rt) : DISCARD;
+	ip->imm = machine_types_sgnExt(immed);
+	break;
+    case JMP_O: case JAL_O:
+	ip->kind = (op == JMP_O) ? srm_jmp : srm_jal;
+	ip->target = text_index(m, machine_types_formAddress(next,
+							     w & 0x3FFFFFF));
+	break;
+    }
+}
+
+// Print the string (ended by a 0 byte) at addr in m's memory on out,
+// reporting a machine error for the instruction ip if it does not end
+// before the end of memory
+static void print_string(const machine *m, const decoded *ip,
+			 address_type addr, FILE *out)
+{
+    for (address_type a = addr; a < m->mem_bytes; a++) {
+	unsigned int w = (unsigned int) m->mem[a / BYTES_PER_WORD];
+	int c = (int) ((w >> (8 * (a % BYTES_PER_WORD))) & 0xFF);
+	if (c == 0) {
+	    return;
+	}
+	putc(c, out);
+    }
+    machine_error(m, ip, "a string runs past the end of memory");
+}
+
+// Set up m's memory and decoded text for running bof
+static void load(machine *m, const bof_file *bof)
+{
+    const bof_header *hdr = &bof->header;
+    uint64_t text_end = (uint64_t) hdr->text_start_address
+	+ hdr->text_length;
+    uint64_t data_end = (uint64_t) hdr->data_start_address
+	+ hdr->data_length;
+    uint64_t size = MAX(MAX(text_end, data_end),
+			(uint64_t) hdr->stack_bottom_address);
+    errno = 0;
+    if (size > MAX_MEMORY_BYTES) {
+	bail_with_error("The program needs more than %u bytes of memory!",
+			MAX_MEMORY_BYTES);
+    }
+    m->mem_bytes = (address_type) size;
+    m->mem = (word_type *) calloc(size / BYTES_PER_WORD + 1,
+				  sizeof(word_type));
+    m->text_start = hdr->text_start_address;
+    m->text_bytes = hdr->text_length;
+    m->num_words = hdr->text_length / BYTES_PER_WORD;
+    m->code = (decoded *) calloc(m->num_words + 1, sizeof(decoded));
+    if (m->mem == NULL || m->code == NULL) {
+	bail_with_error("No space for the program's memory!");
+    }
+    memcpy(&m->mem[hdr->text_start_address / BYTES_PER_WORD], bof->text,
+	   hdr->text_length);
+    memcpy(&m->mem[hdr->data_start_address / BYTES_PER_WORD], bof->data,
+	   hdr->data_length);
+    for (unsigned int i = 0; i < m->num_words; i++) {
+	decode(m, i);
+    }
+    m->code[m->num_words].kind = OUTSIDE;
+}
+
+// Fill in stats from the counts of m's decoded instructions
+// (adding to the counts already in stats->executed)
+static void finish_stats(const machine *m, uint64_t taken, srm_stats *stats)
+{
+    for (unsigned int i = 0; i < m->num_words; i++) {
+	if (m->code[i].kind < SRM_NUM_KINDS) {
+	    stats->executed[m->code[i].kind] += m->code[i].count;
+	}
+    }
+    stats->instructions = 0;
+    stats->cycles = 0;
+    for (int k = 0; k < SRM_NUM_KINDS; k++) {
+	stats->instructions += stats->executed[k];
+	stats->cycles += stats->executed[k] * (1 + extra_cycles[k]);
+    }
+    stats->taken = taken;
+    stats->cycles += taken * TAKEN_CYCLES;
+    stats->loads = stats->executed[srm_lw] + stats->executed[srm_lbu];
+    stats->load_bytes = stats->executed[srm_lw] * BYTES_PER_WORD
+	+ stats->executed[srm_lbu];
+    stats->stores = stats->executed[srm_sw] + stats->executed[srm_sb];
+    stats->store_bytes = stats->executed[srm_sw] * BYTES_PER_WORD
+	+ stats->executed[srm_sb];
+}
+
+// Run the program in bof, with its input on stdin and its output on
+// stdout, and return its exit code (from exit_sc, or EXIT_FAILURE after
+// fail_sc), filling in *stats; exit with an error message (on stderr)
+// if a machine error happens
+int srm_run(const bof_file *bof, srm_stats *stats)
+{
+    machine mach;
+    machine *m = &mach;
+    load(m, bof);
+    memset(stats, 0, sizeof(*stats));
+    word_type *mem = m->mem;
+    const address_type mem_bytes = m->mem_bytes;
+    decoded *code = m->code;
+    decoded *ip = code;
+    word_type gpr[NUM_REGISTERS + 1] = { 0 };
+    gpr[GP] = (word_type) bof->header.data_start_address;
+    gpr[SP] = (word_type) bof->header.stack_bottom_address;
+    gpr[FP] = gpr[SP];
+    word_type hi = 0, lo = 0;
+    uint64_t taken = 0;
+    address_type a;
+    unsigned int shift;
+    int result = EXIT_SUCCESS;
+
+    // (ip is moved on to the instruction after it, or to a taken
+    // branch's target)
+#define BRANCH(cond)					\
+    if (cond) {						\
+	taken++;					\
+	ip = code + ip->target;				\
+	DISPATCH();					\
+    }							\
+    NEXT()
+    // Set a to the address used by a load or store of size bytes
+#define ADDRESS(size)							\
+    a = (address_type) gpr[ip->s] + (address_type) ip->imm;		\
+    if (a >= mem_bytes || a % (size) != 0) {				\
+	machine_error(m, ip, "a memory address is out of range"		\
+		      " or unaligned");					\
+    }
+    // After a store to a, decode the word stored again if it is text
+#define STORED()							\
+    if (a - m->text_start < m->text_bytes) {				\
+	unsigned int i = (a - m->text_start) / BYTES_PER_WORD;		\
+	if (code[i].kind < SRM_NUM_KINDS) {				\
+	    stats->executed[code[i].kind] += code[i].count;		\
+	}								\
+	decode(m, i);							\
+	code[i].count = 0;						\
+    }
+
+#ifdef SRM_COMPUTED_GOTO
+    static const void *const labels[SRM_NUM_KINDS + 2] = {
+	[srm_add] = &&do_srm_add, [srm_sub] = &&do_srm_sub,
+	[srm_and] = &&do_srm_and, [srm_bor] = &&do_srm_bor,
+	[srm_nor] = &&do_srm_nor, [srm_xor] = &&do_srm_xor,
+	[srm_mul] = &&do_srm_mul, [srm_div] = &&do_srm_div,
+	[srm_mfhi] = &&do_srm_mfhi, [srm_mflo] = &&do_srm_mflo,
+	[srm_sll] = &&do_srm_sll, [srm_srl] = &&do_srm_srl,
+	[srm_jr] = &&do_srm_jr, [srm_syscall] = &&do_srm_syscall,
+	[srm_addi] = &&do_srm_addi, [srm_andi] = &&do_srm_andi,
+	[srm_bori] = &&do_srm_bori, [srm_xori] = &&do_srm_xori,
+	[srm_beq] = &&do_srm_beq, [srm_bne] = &&do_srm_bne,
+	[srm_bgez] = &&do_srm_bgez, [srm_bgtz] = &&do_srm_bgtz,
+	[srm_blez] = &&do_srm_blez, [srm_bltz] = &&do_srm_bltz,
+	[srm_lw] = &&do_srm_lw, [srm_lbu] = &&do_srm_lbu,
+	[srm_sw] = &&do_srm_sw, [srm_sb] = &&do_srm_sb,
+	[srm_jmp] = &&do_srm_jmp, [srm_jal] = &&do_srm_jal,
+	[INVALID] = &&do_INVALID, [OUTSIDE] = &&do_OUTSIDE
+    };
+#define INSTRUCTION(kind) do_##kind
+#define DISPATCH() do { ip->count++; goto *labels[ip->kind]; } while (0)
+    DISPATCH();
+#else
+#define INSTRUCTION(kind) case kind
+#define DISPATCH() do { ip->count++; goto dispatch; } while (0)
+    ip->count++;
+ dispatch:
+    switch (ip->kind) {
+#endif
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+
+    INSTRUCTION(srm_add):
+	gpr[ip->d] = (word_type) ((unsigned int) gpr[ip->s]
+				  + (unsigned int) gpr[ip->t]);
+	NEXT();
+    INSTRUCTION(srm_sub):
+	gpr[ip->d] = (word_type) ((unsigned int) gpr[ip->s]
+				  - (unsigned int) gpr[ip->t]);
+	NEXT();
+    INSTRUCTION(srm_and):
+	gpr[ip->d] = gpr[ip->s] & gpr[ip->t];
+	NEXT();
+    INSTRUCTION(srm_bor):
+	gpr[ip->d] = gpr[ip->s] | gpr[ip->t];
+	NEXT();
+    INSTRUCTION(srm_nor):
+	gpr[ip->d] = ~(gpr[ip->s] | gpr[ip->t]);
+	NEXT();
+    INSTRUCTION(srm_xor):
+	gpr[ip->d] = gpr[ip->s] ^ gpr[ip->t];
+	NEXT();
+    INSTRUCTION(srm_mul): {
+	int64_t p = (int64_t) gpr[ip->s] * gpr[ip->t];
+	hi = (word_type) (uint32_t) ((uint64_t) p >> 32);
+	lo = (word_type) (uint32_t) p;
+	NEXT();
+    }
+    INSTRUCTION(srm_div):
+	if (gpr[ip->t] == 0) {
+	    machine_error(m, ip, "division by 0");
+	}
+	// (the most negative word divided by -1 wraps around to itself)
+	if (gpr[ip->t] == -1) {
+	    hi = 0;
+	    lo = (word_type) (0u - (unsigned int) gpr[ip->s]);
+	} else {
+	    hi = gpr[ip->s] % gpr[ip->t];
+	    lo = gpr[ip->s] / gpr[ip->t];
+	}
+	NEXT();
+    INSTRUCTION(srm_mfhi):
+	gpr[ip->d] = hi;
+	NEXT();
+    INSTRUCTION(srm_mflo):
+	gpr[ip->d] = lo;
+	NEXT();
+    INSTRUCTION(srm_sll):
+	gpr[ip->d] = (word_type) ((unsigned int) gpr[ip->t] << ip->imm);
+	NEXT();
+    INSTRUCTION(srm_srl):
+	gpr[ip->d] = (word_type) ((unsigned int) gpr[ip->t] >> ip->imm);
+	NEXT();
+    INSTRUCTION(srm_jr):
+	taken++;
+	ip = code + text_index(m, (address_type) gpr[ip->s]);
+	DISPATCH();
+    INSTRUCTION(srm_addi):
+	gpr[ip->d] = (word_type) ((unsigned int) gpr[ip->s]
+				  + (unsigned int) ip->imm);
+	NEXT();
+    INSTRUCTION(srm_andi):
+	gpr[ip->d] = gpr[ip->s] & ip->imm;
+	NEXT();
+    INSTRUCTION(srm_bori):
+	gpr[ip->d] = gpr[ip->s] | ip->imm;
+	NEXT();
+    INSTRUCTION(srm_xori):
+	gpr[ip->d] = gpr[ip->s] ^ ip->imm;
+	NEXT();
+    INSTRUCTION(srm_beq):
+	BRANCH(gpr[ip->s] == gpr[ip->t]);
+    INSTRUCTION(srm_bne):
+	BRANCH(gpr[ip->s] != gpr[ip->t]);
+    INSTRUCTION(srm_bgez):
+	BRANCH(gpr[ip->s] >= 0);
+    INSTRUCTION(srm_bgtz):
+	BRANCH(gpr[ip->s] > 0);
+    INSTRUCTION(srm_blez):
+	BRANCH(gpr[ip->s] <= 0);
+    INSTRUCTION(srm_bltz):
+	BRANCH(gpr[ip->s] < 0);
+    INSTRUCTION(srm_lw):
+	ADDRESS(BYTES_PER_WORD);
+	gpr[ip->d] = mem[a / BYTES_PER_WORD];
+	NEXT();
+    INSTRUCTION(srm_lbu):
+	ADDRESS(1);
+	shift = 8 * (a % BYTES_PER_WORD);
+	gpr[ip->d] = (word_type)
+	    (((unsigned int) mem[a / BYTES_PER_WORD] >> shift) & 0xFF);
+	NEXT();
+    INSTRUCTION(srm_sw):
+	ADDRESS(BYTES_PER_WORD);
+	mem[a / BYTES_PER_WORD] = gpr[ip->t];
+	STORED();
+	NEXT();
+    INSTRUCTION(srm_sb):
+	ADDRESS(1);
+	shift = 8 * (a % BYTES_PER_WORD);
+	mem[a / BYTES_PER_WORD] = (word_type)
+	    (((unsigned int) mem[a / BYTES_PER_WORD] & ~(0xFFu << shift))
+	     | (((unsigned int) gpr[ip->t] & 0xFF) << shift));
+	STORED();
+	NEXT();
+    INSTRUCTION(srm_jmp):
+	taken++;
+	ip = code + ip->target;
+	DISPATCH();
+    INSTRUCTION(srm_jal):
+	taken++;
+	gpr[RA] = (word_type) (m->text_start
+			       + (address_type) (ip + 1 - code)
+			       * BYTES_PER_WORD);
+	ip = code + ip->target;
+	DISPATCH();
+    INSTRUCTION(srm_syscall):
+	switch ((syscall_code) ip->imm) {
+	case print_int_sc:
+	    printf("%d", gpr[A0]);
+	    break;
+	case print_str_sc:
+	    print_string(m, ip, (address_type) gpr[A0], stdout);
+	    break;
+	case print_char_sc:
+	    putchar(gpr[A0] & 0xFF);
+	    break;
+	case read_char_sc: {
+	    int ch = getchar();
+	    gpr[V0] = (ch == EOF) ? -1 : ch;
+	    break;
+	}
+	case exit_sc:
+	    result = gpr[A0];
+	    goto done;
+	case fail_sc:
+	    fflush(stdout);
+	    print_string(m, ip, (address_type) gpr[A0], stderr);
+	    putc('\n', stderr);
+	    result = EXIT_FAILURE;
+	    goto done;
+	default:
+	    machine_error(m, ip, "unknown system call");
+	}
+	NEXT();
+    INSTRUCTION(INVALID):
+	machine_error(m, ip, "invalid instruction");
+	NEXT();
+    INSTRUCTION(OUTSIDE):
+	machine_error(m, ip, "the PC is outside of the text");
+	NEXT();
+#ifndef SRM_COMPUTED_GOTO
+    }
+#endif
+
+ done:
+    fflush(stdout);
+    finish_stats(m, taken, stats);
+    free(m->mem);
+    free(m->code);
+    return result;
+}
+
+// Print stats on out, with the counts of the kinds of instructions
+// executed (in order)
+void srm_print_stats(FILE *out, const srm_stats *stats)
+{
+    fprintf(out, "instructions executed: %" PRIu64 "\n",
+	    stats->instructions);
+    fprintf(out, "simulated cycles: %" PRIu64 "\n", stats->cycles);
+    fprintf(out, "branches taken and jumps: %" PRIu64 "\n", stats->taken);
+    fprintf(out, "loads: %" PRIu64 " (%" PRIu64 " bytes),"
+	    " stores: %" PRIu64 " (%" PRIu64 " bytes)\n",
+	    stats->loads, stats->load_bytes,
+	    stats->stores, stats->store_bytes);
+    for (int k = 0; k < SRM_NUM_KINDS; k++) {
+	if (stats->executed[k] != 0) {
+	    fprintf(out, "  %-8s %12" PRIu64 " (%5.1f%%)\n",
+		    kind_names[k], stats->executed[k],
+		    100.0 * stats->executed[k] / stats->instructions);
+	}
+    }
+}
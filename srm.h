@@ -0,0 +1,55 @@
+#ifndef _SRM_H
+#define _SRM_H
+#include <stdio.h>
+#include <stdint.h>
+#include "bof.h"
+
+// A simulator for the SRM (see instruction.h), which runs the programs
+// in BOFs (see bof.h). Before running, each word of the text is decoded
+// into its kind of instruction and its operands, with its offsets, jump
+// targets and immediates already formed (by the machine_types helpers).
+// The decoded instructions are dispatched by computed gotos (with GCC
+// and compilers like it), each jumping straight to the code for the
+// next; elsewhere, or if SRM_SWITCH_DISPATCH is defined, a loop around
+// a switch dispatches them. A store into the text decodes the word
+// stored again.
+//
+// A machine error (such as dividing by 0, or using an address outside
+// of memory or not on a word boundary) is reported on stderr, with the
+// address of the instruction, and stops the simulation.
+
+// The kinds of instructions (in the order they are counted in)
+typedef enum {
+    srm_add, srm_sub, srm_and, srm_bor, srm_nor, srm_xor, srm_mul, srm_div,
+    srm_mfhi, srm_mflo, srm_sll, srm_srl, srm_jr, srm_syscall,
+    srm_addi, srm_andi, srm_bori, srm_xori, srm_beq, srm_bne, srm_bgez,
+    srm_bgtz, srm_blez, srm_bltz, srm_lw, srm_lbu, srm_sw, srm_sb,
+    srm_jmp, srm_jal
+} srm_kind;
+
+#define SRM_NUM_KINDS (srm_jal + 1)
+
+// What running a program did
+typedef struct {
+    uint64_t instructions;                 // the instructions executed
+    uint64_t executed[SRM_NUM_KINDS];      // (of each kind)
+    uint64_t taken;                        // the branches taken, and jumps
+    uint64_t loads, load_bytes;            // the data read from memory
+    uint64_t stores, store_bytes;          // the data written to memory
+    uint64_t cycles;                       // the time taken (see srm.c)
+} srm_stats;
+
+// Return the name of the instructions of kind k (e.g., "ADDI")
+extern const char *srm_kind_name(srm_kind k);
+
+// Run the program in bof, with its input on stdin and its output on
+// stdout, and return its exit code (from exit_sc, or EXIT_FAILURE after
+// fail_sc), filling in *stats; exit with an error message (on stderr)
+// if a machine error happens
+extern int srm_run(const bof_file *bof, srm_stats *stats);
+
+// Print stats on out, with the counts of the kinds of instructions
+// executed (in order)
+extern void srm_print_stats(FILE *out, const srm_stats *stats);
+
+#endif
@@ -2,16 +2,116 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 
-#define MAX_SCOPE_DEPTH 100
+// Initial number of scopes that can be nested (the stack grows as needed)
+#define INITIAL_SCOPE_DEPTH 100
 
-static sym_entry_t *symtab_stack[MAX_SCOPE_DEPTH];
-static int current_scope = -1;
+// Size of the data area of an arena chunk (larger requests get their own)
+#define ARENA_CHUNK_SIZE 8192
+
+// Alignment of every allocation made from the arena
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+// Entries and their names are bump allocated from a list of chunks.
+// Chunks are never freed; exiting a scope just resets the allocation point
+// to where it was when the scope was entered, so the chunks are reused.
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;  // size of data
+    size_t used;  // bytes of data in use
+    max_align_t data[];
+} arena_chunk_t;
+
+// A position in the arena, recorded when a scope is entered
+typedef struct {
+    arena_chunk_t *chunk;
+    size_t used;
+} arena_mark_t;
+
+// The symbol table's state is per thread, so that threads can check
+// parts of a program at the same time (see symtab_enter_view)
+static _Thread_local arena_chunk_t *arena_first = NULL;
+static _Thread_local arena_chunk_t *arena_current = NULL;
+
+// A scope on the stack of nested scopes
+typedef struct scope_s {
+    sym_entry_t *entries;     // most recently declared first
+    arena_mark_t mark;        // arena position when the scope was entered
+    unsigned int loc_count;   // number of constants and variables declared
+} scope_t;
+
+static _Thread_local scope_t *symtab_stack = NULL;
+static _Thread_local int scope_capacity = 0;
+static _Thread_local int current_scope = -1;
 
 extern const char *file_name; // For error reporting
 
+// Return a fresh chunk with room for at least size bytes
+static arena_chunk_t *arena_chunk_create(size_t size) {
+    if (size < ARENA_CHUNK_SIZE) {
+        size = ARENA_CHUNK_SIZE;
+    }
+    arena_chunk_t *chunk = malloc(sizeof(arena_chunk_t) + size);
+    if (chunk == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+// Return size bytes (suitably aligned) from the arena
+static void *arena_alloc(size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (arena_current == NULL) {
+        arena_first = arena_current = arena_chunk_create(size);
+    }
+    // move on to later chunks (reusing them) until one has room
+    while (arena_current->size - arena_current->used < size) {
+        arena_chunk_t *next = arena_current->next;
+        if (next == NULL || next->size < size) {
+            // insert a new chunk after the current one
+            arena_chunk_t *chunk = arena_chunk_create(size);
+            chunk->next = next;
+            arena_current->next = chunk;
+            next = chunk;
+        }
+        arena_current = next;
+        arena_current->used = 0;
+    }
+    void *ret = (char *)arena_current->data + arena_current->used;
+    arena_current->used += size;
+    return ret;
+}
+
+// Return the current position in the arena
+static arena_mark_t arena_mark(void) {
+    arena_mark_t ret;
+    ret.chunk = arena_current;
+    ret.used = (arena_current == NULL) ? 0 : arena_current->used;
+    return ret;
+}
+
+// Free everything allocated since mark was taken
+static void arena_reset(arena_mark_t mark) {
+    if (mark.chunk == NULL) {
+        // nothing had been allocated, so start over from the first chunk
+        arena_current = arena_first;
+        if (arena_current != NULL) {
+            arena_current->used = 0;
+        }
+    } else {
+        arena_current = mark.chunk;
+        arena_current->used = mark.used;
+    }
+}
+
 void symtab_initialize(void) {
     current_scope = -1;
+    arena_reset((arena_mark_t){ NULL, 0 });
 }
 
 void symtab_finalize(void) {
@@ -22,48 +122,57 @@ void symtab_finalize(void) {
 
 void symtab_enter_scope(void) {
     current_scope++;
-    if (current_scope >= MAX_SCOPE_DEPTH) {
-        fprintf(stderr, "Error: Maximum scope depth exceeded.\n");
-        exit(EXIT_FAILURE);
+    if (current_scope >= scope_capacity) {
+        scope_capacity = (scope_capacity == 0) ? INITIAL_SCOPE_DEPTH
+                                               : 2 * scope_capacity;
+        symtab_stack = realloc(symtab_stack, scope_capacity * sizeof(scope_t));
+        if (symtab_stack == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for scopes.\n");
+            exit(EXIT_FAILURE);
+        }
     }
-    symtab_stack[current_scope] = NULL;
+    symtab_stack[current_scope].entries = NULL;
+    symtab_stack[current_scope].mark = arena_mark();
+    symtab_stack[current_scope].loc_count = 0;
 }
 
 void symtab_exit_scope(void) {
-    sym_entry_t *entry = symtab_stack[current_scope];
-    while (entry != NULL) {
-        sym_entry_t *temp = entry;
-        entry = entry->next;
-        free(temp->name);
-        free(temp);
-    }
-    symtab_stack[current_scope] = NULL;
+    // all of the scope's entries (and names) were allocated after its mark
+    arena_reset(symtab_stack[current_scope].mark);
+    symtab_stack[current_scope].entries = NULL;
     current_scope--;
 }
 
-void symtab_insert(const char *name, sym_kind_t kind, int value, file_location *loc) {
-    sym_entry_t *new_entry = malloc(sizeof(sym_entry_t));
-    if (new_entry == NULL) {
-        fprintf(stderr, "Error: Memory allocation failed for sym_entry_t.\n");
-        exit(EXIT_FAILURE);
-    }
-    new_entry->name = malloc(strlen(name) + 1);
-    if (new_entry->name == NULL) {
-        fprintf(stderr, "Error: Memory allocation failed for symbol name.\n");
-        exit(EXIT_FAILURE);
-    }
-    strcpy(new_entry->name, name);
+void symtab_insert(const char *name, sym_kind_t kind, int value, id_attrs *attrs) {
+    size_t len = strlen(name) + 1;
+    sym_entry_t *new_entry = arena_alloc(sizeof(sym_entry_t) + len);
+    new_entry->name = (char *)(new_entry + 1);
+    memcpy(new_entry->name, name, len);
     new_entry->kind = kind;
     new_entry->value = value;
-    new_entry->next = symtab_stack[current_scope];
-    symtab_stack[current_scope] = new_entry;
+    new_entry->attrs = attrs;
+    new_entry->next = symtab_stack[current_scope].entries;
+    symtab_stack[current_scope].entries = new_entry;
+    if (kind != SYM_PROC) {
+        symtab_stack[current_scope].loc_count++;
+    }
+}
+
+unsigned int symtab_scope_loc_count(void) {
+    return symtab_stack[current_scope].loc_count;
 }
 
 sym_entry_t *symtab_lookup(const char *name) {
+    unsigned int levels_outward;
+    return symtab_lookup_levels(name, &levels_outward);
+}
+
+sym_entry_t *symtab_lookup_levels(const char *name, unsigned int *levels_outward) {
     for (int i = current_scope; i >= 0; i--) {
-        sym_entry_t *entry = symtab_stack[i];
+        sym_entry_t *entry = symtab_stack[i].entries;
         while (entry != NULL) {
             if (strcmp(entry->name, name) == 0) {
+                *levels_outward = current_scope - i;
                 return entry;
             }
             entry = entry->next;
@@ -73,7 +182,7 @@ sym_entry_t *symtab_lookup(const char *name) {
 }
 
 sym_entry_t *symtab_lookup_current_scope(const char *name) {
-    sym_entry_t *entry = symtab_stack[current_scope];
+    sym_entry_t *entry = symtab_stack[current_scope].entries;
     while (entry != NULL) {
         if (strcmp(entry->name, name) == 0) {
             return entry;
@@ -82,3 +191,47 @@ sym_entry_t *symtab_lookup_current_scope(const char *name) {
     }
     return NULL; // Not found in current scope
 }
+
+symtab_view_t symtab_view(void) {
+    symtab_view_t ret;
+    ret.scopes = symtab_stack;
+    ret.depth = current_scope + 1;
+    ret.entries = (current_scope < 0) ? NULL : symtab_stack[current_scope].entries;
+    ret.loc_count = (current_scope < 0) ? 0 : symtab_stack[current_scope].loc_count;
+    return ret;
+}
+
+void symtab_enter_view(symtab_view_t view) {
+    symtab_initialize();
+    for (int i = 0; i < view.depth; i++) {
+        symtab_enter_scope();
+        // share the view's entries, which are never changed through this copy
+        symtab_stack[current_scope].entries = view.scopes[i].entries;
+        symtab_stack[current_scope].loc_count = view.scopes[i].loc_count;
+    }
+    if (view.depth > 0) {
+        symtab_stack[current_scope].entries = view.entries;
+        symtab_stack[current_scope].loc_count = view.loc_count;
+    }
+}
+
+symtab_view_t symtab_set_view(symtab_view_t view) {
+    symtab_view_t ret = symtab_view();
+    // the entries are a list, to which later declarations were prepended
+    symtab_stack[current_scope].entries = view.entries;
+    symtab_stack[current_scope].loc_count = view.loc_count;
+    return ret;
+}
+
+void symtab_destroy(void) {
+    while (arena_first != NULL) {
+        arena_chunk_t *next = arena_first->next;
+        free(arena_first);
+        arena_first = next;
+    }
+    arena_current = NULL;
+    free(symtab_stack);
+    symtab_stack = NULL;
+    scope_capacity = 0;
+    current_scope = -1;
+}
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "ast.h"           // For ast_id type
 #include "file_location.h" // For file_location
+#include "id_attrs.h"      // For id_attrs
 
 // Enum for symbol kinds
 typedef enum {
@@ -17,16 +18,46 @@ typedef struct sym_entry {
     char *name;
     sym_kind_t kind;
     int value;                // For constants; variables and procedures may not need this
+    id_attrs *attrs;          // Declaration's attributes (outlive the scope)
     struct sym_entry *next;   // For chaining in case of hash collisions
 } sym_entry_t;
 
+// A read-only view of the scopes in effect at some point of the checking;
+// it stays valid (and may be shared between threads) as long as
+// the scopes it includes are not exited or added to
+typedef struct {
+    const struct scope_s *scopes; // the outer scopes
+    int depth;                    // number of scopes (including the innermost)
+    sym_entry_t *entries;         // the innermost scope's entries at the time
+    unsigned int loc_count;       // and its number of constants and variables
+} symtab_view_t;
+
 // Symbol table functions
+// (each thread has its own symbol table; these work on the calling thread's)
 void symtab_initialize(void);
 void symtab_finalize(void);
 void symtab_enter_scope(void);
 void symtab_exit_scope(void);
-void symtab_insert(const char *name, sym_kind_t kind, int value, file_location *loc);
+void symtab_insert(const char *name, sym_kind_t kind, int value, id_attrs *attrs);
+// Number of constants and variables declared so far in the current scope
+// (this is the offset_count for the next declaration)
+unsigned int symtab_scope_loc_count(void);
 sym_entry_t *symtab_lookup(const char *name);
+// Like symtab_lookup, but also sets *levels_outward to the number of scopes
+// outward from the current scope where the name was found
+sym_entry_t *symtab_lookup_levels(const char *name, unsigned int *levels_outward);
 sym_entry_t *symtab_lookup_current_scope(const char *name);
+// Return a view of the scopes currently in effect
+symtab_view_t symtab_view(void);
+// Replace all the scopes with (copies of) those in view;
+// declarations made after this go into new scopes, not into the view's
+void symtab_enter_view(symtab_view_t view);
+// Requires: view was returned by symtab_view (on this thread)
+//           in the current scope, which has not been exited since
+// Go back to the declarations that the current scope had when view was
+// taken, returning a view of its current ones (to come back to them later)
+symtab_view_t symtab_set_view(symtab_view_t view);
+// Free all of the memory used by the symbol table
+void symtab_destroy(void);
 
 #endif // SYMTAB_H
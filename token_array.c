@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include "token_array.h"
+#include "utilities.h"
+
+// Make ta empty (freeing any tokens it had)
+void token_array_clear(token_array *ta)
+{
+    free(ta->tokens);
+    ta->tokens = NULL;
+    ta->count = 0;
+    ta->capacity = 0;
+}
+
+// Add a token with the given kind, location, and text id to the end of ta
+void token_array_add(token_array *ta, int kind, file_location loc,
+		     unsigned int text)
+{
+    if (ta->count == ta->capacity) {
+	ta->capacity = (ta->capacity == 0) ? 4096 : 2 * ta->capacity;
+	ta->tokens = (token_rec *)
+	    realloc(ta->tokens, ta->capacity * sizeof(token_rec));
+	if (ta->tokens == NULL) {
+	    bail_with_error("No space for the token array!");
+	}
+    }
+    token_rec *t = &ta->tokens[ta->count++];
+    t->kind = kind;
+    t->loc = loc;
+    t->text = text;
+}
@@ -0,0 +1,31 @@
+#ifndef _TOKEN_ARRAY_H
+#define _TOKEN_ARRAY_H
+#include "file_location.h"
+
+// The kind of the entries for lexical errors, which are kept in order
+// with the tokens so that the messages can be reported when reached
+#define TOKEN_LEXICAL_ERROR (-1)
+
+// A token (or lexical error) read by the lexer
+typedef struct {
+    file_location loc;   // where the token starts
+    int kind;            // token code (from spl.tab.h) or TOKEN_LEXICAL_ERROR
+    unsigned int text;   // id (see intern.h) of the token's text
+                         // (or of the error message)
+} token_rec;
+
+// A growable array of tokens, in the order they were read
+typedef struct {
+    token_rec *tokens;
+    unsigned int count;
+    unsigned int capacity;
+} token_array;
+
+// Make ta empty (freeing any tokens it had)
+extern void token_array_clear(token_array *ta);
+
+// Add a token with the given kind, location, and text id to the end of ta
+extern void token_array_add(token_array *ta, int kind, file_location loc,
+			    unsigned int text);
+
+#endif
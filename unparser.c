@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <assert.h>
 #include "unparser.h"
+#include "ast_walk.h"
+#include "parser.h"
 #include "utilities.h"
 
 // Amount of spaces to indent per nesting level
@@ -23,11 +25,258 @@ static void newlineAndOptionalSemi(FILE *out, bool addSemiToEnd)
     fprintf(out, "%s\n", (addSemiToEnd ? ";" : ""));
 }
 
-// Unparse the given program AST and then print a period and an newline
-void unparseProgram(FILE *out, block_t prog)
+// The state of an unparsing walk over an AST (see ast_walk.h)
+typedef struct {
+    FILE *out;
+    int level;        // the current nesting level
+    void *root;       // the node the walk started from
+    bool root_semi;   // add a semicolon after root (when it is a stmt)?
+} unparse_state;
+
+// The walk's pre callback: print what comes before node's children
+static bool unparse_pre(void *node, AST_type t, void *data)
+{
+    unparse_state *us = (unparse_state *) data;
+    FILE *out = us->out;
+    switch (t) {
+    case block_ast:
+	indent(out, us->level);
+	fprintf(out, "begin\n");
+	us->level++;
+	break;
+    case const_decls_ast:
+	assert(((const_decls_t *) node)->type_tag == const_decls_ast);
+	break;
+    case const_decl_ast:
+	indent(out, us->level);
+	fprintf(out, "const ");
+	break;
+    case const_def_ast:
+	unparseConstDef(out, *(const_def_t *) node, us->level);
+	break;
+    case var_decls_ast:
+	assert(((var_decls_t *) node)->type_tag == var_decls_ast);
+	break;
+    case var_decl_ast:
+	indent(out, us->level);
+	fprintf(out, "var");
+	break;
+    case ident_ast:
+	fprintf(out, " %s", ((ident_t *) node)->name);
+	break;
+    case proc_decls_ast:
+	assert(((proc_decls_t *) node)->type_tag == proc_decls_ast);
+	break;
+    case proc_decl_ast:
+	indent(out, us->level);
+	fprintf(out, "proc %s\n", ((proc_decl_t *) node)->name);
+	break;
+    case stmt_ast: {
+	stmt_t *s = (stmt_t *) node;
+	assert(s->type_tag == stmt_ast);
+	switch (s->stmt_kind) {
+	case assign_stmt:
+	    assert(s->data.assign_stmt.type_tag == assign_stmt_ast);
+	    indent(out, us->level);
+	    fprintf(out, "%s := ", s->data.assign_stmt.name);
+	    if (s->data.assign_stmt.expr == NULL) {
+		bail_with_error("Found null expression in assignment statment!");
+	    }
+	    break;
+	case call_stmt:
+	    indent(out, us->level);
+	    fprintf(out, "call %s", s->data.call_stmt.name);
+	    break;
+	case if_stmt:
+	    indent(out, us->level);
+	    fprintf(out, "if ");
+	    break;
+	case while_stmt:
+	    indent(out, us->level);
+	    fprintf(out, "while ");
+	    break;
+	case read_stmt:
+	    indent(out, us->level);
+	    fprintf(out, "read %s", s->data.read_stmt.name);
+	    break;
+	case print_stmt:
+	    indent(out, us->level);
+	    fprintf(out, "print ");
+	    break;
+	case block_stmt:
+	    // the block is indented by itself
+	    break;
+	default:
+	    bail_with_error("Unknown stmt_kind (%d) in unparseStmt!",
+			    s->stmt_kind);
+	    break;
+	}
+	break;
+    }
+    case condition_ast:
+	if (((condition_t *) node)->cond_kind == ck_db) {
+	    fprintf(out, "divisible ");
+	}
+	break;
+    case expr_ast: {
+	expr_t *exp = (expr_t *) node;
+	switch (exp->expr_kind) {
+	case expr_bin:
+	    fprintf(out, "(");
+	    break;
+	case expr_negated:
+	    fprintf(out, "-(");
+	    break;
+	case expr_ident:
+	    unparseIdent(out, exp->data.ident);
+	    break;
+	case expr_number:
+	    unparseNumber(out, exp->data.number);
+	    break;
+	default:
+	    bail_with_error("Unexpected expr_kind_e (%d) in unparseExpr!",
+			    exp->expr_kind);
+	    break;
+	}
+	break;
+    }
+    default:
+	break;
+    }
+    return true;
+}
+
+// The walk's between callback: print what comes after node's i-th child
+// and before the next one
+static void unparse_between(void *node, AST_type t, int i, void *data)
 {
+    unparse_state *us = (unparse_state *) data;
+    FILE *out = us->out;
+    switch (t) {
+    case const_decl_ast:
+	fprintf(out, ", ");
+	break;
+    case var_decl_ast:
+	fprintf(out, ",");
+	break;
+    case stmt_ast: {
+	stmt_t *s = (stmt_t *) node;
+	if (s->stmt_kind == if_stmt) {
+	    if (i == 0) {
+		// after the condition, before the then stmts
+		fprintf(out, "\n");
+		indent(out, us->level);
+		fprintf(out, "then\n");
+		us->level++;
+	    } else {
+		// after the then stmts, before the else stmts
+		us->level--;
+		indent(out, us->level);
+		fprintf(out, "else\n");
+		us->level++;
+	    }
+	} else if (s->stmt_kind == while_stmt) {
+	    // after the condition, before the body
+	    fprintf(out, "\n");
+	    indent(out, us->level);
+	    fprintf(out, "do\n");
+	    us->level++;
+	}
+	break;
+    }
+    case condition_ast: {
+	condition_t *cond = (condition_t *) node;
+	switch (cond->cond_kind) {
+	case ck_db:
+	    fprintf(out, " by ");
+	    break;
+	case ck_rel:
+	    fprintf(out, " ");
+	    unparseToken(out, cond->data.rel_op_cond.rel_op);
+	    fprintf(out, " ");
+	    break;
+	default:
+	    bail_with_error("Unexpected condition_kind_e (%d) in unparseCondition!",
+			    cond->cond_kind);
+	    break;
+	}
+	break;
+    }
+    case expr_ast:
+	fprintf(out, " ");
+	unparseToken(out, ((expr_t *) node)->data.binary.arith_op);
+	fprintf(out, " ");
+	break;
+    default:
+	break;
+    }
+}
+
+// The walk's post callback: print what comes after node's children
+static void unparse_post(void *node, AST_type t, void *data)
+{
+    unparse_state *us = (unparse_state *) data;
+    FILE *out = us->out;
+    switch (t) {
+    case block_ast:
+	// the newline (and semicolon) after "end" is printed by the context
+	us->level--;
+	indent(out, us->level);
+	fprintf(out, "end");
+	break;
+    case const_decl_ast: case var_decl_ast:
+	fprintf(out, ";\n");
+	break;
+    case proc_decl_ast:
+	newlineAndOptionalSemi(out, true);
+	break;
+    case stmt_ast: {
+	stmt_t *s = (stmt_t *) node;
+	if (s->stmt_kind == if_stmt || s->stmt_kind == while_stmt) {
+	    us->level--;
+	    indent(out, us->level);
+	    fprintf(out, "end");
+	}
+	// statements in a list are separated by semicolons
+	newlineAndOptionalSemi(out, (node == us->root) ? us->root_semi
+				                        : (s->next != NULL));
+	break;
+    }
+    case expr_ast: {
+	expr_kind_e kind = ((expr_t *) node)->expr_kind;
+	if (kind == expr_bin || kind == expr_negated) {
+	    fprintf(out, ")");
+	}
+	break;
+    }
+    default:
+	break;
+    }
+}
+
+// Unparse node, which is an AST of type t (see ast_walk.h), to out,
+// starting at the given nesting level;
+// if node is a statement, add a semicolon to its end if addSemiToEnd is true.
+static void unparseWalk(FILE *out, void *node, AST_type t, int level,
+			bool addSemiToEnd)
+{
+    unparse_state us = { out, level, node, addSemiToEnd };
+    ast_visitor v = { unparse_pre, unparse_between, unparse_post, &us };
+    ast_walk(node, t, &v);
+}
+
+// Unparse the given program AST and then print a period and an newline;
+// if one of its skipped procedure bodies (see parser.h) has syntax errors,
+// print nothing and return false (after reporting them)
+bool unparseProgram(FILE *out, block_t prog)
+{
+    // (the bodies are parsed first, so the output is not left unfinished)
+    if (!parser_proc_bodies(&prog)) {
+	return false;
+    }
     unparseBlock(out, prog, 0, false);
     fprintf(out, ".\n");
+    return true;
 }
 
 // Unparse the given block, indented by the given level, to out
@@ -35,14 +284,7 @@ void unparseProgram(FILE *out, block_t prog)
 extern void unparseBlock(FILE *out, block_t blk, int level,
 			 bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "begin\n");
-    unparseConstDecls(out, blk.const_decls, level+1);
-    unparseVarDecls(out, blk.var_decls, level+1);
-    unparseProcDecls(out, blk.proc_decls, level+1);
-    unparseStmts(out, blk.stmts, level+1);
-    indent(out, level);
-    fprintf(out, "end");
+    unparseWalk(out, &blk, block_ast, level, false);
     newlineAndOptionalSemi(out, addSemiToEnd);
 }
 
@@ -51,23 +293,14 @@ extern void unparseBlock(FILE *out, block_t blk, int level,
 // (note that if cds == NULL, then nothing is printed)
 void unparseConstDecls(FILE *out, const_decls_t cds, int level)
 {
-    // debug_print("unparseConstDecls entry ...\n");
-    assert(cds.type_tag == const_decls_ast);
-    const_decl_t *cd_listp = cds.start;
-    while (cd_listp != NULL) {
-	unparseConstDecl(out, *cd_listp, level);
-	cd_listp = cd_listp->next;
-    }
+    unparseWalk(out, &cds, const_decls_ast, level, false);
 }
 
 // Unparse a single const-def given by the AST cd to out,
 // indented for the given nesting level
 void unparseConstDecl(FILE *out, const_decl_t cd, int level)
 {
-    // debug_print("unparseConstDecl entry ...\n");
-    indent(out, level);
-    fprintf(out, "const ");
-    unparseConstDefList(out, cd.const_def_list, level);
+    unparseWalk(out, &cd, const_decl_ast, level, false);
 }
 
 // Unparse the list of const-defs given by the AST cdl to out
@@ -101,24 +334,14 @@ extern void unparseConstDef(FILE *out, const_def_t cdf, int level)
 // (note that if vds.var_decls == NULL, then nothing is printed)
 void unparseVarDecls(FILE *out, var_decls_t vds, int level)
 {
-    // debug_print("Entering unparseVarDecls ...\n");
-    assert(vds.type_tag == var_decls_ast);
-    var_decl_t *vdp = vds.var_decls;
-    while (vdp != NULL) {
-	unparseVarDecl(out, *vdp, level);
-	vdp = vdp->next;
-    }
+    unparseWalk(out, &vds, var_decls_ast, level, false);
 }
 
 // Unparse a single var-decl given by the AST vd to out,
 // indented for the given nesting level
 void unparseVarDecl(FILE *out, var_decl_t vd, int level)
 {
-    // debug_print("Entering unparseVarDecl ...\n");
-    indent(out, level);
-    fprintf(out, "var");
-    unparseIdentList(out, vd.ident_list);
-    fprintf(out, ";\n");
+    unparseWalk(out, &vd, var_decl_ast, level, false);
 }
 
 // Unparse the identifiers in idents to out, with a space before each,
@@ -129,8 +352,6 @@ void unparseIdentList(FILE *out, ident_list_t ident_list)
     ident_t *ip = ident_list.start;
     bool already_printed =false;
     while (ip != NULL) {
-	// debug_print("in unparseIdents ip is %x\n", ip);
-	// debug_print("in unparseIdents ip->name is %s\n", ip->name);
 	if (already_printed) {
 	    fprintf(out, ", %s", ip->name);
 	} else {
@@ -146,23 +367,14 @@ void unparseIdentList(FILE *out, ident_list_t ident_list)
 // (note that if pds.proc_decls is NULL, then nothing is printed)
 void unparseProcDecls(FILE *out, proc_decls_t pds, int level)
 {
-    // debug_print("unparseProcDecls entry ...\n");
-    assert(pds.type_tag == proc_decls_ast);
-    proc_decl_t *pdp = pds.proc_decls;
-    while (pdp != NULL) {
-	unparseProcDecl(out, *pdp, level);
-	pdp = pdp ->next;
-    }
+    unparseWalk(out, &pds, proc_decls_ast, level, false);
 }
 
 // Unparse the given proc-decl given by the AST pd to out
 // with the given nesting level followed by a semicolon
 void unparseProcDecl(FILE *out, proc_decl_t pd, int level)
 {
-    // debug_print("unparseProcDecl entry ...\n");
-    indent(out, level);
-    fprintf(out, "proc %s\n", pd.name);
-    unparseBlock(out, *(pd.block), level, true);
+    unparseWalk(out, &pd, proc_decl_ast, level, false);
 }
 
 
@@ -171,12 +383,7 @@ void unparseProcDecl(FILE *out, proc_decl_t pd, int level)
 // (The statements always occur before an end, so a semicolon is never added.)
 void unparseStmts(FILE *out, stmts_t stmts, int level)
 {
-    // indent(out, level);
-    // fprintf(out, "%% stmts at level %d\n", level);
-    if (stmts.stmts_kind != empty_stmts_e) {
-	stmt_list_t sl = stmts.stmt_list;
-	unparseStmtList(out, sl, level, false);
-    }
+    unparseWalk(out, &stmts, stmts_ast, level, false);
 }
 
 // Unparse the stmts given by stmt to out
@@ -185,8 +392,6 @@ void unparseStmts(FILE *out, stmts_t stmts, int level)
 void unparseStmtList(FILE *out, stmt_list_t stmt_list, int level,
 		     bool addSemiToEnd)
 {
-    // indent(out, level);
-    // fprintf(out, "%% stmtList at level %d\n", level);    
     stmt_t *s = stmt_list.start;
     while (s != NULL) {
 	unparseStmt(out, *s, level, addSemiToEnd || (s->next != NULL));
@@ -199,36 +404,7 @@ void unparseStmtList(FILE *out, stmt_list_t stmt_list, int level,
 // adding a semicolon to the end if addSemiToENd is true.
 void unparseStmt(FILE *out, stmt_t stmt, int level, bool addSemiToEnd)
 {
-    // debug_print("In unparseStmt stmt.type_tag is %d\n", stmt.type_tag);
-    assert(stmt.type_tag == stmt_ast);
-    switch (stmt.stmt_kind) {
-    case assign_stmt:
-	assert(stmt.data.assign_stmt.type_tag == assign_stmt_ast);
-	unparseAssignStmt(out, stmt.data.assign_stmt, level, addSemiToEnd);
-	break;
-    case call_stmt:
-	unparseCallStmt(out, stmt.data.call_stmt, level, addSemiToEnd);
-	break;
-    case if_stmt:
-	unparseIfStmt(out, stmt.data.if_stmt, level, addSemiToEnd);
-	break;
-    case while_stmt:
-	unparseWhileStmt(out, stmt.data.while_stmt, level, addSemiToEnd);
-	break;
-    case read_stmt:
-	unparseReadStmt(out, stmt.data.read_stmt, level, addSemiToEnd);
-	break;
-    case print_stmt:
-	unparsePrintStmt(out, stmt.data.print_stmt, level, addSemiToEnd);
-	break;
-    case block_stmt:
-	unparseBlockStmt(out, stmt.data.block_stmt, level, addSemiToEnd);
-	break;
-    default:
-	bail_with_error("Unknown stmt_kind (%d) in unparseStmt!",
-			stmt.stmt_kind);
-	break;
-    }
+    unparseWalk(out, &stmt, stmt_ast, level, addSemiToEnd);
 }
 
 // Unparse the assignment statment given by stmt to out
@@ -237,13 +413,7 @@ void unparseStmt(FILE *out, stmt_t stmt, int level, bool addSemiToEnd)
 void unparseAssignStmt(FILE *out, assign_stmt_t stmt, int level,
 			      bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "%s := ", stmt.name);
-    if (stmt.expr == NULL) {
-	bail_with_error("Found null expression in assignment statment!");
-    }
-    unparseExpr(out, *(stmt.expr));
-    newlineAndOptionalSemi(out, addSemiToEnd);
+    unparseStmt(out, ast_stmt_assign(stmt), level, addSemiToEnd);
 }
 
 // Unparse the call statment given by stmt to out
@@ -252,9 +422,7 @@ void unparseAssignStmt(FILE *out, assign_stmt_t stmt, int level,
 void unparseCallStmt(FILE *out, call_stmt_t stmt, int level,
 			    bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "call %s", stmt.name);
-    newlineAndOptionalSemi(out, addSemiToEnd);
+    unparseStmt(out, ast_stmt_call(stmt), level, addSemiToEnd);
 }
 
 // Unparse the sequential statment given by stmt to out
@@ -271,21 +439,7 @@ void unparseBlockStmt(FILE *out, block_stmt_t stmt, int level,
 // and add a semicolon at the end if addSemiToEnd is true.
 void unparseIfStmt(FILE *out, if_stmt_t stmt, int level, bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "if ");
-    unparseCondition(out, stmt.condition);
-    fprintf(out, "\n");
-    indent(out, level);
-    fprintf(out, "then\n");
-    unparseStmts(out, *(stmt.then_stmts), level+1);
-    if (stmt.else_stmts != NULL) {
-	indent(out, level);
-	fprintf(out, "else\n");
-	unparseStmts(out, *(stmt.else_stmts), level+1);
-    }
-    indent(out, level);
-    fprintf(out, "end");
-    newlineAndOptionalSemi(out, addSemiToEnd);
+    unparseStmt(out, ast_stmt_if(stmt), level, addSemiToEnd);
 }
 
 // Unparse the while-statment given by stmt to out
@@ -294,25 +448,14 @@ void unparseIfStmt(FILE *out, if_stmt_t stmt, int level, bool addSemiToEnd)
 void unparseWhileStmt(FILE *out, while_stmt_t stmt, int level,
 		      bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "while ");
-    unparseCondition(out, stmt.condition);
-    fprintf(out, "\n");
-    indent(out, level);
-    fprintf(out, "do\n");
-    unparseStmts(out, *(stmt.body), level+1);
-    indent(out, level);
-    fprintf(out, "end");
-    newlineAndOptionalSemi(out, addSemiToEnd);
+    unparseStmt(out, ast_stmt_while(stmt), level, addSemiToEnd);
 }
 
 // Unparse the read statment given by stmt to out
 // and add a semicolon at the end if addSemiToEnd is true.
 void unparseReadStmt(FILE *out, read_stmt_t stmt, int level, bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "read %s", stmt.name);
-    newlineAndOptionalSemi(out, addSemiToEnd);
+    unparseStmt(out, ast_stmt_read(stmt), level, addSemiToEnd);
 }
 
 // Unparse the write statment given by stmt to out
@@ -320,46 +463,25 @@ void unparseReadStmt(FILE *out, read_stmt_t stmt, int level, bool addSemiToEnd)
 void unparsePrintStmt(FILE *out, print_stmt_t stmt, int level,
 		      bool addSemiToEnd)
 {
-    indent(out, level);
-    fprintf(out, "print ");
-    unparseExpr(out, stmt.expr);
-    newlineAndOptionalSemi(out, addSemiToEnd);
+    unparseStmt(out, ast_stmt_print(stmt), level, addSemiToEnd);
 }
 
 // Unparse the condition given by cond to out
 void unparseCondition(FILE *out, condition_t cond)
 {
-    switch (cond.cond_kind) {
-    case ck_db:
-	unparseDbCond(out, cond.data.db_cond);
-	break;
-    case ck_rel:
-	unparseRelOpCond(out, cond.data.rel_op_cond);
-	break;
-    default:
-	bail_with_error("Unexpected condition_kind_e (%d) in unparseCondition!",
-			cond.cond_kind);
-	break;
-    }
+    unparseWalk(out, &cond, condition_ast, 0, false);
 }
 
 // Unparse the odd condition given by cond to out
 void unparseDbCond(FILE *out, db_condition_t dbcond)
 {
-    fprintf(out, "divisible ");
-    unparseExpr(out, dbcond.dividend);
-    fprintf(out, " by ");
-    unparseExpr(out, dbcond.divisor);
+    unparseCondition(out, ast_condition_db(dbcond));
 }
 
 // Unparse the binary relation condition given by cond to out
 void unparseRelOpCond(FILE *out, rel_op_condition_t cond)
 {
-    unparseExpr(out, cond.expr1);
-    fprintf(out, " ");
-    unparseToken(out, cond.rel_op);
-    fprintf(out, " ");
-    unparseExpr(out, cond.expr2);
+    unparseCondition(out, ast_condition_rel_op(cond));
 }
 
 // Unparse the given token, t, to out
@@ -372,46 +494,26 @@ void unparseToken(FILE *out, token_t t)
 // adding parentheses to indicate the nesting relationships
 void unparseExpr(FILE *out, expr_t exp)
 {
-    switch (exp.expr_kind) {
-    case expr_bin:
-	unparseBinOpExpr(out, exp.data.binary);
-	break;
-    case expr_negated:
-	unparseNegatedExpr(out, exp.data.negated);
-	break;
-    case expr_ident:
-	unparseIdent(out, exp.data.ident);
-	break;
-    case expr_number:
-	unparseNumber(out, exp.data.number);
-	break;
-    default:
-	bail_with_error("Unexpected expr_kind_e (%d) in unparseExpr!",
-			exp.expr_kind);
-	break;
-    }
+    unparseWalk(out, &exp, expr_ast, 0, false);
 }
 
 // Unparse the expression given by the AST exp to out
 // adding parentheses (whether needed or not)
 void unparseBinOpExpr(FILE *out, binary_op_expr_t exp)
 {
-    fprintf(out, "(");
-    unparseExpr(out, *(exp.expr1));
-    fprintf(out, " ");
-    unparseToken(out, exp.arith_op);
-    fprintf(out, " ");
-    unparseExpr(out, *(exp.expr2));
-    fprintf(out, ")");
+    unparseExpr(out, ast_expr_binary_op(exp));
 }
 
 // Unparse the expression given by the AST exp to out
 // adding parentheses (whether needed or not)
 void unparseNegatedExpr(FILE *out, negated_expr_t exp)
 {
-    fprintf(out, "-(");
-    unparseExpr(out, *(exp.expr));
-    fprintf(out, ")");
+    expr_t e;
+    e.file_loc = exp.file_loc;
+    e.type_tag = expr_ast;
+    e.expr_kind = expr_negated;
+    e.data.negated = exp;
+    unparseExpr(out, e);
 }
 
 // Unparse the given identifier reference (i.e., identifier use), id, to out
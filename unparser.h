@@ -4,8 +4,10 @@
 #include <stdio.h>
 #include "ast.h"
 
-// Unparse the given program AST and then print a period and an newline
-extern void unparseProgram(FILE *out, block_t prog);
+// Unparse the given program AST and then print a period and an newline;
+// if one of its skipped procedure bodies (see parser.h) has syntax errors,
+// print nothing and return false (after reporting them)
+extern bool unparseProgram(FILE *out, block_t prog);
 
 // Unparse the given block, indented by the given level, to out
 // adding a semicolon to the end if addSemiToEnd is true.
@@ -78,7 +78,8 @@ void bail_with_prog_error(file_location floc, const char *fmt, ...)
 {
     fflush(stdout); // flush so output comes after what has happened already
     // print file, line, column information
-    fprintf(stderr, "%s: line %d ", floc.filename, floc.line);
+    fprintf(stderr, "%s: line %u ", file_location_filename(floc),
+	    file_location_line(floc));
 
     va_list(args);
     va_start(args, fmt);
@@ -103,6 +104,26 @@ extern void formatted_yyerror(const char *filename, const char *fmt, ...)
 }
 
 
+// Make the array *items (of *size elements of elem_size bytes)
+// hold at least need elements, growing it by doubling its size;
+// if there is no space, bail with an error saying there is
+// "No space to " followed by what
+void reserve_array(void **items, unsigned int *size, size_t elem_size,
+		   unsigned int need, const char *what)
+{
+    if (need <= *size) {
+	return;
+    }
+    unsigned int new_size = (*size == 0) ? 64 : *size;
+    while (new_size < need) {
+	new_size *= 2;
+    }
+    *items = realloc(*items, (size_t) new_size * elem_size);
+    if (*items == NULL) {
+	bail_with_error("No space to %s!", what);
+    }
+    *size = new_size;
+}
     
 // print a newline on out and flush out
 void newline(FILE *out)
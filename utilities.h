@@ -35,6 +35,14 @@ extern void bail_with_prog_error(file_location floc, const char *fmt, ...);
 // and then the formatted message (as in sprintf)
 extern void formatted_yyerror(const char *filename, const char *fmt, ...);
 
+// Make the array *items (of *size elements of elem_size bytes)
+// hold at least need elements, growing it by doubling its size;
+// if there is no space, bail with an error saying there is
+// "No space to " followed by what
+extern void reserve_array(void **items, unsigned int *size,
+			  size_t elem_size, unsigned int need,
+			  const char *what);
+
 // print a newline on out and flush out
 extern void newline(FILE *out);
 
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "vm.h"
+#include "utilities.h"
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO
+#endif
+
+// Each activation record starts with a header of HEADER_WORDS words:
+// its static link (the start of the record of the block it is declared
+// in), the start of the record in use before it, and the return address;
+// its slots (for the constants and variables of its block) follow
+#define HEADER_WORDS 3
+#define STATIC_LINK 0
+#define DYNAMIC_LINK 1
+#define RETURN_ADDRESS 2
+
+// The most words that the stack of activation records may hold
+#define MAX_STACK_WORDS (1u << 24)
+
+// The stack of activation records
+static word_type *stack = NULL;
+static size_t stack_size = 0;
+
+// Report the run-time error described by fmt (which may use name)
+// for the instruction at pc in bc
+static void vm_error(const bytecode *bc, const word_type *pc,
+		     const char *fmt, const char *name)
+{
+    const bytecode_loc *l = bytecode_location(bc, pc - bc->code);
+    errno = 0;
+    bail_with_prog_error(l->loc, fmt, name);
+}
+
+// Make the stack hold at least need words,
+// reporting a run-time error for the instruction at pc in bc if it can't
+static void grow_stack(size_t need, const bytecode *bc, const word_type *pc)
+{
+    if (need > MAX_STACK_WORDS) {
+	vm_error(bc, pc, "the run-time stack is full (too many nested calls)!",
+		 NULL);
+    }
+    size_t new_size = (stack_size == 0) ? 1024 : stack_size;
+    while (new_size < need) {
+	new_size *= 2;
+    }
+    stack = (word_type *) realloc(stack, new_size * sizeof(word_type));
+    if (stack == NULL) {
+	bail_with_error("No space for the run-time stack!");
+    }
+    stack_size = new_size;
+}
+
+// Requires: bc was returned by bytecode_compile
+// Run bc, reporting a run-time error (on stderr, with its location)
+// and exiting with a failure code if one happens;
+// return the number of instructions executed
+uint64_t vm_run(const bytecode *bc)
+{
+    const word_type *code = bc->code;
+    const word_type *pc = code;
+    // the operand stack (osp is just past its top value)
+    word_type *operands = (word_type *)
+	malloc((bc->max_depth + 1) * sizeof(word_type));
+    if (operands == NULL) {
+	bail_with_error("No space for the operand stack!");
+    }
+    word_type *osp = operands;
+    // the start of the record in use, and its slots,
+    // and where the next record goes
+    size_t fp = 0;
+    word_type *slots = NULL;
+    size_t sp = 0;
+    uint64_t executed = 0;
+    word_type a, b;
+    size_t f;
+
+    // Return the start of the record levels static links out
+    // from the one in use (in f)
+#define OUTER(levels)					\
+    do {						\
+	f = fp;						\
+	for (word_type l = (levels); l > 0; l--) {	\
+	    f = (size_t) stack[f + STATIC_LINK];	\
+	}						\
+    } while (0)
+
+#ifdef VM_COMPUTED_GOTO
+    static const void *const labels[BYTECODE_NUM_OPS] = {
+	[op_halt] = &&do_op_halt, [op_push] = &&do_op_push,
+	[op_load] = &&do_op_load, [op_load_outer] = &&do_op_load_outer,
+	[op_store] = &&do_op_store, [op_store_outer] = &&do_op_store_outer,
+	[op_read] = &&do_op_read, [op_print] = &&do_op_print,
+	[op_add] = &&do_op_add, [op_sub] = &&do_op_sub,
+	[op_mul] = &&do_op_mul, [op_div] = &&do_op_div,
+	[op_neg] = &&do_op_neg, [op_jump] = &&do_op_jump,
+	[op_jump_unless_eq] = &&do_op_jump_unless_eq,
+	[op_jump_unless_ne] = &&do_op_jump_unless_ne,
+	[op_jump_unless_lt] = &&do_op_jump_unless_lt,
+	[op_jump_unless_le] = &&do_op_jump_unless_le,
+	[op_jump_unless_gt] = &&do_op_jump_unless_gt,
+	[op_jump_unless_ge] = &&do_op_jump_unless_ge,
+	[op_jump_unless_divisible] = &&do_op_jump_unless_divisible,
+	[op_call] = &&do_op_call, [op_enter] = &&do_op_enter,
+	[op_return] = &&do_op_return, [op_block] = &&do_op_block,
+	[op_leave] = &&do_op_leave,
+	[op_assign_constant] = &&do_op_assign_constant,
+	[op_div_const] = &&do_op_div_const,
+	[op_jump_unless_divisible_const] = &&do_op_jump_unless_divisible_const
+    };
+#define INSTRUCTION(op) do_##op
+#define NEXT() do { executed++; goto *labels[*pc]; } while (0)
+    NEXT();
+#else
+#define INSTRUCTION(op) case op
+#define NEXT() do { executed++; goto dispatch; } while (0)
+    executed++;
+ dispatch:
+    switch ((bytecode_op) *pc) {
+#endif
+
+    // (in the jumps, pc is only moved on if the relation holds)
+#define JUMP_UNLESS(rel)			\
+    b = *--osp;					\
+    a = *--osp;					\
+    pc = (rel) ? pc + 2 : code + pc[1];		\
+    NEXT()
+
+    INSTRUCTION(op_push):
+	*osp++ = pc[1];
+	pc += 2;
+	NEXT();
+    INSTRUCTION(op_load):
+	*osp++ = slots[pc[1]];
+	pc += 2;
+	NEXT();
+    INSTRUCTION(op_load_outer):
+	OUTER(pc[1]);
+	*osp++ = stack[f + HEADER_WORDS + pc[2]];
+	pc += 3;
+	NEXT();
+    INSTRUCTION(op_store):
+	slots[pc[1]] = *--osp;
+	pc += 2;
+	NEXT();
+    INSTRUCTION(op_store_outer):
+	OUTER(pc[1]);
+	stack[f + HEADER_WORDS + pc[2]] = *--osp;
+	pc += 3;
+	NEXT();
+    INSTRUCTION(op_read): {
+	int ch = getchar();
+	OUTER(pc[1]);
+	stack[f + HEADER_WORDS + pc[2]] = (ch == EOF) ? -1 : ch;
+	pc += 3;
+	NEXT();
+    }
+    INSTRUCTION(op_print):
+	printf("%d\n", *--osp);
+	pc++;
+	NEXT();
+    INSTRUCTION(op_add):
+	b = *--osp;
+	osp[-1] = (word_type) ((unsigned int) osp[-1] + (unsigned int) b);
+	pc++;
+	NEXT();
+    INSTRUCTION(op_sub):
+	b = *--osp;
+	osp[-1] = (word_type) ((unsigned int) osp[-1] - (unsigned int) b);
+	pc++;
+	NEXT();
+    INSTRUCTION(op_mul):
+	b = *--osp;
+	osp[-1] = (word_type) ((unsigned int) osp[-1] * (unsigned int) b);
+	pc++;
+	NEXT();
+    INSTRUCTION(op_div):
+	b = *--osp;
+	if (b == 0) {
+	    vm_error(bc, pc, "division by zero!", NULL);
+	}
+	// (the most negative word divided by -1 wraps around to itself)
+	osp[-1] = (b == -1) ? (word_type) (0u - (unsigned int) osp[-1])
+	    : osp[-1] / b;
+	pc++;
+	NEXT();
+    INSTRUCTION(op_div_const):
+	osp[-1] = bytecode_divide_const(&bc->divisors[pc[1]], osp[-1]);
+	pc += 2;
+	NEXT();
+    INSTRUCTION(op_neg):
+	osp[-1] = (word_type) (0u - (unsigned int) osp[-1]);
+	pc++;
+	NEXT();
+    INSTRUCTION(op_jump):
+	pc = code + pc[1];
+	NEXT();
+    INSTRUCTION(op_jump_unless_eq):
+	JUMP_UNLESS(a == b);
+    INSTRUCTION(op_jump_unless_ne):
+	JUMP_UNLESS(a != b);
+    INSTRUCTION(op_jump_unless_lt):
+	JUMP_UNLESS(a < b);
+    INSTRUCTION(op_jump_unless_le):
+	JUMP_UNLESS(a <= b);
+    INSTRUCTION(op_jump_unless_gt):
+	JUMP_UNLESS(a > b);
+    INSTRUCTION(op_jump_unless_ge):
+	JUMP_UNLESS(a >= b);
+    INSTRUCTION(op_jump_unless_divisible):
+	if (osp[-1] == 0) {
+	    vm_error(bc, pc, "division by zero!", NULL);
+	}
+	JUMP_UNLESS(b == -1 || a % b == 0);
+    INSTRUCTION(op_jump_unless_divisible_const):
+	a = *--osp;
+	pc = bytecode_divisible_const(&bc->divisors[pc[1]], a)
+	    ? pc + 3 : code + pc[2];
+	NEXT();
+    INSTRUCTION(op_call): {
+	// (the callee's code starts with op_enter, giving its record's size)
+	size_t need = sp + HEADER_WORDS + code[pc[2] + 1];
+	if (need > stack_size) {
+	    grow_stack(need, bc, pc);
+	}
+	OUTER(pc[1]);
+	stack[sp + STATIC_LINK] = (word_type) f;
+	stack[sp + DYNAMIC_LINK] = (word_type) fp;
+	stack[sp + RETURN_ADDRESS] = (word_type) (pc + 3 - code);
+	fp = sp;
+	sp += HEADER_WORDS;
+	pc = code + pc[2];
+	NEXT();
+    }
+    INSTRUCTION(op_enter):
+	slots = &stack[fp + HEADER_WORDS];
+	memset(slots, 0, pc[1] * sizeof(word_type));
+	sp += pc[1];
+	pc += 2;
+	NEXT();
+    INSTRUCTION(op_return):
+	sp = fp;
+	pc = code + stack[fp + RETURN_ADDRESS];
+	fp = (size_t) stack[fp + DYNAMIC_LINK];
+	slots = &stack[fp + HEADER_WORDS];
+	NEXT();
+    INSTRUCTION(op_block): {
+	size_t need = sp + HEADER_WORDS + pc[1];
+	if (need > stack_size) {
+	    grow_stack(need, bc, pc);
+	}
+	stack[sp + STATIC_LINK] = (word_type) fp;
+	stack[sp + DYNAMIC_LINK] = (word_type) fp;
+	stack[sp + RETURN_ADDRESS] = 0;
+	fp = sp;
+	slots = &stack[fp + HEADER_WORDS];
+	memset(slots, 0, pc[1] * sizeof(word_type));
+	sp = need;
+	pc += 2;
+	NEXT();
+    }
+    INSTRUCTION(op_leave):
+	sp = fp;
+	fp = (size_t) stack[fp + DYNAMIC_LINK];
+	slots = &stack[fp + HEADER_WORDS];
+	pc++;
+	NEXT();
+    INSTRUCTION(op_assign_constant):
+	vm_error(bc, pc, "cannot assign to constant \"%s\"!",
+		 bytecode_location(bc, pc - code)->name);
+	NEXT();
+    INSTRUCTION(op_halt):
+	fflush(stdout);
+	free(operands);
+	return executed;
+#ifndef VM_COMPUTED_GOTO
+    }
+    return executed;
+#endif
+}
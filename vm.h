@@ -0,0 +1,19 @@
+#ifndef _VM_H
+#define _VM_H
+#include <stdint.h>
+#include "bytecode.h"
+
+// A virtual machine that runs the bytecode of SPL programs (see bytecode.h),
+// with the same results (and run-time errors) as the AST interpreter
+// (see interpreter.h). Its instructions are dispatched by computed gotos
+// (with GCC and compilers like it), each instruction jumping straight to
+// the code for the next; elsewhere, or if VM_SWITCH_DISPATCH is defined,
+// a loop around a switch dispatches them.
+
+// Requires: bc was returned by bytecode_compile
+// Run bc, reporting a run-time error (on stderr, with its location)
+// and exiting with a failure code if one happens;
+// return the number of instructions executed
+extern uint64_t vm_run(const bytecode *bc);
+
+#endif
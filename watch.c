@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include "watch.h"
+#include "incremental.h"
+#include "file_location.h"
+#include "utilities.h"
+
+// The events that say a watched file's new text is all there:
+// it was written and closed, or another file was renamed to it
+// (as by editors that save a file by writing a copy and renaming it)
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+// A file being watched
+typedef struct {
+    char *filename;
+    int wd;              // the watch on its directory
+    const char *base;    // its name in that directory
+    bool saved;          // was it saved since it was last compiled?
+} watched_file;
+
+// The file that is being compiled incrementally (NULL if none)
+static watched_file *current = NULL;
+
+// Return the time (in milliseconds) from some fixed point in the past
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Start watching the directory of wf's file, with the inotify instance fd
+static void watch_directory(int fd, watched_file *wf)
+{
+    const char *slash = strrchr(wf->filename, '/');
+    char *dir;
+    if (slash == NULL) {
+	dir = strdup(".");
+	wf->base = wf->filename;
+    } else {
+	// (the directory of "/f.spl" is "/")
+	size_t len = (slash == wf->filename) ? 1 : slash - wf->filename;
+	dir = strndup(wf->filename, len);
+	wf->base = slash + 1;
+    }
+    if (dir == NULL) {
+	bail_with_error("No space to watch %s!", wf->filename);
+    }
+    // (a directory watched for several files gives the same wd each time)
+    wf->wd = inotify_add_watch(fd, dir, WATCH_EVENTS);
+    if (wf->wd < 0) {
+	bail_with_error("Cannot watch %s for changes!", dir);
+    }
+    free(dir);
+    wf->saved = false;
+}
+
+// Compile wf's file, which was saved (if saved is true, otherwise it is
+// compiled for the first time) at time since, printing a line saying so,
+// then what the compiler prints for it and the time taken
+static void compile(watched_file *wf, bool saved, bool unparse, double since)
+{
+    printf(saved ? "%% %s was saved\n" : "%% compiling %s\n", wf->filename);
+    fflush(stdout);
+    // errors are reported (on stderr) as the file is compiled
+    if (current != wf) {
+	incremental_open(wf->filename);
+	current = wf;
+    } else if (!incremental_reload()) {
+	printf("%% its text has not changed\n");
+	fflush(stdout);
+	return;
+    }
+    incremental_print(unparse);
+    printf("%% compiled in %.3f ms", now_ms() - since);
+    const char *proc = incremental_partial_proc();
+    const block_t *blk = incremental_partial_block();
+    if (proc != NULL) {
+	printf(" (only the body of %s was parsed again)", proc);
+    } else if (blk != NULL) {
+	printf(" (only the block on line %u was parsed again)",
+	       file_location_line(blk->file_loc));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Read the events waiting on the inotify instance fd,
+// noting which of the count files were saved
+static void read_events(int fd, watched_file *files, unsigned int count)
+{
+    _Alignas(struct inotify_event) char buf[4096];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0) {
+	if (errno == EINTR || errno == EAGAIN) {
+	    return;
+	}
+	bail_with_error("Cannot read the changes to the watched files!");
+    }
+    for (char *p = buf; p < buf + n;) {
+	struct inotify_event *ev = (struct inotify_event *) p;
+	for (unsigned int i = 0; i < count; i++) {
+	    // (if events were lost, any of the files may have changed)
+	    if ((ev->mask & IN_Q_OVERFLOW)
+		|| (ev->wd == files[i].wd && (ev->mask & WATCH_EVENTS)
+		    && ev->len > 0
+		    && strcmp(ev->name, files[i].base) == 0)) {
+		files[i].saved = true;
+	    }
+	}
+	p += sizeof(struct inotify_event) + ev->len;
+    }
+}
+
+// Requires: 0 < count and each of files is the name of a readable file
+// Compile each of the files, then compile each one again whenever it is
+// saved (written, or renamed over), until the end of the input on stdin.
+// What the compiler prints for each (the unparsed program, if unparse
+// is true, and the errors) is followed by a line giving the time taken,
+// counting from when the change was noticed; return the exit code
+int watch_files(char *files[], unsigned int count, bool unparse)
+{
+    watched_file *watched = (watched_file *)
+	calloc(count, sizeof(watched_file));
+    if (watched == NULL) {
+	bail_with_error("No space to watch files!");
+    }
+    int fd = inotify_init();
+    if (fd < 0) {
+	bail_with_error("Cannot watch files for changes!");
+    }
+    // (watching starts first, so no change made while compiling is missed)
+    for (unsigned int i = 0; i < count; i++) {
+	watched[i].filename = files[i];
+	watch_directory(fd, &watched[i]);
+    }
+    for (unsigned int i = 0; i < count; i++) {
+	compile(&watched[i], false, unparse, now_ms());
+    }
+    printf("%% watching %u file%s (until the end of the input)\n", count,
+	   (count == 1) ? "" : "s");
+    fflush(stdout);
+
+    struct pollfd fds[2] = { { fd, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+    for (;;) {
+	if (poll(fds, 2, -1) < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    bail_with_error("Cannot wait for changes to the watched files!");
+	}
+	if (fds[0].revents & POLLIN) {
+	    // the changes are dealt with before the end of the input
+	    double since = now_ms();
+	    read_events(fd, watched, count);
+	    for (unsigned int i = 0; i < count; i++) {
+		if (watched[i].saved) {
+		    watched[i].saved = false;
+		    compile(&watched[i], true, unparse, since);
+		}
+	    }
+	} else if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+	    // what is typed is ignored, until the end of the input
+	    char buf[256];
+	    ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+	    if (n <= 0 && !(n < 0 && errno == EINTR)) {
+		break;
+	    }
+	}
+    }
+    close(fd);
+    free(watched);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+#ifndef _WATCH_H
+#define _WATCH_H
+#include <stdbool.h>
+
+// Watching SPL files (with Linux's inotify) and compiling each one again
+// as soon as it is saved, in the same process, so the compiler's state
+// stays warm. The file compiled last is kept compiled incrementally
+// (see incremental.h), so saving it again only compiles what changed;
+// saving another watched file compiles that one (and only that one).
+
+// Requires: 0 < count and each of files is the name of a readable file
+// Compile each of the files, then compile each one again whenever it is
+// saved (written, or renamed over), until the end of the input on stdin.
+// What the compiler prints for each (the unparsed program, if unparse
+// is true, and the errors) is followed by a line giving the time taken,
+// counting from when the change was noticed; return the exit code
+extern int watch_files(char *files[], unsigned int count, bool unparse);
+
+#endif
@@ -0,0 +1,471 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "xref.h"
+#include "ast_walk.h"
+#include "id_use.h"
+#include "utilities.h"
+
+// The start of each file (the offsets are from the start of the file)
+typedef struct {
+    char magic[8];            // XREF_MAGIC
+    uint32_t version;         // XREF_VERSION
+    uint32_t size;            // of the whole file, in bytes
+    uint32_t source;          // offset of the source file's name in strings
+    uint32_t decls;           // offset of the declarations
+    uint32_t num_decls;
+    uint32_t uses;            // offset of the uses
+    uint32_t num_uses;
+    uint32_t strings;         // offset of the names
+    uint32_t strings_size;
+} xref_header;
+
+// A declaration found in the program
+typedef struct {
+    const id_attrs *attrs;
+    const char *name;
+    file_location loc;
+    uint32_t first_use;
+    uint32_t num_uses;
+} found_decl;
+
+// A resolved use found in the program
+typedef struct {
+    const id_attrs *attrs;    // its declaration's attributes
+    file_location loc;
+    unsigned int levels_outward;
+    xref_use_kind kind;
+} found_use;
+
+// A declaration's attributes and its index in the sorted declarations
+typedef struct {
+    const id_attrs *attrs;
+    uint32_t decl;
+} attrs_entry;
+
+// What has been found in the program so far
+typedef struct {
+    found_decl *decls;
+    size_t num_decls;
+    size_t decls_capacity;
+    found_use *uses;
+    size_t num_uses;
+    size_t uses_capacity;
+} found_t;
+
+// Make sure that the array *elems (with *capacity elements of elem_size
+// bytes each) has room for count elements
+static void reserve(void **elems, size_t *capacity, size_t count,
+		    size_t elem_size)
+{
+    if (count <= *capacity) {
+	return;
+    }
+    size_t cap = (*capacity == 0) ? 256 : *capacity;
+    while (cap < count) {
+	cap *= 2;
+    }
+    *elems = realloc(*elems, cap * elem_size);
+    if (*elems == NULL) {
+	bail_with_error("No space for a cross-reference index!");
+    }
+    *capacity = cap;
+}
+
+// Add the declaration of name at loc (if it was resolved, i.e., idu
+// is not NULL, which it is for a duplicate declaration) to found
+static void add_decl(found_t *found, id_use *idu, const char *name,
+		     file_location loc)
+{
+    if (idu == NULL) {
+	return;
+    }
+    reserve((void **) &found->decls, &found->decls_capacity,
+	    found->num_decls + 1, sizeof(found_decl));
+    found_decl *d = &found->decls[found->num_decls++];
+    d->attrs = idu->attrs;
+    d->name = name;
+    d->loc = loc;
+    d->first_use = 0;
+    d->num_uses = 0;
+}
+
+// Add the use at loc (if it was resolved) to found
+static void add_use(found_t *found, id_use *idu, file_location loc,
+		    xref_use_kind kind)
+{
+    if (idu == NULL) {
+	return;
+    }
+    reserve((void **) &found->uses, &found->uses_capacity,
+	    found->num_uses + 1, sizeof(found_use));
+    found_use *u = &found->uses[found->num_uses++];
+    u->attrs = idu->attrs;
+    u->loc = loc;
+    u->levels_outward = idu->levelsOutward;
+    u->kind = kind;
+}
+
+// The walk's pre callback: add the declarations and uses of names
+// directly in node to the found_t that data points to
+static bool find_pre(void *node, AST_type t, void *data)
+{
+    found_t *found = (found_t *) data;
+    switch (t) {
+    case const_def_ast: {
+	ident_t *id = &((const_def_t *) node)->ident;
+	add_decl(found, id->idu, id->name, id->file_loc);
+	break;
+    }
+    case ident_ast: {
+	// only the identifiers declared as variables are visited
+	ident_t *id = (ident_t *) node;
+	add_decl(found, id->idu, id->name, id->file_loc);
+	break;
+    }
+    case proc_decl_ast: {
+	proc_decl_t *pd = (proc_decl_t *) node;
+	add_decl(found, pd->idu, pd->name, pd->file_loc);
+	break;
+    }
+    case stmt_ast: {
+	// (the locations of these statements are those of their names)
+	stmt_t *s = (stmt_t *) node;
+	if (s->stmt_kind == assign_stmt) {
+	    assign_stmt_t *a = &s->data.assign_stmt;
+	    add_use(found, a->idu, a->file_loc, xref_use_assigned);
+	} else if (s->stmt_kind == call_stmt) {
+	    call_stmt_t *c = &s->data.call_stmt;
+	    add_use(found, c->idu, c->file_loc, xref_use_called);
+	} else if (s->stmt_kind == read_stmt) {
+	    read_stmt_t *r = &s->data.read_stmt;
+	    add_use(found, r->idu, r->file_loc, xref_use_read);
+	}
+	break;
+    }
+    case expr_ast: {
+	expr_t *e = (expr_t *) node;
+	if (e->expr_kind == expr_ident) {
+	    ident_t *id = &e->data.ident;
+	    add_use(found, id->idu, id->file_loc, xref_use_value);
+	}
+	break;
+    }
+    default:
+	break;
+    }
+    return true;
+}
+
+// Compare declarations by name, then by location (for qsort)
+static int compare_decls(const void *a, const void *b)
+{
+    const found_decl *x = (const found_decl *) a;
+    const found_decl *y = (const found_decl *) b;
+    int c = strcmp(x->name, y->name);
+    return (c != 0) ? c : (x->loc > y->loc) - (x->loc < y->loc);
+}
+
+// Compare uses by location (for qsort)
+static int compare_uses(const void *a, const void *b)
+{
+    file_location x = ((const found_use *) a)->loc;
+    file_location y = ((const found_use *) b)->loc;
+    return (x > y) - (x < y);
+}
+
+// Compare attrs_entry structs by the addresses of the attributes
+static int compare_attrs(const void *a, const void *b)
+{
+    const id_attrs *x = ((const attrs_entry *) a)->attrs;
+    const id_attrs *y = ((const attrs_entry *) b)->attrs;
+    return (x > y) - (x < y);
+}
+
+// Append the len bytes of s to *strings (of length *size),
+// and return the offset they were put at
+static uint32_t add_string(char **strings, size_t *size, size_t *capacity,
+			   const char *s, size_t len)
+{
+    size_t off = *size;
+    reserve((void **) strings, capacity, off + len, 1);
+    memcpy(*strings + off, s, len);
+    *size = off + len;
+    return (uint32_t) off;
+}
+
+// Requires: prog has been scope checked (so its id_use fields are set)
+// Write the cross-reference index of prog to the file named filename.
+// Names that were not resolved (e.g., as they are not declared,
+// or as checking stopped at the error limit first) are left out.
+void xref_write(const char *filename, block_t *prog)
+{
+    found_t found;
+    memset(&found, 0, sizeof(found));
+    // (so the tables are not NULL, even if the program has no names)
+    reserve((void **) &found.decls, &found.decls_capacity, 1,
+	    sizeof(found_decl));
+    reserve((void **) &found.uses, &found.uses_capacity, 1,
+	    sizeof(found_use));
+    ast_visitor v = { find_pre, NULL, NULL, &found };
+    ast_walk(prog, block_ast, &v);
+    if (found.num_decls + found.num_uses
+	> (UINT32_MAX - sizeof(xref_header)) / sizeof(xref_decl)) {
+	bail_with_error("The cross-reference index is too large to write!");
+    }
+
+    qsort(found.decls, found.num_decls, sizeof(found_decl), compare_decls);
+    qsort(found.uses, found.num_uses, sizeof(found_use), compare_uses);
+    attrs_entry *by_attrs = (attrs_entry *)
+	malloc((found.num_decls + 1) * sizeof(attrs_entry));
+    uint32_t *use_decl = (uint32_t *)
+	malloc((found.num_uses + 1) * sizeof(uint32_t));
+    xref_decl *decls = (xref_decl *)
+	malloc((found.num_decls + 1) * sizeof(xref_decl));
+    xref_use *uses = (xref_use *)
+	malloc((found.num_uses + 1) * sizeof(xref_use));
+    if (by_attrs == NULL || use_decl == NULL || decls == NULL
+	|| uses == NULL) {
+	bail_with_error("No space for a cross-reference index!");
+    }
+    for (size_t i = 0; i < found.num_decls; i++) {
+	by_attrs[i].attrs = found.decls[i].attrs;
+	by_attrs[i].decl = (uint32_t) i;
+    }
+    qsort(by_attrs, found.num_decls, sizeof(attrs_entry), compare_attrs);
+
+    // count the uses of each declaration, then put them (in order)
+    // after those of the declarations before it
+    for (size_t i = 0; i < found.num_uses; i++) {
+	attrs_entry key = { found.uses[i].attrs, 0 };
+	attrs_entry *e = (attrs_entry *)
+	    bsearch(&key, by_attrs, found.num_decls, sizeof(attrs_entry),
+		    compare_attrs);
+	use_decl[i] = (e == NULL) ? UINT32_MAX : e->decl;
+	if (e != NULL) {
+	    found.decls[e->decl].num_uses++;
+	}
+    }
+    uint32_t num_uses = 0;
+    for (size_t d = 0; d < found.num_decls; d++) {
+	found.decls[d].first_use = num_uses;
+	num_uses += found.decls[d].num_uses;
+	found.decls[d].num_uses = 0;
+    }
+    for (size_t i = 0; i < found.num_uses; i++) {
+	if (use_decl[i] == UINT32_MAX) {
+	    continue;
+	}
+	found_decl *d = &found.decls[use_decl[i]];
+	xref_use *u = &uses[d->first_use + d->num_uses++];
+	u->line = file_location_line(found.uses[i].loc);
+	u->column = file_location_column(found.uses[i].loc);
+	u->levels_outward = found.uses[i].levels_outward;
+	u->kind = found.uses[i].kind;
+    }
+
+    // the strings: the source file's name, then the names in order
+    // (each name once, as the declarations of a name are together)
+    char *strings = NULL;
+    size_t strings_size = 0;
+    size_t strings_capacity = 0;
+    const char *source = file_location_filename(prog->file_loc);
+    uint32_t source_off = add_string(&strings, &strings_size,
+				     &strings_capacity, source,
+				     strlen(source) + 1);
+    for (size_t d = 0; d < found.num_decls; d++) {
+	found_decl *fd = &found.decls[d];
+	xref_decl *xd = &decls[d];
+	if (d > 0 && strcmp(fd->name, found.decls[d - 1].name) == 0) {
+	    xd->name = decls[d - 1].name;
+	} else {
+	    xd->name = add_string(&strings, &strings_size, &strings_capacity,
+				  fd->name, strlen(fd->name) + 1);
+	}
+	xd->kind = fd->attrs->kind;
+	xd->offset_count = fd->attrs->offset_count;
+	xd->line = file_location_line(fd->loc);
+	xd->column = file_location_column(fd->loc);
+	xd->first_use = fd->first_use;
+	xd->num_uses = fd->num_uses;
+    }
+
+    xref_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, XREF_MAGIC, sizeof(XREF_MAGIC));
+    hdr.version = XREF_VERSION;
+    hdr.source = source_off;
+    hdr.decls = sizeof(xref_header);
+    hdr.num_decls = (uint32_t) found.num_decls;
+    hdr.uses = hdr.decls + hdr.num_decls * sizeof(xref_decl);
+    hdr.num_uses = num_uses;
+    hdr.strings = hdr.uses + num_uses * sizeof(xref_use);
+    if (strings_size > UINT32_MAX - hdr.strings) {
+	bail_with_error("The cross-reference index is too large to write!");
+    }
+    hdr.strings_size = (uint32_t) strings_size;
+    hdr.size = hdr.strings + hdr.strings_size;
+
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL) {
+	bail_with_error("Cannot open %s for writing!", filename);
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1
+	|| fwrite(decls, sizeof(xref_decl), hdr.num_decls, out)
+	   != hdr.num_decls
+	|| fwrite(uses, sizeof(xref_use), num_uses, out) != num_uses
+	|| fwrite(strings, 1, strings_size, out) != strings_size
+	|| fclose(out) != 0) {
+	bail_with_error("Error writing the cross-reference index to %s!",
+			filename);
+    }
+    free(found.decls);
+    free(found.uses);
+    free(by_attrs);
+    free(use_decl);
+    free(decls);
+    free(uses);
+    free(strings);
+}
+
+// Is the table of count entries of size bytes each at offset off
+// within a file of file_size bytes?
+static bool table_fits(uint32_t off, uint32_t count, size_t size,
+		       uint32_t file_size)
+{
+    return off <= file_size && count <= (file_size - off) / size;
+}
+
+// Requires: filename names a file written by xref_write
+// Map the file named filename into memory and return its index
+xref_index *xref_load(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+	bail_with_error("Cannot open %s!", filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+	bail_with_error("Cannot find the size of %s!", filename);
+    }
+    if ((size_t) st.st_size < sizeof(xref_header)
+	|| st.st_size > UINT32_MAX) {
+	bail_with_error("File %s is not a cross-reference file!", filename);
+    }
+    // (only the pages that are searched are read)
+    char *base = (char *) mmap(NULL, (size_t) st.st_size, PROT_READ,
+			       MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+	bail_with_error("Cannot map %s into memory!", filename);
+    }
+    close(fd);
+
+    const xref_header *hdr = (const xref_header *) base;
+    uint32_t size = (uint32_t) st.st_size;
+    if (memcmp(hdr->magic, XREF_MAGIC, sizeof(XREF_MAGIC)) != 0
+	|| hdr->size != size) {
+	bail_with_error("File %s is not a cross-reference file!", filename);
+    }
+    if (hdr->version != XREF_VERSION) {
+	bail_with_error("Cross-reference file %s was written by another"
+			" version of the compiler!", filename);
+    }
+    if (hdr->decls % sizeof(uint32_t) != 0
+	|| hdr->uses % sizeof(uint32_t) != 0
+	|| !table_fits(hdr->decls, hdr->num_decls, sizeof(xref_decl), size)
+	|| !table_fits(hdr->uses, hdr->num_uses, sizeof(xref_use), size)
+	|| !table_fits(hdr->strings, hdr->strings_size, 1, size)
+	|| hdr->strings_size == 0 || hdr->source >= hdr->strings_size
+	|| base[hdr->strings + hdr->strings_size - 1] != '\0') {
+	bail_with_error("Cross-reference file %s is damaged!", filename);
+    }
+
+    xref_index *x = (xref_index *) malloc(sizeof(xref_index));
+    if (x == NULL) {
+	bail_with_error("No space for a cross-reference index!");
+    }
+    x->strings = base + hdr->strings;
+    x->strings_size = hdr->strings_size;
+    x->source = x->strings + hdr->source;
+    x->decls = (const xref_decl *) (base + hdr->decls);
+    x->num_decls = hdr->num_decls;
+    x->uses = (const xref_use *) (base + hdr->uses);
+    x->num_uses = hdr->num_uses;
+    return x;
+}
+
+// Return the name of the declaration d in x
+const char *xref_name(const xref_index *x, const xref_decl *d)
+{
+    // (the strings end with a null character, so each name does)
+    if (d->name >= x->strings_size) {
+	bail_with_error("A cross-reference file is damaged!");
+    }
+    return x->strings + d->name;
+}
+
+// Return the first of the declarations of name in x,
+// putting their number in *count (0 if name is not declared in x)
+const xref_decl *xref_find(const xref_index *x, const char *name,
+			   unsigned int *count)
+{
+    // find the first declaration whose name is not before name
+    uint32_t lo = 0;
+    uint32_t hi = x->num_decls;
+    while (lo < hi) {
+	uint32_t mid = lo + (hi - lo) / 2;
+	if (strcmp(xref_name(x, &x->decls[mid]), name) < 0) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    uint32_t end = lo;
+    while (end < x->num_decls
+	   && strcmp(xref_name(x, &x->decls[end]), name) == 0) {
+	end++;
+    }
+    *count = end - lo;
+    return &x->decls[lo];
+}
+
+// Return the kind of the declaration d
+id_kind xref_kind(const xref_decl *d)
+{
+    if (d->kind > procedure_idk) {
+	bail_with_error("A cross-reference file is damaged!");
+    }
+    return (id_kind) d->kind;
+}
+
+// Return the uses of the declaration d in x (there are d->num_uses)
+const xref_use *xref_uses(const xref_index *x, const xref_decl *d)
+{
+    if (d->first_use > x->num_uses
+	|| d->num_uses > x->num_uses - d->first_use) {
+	bail_with_error("A cross-reference file is damaged!");
+    }
+    return &x->uses[d->first_use];
+}
+
+// Return a lowercase name for the kind of use k (e.g., "assigned")
+const char *xref_use_kind2str(xref_use_kind k)
+{
+    switch (k) {
+    case xref_use_value:
+	return "used";
+    case xref_use_assigned:
+	return "assigned";
+    case xref_use_read:
+	return "read";
+    case xref_use_called:
+	return "called";
+    }
+    return "used in an unknown way";
+}
@@ -0,0 +1,86 @@
+#ifndef _XREF_H
+#define _XREF_H
+#include <stdint.h>
+#include "ast.h"
+#include "id_attrs.h"
+
+// A cross-reference index of a scope checked program: each of its
+// declarations (name, kind, location, and offset count) with all of the
+// uses of the name that were resolved to it, and how many levels outward
+// from each use the declaration is.
+//
+// The file holds a header, then the declarations (sorted by name, and
+// declarations of the same name by location), then the uses (those of
+// each declaration together, in source order), then the names (and the
+// source file's name), each followed by a null character. Each field is
+// a uint32_t, so loading only maps the file, and looking up a name is a
+// binary search in the mapped declarations.
+
+// Identifies files written by xref_write
+#define XREF_MAGIC "SPL-XRF"
+
+// Incremented whenever the file format changes
+#define XREF_VERSION 1
+
+// how a name is used
+typedef enum { xref_use_value, xref_use_assigned, xref_use_read,
+	       xref_use_called } xref_use_kind;
+
+// a declaration in the index
+typedef struct {
+    uint32_t name;          // offset of its name in the index's strings
+    uint32_t kind;          // its id_kind
+    uint32_t offset_count;  // from its id_attrs
+    uint32_t line;          // where its name is
+    uint32_t column;
+    uint32_t first_use;     // its uses are uses[first_use] onward
+    uint32_t num_uses;
+} xref_decl;
+
+// a use of a declared name
+typedef struct {
+    uint32_t line;
+    uint32_t column;
+    uint32_t levels_outward;
+    uint32_t kind;          // its xref_use_kind
+} xref_use;
+
+// an index loaded by xref_load (whose tables are in the mapped file)
+typedef struct {
+    const char *source;     // the name of the program's source file
+    const xref_decl *decls;
+    uint32_t num_decls;
+    const xref_use *uses;
+    uint32_t num_uses;
+    const char *strings;
+    uint32_t strings_size;
+} xref_index;
+
+// Requires: prog has been scope checked (so its id_use fields are set)
+// Write the cross-reference index of prog to the file named filename.
+// Names that were not resolved (e.g., as they are not declared,
+// or as checking stopped at the error limit first) are left out.
+extern void xref_write(const char *filename, block_t *prog);
+
+// Requires: filename names a file written by xref_write
+// Map the file named filename into memory and return its index
+extern xref_index *xref_load(const char *filename);
+
+// Return the first of the declarations of name in x,
+// putting their number in *count (0 if name is not declared in x)
+extern const xref_decl *xref_find(const xref_index *x, const char *name,
+				  unsigned int *count);
+
+// Return the name of the declaration d in x
+extern const char *xref_name(const xref_index *x, const xref_decl *d);
+
+// Return the kind of the declaration d
+extern id_kind xref_kind(const xref_decl *d);
+
+// Return the uses of the declaration d in x (there are d->num_uses)
+extern const xref_use *xref_uses(const xref_index *x, const xref_decl *d);
+
+// Return a lowercase name for the kind of use k (e.g., "assigned")
+extern const char *xref_use_kind2str(xref_use_kind k);
+
+#endif